@@ -10,10 +10,18 @@
  */
 
 #include "log.hpp"
+#include "log_binary.hpp"
+#include "log_compress.hpp"
+#include "log_crash.hpp"
+#include "log_pattern.hpp"
+#include "log_reader.hpp"
+#include "log_sink.hpp"
 
 #ifdef _WIN32
 
 #include <Windows.h>
+#include <io.h>
+#include <fcntl.h>
 
 inline DWORD gettid() { return GetCurrentThreadId(); }
 
@@ -29,150 +37,4043 @@ int WStrToStr(const wchar_t* _SrcBuf, char* _DstBuf)
 	return WideCharToMultiByte(CP_ACP, 0, _SrcBuf, -1, _DstBuf, nLen, NULL, NULL);
 }
 
-#elif __linux__
+#else
 
 #include <unistd.h>
-/* 待实现 */
+#include <fcntl.h>
+#include <syslog.h>
+#include <poll.h>
+#include <climits>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#ifdef __linux__
+#include <sched.h>
+#endif // __linux__
 
-#else
+#if defined(__linux__) && defined(__GLIBC__) && (__GLIBC__ < 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 30))
+#include <sys/syscall.h>
+/* glibc 2.30之前没有gettid */
+static inline pid_t gettid() { return static_cast<pid_t>(syscall(SYS_gettid)); }
+#elif defined(__APPLE__)
+static inline uint64_t gettid()
+{
+	uint64_t nThreadId = 0;
+	pthread_threadid_np(nullptr, &nThreadId);
+	return nThreadId;
+}
+#endif
 
+/* 按当前区域设置转换，_DstBuf的容量须不小于源字符串的字节数加一 */
 int StrToWStr(const char* _SrcBuf, wchar_t* _DstBuf)
 {
-	size_t size = strlen(_SrcBuf);
-	mbstowcs(_DstBuf, _SrcBuf, size);
-	_DstBuf[size] = '\0'
-	return size;
+	size_t size = mbstowcs(_DstBuf, _SrcBuf, strlen(_SrcBuf) + 1);
+	if (size == static_cast<size_t>(-1))
+		return 0;
+	return static_cast<int>(size);
 }
 
+/* 按当前区域设置转换，_DstBuf的容量须不小于源字符串的宽字符数乘以MB_CUR_MAX再加一 */
 int WStrToStr(const wchar_t* _SrcBuf, char* _DstBuf)
 {
-	size_t size = strlen(_SrcBuf);
-	wcstombs(_DstBuf, _SrcBuf, size);
-	_DstBuf[size] = '\0'
-	return size;
+	size_t size = wcstombs(_DstBuf, _SrcBuf, wcslen(_SrcBuf) * MB_CUR_MAX + 1);
+	if (size == static_cast<size_t>(-1))
+		return 0;
+	return static_cast<int>(size);
 }
 
 #endif
 
-std::shared_ptr<Log>    Log::m_Log              { nullptr };
-std::wstring            Log::m_wstrLogBuffer	{ 0 };
-std::wstring            Log::m_wstrLogFile      { L"./Log.txt" };
-LOGLEVEL                Log::m_LogLevel         { LOG_LEVEL_NONE };
-LOGTARGET               Log::m_LogTarget        { LOG_TARGET_NONE };
-std::once_flag          Log::m_ResourceFlag     { std::once_flag() };
-std::shared_mutex       Log::m_LogMutex         { std::shared_mutex() };
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define LOG_HAS_TSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define LOG_HAS_TSC
+#endif
 
-void Log::Init(LOGLEVEL _LogLevel, LOGTARGET _LogTarget, std::wstring _Path)
+/* 转换调用点名称，结果常驻内存 */
+static const wchar_t* widenSiteName(const char* _Name)
 {
-	if (!m_Log)
-		m_Log.reset(new Log());
-	
-	setLogLevel(_LogLevel);
-	setLogTarget(_LogTarget);
-	setLogFile(_Path);
-	// 支持中文字符
-	setlocale(LC_ALL, "chs");
+	// 宽字符个数不超过多字节字符串的字节数
+	const size_t nLength = strlen(_Name);
+	wchar_t* wszName = new wchar_t[nLength + 1]();
+	if (StrToWStr(_Name, wszName) <= 0 && nLength)
+	{
+		// 当前区域设置无法转换时按字节原样保留
+		for (size_t i = 0; i < nLength; ++i)
+			wszName[i] = static_cast<unsigned char>(_Name[i]);
+	}
+	return wszName;
 }
 
-void Log::writeLog
-(
-	const LOGLEVEL _LogLevel,	// Log等级
-	const wchar_t* _FileName,	// 函数所在文件名
-	const wchar_t* _Function,	// 函数名
-	const uint   _LineNumber,	// 行号
-	const char*      _Format,	// 格式化
-	...							// 参数列表
-)
+/* 每个线程缓存的线程号与名称 */
+struct LogThreadInfo
 {
-	// 写锁
-	std::scoped_lock<std::shared_mutex> writeLock(m_LogMutex);
+	uint                 m_nThreadId   { 0 };
+	uint                 m_nGeneration { ~0u };      // 与LogIdCache的代数不同时重新获取线程号
+	const LogThreadName* m_pName       { nullptr };
+};
 
-	if (_LogLevel > m_LogLevel)
-		return;
-
-	// 清空之前的日志
-	if (m_wstrLogBuffer.size())
-		m_wstrLogBuffer.clear();
-
-	m_wstrLogBuffer += std::wstring(L"\n");
-	m_wstrLogBuffer += std::wstring(60, L'*');
-	m_wstrLogBuffer += std::wstring(L" ");
-	m_wstrLogBuffer += std::wstring(LOGLEVEL_WSTRING.at(_LogLevel));
-	m_wstrLogBuffer += std::wstring(L" ");
-	m_wstrLogBuffer += std::wstring(60, L'*');
-	m_wstrLogBuffer += std::wstring(L"\n");
-
-	// 获取日期和时间
-	char timeBuffer[20];
-	getCurrentLocalTime(timeBuffer);
-	wchar_t wTimeBuffer[strlen(timeBuffer)];
-	StrToWStr(timeBuffer, wTimeBuffer);
-	m_wstrLogBuffer += std::wstring(wTimeBuffer);
-
-	// [进程号] [线程号] [文件名] [函数名:行号]
-	wchar_t logInfo[100];
-	swprintf(logInfo, 100,
-             L" [PID : %-5d] [TID : %-5d] [%-ls] [%-ls : %-4d] ",
-             getpid(),
-             gettid(),
-             _FileName,
-             _Function,
-             _LineNumber);
-	m_wstrLogBuffer += std::wstring(logInfo);
-
-	// 日志正文
-	size_t nLen = sizeof _Format;
-	wchar_t Format[nLen];
-	StrToWStr(_Format, Format);
-	wchar_t logInfo2[256];
-	va_list args;
-	va_start(args, Format);
-	vswprintf(logInfo2, 256, Format, args);
-	va_end(args);
-	m_wstrLogBuffer += std::wstring(logInfo2);
+/**
+ * 进程号、线程号与线程名称的缓存，每个线程只在首次写日志时调用一次gettid
+ *
+ * fork后子进程中的进程号与调用fork的线程的线程号均已改变，atfork处理函数递增代数使缓存失效
+ */
+class LogIdCache
+{
+public:
+	static uint processId() noexcept
+	{
+		uint nPid = m_nPid.load(std::memory_order_relaxed);
+		if (!nPid)
+		{
+			nPid = static_cast<uint>(getpid());
+			m_nPid.store(nPid, std::memory_order_relaxed);
+		}
+		return nPid;
+	}
+
+	static uint threadId() noexcept
+	{
+		const uint nGeneration = m_nGeneration.load(std::memory_order_relaxed);
+		if (m_Thread.m_nGeneration != nGeneration)
+		{
+			m_Thread.m_nThreadId = static_cast<uint>(gettid());
+			m_Thread.m_nGeneration = nGeneration;
+		}
+		return m_Thread.m_nThreadId;
+	}
+
+	static const LogThreadName* threadName() noexcept { return m_Thread.m_pName; }
+
+	/* 登记名称，同名的线程共用一份 */
+	static void setThreadName(const std::string& _Name)
+	{
+		if (_Name.empty())
+		{
+			m_Thread.m_pName = nullptr;
+			return;
+		}
+		std::scoped_lock<std::mutex> lock(m_NameMutex);
+		LogThreadName*& pName = m_Names[_Name];
+		if (!pName)
+		{
+			pName = new LogThreadName;
+			pName->m_strName = _Name;
+			LogAppendWide(pName->m_wstrName, _Name.data(), _Name.size());
+		}
+		m_Thread.m_pName = pName;
+	}
+
+private:
+	static void onFork() noexcept
+	{
+		m_nPid.store(0, std::memory_order_relaxed);
+		m_nGeneration.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	static int registerFork() noexcept
+	{
+#ifndef _WIN32
+		return pthread_atfork(nullptr, nullptr, onFork);
+#else
+		return 0;
+#endif // _WIN32
+	}
 
-	m_wstrLogBuffer += std::wstring(L"\n");
-	m_wstrLogBuffer += std::wstring(60, L'*');
-	m_wstrLogBuffer += std::wstring(L" ");
-	m_wstrLogBuffer += std::wstring(LOGLEVEL_WSTRING.at(_LogLevel));
-	m_wstrLogBuffer += std::wstring(L" ");
-	m_wstrLogBuffer += std::wstring(60, L'*');
-	m_wstrLogBuffer += std::wstring(L"\n");
+	static inline std::atomic<uint> m_nPid        { 0 };
+	static inline std::atomic<uint> m_nGeneration { 0 };
+	static inline const int         m_nAtFork     { registerFork() };
+	static inline thread_local LogThreadInfo m_Thread;
+	static inline std::mutex        m_NameMutex;
+	static inline std::unordered_map<std::string, LogThreadName*> m_Names;   // 登记的名称，不释放
+};
 
-	outputToTarget();
+void Log::setThreadName(const std::string& _Name)
+{
+	LogIdCache::setThreadName(_Name);
 }
 
-bool Log::getLogFromFile(std::vector<std::wstring>& _LogTable)
+std::string Log::getThreadName()
 {
-	// 读锁
-	std::shared_lock<std::shared_mutex> readLock(m_LogMutex);
-	std::wifstream wFileInput;
-	wFileInput.open(m_wstrLogFile.c_str());
-	int ret = 0;
-	if (!wFileInput.is_open())
+	const LogThreadName* pName = LogIdCache::threadName();
+	return pName ? pName->m_strName : std::string();
+}
+
+/* 回溯缓冲的环形存储 */
+struct LogBacktraceRing
+{
+	std::vector<LogRecord> m_Records;
+	size_t                 m_nNext  { 0 };   // 下一条记录的位置
+	size_t                 m_nCount { 0 };   // 保存的条数
+};
+
+/* 每个线程的回溯缓冲，保存超出日志等级的最近若干条记录，记录的缓冲区在覆盖与输出时复用 */
+class LogBacktrace
+{
+public:
+	/* 下一条记录的槽位，容量变化时丢弃已保存的记录 */
+	static LogRecord& next(size_t _Capacity)
+	{
+		LogBacktraceRing& ring = m_Ring;
+		if (ring.m_Records.size() != _Capacity)
+		{
+			ring.m_Records.clear();
+			ring.m_Records.resize(_Capacity);
+			ring.m_nNext = 0;
+			ring.m_nCount = 0;
+		}
+		LogRecord& record = ring.m_Records[ring.m_nNext];
+		ring.m_nNext = (ring.m_nNext + 1) % _Capacity;
+		ring.m_nCount = std::min(ring.m_nCount + 1, _Capacity);
+		return record;
+	}
+
+	/* 按记录顺序取出保存的记录并清空 */
+	template<typename Fn>
+	static void drain(Fn&& _Output)
+	{
+		LogBacktraceRing& ring = m_Ring;
+		const size_t nCapacity = ring.m_Records.size();
+		const size_t nCount = ring.m_nCount;
+		ring.m_nCount = 0;
+		for (size_t i = 0; i < nCount; ++i)
+			_Output(ring.m_Records[(ring.m_nNext + nCapacity - nCount + i) % nCapacity]);
+	}
+
+	static bool empty() noexcept { return !m_Ring.m_nCount; }
+	static void clear() noexcept { m_Ring.m_nCount = 0; }
+
+private:
+	static inline thread_local LogBacktraceRing m_Ring;
+};
+
+/* 登记的调用点与Log::setSiteLimit保存的规则，未采样或限速的日志由此汇总输出 */
+class LogSiteRegistry
+{
+public:
+	/* 登记调用点并应用匹配的规则 */
+	void add(LogSite* _Site)
+	{
+		std::scoped_lock<std::mutex> lock(m_Mutex);
+		m_Sites.push_back(_Site);
+		for (const auto& rule : m_Rules)
+		{
+			if (matches(rule, _Site))
+				apply(rule.m_Limit, _Site);
+		}
+	}
+	/* 保存规则并应用到已登记的调用点，文件与行号相同的旧规则被替换 */
+	void setLimit(const char* _File, uint _Line, const LogSiteLimit& _Limit)
+	{
+		std::scoped_lock<std::mutex> lock(m_Mutex);
+		Rule rule { _File ? _File : "", _Line, _Limit };
+		m_Rules.erase(std::remove_if(m_Rules.begin(), m_Rules.end(), [&rule](const Rule& _Rule)
+		{
+			return _Rule.m_strFile == rule.m_strFile && _Rule.m_nLine == rule.m_nLine;
+		}), m_Rules.end());
+		for (const LogSite* site : m_Sites)
+		{
+			if (matches(rule, site))
+				apply(rule.m_Limit, site);
+		}
+		m_Rules.push_back(std::move(rule));
+	}
+	/* 记录一条未输出的日志 */
+	void suppress() noexcept { m_nSuppressed.fetch_add(1, std::memory_order_relaxed); }
+	/* 未输出的日志总数 */
+	uint64_t suppressedCount() const noexcept { return m_nSuppressed.load(std::memory_order_relaxed); }
+	/* 距上次汇总超过汇总间隔时汇总，多个线程同时到期时只有一个执行，_Output同report */
+	template<typename Fn>
+	void reportIfDue(uint64_t _Now, Fn&& _Output)
+	{
+		uint64_t nLast = m_nLastReport.load(std::memory_order_relaxed);
+		if ((nLast && _Now - nLast < REPORT_INTERVAL_NS)
+			|| !m_nLastReport.compare_exchange_strong(nLast, _Now, std::memory_order_relaxed))
+			return;
+		// 首次调用只开始计时
+		if (nLast)
+			report(_Output);
+	}
+	/**
+	 * @brief 为每个有未输出日志的调用点输出一条汇总
+	 *
+	 * 汇总以该调用点的位置与最近一次未输出的等级输出，不再经过采样与限速
+	 *
+	 * @param _Output    以(调用点, 等级, 未输出的条数)调用，输出一条汇总
+	 */
+	template<typename Fn>
+	void report(Fn&& _Output)
+	{
+		std::vector<std::pair<const LogSite*, uint64_t>> pending;
+		{
+			std::scoped_lock<std::mutex> lock(m_Mutex);
+			for (const LogSite* site : m_Sites)
+			{
+				if (!site->m_nSuppressed.load(std::memory_order_relaxed))
+					continue;
+				const uint64_t nCount = site->m_nSuppressed.exchange(0, std::memory_order_relaxed);
+				if (nCount)
+					pending.emplace_back(site, nCount);
+			}
+		}
+		for (const auto& [site, nCount] : pending)
+			_Output(*site, site->m_SuppressedLevel.load(std::memory_order_relaxed), nCount);
+	}
+
+private:
+	/* 汇总间隔 */
+	static constexpr uint64_t REPORT_INTERVAL_NS { 1000000000 };
+
+	struct Rule
+	{
+		std::string  m_strFile;   // 文件名后缀，为空表示所有文件
+		uint         m_nLine;     // 行号，0表示所有行
+		LogSiteLimit m_Limit;
+	};
+
+	static bool matches(const Rule& _Rule, const LogSite* _Site) noexcept
+	{
+		if (_Rule.m_nLine && _Rule.m_nLine != _Site->m_nLine)
+			return false;
+		const size_t nFile = strlen(_Site->m_szFile);
+		return _Rule.m_strFile.size() <= nFile
+			&& !memcmp(_Site->m_szFile + nFile - _Rule.m_strFile.size(), _Rule.m_strFile.data(), _Rule.m_strFile.size());
+	}
+	static void apply(const LogSiteLimit& _Limit, const LogSite* _Site) noexcept
+	{
+		_Site->m_nBurst.store(_Limit.m_nBurst, std::memory_order_relaxed);
+		_Site->m_nRatePerSec.store(_Limit.m_nRatePerSec, std::memory_order_relaxed);
+		_Site->m_nSampleEvery.store(_Limit.m_nSampleEvery, std::memory_order_relaxed);
+	}
+
+	std::mutex                  m_Mutex;
+	std::vector<const LogSite*> m_Sites;
+	std::vector<Rule>           m_Rules;
+	std::atomic<uint64_t>       m_nSuppressed { 0 };
+	std::atomic<uint64_t>       m_nLastReport { 0 };
+};
+
+/* 汇总日志的正文，参数为未输出的条数；为ASCII，任何区域设置与编码下均可转换 */
+static constexpr char SUPPRESSED_FORMAT[] = "%llu records suppressed by sampling or rate limit since the last summary";
+
+/* 调用点可能在任何静态对象析构之后执行，注册表不释放 */
+static LogSiteRegistry& siteRegistry()
+{
+	static LogSiteRegistry* registry = new LogSiteRegistry;
+	return *registry;
+}
+
+LogSite::LogSite(const char* _File, const char* _Function, uint _Line, const char* _Format, uint _SampleEvery, uint _RatePerSec)
+	: m_szFile(_File)
+	, m_szFunction(_Function)
+	, m_nLine(_Line)
+	, m_szFormat(_Format)
+	, m_wszFile(widenSiteName(_File))
+	, m_wszFunction(widenSiteName(_Function))
+	, m_nSampleEvery(_SampleEvery)
+	, m_nRatePerSec(_RatePerSec)
+{
+	siteRegistry().add(this);
+}
+
+/* 单个线程的日志队列：生产者为所属线程，消费者为后台写线程 */
+class LogRingBuffer
+{
+public:
+	/**
+	 * @param _Capacity    容量
+	 * @param _Node        所属线程创建队列时所在的NUMA节点
+	 */
+	LogRingBuffer(size_t _Capacity, int _Node) : m_nNode(_Node)
+	{
+		// 容量取不小于_Capacity的2的幂
+		size_t capacity = 2;
+		while (capacity < _Capacity)
+			capacity <<= 1;
+		m_nMask = capacity - 1;
+		m_Slots.reset(new Slot[capacity]);
+		for (size_t i = 0; i < capacity; ++i)
+			m_Slots[i].m_nSequence.store(i, std::memory_order_relaxed);
+	}
+
+	/**
+	 * @brief 生产者入队
+	 * 
+	 * @param _Timestamp    入队时间
+	 * @param _Record       日志，入队后与槽位中的空闲缓冲区交换
+	 * @return false        队列已满
+	 */
+	bool push(uint64_t _Timestamp, LogRecord& _Record)
+	{
+		uint64_t pos = m_nHead.load(std::memory_order_relaxed);
+		Slot& slot = m_Slots[pos & m_nMask];
+		if (slot.m_nSequence.load(std::memory_order_acquire) != pos)
+			return false;
+		slot.m_nTimestamp.store(_Timestamp, std::memory_order_relaxed);
+		std::swap(slot.m_Record, _Record);
+		slot.m_nSequence.store(pos + 1, std::memory_order_release);
+		m_nHead.store(pos + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	/**
+	 * @brief 出队，后台线程取日志与生产者丢弃最旧日志时都会调用
+	 * 
+	 * @param _Record     OUT 与槽位中的日志交换，为nullptr时直接丢弃
+	 * @param _Level      OUT 日志的等级，可为nullptr
+	 * @return false       队列为空
+	 */
+	bool pop(LogRecord* _Record, LOGLEVEL* _Level = nullptr)
+	{
+		uint64_t pos = m_nTail.load(std::memory_order_relaxed);
+		while (true)
+		{
+			Slot& slot = m_Slots[pos & m_nMask];
+			uint64_t seq = slot.m_nSequence.load(std::memory_order_acquire);
+			int64_t diff = static_cast<int64_t>(seq - (pos + 1));
+			if (diff < 0)
+				return false;
+			if (diff > 0)
+			{
+				// 槽位已被另一方取走
+				pos = m_nTail.load(std::memory_order_relaxed);
+				continue;
+			}
+			if (m_nTail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+			{
+				if (_Level)
+					*_Level = slot.m_Record.m_Level;
+				if (_Record)
+					std::swap(*_Record, slot.m_Record);
+				slot.m_nSequence.store(pos + m_nMask + 1, std::memory_order_release);
+				return true;
+			}
+		}
+	}
+
+	/**
+	 * @brief 查看队首日志的时间戳
+	 * 
+	 * @return false    队列为空
+	 */
+	bool peek(uint64_t& _Timestamp) const
+	{
+		uint64_t pos = m_nTail.load(std::memory_order_relaxed);
+		const Slot& slot = m_Slots[pos & m_nMask];
+		if (slot.m_nSequence.load(std::memory_order_acquire) != pos + 1)
+			return false;
+		_Timestamp = slot.m_nTimestamp.load(std::memory_order_relaxed);
+		return true;
+	}
+
+	/* 队列中的日志数，由生产者调用 */
+	uint64_t size() const noexcept
+	{
+		return m_nHead.load(std::memory_order_relaxed) - m_nTail.load(std::memory_order_relaxed);
+	}
+
+	/* 所属线程退出 */
+	void close() noexcept { m_bClosed.store(true, std::memory_order_release); }
+	bool isClosed() const noexcept { return m_bClosed.load(std::memory_order_acquire); }
+
+	int node() const noexcept { return m_nNode; }
+	/* 负责输出该队列的写线程，由m_RingMutex保护修改 */
+	size_t writer() const noexcept { return m_nWriter.load(std::memory_order_relaxed); }
+	void setWriter(size_t _Writer) noexcept { m_nWriter.store(_Writer, std::memory_order_relaxed); }
+
+private:
+	struct Slot
+	{
+		std::atomic<uint64_t> m_nSequence;    // 槽位序号，标记槽位可写或可读
+		std::atomic<uint64_t> m_nTimestamp;   // 入队时间
+		LogRecord             m_Record;       // 日志
+	};
+
+	alignas(64) std::atomic<uint64_t> m_nHead { 0 };   // 生产者写入位置
+	alignas(64) std::atomic<uint64_t> m_nTail { 0 };   // 消费者读取位置
+	alignas(64) std::atomic<bool> m_bClosed { false };
+	std::atomic<size_t>     m_nWriter { 0 };
+	const int               m_nNode;
+	size_t                  m_nMask;
+	std::unique_ptr<Slot[]> m_Slots;
+};
+
+/* 线程退出时标记其队列，由后台线程输出剩余日志后回收 */
+struct LogRingHolder
+{
+	std::shared_ptr<LogRingBuffer> m_pRing;
+	~LogRingHolder() { if (m_pRing) m_pRing->close(); }
+};
+
+/* NUMA节点与CPU的对应关系，首次使用时读取，进程退出前不释放 */
+class LogNuma
+{
+public:
+	struct Node
+	{
+		int              m_nId;     // 节点编号
+		std::vector<int> m_Cpus;    // 节点上的CPU
+	};
+
+	/* 各节点，无法读取时为包含所有CPU的节点0 */
+	static const std::vector<Node>& nodes() { return topology().m_Nodes; }
+
+	/* CPU所在的节点，未知的CPU为-1 */
+	static int nodeOf(int _Cpu)
+	{
+		const std::vector<int>& cpuNodes = topology().m_CpuNodes;
+		return _Cpu >= 0 && static_cast<size_t>(_Cpu) < cpuNodes.size() ? cpuNodes[_Cpu] : -1;
+	}
+
+	/* 当前线程所在的节点，无法获取时为0 */
+	static int currentNode()
+	{
+#ifdef __linux__
+		if (nodes().size() > 1)
+			return std::max(nodeOf(sched_getcpu()), 0);
+#endif // __linux__
+		return 0;
+	}
+
+	/* 将当前线程绑定到_Cpus，为空时不绑定 */
+	static bool bindCurrentThread(const std::vector<int>& _Cpus)
+	{
+		if (_Cpus.empty())
+			return true;
+#if defined(__linux__)
+		cpu_set_t cpuSet;
+		CPU_ZERO(&cpuSet);
+		for (int cpu : _Cpus)
+		{
+			if (cpu >= 0 && cpu < CPU_SETSIZE)
+				CPU_SET(cpu, &cpuSet);
+		}
+		return !pthread_setaffinity_np(pthread_self(), sizeof cpuSet, &cpuSet);
+#elif defined(_WIN32)
+		DWORD_PTR mask = 0;
+		for (int cpu : _Cpus)
+		{
+			if (cpu >= 0 && cpu < static_cast<int>(sizeof(DWORD_PTR) * CHAR_BIT))
+				mask |= static_cast<DWORD_PTR>(1) << cpu;
+		}
+		return mask && SetThreadAffinityMask(GetCurrentThread(), mask);
+#else
 		return false;
-	while (wFileInput.good())
+#endif
+	}
+
+private:
+	struct Topology
+	{
+		std::vector<Node> m_Nodes;
+		std::vector<int>  m_CpuNodes;   // 下标为CPU编号
+	};
+
+	static const Topology& topology()
 	{
-		std::wstring line;
-		wFileInput >> line;
-		_LogTable.emplace_back(line);
+		static const Topology* pTopology = new Topology(load());
+		return *pTopology;
 	}
-	wFileInput.close();
-	return true;
+
+	/* 解析"0-3,8-11"形式的编号列表 */
+	static std::vector<int> parseList(const std::string& _List)
+	{
+		std::vector<int> result;
+		const char* p = _List.c_str();
+		while (*p)
+		{
+			char* end = nullptr;
+			const long first = strtol(p, &end, 10);
+			if (end == p)
+				break;
+			long last = first;
+			p = end;
+			if (*p == '-')
+			{
+				last = strtol(p + 1, &end, 10);
+				p = end;
+			}
+			for (long i = first; i <= last && i < 65536; ++i)
+				result.push_back(static_cast<int>(i));
+			if (*p != ',')
+				break;
+			++p;
+		}
+		return result;
+	}
+
+	static Topology load()
+	{
+		Topology topology;
+#ifdef __linux__
+		const std::string strRoot = "/sys/devices/system/node/";
+		std::string strLine;
+		std::ifstream online(strRoot + "online");
+		if (std::getline(online, strLine))
+		{
+			for (int nId : parseList(strLine))
+			{
+				std::ifstream cpuList(strRoot + "node" + std::to_string(nId) + "/cpulist");
+				std::string strCpus;
+				std::getline(cpuList, strCpus);
+				Node node { nId, parseList(strCpus) };
+				if (!node.m_Cpus.empty())
+					topology.m_Nodes.push_back(std::move(node));
+			}
+		}
+#endif // __linux__
+		if (topology.m_Nodes.empty())
+		{
+			Node node { 0, {} };
+			const unsigned nCpus = std::max(std::thread::hardware_concurrency(), 1u);
+			for (unsigned i = 0; i < nCpus; ++i)
+				node.m_Cpus.push_back(static_cast<int>(i));
+			topology.m_Nodes.push_back(std::move(node));
+		}
+		for (const Node& node : topology.m_Nodes)
+		{
+			for (int cpu : node.m_Cpus)
+			{
+				if (static_cast<size_t>(cpu) >= topology.m_CpuNodes.size())
+					topology.m_CpuNodes.resize(cpu + 1, -1);
+				topology.m_CpuNodes[cpu] = node.m_nId;
+			}
+		}
+		return topology;
+	}
+};
+
+/* 一个后台写线程，m_bSleeping以外的成员由m_QueueMutex保护 */
+struct alignas(64) LogWriterSlot
+{
+	std::thread             m_Thread;
+	std::condition_variable m_Cond;                  // 唤醒该线程
+	std::atomic<bool>       m_bSleeping  { false };  // 是否休眠，写日志的线程据此决定是否唤醒
+	bool                    m_bWakeup    { false };  // 唤醒标志
+	uint64_t                m_nFlushDone { 0 };      // 已完成的Flush请求序号
+	int                     m_nNode      { -1 };     // 负责的NUMA节点，-1表示所有节点，同时由m_RingMutex保护
+	std::vector<int>        m_Cpus;                  // 绑定的CPU
+};
+
+/* 后台写线程组，槽位固定，写日志的线程可随时按队列记录的下标访问 */
+struct LogWriters
+{
+	static constexpr size_t MAX_WRITERS { 64 };
+
+	/* 节点对应的写线程，没有对应的写线程时由第一个负责，须持有m_RingMutex */
+	size_t writerOf(int _Node) const noexcept
+	{
+		const size_t nCount = m_nCount.load(std::memory_order_relaxed);
+		for (size_t i = 0; i < nCount; ++i)
+		{
+			if (m_Slots[i].m_nNode == _Node)
+				return i;
+		}
+		return 0;
+	}
+
+	LogWriterSlot       m_Slots[MAX_WRITERS];
+	std::atomic<size_t> m_nCount   { 0 };        // 运行中的写线程数
+	std::atomic<bool>   m_bRestart { false };    // 正在按新设置重启写线程
+};
+
+/* 自旋等待时提示CPU，x86下为pause指令 */
+static inline void cpuRelax() noexcept
+{
+#ifdef LOG_HAS_TSC
+	_mm_pause();
+#else
+	std::this_thread::yield();
+#endif // LOG_HAS_TSC
 }
 
-void Log::outputToTarget()
+/* 宽字符日志按当前区域设置转为多字节字符串追加到_Out，无法表示的字符以'?'代替 */
+static void appendMultiByte(std::string& _Out, const std::wstring& _Log)
 {
-	LOGTARGET target = getLogTarget();
-	if (target & LOG_TARGET_CONSOLE)
+	size_t nOld = _Out.size();
+	size_t nMax = _Log.size() * MB_CUR_MAX;
+	_Out.resize(nOld + nMax);
+	const wchar_t* src = _Log.c_str();
+	std::mbstate_t state {};
+	size_t nLen = wcsrtombs(&_Out[nOld], &src, nMax, &state);
+	if (nLen == static_cast<size_t>(-1))
 	{
-		std::wcout << m_wstrLogBuffer;
+		// 含当前区域无法表示的字符，逐个转换
+		nLen = 0;
+		state = std::mbstate_t {};
+		for (wchar_t wc : _Log)
+		{
+			size_t n = wcrtomb(&_Out[nOld + nLen], wc, &state);
+			if (n == static_cast<size_t>(-1))
+			{
+				_Out[nOld + nLen] = '?';
+				n = 1;
+				state = std::mbstate_t {};
+			}
+			nLen += n;
+		}
 	}
-	if (target & LOG_TARGET_FILE)
+	_Out.resize(nOld + nLen);
+}
+
+/* 日志文件的计数器 */
+struct LogFileCounters
+{
+	std::atomic<uint64_t> m_nBytes     { 0 };   // 写入的字节数
+	std::atomic<uint64_t> m_nRotations { 0 };   // 滚动次数
+	std::array<std::atomic<uint64_t>, LOG_STATS_FLUSH_BUCKETS> m_nFlushLatency {};   // 写入耗时分布，区间同LogStats
+
+	/* 记录一次写入的耗时 */
+	void addFlush(std::chrono::steady_clock::duration _Elapsed) noexcept
+	{
+		uint64_t nMicro = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(_Elapsed).count());
+		size_t nBucket = 0;
+		while (nMicro && nBucket + 1 < LOG_STATS_FLUSH_BUCKETS)
+		{
+			nMicro >>= 1;
+			++nBucket;
+		}
+		m_nFlushLatency[nBucket].fetch_add(1, std::memory_order_relaxed);
+	}
+};
+
+/* 运行统计的计数器，均以relaxed方式更新 */
+struct LogCounters
+{
+	std::array<std::atomic<uint64_t>, 5> m_nWritten {};
+	std::array<std::atomic<uint64_t>, 5> m_nDropped {};
+	std::atomic<uint64_t> m_nQueueHighWater { 0 };
+	std::atomic<uint64_t> m_nLockWaits      { 0 };
+	std::atomic<uint64_t> m_nLockWaitNs     { 0 };
+	LogFileCounters       m_File;
+	LogFileCounters       m_Binary;
+};
+
+/* 按日志等级计数 */
+static inline void countLevel(std::array<std::atomic<uint64_t>, 5>& _Counts, LOGLEVEL _LogLevel) noexcept
+{
+	if (static_cast<size_t>(_LogLevel) < _Counts.size())
+		_Counts[static_cast<size_t>(_LogLevel)].fetch_add(1, std::memory_order_relaxed);
+}
+
+/* 崩溃保护缓冲区，格式见log_crash.hpp，只由LogFile在写锁内写入，信号处理函数只读取 */
+class LogCrashBuffer
+{
+public:
+	LogCrashBuffer() = default;
+	~LogCrashBuffer() { close(); }
+	LogCrashBuffer(const LogCrashBuffer&) = delete;
+	LogCrashBuffer& operator=(const LogCrashBuffer&) = delete;
+
+	/**
+	 * @brief 映射缓冲区文件，文件中上次运行未写入日志文件的日志先补写到原日志文件
+	 *
+	 * @param _Policy    设置
+	 * @return false     无法创建或映射文件
+	 */
+	bool open(const LogCrashPolicy& _Policy)
+	{
+		close();
+		if (!_Policy.m_nSize)
+			return false;
+		recover(_Policy.m_wstrPath);
+
+		const std::filesystem::path path(_Policy.m_wstrPath);
+		const size_t nMapSize = LOG_CRASH_HEADER_SIZE + _Policy.m_nSize;
+		void* pData = nullptr;
+#ifdef _WIN32
+		HANDLE hFile = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (hFile == INVALID_HANDLE_VALUE)
+			return false;
+		const uint64_t nSize = nMapSize;
+		HANDLE hMapping = CreateFileMappingW(hFile, NULL, PAGE_READWRITE, static_cast<DWORD>(nSize >> 32), static_cast<DWORD>(nSize), NULL);
+		if (hMapping)
+			pData = MapViewOfFile(hMapping, FILE_MAP_WRITE, 0, 0, nMapSize);
+		if (!pData)
+		{
+			if (hMapping)
+				CloseHandle(hMapping);
+			CloseHandle(hFile);
+			return false;
+		}
+		m_hFile = hFile;
+		m_hMapping = hMapping;
+#else
+		const int nFd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		if (nFd < 0)
+			return false;
+		if (ftruncate(nFd, static_cast<off_t>(nMapSize)) == 0)
+			pData = mmap(nullptr, nMapSize, PROT_READ | PROT_WRITE, MAP_SHARED, nFd, 0);
+		// 映射建立后即可关闭文件
+		::close(nFd);
+		if (!pData || pData == MAP_FAILED)
+			return false;
+#endif // _WIN32
+
+		m_nMapSize = nMapSize;
+		m_pData = static_cast<char*>(pData) + LOG_CRASH_HEADER_SIZE;
+		m_pHeader = new (pData) LogCrashHeader {};
+		memcpy(m_pHeader->m_szMagic, LOG_CRASH_MAGIC, sizeof LOG_CRASH_MAGIC);
+		m_pHeader->m_nVersion = LOG_CRASH_VERSION;
+		m_pHeader->m_nCapacity = _Policy.m_nSize;
+		if (_Policy.m_bHandleSignals)
+		{
+			installHandlers();
+			installSignalStack();
+		}
+		m_pActive.store(this, std::memory_order_release);
+		return true;
+	}
+
+	/* 解除映射，此前应已将缓冲区中的日志写入日志文件 */
+	void close()
+	{
+		if (!m_pHeader)
+			return;
+		m_pActive.store(nullptr, std::memory_order_release);
+		void* pData = m_pHeader;
+		m_pHeader = nullptr;
+		m_pData = nullptr;
+#ifdef _WIN32
+		UnmapViewOfFile(pData);
+		CloseHandle(m_hMapping);
+		CloseHandle(m_hFile);
+		m_hMapping = nullptr;
+		m_hFile = nullptr;
+#else
+		munmap(pData, m_nMapSize);
+#endif // _WIN32
+		m_nMapSize = 0;
+	}
+
+	bool isOpen() const noexcept { return m_pHeader != nullptr; }
+
+	/* 是否已安装信号处理函数 */
+	static bool handlesSignals() noexcept { return m_bHandlers.load(std::memory_order_acquire); }
+
+	/**
+	 * @brief 为调用线程安装备用信号栈，栈溢出引起的SIGSEGV也能在备用栈上运行处理函数
+	 *
+	 * 打开缓冲区的线程与后台写线程会自动安装；其他线程栈溢出时没有备用栈，进程直接终止，
+	 * 缓冲区中的日志在下次启用时补写。线程已有备用栈时不替换，线程退出时释放。Windows下不需要
+	 */
+	static void installSignalStack() noexcept
+	{
+#ifndef _WIN32
+		thread_local SignalStack stack;
+		stack.install();
+#endif // _WIN32
+	}
+
+	/* 关联当前的日志文件，崩溃时未写入的日志写到该文件，_Fd为-1表示没有打开的文件 */
+	void attach(int _Fd, const std::wstring& _Path)
+	{
+		if (!m_pHeader)
+			return;
+		m_nFd.store(-1, std::memory_order_release);
+		std::string strPath;
+		LogAppendUtf8(strPath, _Path.data(), _Path.size());
+		const size_t nSize = std::min(strPath.size(), LOG_CRASH_PATH_SIZE);
+		memcpy(m_pHeader->m_szPath, strPath.data(), nSize);
+		m_pHeader->m_nPathSize = static_cast<uint32_t>(nSize);
+		m_nFd.store(_Fd, std::memory_order_release);
+	}
+
+	/* 追加放入日志文件写缓冲区的内容，超过数据区大小时只保留最后的部分 */
+	void append(const char* _Data, size_t _Size) noexcept
+	{
+		if (!m_pHeader || !_Size)
+			return;
+		const uint64_t nCapacity = m_pHeader->m_nCapacity;
+		const uint64_t nHead = m_pHeader->m_nHead.load(std::memory_order_relaxed);
+		const char* data = _Data;
+		size_t nSize = _Size;
+		if (nSize > nCapacity)
+		{
+			data += nSize - nCapacity;
+			nSize = static_cast<size_t>(nCapacity);
+		}
+		const uint64_t nStart = nHead + _Size - nSize;
+		const size_t nFirst = static_cast<size_t>(nStart % nCapacity);
+		const size_t nPart = std::min(nSize, static_cast<size_t>(nCapacity) - nFirst);
+		memcpy(m_pData + nFirst, data, nPart);
+		memcpy(m_pData, data + nPart, nSize - nPart);
+		m_pHeader->m_nHead.store(nHead + _Size, std::memory_order_release);
+	}
+
+	/* 已追加的内容均已写入日志文件 */
+	void markDurable() noexcept
+	{
+		if (m_pHeader)
+			m_pHeader->m_nDurable.store(m_pHeader->m_nHead.load(std::memory_order_relaxed), std::memory_order_release);
+	}
+
+	/* 未写入的日志写入日志文件，只使用异步信号安全的函数 */
+	void flushToFile() noexcept
+	{
+		const int nFd = m_nFd.load(std::memory_order_acquire);
+		LogCrashHeader* header = m_pHeader;
+		if (nFd < 0 || !header)
+			return;
+		const uint64_t nCapacity = header->m_nCapacity;
+		const uint64_t nHead = header->m_nHead.load(std::memory_order_acquire);
+		uint64_t nBegin = header->m_nDurable.load(std::memory_order_acquire);
+		if (nBegin >= nHead)
+			return;
+		if (nHead - nBegin > nCapacity)
+			nBegin = nHead - nCapacity;
+		const size_t nFirst = static_cast<size_t>(nBegin % nCapacity);
+		const size_t nSize = static_cast<size_t>(nHead - nBegin);
+		const size_t nPart = std::min(nSize, static_cast<size_t>(nCapacity) - nFirst);
+		writeAll(nFd, m_pData + nFirst, nPart);
+		writeAll(nFd, m_pData, nSize - nPart);
+		header->m_nDurable.store(nHead, std::memory_order_release);
+	}
+
+private:
+	/* 上次运行未写入的日志补写到原日志文件 */
+	static void recover(const std::wstring& _Path)
+	{
+		std::ifstream input(std::filesystem::path(_Path), std::ios::binary);
+		if (!input)
+			return;
+		const std::string strData((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+		input.close();
+		std::string strPath;
+		std::string strTail;
+		if (!LogCrashTail(strData.data(), strData.size(), strPath, strTail) || strTail.empty() || strPath.empty())
+			return;
+		std::wstring wstrPath;
+		LogAppendWide(wstrPath, strPath.data(), strPath.size());
+		std::ofstream output(std::filesystem::path(wstrPath), std::ios::binary | std::ios::app);
+		output.write(strTail.data(), static_cast<std::streamsize>(strTail.size()));
+	}
+
+	static void writeAll(int _Fd, const char* _Data, size_t _Size) noexcept
+	{
+		while (_Size)
+		{
+#ifdef _WIN32
+			int n = _write(_Fd, _Data, static_cast<unsigned int>(_Size));
+#else
+			ssize_t n = ::write(_Fd, _Data, _Size);
+			if (n < 0 && errno == EINTR)
+				continue;
+#endif // _WIN32
+			if (n <= 0)
+				break;
+			_Data += n;
+			_Size -= static_cast<size_t>(n);
+		}
+	}
+
+#ifndef _WIN32
+	/* 线程的备用信号栈 */
+	struct SignalStack
+	{
+		void*  m_pStack { nullptr };
+		size_t m_nSize  { 0 };
+
+		void install() noexcept
+		{
+			if (m_pStack)
+				return;
+			stack_t current {};
+			if (sigaltstack(nullptr, &current) != 0 || !(current.ss_flags & SS_DISABLE))
+				return;
+			const size_t nSize = std::max<size_t>(SIGSTKSZ, 64 * 1024);
+			void* pStack = mmap(nullptr, nSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (pStack == MAP_FAILED)
+				return;
+			stack_t stack {};
+			stack.ss_sp = pStack;
+			stack.ss_size = nSize;
+			if (sigaltstack(&stack, nullptr) != 0)
+			{
+				munmap(pStack, nSize);
+				return;
+			}
+			m_pStack = pStack;
+			m_nSize = nSize;
+		}
+
+		~SignalStack()
+		{
+			if (!m_pStack)
+				return;
+			stack_t stack {};
+			stack.ss_flags = SS_DISABLE;
+			sigaltstack(&stack, nullptr);
+			munmap(m_pStack, m_nSize);
+		}
+	};
+#endif // _WIN32
+
+	/* 信号处理函数只安装一次，之后的信号交给原来的处理函数 */
+	static void installHandlers()
+	{
+		static std::once_flag handlerFlag;
+		std::call_once(handlerFlag, []
+		{
+			for (size_t i = 0; i < std::size(CRASH_SIGNALS); ++i)
+			{
+#ifdef _WIN32
+				m_PrevHandlers[i] = signal(CRASH_SIGNALS[i], signalHandler);
+#else
+				struct sigaction action {};
+				action.sa_handler = signalHandler;
+				sigemptyset(&action.sa_mask);
+				action.sa_flags = SA_ONSTACK;
+				sigaction(CRASH_SIGNALS[i], &action, &m_PrevHandlers[i]);
+#endif // _WIN32
+			}
+			m_bHandlers.store(true, std::memory_order_release);
+		});
+	}
+
+	static void signalHandler(int _Signal)
+	{
+		LogCrashBuffer* buffer = m_pActive.load(std::memory_order_acquire);
+		if (buffer)
+			buffer->flushToFile();
+
+		// 恢复原来的处理方式后重新触发该信号
+		for (size_t i = 0; i < std::size(CRASH_SIGNALS); ++i)
+		{
+			if (CRASH_SIGNALS[i] != _Signal)
+				continue;
+#ifdef _WIN32
+			signal(_Signal, m_PrevHandlers[i] == SIG_ERR ? SIG_DFL : m_PrevHandlers[i]);
+#else
+			sigaction(_Signal, &m_PrevHandlers[i], nullptr);
+#endif // _WIN32
+		}
+		raise(_Signal);
+	}
+
+#ifdef _WIN32
+	static constexpr int CRASH_SIGNALS[] { SIGSEGV, SIGABRT, SIGFPE, SIGILL };
+	using Handler = void (__cdecl*)(int);
+	static inline Handler m_PrevHandlers[std::size(CRASH_SIGNALS)] {};
+#else
+	static constexpr int CRASH_SIGNALS[] { SIGSEGV, SIGBUS, SIGABRT, SIGFPE, SIGILL };
+	static inline struct sigaction m_PrevHandlers[std::size(CRASH_SIGNALS)] {};
+#endif // _WIN32
+	static inline std::atomic<LogCrashBuffer*> m_pActive { nullptr };   // 信号处理函数使用的缓冲区
+	static inline std::atomic<bool>            m_bHandlers { false };   // 是否已安装信号处理函数
+
+	LogCrashHeader*  m_pHeader  { nullptr };
+	char*            m_pData    { nullptr };   // 数据区
+	size_t           m_nMapSize { 0 };
+	std::atomic<int> m_nFd      { -1 };        // 当前日志文件
+#ifdef _WIN32
+	HANDLE           m_hFile    { nullptr };
+	HANDLE           m_hMapping { nullptr };
+#endif // _WIN32
+};
+
+/**
+ * 在后台线程中压缩滚动后的历史文件，Log.1.txt压缩为Log.1.txt.gz后删除原文件
+ *
+ * 压缩期间文件可能因再次滚动而改名，压缩完成后若期间发生过滚动则放弃结果，由下一次滚动重新压缩
+ */
+class LogCompressor
+{
+public:
+	/* 输出线程滚动时可能在任何静态对象析构之后，不释放 */
+	static LogCompressor& instance()
+	{
+		static LogCompressor* compressor = new LogCompressor;
+		return *compressor;
+	}
+
+	/* 滚动改名期间持有，返回前递增滚动次数 */
+	std::unique_lock<std::mutex> beginRename()
+	{
+		std::unique_lock<std::mutex> lock(m_RenameMutex);
+		++m_nRenames;
+		return lock;
+	}
+
+	/**
+	 * @brief 压缩其中存在且尚未压缩的文件
+	 *
+	 * @param _Paths    历史文件路径
+	 * @param _Level    压缩级别
+	 */
+	void compress(std::vector<std::wstring> _Paths, int _Level)
+	{
+		std::scoped_lock<std::mutex> lock(m_Mutex);
+		m_Jobs.push_back(Job { std::move(_Paths), _Level });
+		if (!m_bStarted)
+		{
+			m_bStarted = true;
+			std::thread([this] { threadProc(); }).detach();
+		}
+		m_Cond.notify_one();
+	}
+
+private:
+	struct Job
+	{
+		std::vector<std::wstring> m_Paths;
+		int                       m_nLevel;
+	};
+
+	void threadProc()
+	{
+		for (;;)
+		{
+			Job job;
+			{
+				std::unique_lock<std::mutex> lock(m_Mutex);
+				m_Cond.wait(lock, [this] { return !m_Jobs.empty(); });
+				job = std::move(m_Jobs.front());
+				m_Jobs.pop_front();
+			}
+			for (const std::wstring& wstrPath : job.m_Paths)
+				compressFile(wstrPath, job.m_nLevel);
+		}
+	}
+
+	void compressFile(const std::wstring& _Path, int _Level)
+	{
+		std::error_code ec;
+		if (!std::filesystem::is_regular_file(_Path, ec))
+			return;
+		uint64_t nRenames = 0;
+		{
+			std::scoped_lock<std::mutex> lock(m_RenameMutex);
+			nRenames = m_nRenames;
+		}
+
+		const std::wstring wstrTarget = _Path + LOG_GZIP_EXTENSION;
+		const std::wstring wstrTemp = wstrTarget + L".tmp";
+		std::ifstream input(std::filesystem::path(_Path), std::ios::binary);
+		std::ofstream output(std::filesystem::path(wstrTemp), std::ios::binary | std::ios::trunc);
+		LogDeflater deflater;
+		if (!input || !output || !deflater.begin(_Level))
+			return;
+		std::string strChunk(256 * 1024, '\0');
+		std::string strOut;
+		while (input)
+		{
+			input.read(&strChunk[0], static_cast<std::streamsize>(strChunk.size()));
+			const size_t nRead = static_cast<size_t>(input.gcount());
+			strOut.clear();
+			deflater.compress(strChunk.data(), nRead, strOut, input ? LOG_DEFLATE_NONE : LOG_DEFLATE_FINISH);
+			output.write(strOut.data(), static_cast<std::streamsize>(strOut.size()));
+		}
+		output.close();
+		const bool bComplete = input.eof() && output;
+		input.close();
+
+		std::scoped_lock<std::mutex> lock(m_RenameMutex);
+		if (!bComplete || nRenames != m_nRenames)
+		{
+			std::filesystem::remove(wstrTemp, ec);
+			return;
+		}
+		std::filesystem::rename(wstrTemp, wstrTarget, ec);
+		if (!ec)
+			std::filesystem::remove(_Path, ec);
+	}
+
+	std::mutex              m_Mutex;                // 任务队列互斥
+	std::condition_variable m_Cond;                 // 通知压缩线程
+	std::deque<Job>         m_Jobs;                 // 待压缩的任务
+	bool                    m_bStarted { false };   // 压缩线程是否已启动
+	std::mutex              m_RenameMutex;          // 滚动改名与替换为压缩文件互斥
+	uint64_t                m_nRenames { 0 };       // 滚动改名的次数
+};
+
+/* 常驻打开的日志文件，在写线程中按刷新策略批量写入，按滚动策略切换文件 */
+class LogFile
+{
+public:
+	/* _Counters为nullptr时不统计 */
+	explicit LogFile(LogFileCounters* _Counters = nullptr) : m_pCounters(_Counters) {}
+	~LogFile() { close(); }
+	LogFile(const LogFile&) = delete;
+	LogFile& operator=(const LogFile&) = delete;
+
+	/**
+	 * @brief 以追加方式打开文件，已打开其他文件时先将其关闭
+	 * 
+	 * @param _Path     文件路径
+	 * @return false    打开失败
+	 */
+	bool open(const std::wstring& _Path)
+	{
+		close();
+		m_nFd = openAppend(_Path);
+		m_wstrPath = _Path;
+		if (m_pCrash)
+			m_pCrash->attach(isCompressed() ? -1 : m_nFd, m_wstrPath);
+		m_LastFlush = std::chrono::steady_clock::now();
+		m_nFileSize = 0;
+		if (m_nFd >= 0)
+		{
+#ifdef _WIN32
+			long long nSize = _lseeki64(m_nFd, 0, SEEK_END);
+#else
+			off_t nSize = lseek(m_nFd, 0, SEEK_END);
+#endif // _WIN32
+			if (nSize > 0)
+				m_nFileSize = static_cast<uint64_t>(nSize);
+			++m_nGeneration;
+		}
+		m_tNextRotate = nextMidnight();
+		return m_nFd >= 0;
+	}
+
+	/* 写入缓冲区中剩余的内容并关闭文件 */
+	void close()
 	{
-		std::wofstream wFileOutPut;
-		wFileOutPut.open(m_wstrLogFile.c_str(), std::ios::app);
-		wFileOutPut << m_wstrLogBuffer;
-		wFileOutPut.close();
+		if (m_nFd < 0)
+			return;
+		writeBuffer();
+		finishMember();
+		if (m_pCrash)
+			m_pCrash->attach(-1, m_wstrPath);
+#ifdef _WIN32
+		_close(m_nFd);
+#else
+		// 释放预分配但未使用的空间
+		if (m_bPreallocated)
+			(void)ftruncate(m_nFd, static_cast<off_t>(m_nFileSize));
+		::close(m_nFd);
+#endif // _WIN32
+		m_nFd = -1;
+		m_bPreallocated = false;
+		m_wstrPath.clear();
+	}
+
+	bool isOpen() const noexcept { return m_nFd >= 0; }
+	const std::wstring& path() const noexcept { return m_wstrPath; }
+	/* 每次成功打开文件（含滚动）后递增 */
+	uint64_t generation() const noexcept { return m_nGeneration; }
+	/* 文件与缓冲区均为空 */
+	bool isEmpty() const noexcept { return m_nFileSize == 0 && m_strBuffer.empty(); }
+
+	/**
+	 * @brief 日志转为多字节字符串放入缓冲区，按刷新策略写入文件，按滚动策略切换文件
+	 * 
+	 * @param       _Log    已格式化的日志
+	 * @param  _LogLevel    日志等级
+	 * @param    _Policy    刷新策略
+	 * @param    _Rotate    滚动策略
+	 */
+	void write(const std::wstring& _Log, LOGLEVEL _LogLevel, const LogFlushPolicy& _Policy, const LogRotatePolicy& _Rotate)
+	{
+		reserve(_Policy);
+		const size_t nOld = m_strBuffer.size();
+		appendMultiByte(m_strBuffer, _Log);
+		if (m_pCrash && !isCompressed())
+			m_pCrash->append(m_strBuffer.data() + nOld, m_strBuffer.size() - nOld);
+		commit(_LogLevel, _Policy, _Rotate);
+	}
+
+	/* 同上，UTF-8日志直接放入缓冲区 */
+	void write(const std::string& _Log, LOGLEVEL _LogLevel, const LogFlushPolicy& _Policy, const LogRotatePolicy& _Rotate)
+	{
+		reserve(_Policy);
+		m_strBuffer += _Log;
+		if (m_pCrash && !isCompressed())
+			m_pCrash->append(_Log.data(), _Log.size());
+		commit(_LogLevel, _Policy, _Rotate);
+	}
+
+	/* 距上次写入是否已超过刷新间隔 */
+	bool isFlushDue(const LogFlushPolicy& _Policy) const
+	{
+		return _Policy.m_nFlushIntervalMs && !m_strBuffer.empty()
+			&& std::chrono::steady_clock::now() - m_LastFlush >= std::chrono::milliseconds(_Policy.m_nFlushIntervalMs);
+	}
+
+	/* 缓冲区内容写入文件，之后文件写过一半时提前创建下一个文件 */
+	void flush()
+	{
+		writeBuffer();
+		prepareNext(m_RotatePolicy);
+	}
+
+	/* 缓冲区内容写入文件，流式压缩时先压缩并结束当前块 */
+	void writeBuffer()
+	{
+		const auto tBegin = std::chrono::steady_clock::now();
+		m_LastFlush = tBegin;
+		const uint64_t nOldSize = m_nFileSize;
+		const bool bTimed = m_pCounters && m_nFd >= 0 && !m_strBuffer.empty();
+		if (isCompressed() && m_nFd >= 0 && !m_strBuffer.empty())
+		{
+			if (!m_Deflater.isActive())
+				m_Deflater.begin(m_CompressPolicy.m_nLevel);
+			m_strCompressed.clear();
+			m_Deflater.compress(m_strBuffer.data(), m_strBuffer.size(), m_strCompressed, LOG_DEFLATE_SYNC);
+			writeAll(m_strCompressed.data(), m_strCompressed.size());
+		}
+		else
+			writeAll(m_strBuffer.data(), m_strBuffer.size());
+		m_strBuffer.clear();
+		if (m_pCrash)
+			m_pCrash->markDurable();
+		if (bTimed)
+		{
+			m_pCounters->m_nBytes.fetch_add(m_nFileSize - nOldSize, std::memory_order_relaxed);
+			m_pCounters->addFlush(std::chrono::steady_clock::now() - tBegin);
+		}
+	}
+
+	/**
+	 * @brief 设置崩溃保护缓冲区，之后放入写缓冲区的日志同时写入该缓冲区
+	 *
+	 * @param _Crash    崩溃保护缓冲区，nullptr表示不使用
+	 */
+	void setCrashBuffer(LogCrashBuffer* _Crash)
+	{
+		flush();
+		m_pCrash = _Crash;
+		if (m_pCrash)
+			m_pCrash->attach(isCompressed() ? -1 : m_nFd, m_wstrPath);
+	}
+
+	/* 设置压缩策略，结束当前的压缩成员，之后写入的内容按新策略压缩 */
+	void setCompression(const LogCompressPolicy& _Policy)
+	{
+		flush();
+		finishMember();
+		m_CompressPolicy = _Policy;
+		if (m_pCrash)
+			m_pCrash->attach(isCompressed() ? -1 : m_nFd, m_wstrPath);
+	}
+
+	/**
+	 * @brief 文件写过一半时提前创建下一个文件并预分配空间，切换文件时只需重命名
+	 * 
+	 * @param _Rotate    滚动策略
+	 */
+	void prepareNext(const LogRotatePolicy& _Rotate)
+	{
+		if (m_bNextReady || !_Rotate.m_bPreallocate || !_Rotate.m_nMaxFileSize
+			|| m_nFd < 0 || m_nFileSize < _Rotate.m_nMaxFileSize / 2)
+			return;
+
+		int nFd = openAppend(generationPath(m_wstrPath, -1));
+		if (nFd < 0)
+			return;
+#ifdef _WIN32
+		// CRT句柄关闭时会释放超出文件长度的预分配空间，Windows下只提前创建文件
+		_close(nFd);
+#else
+#ifdef __linux__
+		// 保持文件长度为0，追加写入时从头开始
+		(void)fallocate(nFd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(_Rotate.m_nMaxFileSize));
+#endif // __linux__
+		::close(nFd);
+#endif // _WIN32
+		m_bNextReady = true;
+	}
+
+private:
+	/* 是否以流式压缩写入 */
+	bool isCompressed() const noexcept
+	{
+		return m_CompressPolicy.m_Live != LOG_COMPRESSION_NONE && LogDeflater::isSupported();
+	}
+
+	/* 写入压缩成员的结尾 */
+	void finishMember()
+	{
+		if (!m_Deflater.isActive())
+			return;
+		m_strCompressed.clear();
+		m_Deflater.compress(nullptr, 0, m_strCompressed, LOG_DEFLATE_FINISH);
+		writeAll(m_strCompressed.data(), m_strCompressed.size());
+	}
+
+	/* 写入文件并累计文件大小 */
+	void writeAll(const char* _Data, size_t _Size)
+	{
+		while (m_nFd >= 0 && _Size)
+		{
+#ifdef _WIN32
+			int n = _write(m_nFd, _Data, static_cast<unsigned int>(_Size));
+#else
+			ssize_t n = ::write(m_nFd, _Data, _Size);
+			if (n < 0 && errno == EINTR)
+				continue;
+#endif // _WIN32
+			if (n <= 0)
+				break;
+			_Data += n;
+			_Size -= static_cast<size_t>(n);
+			m_nFileSize += static_cast<uint64_t>(n);
+		}
+	}
+
+	/* 缓冲区至少预留刷新策略指定的大小 */
+	void reserve(const LogFlushPolicy& _Policy)
+	{
+		if (m_strBuffer.capacity() < _Policy.m_nBufferSize)
+			m_strBuffer.reserve(_Policy.m_nBufferSize);
+	}
+
+	/* 日志放入缓冲区后按滚动策略切换文件，按刷新策略写入文件 */
+	void commit(LOGLEVEL _LogLevel, const LogFlushPolicy& _Policy, const LogRotatePolicy& _Rotate)
+	{
+		// 记下滚动策略，不经commit的写入文件（按时间写入、Log::Flush）同样提前创建下一个文件
+		m_RotatePolicy = _Rotate;
+		if (needRotate(_Rotate))
+		{
+			flush();
+			rotate(_Rotate);
+			return;
+		}
+
+		if (m_strBuffer.size() >= _Policy.m_nBufferSize
+			|| (_Policy.m_nFlushBytes && m_strBuffer.size() >= _Policy.m_nFlushBytes)
+			|| (_Policy.m_bFlushOnError && _LogLevel == LOG_LEVEL_ERROR)
+			|| isFlushDue(_Policy))
+			flush();
+	}
+
+	static int openAppend(const std::wstring& _Path)
+	{
+		const std::filesystem::path path(_Path);
+#ifdef _WIN32
+		return _wopen(path.c_str(), _O_WRONLY | _O_APPEND | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+		return ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+#endif // _WIN32
+	}
+
+	/**
+	 * @brief 历史文件路径，Log.txt的第1代为Log.1.txt，预先创建的下一个文件为Log.next.txt
+	 * 
+	 * @param _Path          当前文件路径
+	 * @param _Generation    代数，-1表示预先创建的下一个文件
+	 */
+	static std::wstring generationPath(const std::wstring& _Path, int _Generation)
+	{
+		std::filesystem::path path(_Path);
+		std::wstring wstrName = path.stem().wstring();
+		wstrName += _Generation < 0 ? std::wstring(L".next") : L"." + std::to_wstring(_Generation);
+		wstrName += path.extension().wstring();
+		path.replace_filename(wstrName);
+		return path.wstring();
+	}
+
+	/* 下一个本地时间零点 */
+	static time_t nextMidnight()
+	{
+		time_t now = time(nullptr);
+		struct tm tmNext;
+#ifdef _WIN32
+		localtime_s(&tmNext, &now);
+#else
+		localtime_r(&now, &tmNext);
+#endif // _WIN32
+		tmNext.tm_mday += 1;
+		tmNext.tm_hour = 0;
+		tmNext.tm_min = 0;
+		tmNext.tm_sec = 0;
+		tmNext.tm_isdst = -1;
+		return mktime(&tmNext);
+	}
+
+	bool needRotate(const LogRotatePolicy& _Rotate) const
+	{
+		if (m_nFd < 0)
+			return false;
+		// 流式压缩时按压缩后的大小计算，缓冲区中未压缩的内容不计入
+		const uint64_t nPending = isCompressed() ? 0 : m_strBuffer.size();
+		if (_Rotate.m_nMaxFileSize && m_nFileSize + nPending >= _Rotate.m_nMaxFileSize)
+			return true;
+		return _Rotate.m_bDaily && time(nullptr) >= m_tNextRotate;
+	}
+
+	/* 当前文件依次改名为历史文件，超出保留数量的删除，再切换到下一个文件 */
+	void rotate(const LogRotatePolicy& _Rotate)
+	{
+		const std::wstring wstrPath = m_wstrPath;
+		close();
+		if (m_pCounters)
+			m_pCounters->m_nRotations.fetch_add(1, std::memory_order_relaxed);
+
+		std::error_code ec;
+		std::vector<std::wstring> compressList;
+		if (_Rotate.m_nMaxFiles == 0)
+		{
+			std::filesystem::remove(wstrPath, ec);
+		}
+		else
+		{
+			// 历史文件可能已压缩，压缩与未压缩的文件一并改名；改名期间后台压缩不会替换文件
+			std::unique_lock<std::mutex> renameLock = LogCompressor::instance().beginRename();
+			int nMaxFiles = static_cast<int>(_Rotate.m_nMaxFiles);
+			std::filesystem::remove(generationPath(wstrPath, nMaxFiles), ec);
+			std::filesystem::remove(generationPath(wstrPath, nMaxFiles) + LOG_GZIP_EXTENSION, ec);
+			for (int i = nMaxFiles - 1; i >= 1; --i)
+			{
+				std::filesystem::rename(generationPath(wstrPath, i), generationPath(wstrPath, i + 1), ec);
+				std::filesystem::rename(generationPath(wstrPath, i) + LOG_GZIP_EXTENSION, generationPath(wstrPath, i + 1) + LOG_GZIP_EXTENSION, ec);
+			}
+			// 流式压缩的文件直接改名为压缩文件
+			std::filesystem::rename(wstrPath, generationPath(wstrPath, 1) + (isCompressed() ? LOG_GZIP_EXTENSION : L""), ec);
+			if (m_CompressPolicy.m_Rotated != LOG_COMPRESSION_NONE && LogDeflater::isSupported())
+			{
+				for (int i = 1; i <= nMaxFiles; ++i)
+					compressList.push_back(generationPath(wstrPath, i));
+			}
+		}
+		if (!compressList.empty())
+			LogCompressor::instance().compress(std::move(compressList), m_CompressPolicy.m_nLevel);
+
+		bool bPreallocated = false;
+		if (m_bNextReady)
+		{
+			std::filesystem::rename(generationPath(wstrPath, -1), wstrPath, ec);
+			bPreallocated = !ec;
+			m_bNextReady = false;
+		}
+		open(wstrPath);
+		m_bPreallocated = bPreallocated;
+	}
+
+	int                                   m_nFd { -1 };             // 文件描述符
+	std::wstring                          m_wstrPath;               // 已打开的文件路径
+	std::string                           m_strBuffer;              // 写缓冲区
+	std::chrono::steady_clock::time_point m_LastFlush;              // 上次写入文件的时间
+	uint64_t                              m_nFileSize { 0 };        // 已写入文件的字节数
+	time_t                                m_tNextRotate { 0 };      // 下一次按天滚动的时间
+	bool                                  m_bNextReady { false };   // 下一个文件是否已创建
+	bool                                  m_bPreallocated { false };// 当前文件是否预分配了空间
+	uint64_t                              m_nGeneration { 0 };      // 打开文件的次数
+	LogCrashBuffer*                       m_pCrash { nullptr };     // 崩溃保护缓冲区
+	LogFileCounters*                      m_pCounters;              // 计数器
+	LogRotatePolicy                       m_RotatePolicy;           // 最近一次写入时的滚动策略
+	LogCompressPolicy                     m_CompressPolicy;         // 压缩策略
+	LogDeflater                           m_Deflater;               // 当前压缩成员
+	std::string                           m_strCompressed;          // 压缩后待写入的内容
+};
+
+/* 二进制日志文件，格式见log_binary.hpp，缓冲、刷新与滚动沿用LogFile */
+class LogBinaryFile
+{
+public:
+	explicit LogBinaryFile(LogFileCounters* _Counters = nullptr) : m_File(_Counters) {}
+
+	/* 按调用点记录一条日志，调用点在本段中首次出现时先写入其定义 */
+	void writeEvent(const LogRecord& _Record, const std::wstring& _Path, const LogFlushPolicy& _Policy, const LogRotatePolicy& _Rotate)
+	{
+		begin(_Path);
+		m_strRecord.clear();
+		uint32_t& nId = m_SiteIds[_Record.m_pSite];
+		if (!nId)
+		{
+			const LogSite* site = _Record.m_pSite;
+			nId = static_cast<uint32_t>(m_SiteIds.size());
+			m_strRecord.push_back(static_cast<char>(LOG_BINARY_SITE));
+			LogPutVarint(m_strRecord, nId);
+			LogPutVarint(m_strRecord, site->m_nLine);
+			LogPutString(m_strRecord, site->m_szFile);
+			LogPutString(m_strRecord, site->m_szFunction);
+			LogPutString(m_strRecord, site->m_szFormat);
+		}
+		m_strRecord.push_back(static_cast<char>(LOG_BINARY_EVENT));
+		LogPutVarint(m_strRecord, nId);
+		LogPutVarint(m_strRecord, static_cast<uint64_t>(_Record.m_Level));
+		LogPutVarint(m_strRecord, _Record.m_nThreadId);
+		LogPutVarint(m_strRecord, static_cast<uint64_t>(_Record.m_nTime));
+		LogPutString(m_strRecord, _Record.m_strBinary);
+		m_File.write(m_strRecord, _Record.m_Level, _Policy, _Rotate);
+	}
+
+	/* 无调用点的日志保存格式化后的文本 */
+	void writeText(LOGLEVEL _LogLevel, const std::string& _Log, const std::wstring& _Path, const LogFlushPolicy& _Policy, const LogRotatePolicy& _Rotate)
+	{
+		begin(_Path);
+		m_strRecord.clear();
+		m_strRecord.push_back(static_cast<char>(LOG_BINARY_TEXT));
+		LogPutVarint(m_strRecord, static_cast<uint64_t>(_LogLevel));
+		LogPutString(m_strRecord, _Log);
+		m_File.write(m_strRecord, _LogLevel, _Policy, _Rotate);
+	}
+
+	void writeText(LOGLEVEL _LogLevel, const std::wstring& _Log, const std::wstring& _Path, const LogFlushPolicy& _Policy, const LogRotatePolicy& _Rotate)
+	{
+		m_strText.clear();
+		LogAppendUtf8(m_strText, _Log.data(), _Log.size());
+		writeText(_LogLevel, m_strText, _Path, _Policy, _Rotate);
+	}
+
+	bool isFlushDue(const LogFlushPolicy& _Policy) const { return m_File.isFlushDue(_Policy); }
+	void flush() { m_File.flush(); }
+
+private:
+	/* 打开文件，新文件写入文件头，每次打开或滚动后开始新的一段 */
+	void begin(const std::wstring& _Path)
+	{
+		if (!m_File.isOpen() || m_File.path() != _Path)
+			m_File.open(_Path);
+		if (m_File.generation() == m_nGeneration)
+			return;
+		m_nGeneration = m_File.generation();
+		m_SiteIds.clear();
+
+		m_strRecord.clear();
+		if (m_File.isEmpty())
+		{
+			m_strRecord.append(LOG_BINARY_MAGIC, sizeof LOG_BINARY_MAGIC);
+			LogPutVarint(m_strRecord, LOG_BINARY_VERSION);
+		}
+		m_strRecord.push_back(static_cast<char>(LOG_BINARY_SEGMENT));
+		LogPutVarint(m_strRecord, static_cast<uint64_t>(LogIdCache::processId()));
+		// 段头不触发刷新与滚动
+		m_File.write(m_strRecord, LOG_LEVEL_NONE, LogFlushPolicy {}, LogRotatePolicy {});
+	}
+
+	LogFile                                        m_File;
+	std::unordered_map<const LogSite*, uint32_t>   m_SiteIds;            // 本段中已定义的调用点
+	uint64_t                                       m_nGeneration { 0 };  // 当前段所在文件的打开次数
+	std::string                                    m_strRecord;          // 编码中的记录
+	std::string                                    m_strText;            // 宽字符日志转换后的文本
+};
+
+/* 写入文件描述符，直到写完或出错，返回写入的字节数 */
+static size_t writeFd(int _Fd, const char* _Data, size_t _Size)
+{
+	const size_t nTotal = _Size;
+	while (_Size)
+	{
+#ifdef _WIN32
+		int n = _write(_Fd, _Data, static_cast<unsigned int>(_Size));
+#else
+		ssize_t n = ::write(_Fd, _Data, _Size);
+		if (n < 0 && errno == EINTR)
+			continue;
+#endif // _WIN32
+		if (n <= 0)
+			break;
+		_Data += n;
+		_Size -= static_cast<size_t>(n);
+	}
+	return nTotal - _Size;
+}
+
+/* 命令行输出，日志先放入缓冲区，异步模式下由后台线程每轮整批写出，同步模式下立即写出 */
+class LogConsole
+{
+public:
+	/* 宽字符日志按当前区域设置转换后放入缓冲区 */
+	void append(const std::wstring& _Log, LOGLEVEL _LogLevel, const LogConsolePolicy& _Policy)
+	{
+		std::scoped_lock<std::mutex> lock(m_Mutex);
+		appendColor(_LogLevel, _Policy);
+		appendMultiByte(m_strPending, _Log);
+		endRecord(_LogLevel, _Policy);
+	}
+
+	/* 同上，UTF-8日志直接放入缓冲区 */
+	void append(const std::string& _Log, LOGLEVEL _LogLevel, const LogConsolePolicy& _Policy)
+	{
+		std::scoped_lock<std::mutex> lock(m_Mutex);
+		appendColor(_LogLevel, _Policy);
+		m_strPending += _Log;
+		endRecord(_LogLevel, _Policy);
+	}
+
+	/**
+	 * @brief 写出缓冲区中的日志，写出期间可继续放入新日志
+	 *
+	 * @param _Policy    输出策略
+	 */
+	void flush(const LogConsolePolicy& _Policy)
+	{
+		std::scoped_lock<std::mutex> writeLock(m_WriteMutex);
+		{
+			std::scoped_lock<std::mutex> lock(m_Mutex);
+			if (m_strPending.empty())
+				return;
+			m_strPending.swap(m_strWriting);
+			m_RecordEnds.swap(m_WritingEnds);
+		}
+		write(_Policy);
+		m_strWriting.clear();
+		m_WritingEnds.clear();
+	}
+
+	/* 后台线程整批输出期间不逐条写出，由写锁保护 */
+	void setBatch(bool _Batch) noexcept { m_bBatch = _Batch; }
+	bool isBatch() const noexcept { return m_bBatch; }
+	uint64_t droppedCount() const noexcept { return m_nDroppedCount.load(std::memory_order_relaxed); }
+	uint64_t bytesWritten() const noexcept { return m_nBytesWritten.load(std::memory_order_relaxed); }
+
+private:
+	/* 各等级的颜色，LOG_LEVEL_INFO使用终端默认颜色 */
+	static std::string_view colorOf(LOGLEVEL _LogLevel) noexcept
+	{
+		switch (_LogLevel)
+		{
+		case LOG_LEVEL_ERROR:   return "\x1b[31m";
+		case LOG_LEVEL_WARNING: return "\x1b[33m";
+		case LOG_LEVEL_DEBUG:   return "\x1b[36m";
+		default:                return {};
+		}
+	}
+
+	void appendColor(LOGLEVEL _LogLevel, const LogConsolePolicy& _Policy)
+	{
+		if (_Policy.m_bColor)
+			m_strPending += colorOf(_LogLevel);
+	}
+
+	void endRecord(LOGLEVEL _LogLevel, const LogConsolePolicy& _Policy)
+	{
+		if (_Policy.m_bColor && !colorOf(_LogLevel).empty())
+			m_strPending += "\x1b[0m";
+		m_RecordEnds.push_back(m_strPending.size());
+	}
+
+	void write(const LogConsolePolicy& _Policy)
+	{
+#ifndef _WIN32
+		if (_Policy.m_bDropWhenFull)
+		{
+			// 每次写入不超过PIPE_BUF的若干条完整日志，标准输出可写时不会阻塞；超过PIPE_BUF的单条日志整条写出
+			size_t nBegin = 0;
+			size_t nRecord = 0;
+			while (nRecord < m_WritingEnds.size())
+			{
+				pollfd pfd { 1, POLLOUT, 0 };
+				int n = poll(&pfd, 1, 0);
+				if (n < 0 && errno == EINTR)
+					continue;
+				if (n <= 0 || !(pfd.revents & POLLOUT))
+				{
+					m_nDroppedCount.fetch_add(m_WritingEnds.size() - nRecord, std::memory_order_relaxed);
+					return;
+				}
+				size_t nEnd = m_WritingEnds[nRecord++];
+				while (nRecord < m_WritingEnds.size() && m_WritingEnds[nRecord] - nBegin <= PIPE_BUF)
+					nEnd = m_WritingEnds[nRecord++];
+				m_nBytesWritten.fetch_add(writeFd(1, m_strWriting.data() + nBegin, nEnd - nBegin), std::memory_order_relaxed);
+				nBegin = nEnd;
+			}
+			return;
+		}
+#else
+		(void)_Policy;
+#endif // _WIN32
+		m_nBytesWritten.fetch_add(writeFd(1, m_strWriting.data(), m_strWriting.size()), std::memory_order_relaxed);
+	}
+
+	std::mutex            m_Mutex;                 // 保护待写出的缓冲区
+	std::mutex            m_WriteMutex;            // 保证同一时刻只有一个线程写出
+	std::string           m_strPending;            // 待写出的日志
+	std::vector<size_t>   m_RecordEnds;            // m_strPending中每条日志的结束位置
+	std::string           m_strWriting;            // 正在写出的日志
+	std::vector<size_t>   m_WritingEnds;           // m_strWriting中每条日志的结束位置
+	bool                  m_bBatch { false };
+	std::atomic<uint64_t> m_nDroppedCount { 0 };
+	std::atomic<uint64_t> m_nBytesWritten { 0 };
+};
+
+/* 注册目标的队列与输出线程，队列满时丢弃新日志，不阻塞调用者 */
+class LogSinkWorker
+{
+public:
+	LogSinkWorker(const std::shared_ptr<LogSink>& _Sink, size_t _Capacity)
+		: m_pSink(_Sink), m_nCapacity(_Capacity ? _Capacity : 1), m_Thread([this] { run(); })
+	{
+	}
+
+	~LogSinkWorker() { stop(); }
+
+	const std::shared_ptr<LogSink>& sink() const noexcept { return m_pSink; }
+
+	/* 日志等级与类型是否满足该目标的要求 */
+	bool accepts(LOGLEVEL _LogLevel, bool _Structured) const noexcept
+	{
+		return _LogLevel <= m_pSink->getLevel() && (_Structured || !m_pSink->isStructuredOnly());
+	}
+
+	/* 入队，多个目标共享同一份日志 */
+	void push(LOGLEVEL _LogLevel, const std::shared_ptr<const std::string>& _Log)
+	{
+		{
+			std::scoped_lock<std::mutex> lock(m_Mutex);
+			if (m_Queue.size() >= m_nCapacity)
+			{
+				m_pSink->m_nDroppedCount.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			m_Queue.push_back({ _LogLevel, _Log });
+		}
+		m_Cond.notify_one();
+	}
+
+	/* 等待队列中的日志输出完毕并调用目标的flush */
+	void flush()
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		if (m_bStop)
+			return;
+		const uint64_t request = ++m_nFlushRequest;
+		m_Cond.notify_one();
+		m_DoneCond.wait(lock, [this, request] { return m_nFlushDone >= request || m_bStop; });
+	}
+
+	/* 输出队列中剩余的日志后结束线程 */
+	void stop()
+	{
+		{
+			std::scoped_lock<std::mutex> lock(m_Mutex);
+			m_bStop = true;
+		}
+		m_Cond.notify_one();
+		if (m_Thread.joinable())
+			m_Thread.join();
+		m_DoneCond.notify_all();
+	}
+
+private:
+	struct Item
+	{
+		LOGLEVEL                           m_Level;
+		std::shared_ptr<const std::string> m_pLog;
+	};
+
+	void run()
+	{
+		std::deque<Item> batch;
+		bool bDirty = false;
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		for (;;)
+		{
+			const bool bWoken = m_Cond.wait_for(lock, std::chrono::seconds(1), [this]
+			{
+				return !m_Queue.empty() || m_bStop || m_nFlushDone < m_nFlushRequest;
+			});
+			batch.swap(m_Queue);
+			lock.unlock();
+
+			for (const Item& item : batch)
+			{
+				m_pSink->write(item.m_Level, *item.m_pLog);
+				m_pSink->m_nBytesWritten.fetch_add(item.m_pLog->size(), std::memory_order_relaxed);
+			}
+			bDirty = bDirty || !batch.empty();
+			batch.clear();
+
+			lock.lock();
+			if (!m_Queue.empty())
+				continue;
+			// 队列已空：处理Flush请求、停止请求，空闲时将目标的缓冲写出
+			const uint64_t request = m_nFlushRequest;
+			if (bDirty && (!bWoken || m_nFlushDone < request || m_bStop))
+			{
+				lock.unlock();
+				m_pSink->flush();
+				bDirty = false;
+				lock.lock();
+			}
+			if (m_nFlushDone < request)
+			{
+				m_nFlushDone = request;
+				m_DoneCond.notify_all();
+			}
+			if (m_bStop && m_Queue.empty())
+				return;
+		}
+	}
+
+	std::shared_ptr<LogSink>    m_pSink;
+	size_t                      m_nCapacity;
+	std::mutex                  m_Mutex;
+	std::condition_variable     m_Cond;                 // 唤醒输出线程
+	std::condition_variable     m_DoneCond;             // 通知flush已完成
+	std::deque<Item>            m_Queue;
+	bool                        m_bStop { false };
+	uint64_t                    m_nFlushRequest { 0 };  // flush请求序号
+	uint64_t                    m_nFlushDone { 0 };     // 已完成的flush请求序号
+	std::thread                 m_Thread;               // 最后构造，线程启动时其它成员均已初始化
+};
+
+void LogConsoleSink::write(LOGLEVEL, const std::string& _Log)
+{
+	writeFd(m_nFd, _Log.data(), _Log.size());
+}
+
+LogFileSink::LogFileSink(const std::wstring& _Path, const LogFlushPolicy& _Policy, const LogRotatePolicy& _Rotate, const LogCompressPolicy& _Compress)
+	: m_pFile(new LogFile()), m_FlushPolicy(_Policy), m_RotatePolicy(_Rotate)
+{
+	m_pFile->setCompression(_Compress);
+	m_pFile->open(_Path);
+}
+
+LogFileSink::~LogFileSink()
+{
+	m_pFile->flush();
+}
+
+void LogFileSink::write(LOGLEVEL _LogLevel, const std::string& _Log)
+{
+	m_pFile->write(_Log, _LogLevel, m_FlushPolicy, m_RotatePolicy);
+}
+
+void LogFileSink::flush()
+{
+	m_pFile->flush();
+}
+
+void LogMemorySink::write(LOGLEVEL, const std::string& _Log)
+{
+	std::scoped_lock<std::mutex> lock(m_Mutex);
+	if (m_Logs.size() >= m_nCapacity && !m_Logs.empty())
+	{
+		// 复用最旧一条的空间
+		std::string strOldest = std::move(m_Logs.front());
+		m_Logs.pop_front();
+		strOldest.assign(_Log);
+		m_Logs.push_back(std::move(strOldest));
+		return;
+	}
+	if (m_nCapacity)
+		m_Logs.push_back(_Log);
+}
+
+std::vector<std::string> LogMemorySink::snapshot() const
+{
+	std::scoped_lock<std::mutex> lock(m_Mutex);
+	return std::vector<std::string>(m_Logs.begin(), m_Logs.end());
+}
+
+#ifndef _WIN32
+/* 去掉按当前输出模式写入的首尾分隔行与结尾的换行，定义见LogPattern之后 */
+static std::string_view trimBanners(std::string_view _Log, LOGLEVEL _LogLevel);
+
+static_assert(LOG_SYSLOG_FACILITY_USER == LOG_USER, "LOG_SYSLOG_FACILITY_USER differs from LOG_USER");
+
+LogSyslogSink::LogSyslogSink(const char* _Ident, int _Facility)
+{
+	openlog(_Ident, LOG_PID, _Facility);
+}
+
+LogSyslogSink::~LogSyslogSink()
+{
+	closelog();
+}
+
+void LogSyslogSink::write(LOGLEVEL _LogLevel, const std::string& _Log)
+{
+	// syslog自带时间与分隔，只去掉按输出模式写入的首尾分隔行与结尾的换行
+	const std::string_view log = trimBanners(_Log, _LogLevel);
+
+	int nPriority = LOG_INFO;
+	switch (_LogLevel)
+	{
+	case LOG_LEVEL_ERROR:   nPriority = LOG_ERR;     break;
+	case LOG_LEVEL_WARNING: nPriority = LOG_WARNING; break;
+	case LOG_LEVEL_DEBUG:   nPriority = LOG_DEBUG;   break;
+	default:                                          break;
+	}
+	syslog(nPriority, "%.*s", static_cast<int>(log.size()), log.data());
+}
+#endif // _WIN32
+
+/* 单调时钟纳秒数，用于合并各线程队列 */
+static inline uint64_t steadyNanoseconds()
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+bool LogSite::admitSlow(LOGLEVEL _LogLevel) const noexcept
+{
+	bool bAdmit = true;
+	const uint nSampleEvery = m_nSampleEvery.load(std::memory_order_relaxed);
+	if (nSampleEvery > 1 && m_nCalls.fetch_add(1, std::memory_order_relaxed) % nSampleEvery)
+		bAdmit = false;
+
+	uint64_t now = 0;
+	const uint nRate = m_nRatePerSec.load(std::memory_order_relaxed);
+	if (bAdmit && nRate)
+	{
+		// 令牌桶的GCRA形式：每条日志将理论时间推后一个间隔，理论时间超前当前时间不超过突发容量时输出
+		now = steadyNanoseconds();
+		const uint nBurst = m_nBurst.load(std::memory_order_relaxed);
+		const int64_t nInterval = std::max<int64_t>(1000000000 / nRate, 1);
+		const int64_t nTolerance = nInterval * ((nBurst ? nBurst : nRate) - 1);
+		const int64_t nNow = static_cast<int64_t>(now);
+		int64_t nAllowAt = m_nAllowAt.load(std::memory_order_relaxed);
+		while (true)
+		{
+			const int64_t nBase = std::max(nAllowAt, nNow);
+			if (nBase - nNow > nTolerance)
+			{
+				bAdmit = false;
+				break;
+			}
+			if (m_nAllowAt.compare_exchange_weak(nAllowAt, nBase + nInterval, std::memory_order_relaxed))
+				break;
+		}
+	}
+	if (bAdmit)
+		return true;
+
+	m_SuppressedLevel.store(_LogLevel, std::memory_order_relaxed);
+	m_nSuppressed.fetch_add(1, std::memory_order_relaxed);
+	LogSiteRegistry& registry = siteRegistry();
+	registry.suppress();
+	// 同步模式下没有后台线程，由未输出的调用顺带汇总并直接输出；异步模式下由后台写线程汇总
+	if (Log::getLogMode() == LOG_MODE_SYNC)
+	{
+		registry.reportIfDue(now ? now : steadyNanoseconds(), [](const LogSite& _Site, LOGLEVEL _LogLevel, uint64_t _Count)
+		{
+			Log::writeLog(_LogLevel, _Site.m_wszFile, _Site.m_wszFunction, _Site.m_nLine, SUPPRESSED_FORMAT,
+				static_cast<unsigned long long>(_Count));
+		});
+	}
+	return false;
+}
+
+void Log::setSiteLimit(const char* _File, uint _Line, const LogSiteLimit& _Limit)
+{
+	siteRegistry().setLimit(_File, _Line, _Limit);
+}
+
+/* 系统时钟纳秒数 */
+static inline int64_t systemNanoseconds()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		system_clock::now().time_since_epoch()).count();
+}
+
+#ifdef LOG_HAS_TSC
+/**
+ * 以CPU时间戳计数器推算系统时间，每个线程每秒以系统时钟校准一次
+ *
+ * 频率在选择该时钟源时测量一次。校准时系统时间略落后于推算值（频率误差）时，本线程保持上次的值直到系统时间追上，
+ * 同一线程的时间不会倒退；落后超过LOG_TSC_MAX_SLEW_NS视为系统时间被调整，直接采用系统时间
+ */
+class LogTscClock
+{
+public:
+	/* 检查CPU并测量频率，只进行一次，返回计数器是否可用 */
+	static bool prepare()
+	{
+		static const bool bUsable = []
+		{
+			if (!isInvariant())
+				return false;
+			m_dTicksPerNs = calibrate();
+			return m_dTicksPerNs > 0;
+		}();
+		return bUsable;
+	}
+
+	/* 调用前prepare已返回true */
+	static int64_t now() noexcept
+	{
+		thread_local uint64_t anchorTicks = 0;
+		thread_local int64_t  anchorTime  = 0;
+		thread_local int64_t  lastTime    = 0;
+
+		const uint64_t ticks = __rdtsc();
+		const double elapsed = static_cast<double>(ticks - anchorTicks) / m_dTicksPerNs;
+		int64_t time = anchorTime + static_cast<int64_t>(elapsed);
+		if (!anchorTicks || ticks < anchorTicks || elapsed >= 1e9)
+		{
+			anchorTicks = __rdtsc();
+			anchorTime = systemNanoseconds();
+			time = anchorTime;
+		}
+		if (time < lastTime && lastTime - time < LOG_TSC_MAX_SLEW_NS)
+			time = lastTime;
+		lastTime = time;
+		return time;
+	}
+
+private:
+	/* 校准时允许保持上次值的最大差值（纳秒） */
+	static constexpr int64_t LOG_TSC_MAX_SLEW_NS { 10'000'000 };
+
+	/* CPUID 0x80000007的EDX第8位：计数器频率恒定，不随变频与休眠状态变化 */
+	static bool isInvariant() noexcept
+	{
+#ifdef _MSC_VER
+		int regs[4] {};
+		__cpuid(regs, 0x80000000);
+		if (static_cast<unsigned>(regs[0]) < 0x80000007u)
+			return false;
+		__cpuid(regs, 0x80000007);
+		return (regs[3] >> 8) & 1;
+#else
+		unsigned eax = 0, ebx = 0, ecx = 0, edx = 0;
+		if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx))
+			return false;
+		return (edx >> 8) & 1;
+#endif // _MSC_VER
+	}
+
+	/* 以单调时钟测量计数器频率 */
+	static double calibrate() noexcept
+	{
+		const uint64_t beginTicks = __rdtsc();
+		const uint64_t beginTime = steadyNanoseconds();
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		const uint64_t endTicks = __rdtsc();
+		const uint64_t endTime = steadyNanoseconds();
+		if (endTicks <= beginTicks || endTime <= beginTime)
+			return 0;
+		return static_cast<double>(endTicks - beginTicks) / static_cast<double>(endTime - beginTime);
+	}
+
+	static inline double m_dTicksPerNs { 0 };   // 每纳秒的计数，prepare之后不变
+};
+#endif // LOG_HAS_TSC
+
+/* 每个格式化线程缓存已格式化的时间，秒变化时只改写秒，分钟变化时才重新计算本地时间，日期只在跨天时改写 */
+template<typename Char>
+class LogTimeCache
+{
+public:
+	LogTimeCache()
+	{
+		const char* initial = "0000-00-00 00:00:00";
+		for (size_t i = 0; i < 20; ++i)
+			m_szTime[i] = static_cast<Char>(initial[i]);
+	}
+
+	/**
+	 * @brief 追加时间
+	 * 
+	 * @param _Buffer       OUT 日志
+	 * @param _Time         自1970年起的纳秒数
+	 * @param _Precision    时间精度
+	 */
+	void append(std::basic_string<Char>& _Buffer, int64_t _Time, LOGTIMEPRECISION _Precision)
+	{
+		int64_t nSecond = _Time / 1000000000;
+		int64_t nNanosecond = _Time % 1000000000;
+		if (nNanosecond < 0)
+		{
+			--nSecond;
+			nNanosecond += 1000000000;
+		}
+		if (nSecond != m_nSecond)
+			update(nSecond);
+		_Buffer.append(m_szTime, 19);
+
+		if (_Precision == LOG_TIME_SECOND)
+			return;
+		const int nDigits = _Precision == LOG_TIME_MILLISECOND ? 3 : _Precision == LOG_TIME_MICROSECOND ? 6 : 9;
+		for (int i = nDigits; i < 9; ++i)
+			nNanosecond /= 10;
+		Char szFraction[10];
+		szFraction[0] = static_cast<Char>('.');
+		for (int i = nDigits; i > 0; --i)
+		{
+			szFraction[i] = static_cast<Char>('0' + nNanosecond % 10);
+			nNanosecond /= 10;
+		}
+		_Buffer.append(szFraction, nDigits + 1);
+	}
+
+private:
+	void update(int64_t _Second)
+	{
+		const int64_t nOffset = _Second - m_nMinute;
+		if (m_nSecond < 0 || nOffset < 0 || nOffset >= 60)
+		{
+			time_t now = static_cast<time_t>(_Second);
+			struct tm tmNow;
+#ifdef _WIN32
+			localtime_s(&tmNow, &now);
+#else
+			localtime_r(&now, &tmNow);
+#endif // _WIN32
+			m_nMinute = _Second - tmNow.tm_sec;
+			if (tmNow.tm_year != m_nYear || tmNow.tm_yday != m_nDay)
+			{
+				m_nYear = tmNow.tm_year;
+				m_nDay = tmNow.tm_yday;
+				writeDigits(0, tmNow.tm_year + 1900, 4);
+				writeDigits(5, tmNow.tm_mon + 1, 2);
+				writeDigits(8, tmNow.tm_mday, 2);
+			}
+			writeDigits(11, tmNow.tm_hour, 2);
+			writeDigits(14, tmNow.tm_min, 2);
+		}
+		writeDigits(17, static_cast<int>(_Second - m_nMinute), 2);
+		m_nSecond = _Second;
+	}
+
+	void writeDigits(int _Pos, int _Value, int _Count)
+	{
+		for (int i = _Pos + _Count - 1; i >= _Pos; --i)
+		{
+			m_szTime[i] = static_cast<Char>('0' + _Value % 10);
+			_Value /= 10;
+		}
+	}
+
+	Char    m_szTime[20];                                // 已格式化的时间
+	int64_t m_nSecond     { -1 };                        // 已格式化的秒
+	int64_t m_nMinute     { 0 };                         // 已格式化的分钟起始秒
+	int     m_nYear       { -1 };                        // 已格式化的年
+	int     m_nDay        { -1 };                        // 已格式化的日（一年中的第几天）
+};
+
+std::shared_ptr<Log>    Log::m_Log              { nullptr };
+std::wstring            Log::m_wstrLogBuffer	{ 0 };
+std::string             Log::m_strLogBuffer     {};
+std::atomic<LOGLEVEL>   Log::m_LogLevel         { LOG_LEVEL_NONE };
+std::atomic<LOGLEVEL>   Log::m_BacktraceLevel   { LOG_LEVEL_NONE };
+std::atomic<size_t>     Log::m_nBacktraceCount  { 0 };
+uint64_t                Log::m_nFileGeneration  { 0 };
+std::mutex              Log::m_ConfigMutex      {};
+std::shared_mutex       Log::m_LogMutex         { std::shared_mutex() };
+std::atomic<LOGMODE>    Log::m_LogMode          { LOG_MODE_SYNC };
+LogCounters             Log::m_Counters         {};
+LogCrashBuffer          Log::m_CrashBuffer      {};
+LogFile                 Log::m_LogFile          { &m_Counters.m_File };
+LogBinaryFile           Log::m_BinaryFile       { &m_Counters.m_Binary };
+LogFlushPolicy          Log::m_FlushPolicy      {};
+LogRotatePolicy         Log::m_RotatePolicy     {};
+LogCompressPolicy       Log::m_CompressPolicy   {};
+LogConsole              Log::m_Console          {};
+LogConsolePolicy        Log::m_ConsolePolicy    {};
+LogCrashPolicy          Log::m_CrashPolicy      {};
+std::vector<std::shared_ptr<LogRingBuffer>> Log::m_RingList {};
+std::mutex              Log::m_RingMutex        {};
+std::atomic<uint64_t>   Log::m_nRingVersion     { 0 };
+std::atomic<size_t>     Log::m_nQueueCapacity   { 8192 };
+std::atomic<LOGOVERFLOW> Log::m_OverflowPolicy  { LOG_OVERFLOW_BLOCK };
+std::atomic<uint64_t>   Log::m_nDroppedCount    { 0 };
+std::atomic<LOGENCODING> Log::m_Encoding        { LOG_ENCODING_WIDE };
+std::atomic<LOGTIMEPRECISION> Log::m_TimePrecision { LOG_TIME_SECOND };
+std::atomic<LOGCLOCK>   Log::m_ClockSource      { LOG_CLOCK_SYSTEM };
+std::atomic<LOGKVFORMAT> Log::m_KvFormat        { LOG_KV_JSON };
+std::vector<std::shared_ptr<LogSinkWorker>> Log::m_SinkList {};
+std::atomic<size_t>     Log::m_nSinkCount       { 0 };
+std::mutex              Log::m_QueueMutex       {};
+std::condition_variable Log::m_FlushCond        {};
+LogWriters              Log::m_Writers          {};
+LogWriterPolicy         Log::m_WriterPolicy     {};
+std::atomic<bool>       Log::m_bWriterRunning   { false };
+uint64_t                Log::m_nFlushRequest    { 0 };
+
+void Log::Init(LOGLEVEL _LogLevel, LOGTARGET _LogTarget, std::wstring _Path, LOGMODE _LogMode)
+{
+	if (!m_Log)
+		m_Log.reset(new Log());
+
+	// 切换模式或重新初始化前先输出已入队的日志
+	if (_LogMode == LOG_MODE_SYNC)
+		Shutdown();
+	else
+		Flush();
+	
+	setLogLevel(_LogLevel);
+	setLogTarget(_LogTarget);
+	setLogFile(_Path);
+	{
+		std::scoped_lock<std::shared_mutex> writeLock(m_LogMutex);
+		applyCrashPolicy();
+	}
+	// 支持中文字符
+#ifdef _WIN32
+	setlocale(LC_ALL, "chs");
+#else
+	setlocale(LC_ALL, "");
+#endif // _WIN32
+
+	if (_LogMode != LOG_MODE_SYNC)
+	{
+		std::scoped_lock<std::mutex> queueLock(m_QueueMutex);
+		if (!m_bWriterRunning)
+		{
+			// 进程正常退出时输出剩余日志
+			static std::once_flag exitFlag;
+			std::call_once(exitFlag, [] { std::atexit(Shutdown); });
+
+			startWriters();
+		}
+		m_LogMode = _LogMode;
+	}
+}
+
+void Log::writeLog
+(
+	const LOGLEVEL _LogLevel,	// Log等级
+	const wchar_t* _FileName,	// 函数所在文件名
+	const wchar_t* _Function,	// 函数名
+	const uint   _LineNumber,	// 行号
+	const char*      _Format,	// 格式化
+	...							// 参数列表
+)
+{
+	if (!isLevelEnabled(_LogLevel))
+		return;
+
+	va_list args;
+	va_start(args, _Format);
+	if (getEncoding() == LOG_ENCODING_UTF8)
+	{
+		thread_local std::string strFile, strFunction;
+		strFile.clear();
+		strFunction.clear();
+		LogAppendUtf8(strFile, _FileName);
+		LogAppendUtf8(strFunction, _Function);
+		writeLogV(_LogLevel, strFile.c_str(), strFunction.c_str(), _LineNumber, _Format, args);
+	}
+	else
+		writeLogV(_LogLevel, _FileName, _Function, _LineNumber, _Format, args);
+	va_end(args);
+}
+
+void Log::writeLog
+(
+	const LOGLEVEL _LogLevel,	// Log等级
+	const LogSite&     _Site,	// 调用点
+	const char*      _Format,	// 格式化
+	...							// 参数列表
+)
+{
+	if (!isLevelEnabled(_LogLevel))
+		return;
+
+	va_list args;
+	va_start(args, _Format);
+	// 调用点保存的文件名与函数名本身即为UTF-8，无需转换
+	if (getEncoding() == LOG_ENCODING_UTF8)
+		writeLogV(_LogLevel, _Site.m_szFile, _Site.m_szFunction, _Site.m_nLine, _Format, args);
+	else
+		writeLogV(_LogLevel, _Site.m_wszFile, _Site.m_wszFunction, _Site.m_nLine, _Format, args);
+	va_end(args);
+}
+
+template<typename Char>
+void Log::writeLogV
+(
+	const LOGLEVEL _LogLevel,	// Log等级
+	const Char*    _FileName,	// 函数所在文件名
+	const Char*    _Function,	// 函数名
+	const uint   _LineNumber,	// 行号
+	const char*      _Format,	// 格式化
+	va_list            _Args	// 参数列表
+)
+{
+	// 可变参数无法保存到调用结束之后，保存到回溯缓冲时即格式化
+	if (isBacktraced(_LogLevel))
+	{
+		LogRecord& record = acquireBacktrace(_LogLevel);
+		record.m_bUtf8 = std::is_same_v<Char, char>;
+		formatLog(record.text<Char>(), _LogLevel, _FileName, _Function, _LineNumber, _Format, _Args);
+		return;
+	}
+	if (getLogMode() != LOG_MODE_SYNC)
+	{
+		// 异步模式：在调用线程格式化，放入本线程的队列后由后台线程输出
+		// 可变参数无法保存到调用结束之后，延迟格式化模式下同样在此格式化
+		flushBacktrace(_LogLevel, false);
+		LogRecord& record = acquireRecord(_LogLevel);
+		record.m_bUtf8 = std::is_same_v<Char, char>;
+		formatLog(record.text<Char>(), _LogLevel, _FileName, _Function, _LineNumber, _Format, _Args);
+		pushToRing(record);
+		return;
+	}
+
+	// 写锁
+	CallerLock writeLock;
+	flushBacktrace(_LogLevel, true);
+
+	std::basic_string<Char>& buffer = syncBuffer<Char>();
+	formatLog(buffer, _LogLevel, _FileName, _Function, _LineNumber, _Format, _Args);
+
+	outputToTarget(buffer, _LogLevel);
+}
+
+void Log::formatLog
+(
+	std::wstring&    _Buffer,	// 格式化后的日志
+	const LOGLEVEL _LogLevel,	// Log等级
+	const wchar_t* _FileName,	// 函数所在文件名
+	const wchar_t* _Function,	// 函数名
+	const uint   _LineNumber,	// 行号
+	const char*      _Format,	// 格式化
+	va_list            _Args	// 参数列表
+)
+{
+	const int64_t nTime = currentTime();
+	const uint nThreadId = LogIdCache::threadId();
+	const LogThreadName* pThreadName = LogIdCache::threadName();
+	const PatternReader pattern;
+	formatLogHeader(*pattern, _Buffer, _LogLevel, _FileName, _Function, _LineNumber, nTime, nThreadId, pThreadName);
+
+	// 日志正文，宽字符个数不超过多字节字符串的字节数
+	thread_local std::wstring wstrFormat;
+	wstrFormat.assign(strlen(_Format) + 1, L'\0');
+	StrToWStr(_Format, &wstrFormat[0]);
+
+	// 直接格式化到日志末尾，空间不足时扩大后重试
+	const size_t nOld = _Buffer.size();
+	size_t nSpace = 256;
+	while (true)
+	{
+		_Buffer.resize(nOld + nSpace);
+		va_list args;
+		va_copy(args, _Args);
+		int nLen = vswprintf(&_Buffer[nOld], nSpace, wstrFormat.c_str(), args);
+		va_end(args);
+		if (nLen >= 0)
+		{
+			_Buffer.resize(nOld + nLen);
+			break;
+		}
+		if (nSpace >= 64 * 1024)
+		{
+			// 格式串有误或参数无法转换时同样返回-1，不无限扩大，保留格式串以免丢失日志
+			_Buffer.resize(nOld);
+			_Buffer.append(wstrFormat.c_str());
+			break;
+		}
+		nSpace *= 4;
+	}
+
+	formatLogFooter(*pattern, _Buffer, _LogLevel, _FileName, _Function, _LineNumber, nTime, nThreadId, pThreadName);
+}
+
+void Log::formatLog
+(
+	std::string&     _Buffer,	// 格式化后的日志
+	const LOGLEVEL _LogLevel,	// Log等级
+	const char*    _FileName,	// 函数所在文件名
+	const char*    _Function,	// 函数名
+	const uint   _LineNumber,	// 行号
+	const char*      _Format,	// 格式化
+	va_list            _Args	// 参数列表
+)
+{
+	const int64_t nTime = currentTime();
+	const uint nThreadId = LogIdCache::threadId();
+	const LogThreadName* pThreadName = LogIdCache::threadName();
+	const PatternReader pattern;
+	formatLogHeader(*pattern, _Buffer, _LogLevel, _FileName, _Function, _LineNumber, nTime, nThreadId, pThreadName);
+
+	// 直接格式化到日志末尾，空间不足时按返回的长度扩大后重试
+	const size_t nOld = _Buffer.size();
+	size_t nSpace = 256;
+	while (true)
+	{
+		_Buffer.resize(nOld + nSpace);
+		va_list args;
+		va_copy(args, _Args);
+		int nLen = vsnprintf(&_Buffer[nOld], nSpace, _Format, args);
+		va_end(args);
+		if (nLen < 0)
+		{
+			// 参数无法转换时保留格式串以免丢失日志
+			_Buffer.resize(nOld);
+			_Buffer.append(_Format);
+			break;
+		}
+		if (static_cast<size_t>(nLen) < nSpace)
+		{
+			_Buffer.resize(nOld + nLen);
+			break;
+		}
+		nSpace = static_cast<size_t>(nLen) + 1;
+	}
+
+	formatLogFooter(*pattern, _Buffer, _LogLevel, _FileName, _Function, _LineNumber, nTime, nThreadId, pThreadName);
+}
+
+/* 等级分隔行，每个等级只构造一次 */
+template<typename Char>
+static const std::basic_string<Char>& levelBanner(const LOGLEVEL _LogLevel)
+{
+	static const std::array<std::basic_string<Char>, LOG_LEVEL_INFO + 1> banners = []
+	{
+		std::array<std::basic_string<Char>, LOG_LEVEL_INFO + 1> result;
+		for (const auto& level : LOGLEVEL_WSTRING)
+		{
+			std::basic_string<Char>& banner = result[level.first];
+			banner += static_cast<Char>('\n');
+			banner.append(60, static_cast<Char>('*'));
+			banner += static_cast<Char>(' ');
+			// 等级名称只含ASCII字符
+			for (const wchar_t* name = level.second; *name; ++name)
+				banner += static_cast<Char>(*name);
+			banner += static_cast<Char>(' ');
+			banner.append(60, static_cast<Char>('*'));
+			banner += static_cast<Char>('\n');
+		}
+		return result;
+	}();
+	return banners.at(_LogLevel);
+}
+
+/* 追加左对齐的整数，不足_Width时以空格补齐 */
+template<typename Char>
+static void appendNumber(std::basic_string<Char>& _Buffer, unsigned long long _Value, size_t _Width)
+{
+	Char digits[24];
+	size_t nCount = 0;
+	do
+	{
+		digits[sizeof(digits) / sizeof(digits[0]) - 1 - nCount++] = static_cast<Char>('0' + _Value % 10);
+		_Value /= 10;
+	} while (_Value);
+	_Buffer.append(digits + sizeof(digits) / sizeof(digits[0]) - nCount, nCount);
+	if (nCount < _Width)
+		_Buffer.append(_Width - nCount, static_cast<Char>(' '));
+}
+
+/* 追加ASCII字符串字面量 */
+template<typename Char>
+static void appendAscii(std::basic_string<Char>& _Buffer, const char* _Text)
+{
+	for (; *_Text; ++_Text)
+		_Buffer += static_cast<Char>(*_Text);
+}
+
+/**
+ * 编译后的输出模式，以正文为界分为开头与结尾两段，每段为依次执行的字段
+ *
+ * 模式在设置时解析一次，之后只按字段序列追加，不再扫描模式串。以LogSnapshot发布，
+ * 其他线程在设置新模式时仍可使用旧模式完成正在格式化的日志，之后旧模式释放
+ */
+class LogPattern
+{
+public:
+	LogPattern() : LogPattern(LOG_DEFAULT_PATTERN) {}
+	explicit LogPattern(const std::string& _Pattern) : m_strPattern(_Pattern)
+	{
+		std::vector<LogPatternField> header;
+		std::vector<LogPatternField> footer;
+		LogParsePattern(_Pattern, header, footer);
+		compile(header, m_Header);
+		compile(footer, m_Footer);
+	}
+
+	const std::string& pattern() const noexcept { return m_strPattern; }
+
+	/**
+	 * @brief 去掉按本模式写入的开头与结尾的分隔行，以及结尾的换行
+	 *
+	 * 逐字比较分隔行，不是按本模式输出的日志（如结构化日志）只去掉结尾的换行
+	 *
+	 * @param _Log         UTF-8日志
+	 * @param _LogLevel    日志等级
+	 */
+	std::string_view trimBanners(std::string_view _Log, const LOGLEVEL _LogLevel) const
+	{
+		const std::string& banner = levelBanner<char>(_LogLevel);
+		for (auto it = m_Header.begin(); it != m_Header.end() && it->m_Type == LOG_FIELD_BANNER && _Log.substr(0, banner.size()) == banner; ++it)
+			_Log.remove_prefix(banner.size());
+		for (auto it = m_Footer.rbegin(); it != m_Footer.rend() && it->m_Type == LOG_FIELD_BANNER
+			&& _Log.size() >= banner.size() && _Log.substr(_Log.size() - banner.size()) == banner; ++it)
+			_Log.remove_suffix(banner.size());
+		if (!_Log.empty() && _Log.back() == '\n')
+			_Log.remove_suffix(1);
+		return _Log;
+	}
+
+	/**
+	 * @brief 追加正文之前或之后的部分
+	 *
+	 * @param _Buffer      OUT 日志
+	 * @param _Footer      true为正文之后的部分
+	 * @param _Precision   时间精度
+	 */
+	template<typename Char>
+	void append
+	(
+		std::basic_string<Char>& _Buffer,
+		const bool               _Footer,
+		const LOGLEVEL         _LogLevel,
+		const Char*            _FileName,
+		const Char*            _Function,
+		const uint           _LineNumber,
+		const int64_t              _Time,
+		const uint             _ThreadId,
+		const LogThreadName*   _ThreadName,
+		const LOGTIMEPRECISION _Precision
+	) const;
+
+private:
+	/* 文本字段另存一份宽字符，宽字符日志直接追加 */
+	struct Field : LogPatternField
+	{
+		std::wstring m_wstrText;
+	};
+
+	static void compile(const std::vector<LogPatternField>& _Fields, std::vector<Field>& _Compiled)
+	{
+		for (const LogPatternField& field : _Fields)
+		{
+			Field& compiled = _Compiled.emplace_back();
+			static_cast<LogPatternField&>(compiled) = field;
+			LogAppendWide(compiled.m_wstrText, field.m_strText.data(), field.m_strText.size());
+		}
+	}
+
+	std::string        m_strPattern;
+	std::vector<Field> m_Header;
+	std::vector<Field> m_Footer;
+};
+
+template<typename Char>
+void LogPattern::append
+(
+	std::basic_string<Char>& _Buffer,
+	const bool               _Footer,
+	const LOGLEVEL         _LogLevel,
+	const Char*            _FileName,
+	const Char*            _Function,
+	const uint           _LineNumber,
+	const int64_t              _Time,
+	const uint             _ThreadId,
+	const LogThreadName*   _ThreadName,
+	const LOGTIMEPRECISION _Precision
+) const
+{
+	thread_local LogTimeCache<Char> timeCache;
+	for (const Field& field : _Footer ? m_Footer : m_Header)
+	{
+		const size_t nOld = _Buffer.size();
+		switch (field.m_Type)
+		{
+		case LOG_FIELD_TEXT:
+			if constexpr (std::is_same_v<Char, char>)
+				_Buffer += field.m_strText;
+			else
+				_Buffer += field.m_wstrText;
+			break;
+		case LOG_FIELD_TIME:
+			timeCache.append(_Buffer, _Time, _Precision);
+			break;
+		case LOG_FIELD_LEVEL:
+		{
+			const auto it = LOGLEVEL_WSTRING.find(_LogLevel);
+			if (it != LOGLEVEL_WSTRING.end())
+			{
+				// 等级名称只含ASCII字符
+				for (const wchar_t* name = it->second; *name; ++name)
+					_Buffer += static_cast<Char>(*name);
+			}
+			break;
+		}
+		case LOG_FIELD_PID:
+			appendNumber(_Buffer, LogIdCache::processId(), 0);
+			break;
+		case LOG_FIELD_TID:
+			appendNumber(_Buffer, _ThreadId, 0);
+			break;
+		case LOG_FIELD_THREAD:
+			if (!_ThreadName)
+				appendNumber(_Buffer, _ThreadId, 0);
+			else if constexpr (std::is_same_v<Char, char>)
+				_Buffer += _ThreadName->m_strName;
+			else
+				_Buffer += _ThreadName->m_wstrName;
+			break;
+		case LOG_FIELD_FILE:
+			_Buffer += _FileName;
+			break;
+		case LOG_FIELD_FUNCTION:
+			_Buffer += _Function;
+			break;
+		case LOG_FIELD_LINE:
+			appendNumber(_Buffer, _LineNumber, 0);
+			break;
+		case LOG_FIELD_BANNER:
+			_Buffer += levelBanner<Char>(_LogLevel);
+			break;
+		}
+		if (_Buffer.size() - nOld < field.m_nWidth)
+			_Buffer.append(field.m_nWidth - (_Buffer.size() - nOld), static_cast<Char>(' '));
+	}
+}
+
+void Log::setPattern(const std::string& _Pattern)
+{
+	// 重新加载配置时模式多半未变，不替换
+	if (LogSnapshot<LogPattern>::Reader()->pattern() == _Pattern)
+		return;
+	LogSnapshot<LogPattern>::publish(LogPattern(_Pattern));
+}
+
+std::string Log::getPattern()
+{
+	return LogSnapshot<LogPattern>::Reader()->pattern();
+}
+
+Log::PatternReader::PatternReader() : m_Pattern(LogSnapshot<LogPattern>::acquire()) {}
+
+Log::PatternReader::~PatternReader() { LogSnapshot<LogPattern>::release(); }
+
+#ifndef _WIN32
+static std::string_view trimBanners(std::string_view _Log, LOGLEVEL _LogLevel)
+{
+	return LogSnapshot<LogPattern>::Reader()->trimBanners(_Log, _LogLevel);
+}
+#endif // _WIN32
+
+void Log::formatLogHeader
+(
+	const LogPattern& _Pattern,	// 输出模式
+	std::wstring&    _Buffer,	// 格式化后的日志
+	const LOGLEVEL _LogLevel,	// Log等级
+	const wchar_t* _FileName,	// 函数所在文件名
+	const wchar_t* _Function,	// 函数名
+	const uint   _LineNumber,	// 行号
+	const int64_t      _Time,	// 记录时间
+	const uint     _ThreadId,	// 调用线程号
+	const LogThreadName* _ThreadName	// 调用线程的名称
+)
+{
+	// 清空之前的日志，保留已分配的空间
+	_Buffer.clear();
+	_Pattern.append(_Buffer, false, _LogLevel, _FileName, _Function, _LineNumber,
+		_Time, _ThreadId, _ThreadName, getTimePrecision());
+}
+
+void Log::formatLogHeader
+(
+	const LogPattern& _Pattern,	// 输出模式
+	std::string&     _Buffer,	// 格式化后的日志
+	const LOGLEVEL _LogLevel,	// Log等级
+	const char*    _FileName,	// 函数所在文件名
+	const char*    _Function,	// 函数名
+	const uint   _LineNumber,	// 行号
+	const int64_t      _Time,	// 记录时间
+	const uint     _ThreadId,	// 调用线程号
+	const LogThreadName* _ThreadName	// 调用线程的名称
+)
+{
+	_Buffer.clear();
+	_Pattern.append(_Buffer, false, _LogLevel, _FileName, _Function, _LineNumber,
+		_Time, _ThreadId, _ThreadName, getTimePrecision());
+}
+
+void Log::formatKvHeader
+(
+	std::string&     _Buffer,	// 格式化后的日志
+	const LOGKVFORMAT _Format,	// 输出格式
+	const LOGLEVEL _LogLevel,	// Log等级
+	const LogSite&     _Site,	// 调用点
+	const int64_t      _Time,	// 记录时间
+	const uint     _ThreadId,	// 调用线程号
+	const LogThreadName* _ThreadName,	// 调用线程的名称
+	const char*     _Message	// 消息
+)
+{
+	static constexpr std::array<const char*, LOG_LEVEL_INFO + 1> LEVEL_NAMES { "NONE", "ERROR", "WARNING", "DEBUG", "INFO" };
+	const bool bJson = _Format == LOG_KV_JSON;
+	thread_local LogTimeCache<char> timeCache;
+	_Buffer.clear();
+
+	_Buffer += bJson ? "{\"time\":\"" : "time=\"";
+	timeCache.append(_Buffer, _Time, getTimePrecision());
+	_Buffer += bJson ? "\",\"level\":\"" : "\" level=";
+	_Buffer += LEVEL_NAMES.at(_LogLevel);
+	_Buffer += bJson ? "\",\"pid\":" : " pid=";
+	appendNumber(_Buffer, LogIdCache::processId(), 0);
+	_Buffer += bJson ? ",\"tid\":" : " tid=";
+	appendNumber(_Buffer, _ThreadId, 0);
+	if (_ThreadName)
+	{
+		_Buffer += bJson ? ",\"thread\":" : " thread=";
+		LogKvAppendString(_Buffer, _Format, std::string_view(_ThreadName->m_strName));
+	}
+	_Buffer += bJson ? ",\"file\":" : " file=";
+	LogKvAppendString(_Buffer, _Format, std::string_view(_Site.m_szFile));
+	_Buffer += bJson ? ",\"func\":" : " func=";
+	LogKvAppendString(_Buffer, _Format, std::string_view(_Site.m_szFunction));
+	_Buffer += bJson ? ",\"line\":" : " line=";
+	appendNumber(_Buffer, _Site.m_nLine, 0);
+	_Buffer += bJson ? ",\"msg\":" : " msg=";
+	LogKvAppendString(_Buffer, _Format, std::string_view(_Message ? _Message : ""));
+}
+
+void Log::formatLogFooter
+(
+	const LogPattern& _Pattern,	// 输出模式
+	std::wstring&    _Buffer,	// 格式化后的日志
+	const LOGLEVEL _LogLevel,	// Log等级
+	const wchar_t* _FileName,	// 函数所在文件名
+	const wchar_t* _Function,	// 函数名
+	const uint   _LineNumber,	// 行号
+	const int64_t      _Time,	// 记录时间
+	const uint     _ThreadId,	// 调用线程号
+	const LogThreadName* _ThreadName	// 调用线程的名称
+)
+{
+	_Pattern.append(_Buffer, true, _LogLevel, _FileName, _Function, _LineNumber,
+		_Time, _ThreadId, _ThreadName, getTimePrecision());
+}
+
+void Log::formatLogFooter
+(
+	const LogPattern& _Pattern,	// 输出模式
+	std::string&     _Buffer,	// 格式化后的日志
+	const LOGLEVEL _LogLevel,	// Log等级
+	const char*    _FileName,	// 函数所在文件名
+	const char*    _Function,	// 函数名
+	const uint   _LineNumber,	// 行号
+	const int64_t      _Time,	// 记录时间
+	const uint     _ThreadId,	// 调用线程号
+	const LogThreadName* _ThreadName	// 调用线程的名称
+)
+{
+	_Pattern.append(_Buffer, true, _LogLevel, _FileName, _Function, _LineNumber,
+		_Time, _ThreadId, _ThreadName, getTimePrecision());
+}
+
+/* 按当前区域设置转换文件中的日志，无法转换的字节原样保留 */
+static void appendWidened(std::wstring& _Out, std::string_view _Text)
+{
+	std::mbstate_t state {};
+	for (size_t i = 0; i < _Text.size();)
+	{
+		wchar_t wc;
+		size_t n = mbrtowc(&wc, _Text.data() + i, _Text.size() - i, &state);
+		if (n == static_cast<size_t>(-1) || n == static_cast<size_t>(-2))
+		{
+			wc = static_cast<unsigned char>(_Text[i]);
+			n = 1;
+			state = std::mbstate_t {};
+		}
+		else if (n == 0)
+		{
+			n = 1;
+		}
+		_Out.push_back(wc);
+		i += n;
+	}
+}
+
+bool Log::getLogFromFile(std::vector<std::wstring>& _LogTable)
+{
+	return getLogFromFile(_LogTable, LogQuery {});
+}
+
+bool Log::getLogFromFile(std::vector<std::wstring>& _LogTable, const LogQuery& _Query)
+{
+	// 先等待各线程队列中的日志输出，并将缓冲区中的日志写入文件
+	Flush();
+	const std::wstring wstrPath = getLogFile();
+
+	// 映射后的读取不需要持有锁，按当前的输出模式划分日志
+	LogReader reader;
+	if (!reader.setPattern(getPattern()) || !reader.open(wstrPath))
+		return false;
+	const bool bUtf8 = getEncoding() == LOG_ENCODING_UTF8;
+	for (const LogEntry& entry : reader.search(_Query))
+	{
+		std::wstring& wstrLog = _LogTable.emplace_back();
+		if (bUtf8)
+			LogAppendWide(wstrLog, entry.m_strText.data(), entry.m_strText.size());
+		else
+			appendWidened(wstrLog, entry.m_strText);
+	}
+	return true;
+}
+
+void Log::outputToTarget(const std::wstring& _Log, LOGLEVEL _LogLevel)
+{
+	countLevel(m_Counters.m_nWritten, _LogLevel);
+	outputText(_Log, _LogLevel);
+	outputToSinks(_Log, _LogLevel);
+	const LogSnapshot<LogConfig>::Reader config;
+	if (config->m_LogTarget & LOG_TARGET_BINARY)
+		m_BinaryFile.writeText(_LogLevel, _Log, config->m_wstrBinaryFile, m_FlushPolicy, m_RotatePolicy);
+}
+
+void Log::outputToTarget(const std::string& _Log, LOGLEVEL _LogLevel)
+{
+	countLevel(m_Counters.m_nWritten, _LogLevel);
+	outputText(_Log, _LogLevel);
+	outputToSinks(_Log, _LogLevel);
+	const LogSnapshot<LogConfig>::Reader config;
+	if (config->m_LogTarget & LOG_TARGET_BINARY)
+		m_BinaryFile.writeText(_LogLevel, _Log, config->m_wstrBinaryFile, m_FlushPolicy, m_RotatePolicy);
+}
+
+void Log::outputToSinks(const std::wstring& _Log, LOGLEVEL _LogLevel)
+{
+	if (m_SinkList.empty())
+		return;
+	thread_local std::string strLog;
+	strLog.clear();
+	LogAppendUtf8(strLog, _Log.data(), _Log.size());
+	outputToSinks(strLog, _LogLevel);
+}
+
+void Log::outputToSinks(const std::string& _Log, LOGLEVEL _LogLevel, bool _Structured)
+{
+	// 只拷贝一次，由需要该日志的目标共享
+	std::shared_ptr<const std::string> pLog;
+	for (const std::shared_ptr<LogSinkWorker>& worker : m_SinkList)
+	{
+		if (!worker->accepts(_LogLevel, _Structured))
+			continue;
+		if (!pLog)
+			pLog = std::make_shared<const std::string>(_Log);
+		worker->push(_LogLevel, pLog);
+	}
+}
+
+void Log::addSink(const std::shared_ptr<LogSink>& _Sink, size_t _QueueSize)
+{
+	if (!_Sink)
+		return;
+	std::scoped_lock<std::shared_mutex> writeLock(m_LogMutex);
+	for (const std::shared_ptr<LogSinkWorker>& worker : m_SinkList)
+	{
+		if (worker->sink() == _Sink)
+			return;
+	}
+	m_SinkList.push_back(std::make_shared<LogSinkWorker>(_Sink, _QueueSize));
+	m_nSinkCount.store(m_SinkList.size(), std::memory_order_relaxed);
+}
+
+void Log::removeSink(const std::shared_ptr<LogSink>& _Sink)
+{
+	std::shared_ptr<LogSinkWorker> removed;
+	{
+		std::scoped_lock<std::shared_mutex> writeLock(m_LogMutex);
+		auto it = std::find_if(m_SinkList.begin(), m_SinkList.end(),
+			[&_Sink](const std::shared_ptr<LogSinkWorker>& _Worker) { return _Worker->sink() == _Sink; });
+		if (it == m_SinkList.end())
+			return;
+		removed = *it;
+		m_SinkList.erase(it);
+		m_nSinkCount.store(m_SinkList.size(), std::memory_order_relaxed);
+	}
+	// 在锁外等待该目标输出剩余的日志
+	removed->stop();
+}
+
+/* 命名的日志实例，只增不减，实例不释放 */
+class LoggerRegistry
+{
+public:
+	Logger& get(const std::string& _Name)
+	{
+		std::scoped_lock<std::mutex> lock(m_Mutex);
+		Logger*& pLogger = m_Loggers[_Name];
+		if (!pLogger)
+		{
+			// 实例不析构，进程正常退出时输出各目标队列中的日志
+			if (m_Loggers.size() == 1)
+				std::atexit([] { loggerRegistry().flushAll(); });
+			pLogger = new Logger(_Name);
+		}
+		return *pLogger;
+	}
+	/* 刷新所有实例的输出目标 */
+	void flushAll()
+	{
+		std::vector<Logger*> loggers;
+		{
+			std::scoped_lock<std::mutex> lock(m_Mutex);
+			for (const auto& [strName, pLogger] : m_Loggers)
+				loggers.push_back(pLogger);
+		}
+		for (Logger* pLogger : loggers)
+			pLogger->flush();
+	}
+
+	static LoggerRegistry& loggerRegistry()
+	{
+		static LoggerRegistry* registry = new LoggerRegistry;
+		return *registry;
+	}
+
+private:
+	std::mutex                              m_Mutex;
+	std::unordered_map<std::string, Logger*> m_Loggers;
+};
+
+Logger& Log::getLogger(const std::string& _Name)
+{
+	return LoggerRegistry::loggerRegistry().get(_Name);
+}
+
+void Logger::addSink(const std::shared_ptr<LogSink>& _Sink, size_t _QueueSize)
+{
+	if (!_Sink)
+		return;
+	std::scoped_lock<std::shared_mutex> writeLock(m_SinkMutex);
+	for (const std::shared_ptr<LogSinkWorker>& worker : m_SinkList)
+	{
+		if (worker->sink() == _Sink)
+			return;
+	}
+	m_SinkList.push_back(std::make_shared<LogSinkWorker>(_Sink, _QueueSize));
+}
+
+void Logger::removeSink(const std::shared_ptr<LogSink>& _Sink)
+{
+	std::shared_ptr<LogSinkWorker> removed;
+	{
+		std::scoped_lock<std::shared_mutex> writeLock(m_SinkMutex);
+		auto it = std::find_if(m_SinkList.begin(), m_SinkList.end(),
+			[&_Sink](const std::shared_ptr<LogSinkWorker>& _Worker) { return _Worker->sink() == _Sink; });
+		if (it == m_SinkList.end())
+			return;
+		removed = *it;
+		m_SinkList.erase(it);
+	}
+	removed->stop();
+}
+
+void Logger::flush()
+{
+	std::vector<std::shared_ptr<LogSinkWorker>> sinks;
+	{
+		std::shared_lock<std::shared_mutex> readLock(m_SinkMutex);
+		sinks = m_SinkList;
+	}
+	for (const std::shared_ptr<LogSinkWorker>& worker : sinks)
+		worker->flush();
+}
+
+void Logger::writeLog
+(
+	const LOGLEVEL _LogLevel,	// Log等级
+	const LogSite&     _Site,	// 调用点
+	const char*      _Format,	// 格式化
+	...							// 参数列表
+)
+{
+	if (!isLevelEnabled(_LogLevel))
+		return;
+
+	va_list args;
+	va_start(args, _Format);
+	LogRecord& record = Log::acquireRecord(_LogLevel);
+	Log::formatLog(record.m_strLog, _LogLevel, _Site.m_szFile, _Site.m_szFunction, _Site.m_nLine, _Format, args);
+	va_end(args);
+	output(record.m_strLog, _LogLevel);
+}
+
+void Logger::output(const std::string& _Log, LOGLEVEL _LogLevel)
+{
+	{
+		// 只拷贝一次，由需要该日志的目标共享
+		std::shared_ptr<const std::string> pLog;
+		std::shared_lock<std::shared_mutex> readLock(m_SinkMutex);
+		for (const std::shared_ptr<LogSinkWorker>& worker : m_SinkList)
+		{
+			if (!worker->accepts(_LogLevel, false))
+				continue;
+			if (!pLog)
+				pLog = std::make_shared<const std::string>(_Log);
+			worker->push(_LogLevel, pLog);
+		}
+	}
+	if (getPropagate())
+	{
+		Log::CallerLock writeLock;
+		Log::outputToTarget(_Log, _LogLevel);
+	}
+}
+
+void Log::flushSinks()
+{
+	std::vector<std::shared_ptr<LogSinkWorker>> sinks;
+	{
+		std::shared_lock<std::shared_mutex> readLock(m_LogMutex);
+		sinks = m_SinkList;
+	}
+	for (const std::shared_ptr<LogSinkWorker>& worker : sinks)
+		worker->flush();
+	LoggerRegistry::loggerRegistry().flushAll();
+}
+
+void Log::outputText(const std::wstring& _Log, LOGLEVEL _LogLevel)
+{
+	const LogSnapshot<LogConfig>::Reader config;
+	const LOGTARGET target = config->m_LogTarget;
+	if (target & LOG_TARGET_CONSOLE)
+	{
+		// 不经过std::wcout，转换后整批写入标准输出
+		m_Console.append(_Log, _LogLevel, m_ConsolePolicy);
+		if (!m_Console.isBatch())
+			m_Console.flush(m_ConsolePolicy);
+	}
+	if (target & LOG_TARGET_FILE)
+	{
+		// 文件在Log生命周期内保持打开，路径变化时重新打开
+		openLogFile(*config, config.generation());
+		m_LogFile.write(_Log, _LogLevel, m_FlushPolicy, m_RotatePolicy);
+	}
+}
+
+void Log::outputText(const std::string& _Log, LOGLEVEL _LogLevel)
+{
+	const LogSnapshot<LogConfig>::Reader config;
+	const LOGTARGET target = config->m_LogTarget;
+	if (target & LOG_TARGET_CONSOLE)
+	{
+		m_Console.append(_Log, _LogLevel, m_ConsolePolicy);
+		if (!m_Console.isBatch())
+			m_Console.flush(m_ConsolePolicy);
+	}
+	if (target & LOG_TARGET_FILE)
+	{
+		openLogFile(*config, config.generation());
+		m_LogFile.write(_Log, _LogLevel, m_FlushPolicy, m_RotatePolicy);
+	}
+}
+
+void Log::outputRecord(const LogRecord& _Record)
+{
+	if (_Record.m_bStructured)
+	{
+		countLevel(m_Counters.m_nWritten, _Record.m_Level);
+		outputText(_Record.m_strLog, _Record.m_Level);
+		outputToSinks(_Record.m_strLog, _Record.m_Level, true);
+		const LogSnapshot<LogConfig>::Reader config;
+		if (config->m_LogTarget & LOG_TARGET_BINARY)
+			m_BinaryFile.writeText(_Record.m_Level, _Record.m_strLog, config->m_wstrBinaryFile, m_FlushPolicy, m_RotatePolicy);
+		return;
+	}
+	if (!_Record.m_bBinary)
+	{
+		if (_Record.m_bUtf8)
+			outputToTarget(_Record.m_strLog, _Record.m_Level);
+		else
+			outputToTarget(_Record.m_wstrLog, _Record.m_Level);
+		return;
+	}
+
+	// 携带二进制参数的日志，文本目标输出已格式化的部分，二进制目标按调用点记录
+	countLevel(m_Counters.m_nWritten, _Record.m_Level);
+	if (_Record.m_bUtf8 ? !_Record.m_strLog.empty() : !_Record.m_wstrLog.empty())
+	{
+		if (_Record.m_bUtf8)
+		{
+			outputText(_Record.m_strLog, _Record.m_Level);
+			outputToSinks(_Record.m_strLog, _Record.m_Level);
+		}
+		else
+		{
+			outputText(_Record.m_wstrLog, _Record.m_Level);
+			outputToSinks(_Record.m_wstrLog, _Record.m_Level);
+		}
+	}
+	const LogSnapshot<LogConfig>::Reader config;
+	if (config->m_LogTarget & LOG_TARGET_BINARY)
+		m_BinaryFile.writeEvent(_Record, config->m_wstrBinaryFile, m_FlushPolicy, m_RotatePolicy);
+}
+
+void Log::openLogFile(const LogConfig& _Config, uint64_t _Generation)
+{
+	// 快照未变化时不比较路径；文件未能打开时每条日志重试
+	if (m_LogFile.isOpen() && _Generation == m_nFileGeneration)
+		return;
+	if (!m_LogFile.isOpen() || m_LogFile.path() != _Config.m_wstrLogFile)
+		m_LogFile.open(_Config.m_wstrLogFile);
+	m_nFileGeneration = _Generation;
+}
+
+void Log::updateConfig(const std::function<void(LogConfig&)>& _Update)
+{
+	std::scoped_lock<std::mutex> lock(m_ConfigMutex);
+	LogConfig config = *LogSnapshot<LogConfig>::Reader();
+	_Update(config);
+	config.m_LogLevel = getLogLevel();
+	LogSnapshot<LogConfig>::publish(std::move(config));
+}
+
+void Log::setLogTarget(LOGTARGET _LogTarget)
+{
+	updateConfig([_LogTarget](LogConfig& _Config) { _Config.m_LogTarget = _LogTarget; });
+}
+
+void Log::setLogFile(const std::wstring& _Path)
+{
+	updateConfig([&_Path](LogConfig& _Config) { _Config.m_wstrLogFile = _Path; });
+}
+
+void Log::setBinaryFile(const std::wstring& _Path)
+{
+	updateConfig([&_Path](LogConfig& _Config) { _Config.m_wstrBinaryFile = _Path; });
+}
+
+LogConfig Log::getConfig()
+{
+	LogConfig config = *LogSnapshot<LogConfig>::Reader();
+	config.m_LogLevel = getLogLevel();
+	return config;
+}
+
+void Log::setConfig(const LogConfig& _Config)
+{
+	setLogLevel(_Config.m_LogLevel);
+	updateConfig([&_Config](LogConfig& _Current) { _Current = _Config; });
+}
+
+/* 去掉首尾空白 */
+static std::string_view trimConfig(std::string_view _Text)
+{
+	const size_t nBegin = _Text.find_first_not_of(" \t\r");
+	if (nBegin == std::string_view::npos)
+		return {};
+	return _Text.substr(nBegin, _Text.find_last_not_of(" \t\r") + 1 - nBegin);
+}
+
+bool Log::loadConfig(const std::wstring& _Path)
+{
+	std::ifstream file(std::filesystem::path(_Path), std::ios::binary);
+	if (!file)
+		return false;
+
+	LogConfig config = getConfig();
+	std::string strPattern;
+	bool bPattern = false;
+	std::string strLine;
+	while (std::getline(file, strLine))
+	{
+		std::string_view line = trimConfig(strLine);
+		if (line.empty() || line[0] == '#')
+			continue;
+		const size_t nEqual = line.find('=');
+		if (nEqual == std::string_view::npos)
+			return false;
+		const std::string_view key = trimConfig(line.substr(0, nEqual));
+		const std::string_view value = trimConfig(line.substr(nEqual + 1));
+		if (key == "level")
+		{
+			// 等级名称不区分大小写
+			std::wstring wstrLevel;
+			for (const char c : value)
+				wstrLevel += static_cast<wchar_t>(toupper(static_cast<unsigned char>(c)));
+			const auto it = std::find_if(LOGLEVEL_WSTRING.begin(), LOGLEVEL_WSTRING.end(),
+				[&wstrLevel](const auto& _Level) { return wstrLevel == _Level.second; });
+			if (it != LOGLEVEL_WSTRING.end())
+				config.m_LogLevel = it->first;
+			else if (wstrLevel == L"NONE")
+				config.m_LogLevel = LOG_LEVEL_NONE;
+			else
+				return false;
+		}
+		else if (key == "target")
+		{
+			int nTarget = LOG_TARGET_NONE;
+			size_t nPos = 0;
+			while (nPos <= value.size())
+			{
+				const size_t nEnd = std::min(value.find_first_of(",|", nPos), value.size());
+				const std::string_view name = trimConfig(value.substr(nPos, nEnd - nPos));
+				if (name == "console")
+					nTarget |= LOG_TARGET_CONSOLE;
+				else if (name == "file")
+					nTarget |= LOG_TARGET_FILE;
+				else if (name == "binary")
+					nTarget |= LOG_TARGET_BINARY;
+				else if (name != "none")
+					return false;
+				nPos = nEnd + 1;
+			}
+			config.m_LogTarget = static_cast<LOGTARGET>(nTarget);
+		}
+		else if (key == "file" || key == "binary_file")
+		{
+			std::wstring& wstrPath = key == "file" ? config.m_wstrLogFile : config.m_wstrBinaryFile;
+			wstrPath.clear();
+			LogAppendWide(wstrPath, value.data(), value.size());
+		}
+		else if (key == "pattern")
+		{
+			strPattern = value;
+			bPattern = true;
+		}
+		else
+			return false;
+	}
+
+	if (bPattern)
+		setPattern(strPattern);
+	setConfig(config);
+	return true;
+}
+
+#ifndef _WIN32
+/* 收到信号时重新读取配置文件，信号处理函数只向管道写入一个字节，读取在专用线程中进行 */
+class LogConfigReloader
+{
+public:
+	static bool watch(const std::wstring& _Path, int _Signal)
+	{
+		std::scoped_lock<std::mutex> lock(m_Mutex);
+		m_wstrPath = _Path;
+		if (m_nPipe[0] < 0)
+		{
+			if (pipe(m_nPipe) != 0)
+				return false;
+			fcntl(m_nPipe[0], F_SETFD, FD_CLOEXEC);
+			fcntl(m_nPipe[1], F_SETFD, FD_CLOEXEC);
+			// 管道满时丢弃信号，已有待处理的读取即可
+			fcntl(m_nPipe[1], F_SETFL, fcntl(m_nPipe[1], F_GETFL) | O_NONBLOCK);
+			std::thread(run).detach();
+		}
+
+		struct sigaction action {};
+		action.sa_handler = onSignal;
+		sigemptyset(&action.sa_mask);
+		action.sa_flags = SA_RESTART;
+		return sigaction(_Signal, &action, nullptr) == 0;
+	}
+
+private:
+	static void onSignal(int)
+	{
+		const int nErrno = errno;
+		const char c = 0;
+		const ssize_t nWritten = write(m_nPipe[1], &c, 1);
+		(void)nWritten;
+		errno = nErrno;
+	}
+
+	static void run()
+	{
+		char buffer[64];
+		while (true)
+		{
+			const ssize_t nRead = read(m_nPipe[0], buffer, sizeof buffer);
+			if (nRead < 0 && errno == EINTR)
+				continue;
+			if (nRead <= 0)
+				return;
+			std::wstring wstrPath;
+			{
+				std::scoped_lock<std::mutex> lock(m_Mutex);
+				wstrPath = m_wstrPath;
+			}
+			Log::loadConfig(wstrPath);
+		}
+	}
+
+	static inline int          m_nPipe[2] { -1, -1 };   // 信号处理函数与读取线程之间的管道
+	static inline std::mutex   m_Mutex;                  // 保护m_wstrPath
+	static inline std::wstring m_wstrPath;               // 配置文件路径
+};
+#endif // _WIN32
+
+bool Log::reloadOnSignal(const std::wstring& _Path, int _Signal)
+{
+#ifdef _WIN32
+	(void)_Path;
+	(void)_Signal;
+	return false;
+#else
+	return LogConfigReloader::watch(_Path, _Signal);
+#endif // _WIN32
+}
+
+LogRotatePolicy Log::getRotatePolicy()
+{
+	std::shared_lock<std::shared_mutex> readLock(m_LogMutex);
+	return m_RotatePolicy;
+}
+
+void Log::setRotatePolicy(const LogRotatePolicy& _Policy)
+{
+	std::scoped_lock<std::shared_mutex> writeLock(m_LogMutex);
+	m_RotatePolicy = _Policy;
+}
+
+LogCompressPolicy Log::getCompressPolicy()
+{
+	std::shared_lock<std::shared_mutex> readLock(m_LogMutex);
+	return m_CompressPolicy;
+}
+
+void Log::setCompressPolicy(const LogCompressPolicy& _Policy)
+{
+	std::scoped_lock<std::shared_mutex> writeLock(m_LogMutex);
+	m_CompressPolicy = _Policy;
+	m_LogFile.setCompression(_Policy);
+}
+
+LogFlushPolicy Log::getFlushPolicy()
+{
+	std::shared_lock<std::shared_mutex> readLock(m_LogMutex);
+	return m_FlushPolicy;
+}
+
+void Log::setFlushPolicy(const LogFlushPolicy& _Policy)
+{
+	std::scoped_lock<std::shared_mutex> writeLock(m_LogMutex);
+	m_FlushPolicy = _Policy;
+}
+
+LogStats Log::getStats() noexcept
+{
+	LogStats stats;
+	for (size_t i = 0; i < stats.m_nWritten.size(); ++i)
+	{
+		stats.m_nWritten[i] = m_Counters.m_nWritten[i].load(std::memory_order_relaxed);
+		stats.m_nDropped[i] = m_Counters.m_nDropped[i].load(std::memory_order_relaxed);
+	}
+	stats.m_nConsoleDropped = m_Console.droppedCount();
+	stats.m_nQueueHighWater = m_Counters.m_nQueueHighWater.load(std::memory_order_relaxed);
+	stats.m_nLockWaits = m_Counters.m_nLockWaits.load(std::memory_order_relaxed);
+	stats.m_nLockWaitNs = m_Counters.m_nLockWaitNs.load(std::memory_order_relaxed);
+	stats.m_nConsoleBytes = m_Console.bytesWritten();
+	stats.m_nFileBytes = m_Counters.m_File.m_nBytes.load(std::memory_order_relaxed);
+	stats.m_nBinaryBytes = m_Counters.m_Binary.m_nBytes.load(std::memory_order_relaxed);
+	stats.m_nRotations = m_Counters.m_File.m_nRotations.load(std::memory_order_relaxed)
+		+ m_Counters.m_Binary.m_nRotations.load(std::memory_order_relaxed);
+	stats.m_nSuppressed = siteRegistry().suppressedCount();
+	for (size_t i = 0; i < LOG_STATS_FLUSH_BUCKETS; ++i)
+	{
+		stats.m_nFlushLatency[i] = m_Counters.m_File.m_nFlushLatency[i].load(std::memory_order_relaxed)
+			+ m_Counters.m_Binary.m_nFlushLatency[i].load(std::memory_order_relaxed);
+	}
+	return stats;
+}
+
+void Log::waitLock()
+{
+	const uint64_t tBegin = steadyNanoseconds();
+	m_LogMutex.lock();
+	m_Counters.m_nLockWaits.fetch_add(1, std::memory_order_relaxed);
+	m_Counters.m_nLockWaitNs.fetch_add(steadyNanoseconds() - tBegin, std::memory_order_relaxed);
+}
+
+LogCrashPolicy Log::getCrashPolicy()
+{
+	std::shared_lock<std::shared_mutex> readLock(m_LogMutex);
+	return m_CrashPolicy;
+}
+
+void Log::setCrashPolicy(const LogCrashPolicy& _Policy)
+{
+	std::scoped_lock<std::shared_mutex> writeLock(m_LogMutex);
+	m_CrashPolicy = _Policy;
+	if (m_Log)
+		applyCrashPolicy();
+}
+
+void Log::applyCrashPolicy()
+{
+	// 先写出写缓冲区，重新映射后缓冲区从空开始
+	m_LogFile.setCrashBuffer(nullptr);
+	m_CrashBuffer.close();
+	if (m_CrashPolicy.m_bEnable && m_CrashBuffer.open(m_CrashPolicy))
+		m_LogFile.setCrashBuffer(&m_CrashBuffer);
+}
+
+LogConsolePolicy Log::getConsolePolicy()
+{
+	std::shared_lock<std::shared_mutex> readLock(m_LogMutex);
+	return m_ConsolePolicy;
+}
+
+void Log::setConsolePolicy(const LogConsolePolicy& _Policy)
+{
+	std::scoped_lock<std::shared_mutex> writeLock(m_LogMutex);
+	m_ConsolePolicy = _Policy;
+}
+
+uint64_t Log::getConsoleDroppedCount() noexcept
+{
+	return m_Console.droppedCount();
+}
+
+void Log::Flush()
+{
+	{
+		std::unique_lock<std::mutex> queueLock(m_QueueMutex);
+		if (m_bWriterRunning.load(std::memory_order_acquire))
+		{
+			// 各后台线程在一轮输出后发现其队列均为空，才会确认该请求
+			uint64_t request = ++m_nFlushRequest;
+			for (size_t i = 0; i < m_Writers.m_nCount.load(std::memory_order_relaxed); ++i)
+			{
+				m_Writers.m_Slots[i].m_bWakeup = true;
+				m_Writers.m_Slots[i].m_Cond.notify_one();
+			}
+			// 重启写线程期间继续等待，由新的写线程确认
+			m_FlushCond.wait(queueLock, [request]
+			{
+				if (!m_bWriterRunning.load(std::memory_order_acquire))
+					return !m_Writers.m_bRestart.load(std::memory_order_acquire);
+				for (size_t i = 0; i < m_Writers.m_nCount.load(std::memory_order_relaxed); ++i)
+				{
+					if (m_Writers.m_Slots[i].m_nFlushDone < request)
+						return false;
+				}
+				return true;
+			});
+		}
+	}
+
+	{
+		std::scoped_lock<std::shared_mutex> writeLock(m_LogMutex);
+		m_Console.flush(m_ConsolePolicy);
+		m_LogFile.flush();
+		m_BinaryFile.flush();
+	}
+	flushSinks();
+}
+
+void Log::Shutdown()
+{
+	{
+		std::scoped_lock<std::mutex> queueLock(m_QueueMutex);
+		if (!m_bWriterRunning.load(std::memory_order_acquire))
+			return;
+		m_LogMode = LOG_MODE_SYNC;
+	}
+	// 后台线程退出前会输出队列中剩余的日志
+	if (!stopWriters())
+		return;
+
+	// 输出后台线程退出前最后一刻入队的日志
+	std::vector<std::shared_ptr<LogRingBuffer>> rings;
+	{
+		std::scoped_lock<std::mutex> ringLock(m_RingMutex);
+		rings = m_RingList;
+	}
+	while (drainRings(rings))
+		;
+	m_FlushCond.notify_all();
+
+	{
+		std::scoped_lock<std::shared_mutex> writeLock(m_LogMutex);
+		m_Console.flush(m_ConsolePolicy);
+		m_LogFile.flush();
+		m_BinaryFile.flush();
+	}
+	flushSinks();
+}
+
+int64_t Log::currentTime() noexcept
+{
+#ifdef LOG_HAS_TSC
+	// 与setClockSource的release配对，读到LOG_CLOCK_TSC时频率已测量
+	if (m_ClockSource.load(std::memory_order_acquire) == LOG_CLOCK_TSC)
+		return LogTscClock::now();
+#endif // LOG_HAS_TSC
+	return systemNanoseconds();
+}
+
+void Log::setClockSource(LOGCLOCK _Clock)
+{
+#ifdef LOG_HAS_TSC
+	if (_Clock == LOG_CLOCK_TSC && !LogTscClock::prepare())
+		_Clock = LOG_CLOCK_SYSTEM;
+#else
+	_Clock = LOG_CLOCK_SYSTEM;
+#endif // LOG_HAS_TSC
+	m_ClockSource.store(_Clock, std::memory_order_release);
+}
+
+/* 清空复用的记录，保留缓冲区容量 */
+static void resetRecord(LogRecord& _Record, const LOGLEVEL _LogLevel) noexcept
+{
+	_Record.m_Level = _LogLevel;
+	_Record.m_bUtf8 = false;
+	_Record.m_bStructured = false;
+	_Record.m_bBinary = false;
+	_Record.m_pfnFormat = nullptr;
+	_Record.m_pSite = nullptr;
+	_Record.m_wstrLog.clear();
+	_Record.m_strLog.clear();
+}
+
+LogRecord& Log::acquireRecord(const LOGLEVEL _LogLevel)
+{
+	// 入队时与槽位中的记录交换，稳定后各缓冲区在调用线程与后台线程之间循环使用
+	thread_local LogRecord record = []
+	{
+		LogRecord result;
+		result.m_wstrLog.reserve(512);
+		return result;
+	}();
+	resetRecord(record, _LogLevel);
+	return record;
+}
+
+LogRecord& Log::acquireBacktrace(const LOGLEVEL _LogLevel)
+{
+	LogRecord& record = LogBacktrace::next(std::max<size_t>(getBacktraceCount(), 1));
+	resetRecord(record, _LogLevel);
+	return record;
+}
+
+void Log::dumpBacktrace(bool _Locked)
+{
+	if (LogBacktrace::empty())
+		return;
+	// 回溯缓冲已关闭时丢弃保存的记录
+	if (getBacktraceLevel() == LOG_LEVEL_NONE)
+	{
+		LogBacktrace::clear();
+		return;
+	}
+
+	LogBacktrace::drain([_Locked](LogRecord& _Record)
+	{
+		if (!_Locked)
+		{
+			pushToRing(_Record);
+			return;
+		}
+		if (_Record.m_pfnFormat)
+			renderRecord(_Record);
+		outputRecord(_Record);
+	});
+}
+
+void Log::stampRecord(LogRecord& _Record)
+{
+	_Record.m_nTime = currentTime();
+	_Record.m_nThreadId = LogIdCache::threadId();
+	_Record.m_pThreadName = LogIdCache::threadName();
+}
+
+void Log::renderRecord(LogRecord& _Record)
+{
+	const LogSite* site = _Record.m_pSite;
+	const PatternReader pattern;
+	if (_Record.m_bUtf8)
+	{
+		formatLogHeader(*pattern, _Record.m_strLog, _Record.m_Level, site->m_szFile, site->m_szFunction,
+			site->m_nLine, _Record.m_nTime, _Record.m_nThreadId, _Record.m_pThreadName);
+		_Record.m_pfnFormat(_Record);
+		formatLogFooter(*pattern, _Record.m_strLog, _Record.m_Level, site->m_szFile, site->m_szFunction,
+			site->m_nLine, _Record.m_nTime, _Record.m_nThreadId, _Record.m_pThreadName);
+	}
+	else
+	{
+		formatLogHeader(*pattern, _Record.m_wstrLog, _Record.m_Level, site->m_wszFile, site->m_wszFunction,
+			site->m_nLine, _Record.m_nTime, _Record.m_nThreadId, _Record.m_pThreadName);
+		_Record.m_pfnFormat(_Record);
+		formatLogFooter(*pattern, _Record.m_wstrLog, _Record.m_Level, site->m_wszFile, site->m_wszFunction,
+			site->m_nLine, _Record.m_nTime, _Record.m_nThreadId, _Record.m_pThreadName);
+	}
+	_Record.m_pfnFormat = nullptr;
+}
+
+/* 汇总日志的正文，未输出的条数保存在m_strArgs中 */
+static void formatSummary(LogRecord& _Record)
+{
+	uint64_t nCount = 0;
+	memcpy(&nCount, _Record.m_strArgs.data(), sizeof nCount);
+	char szText[128];
+	const int nLen = snprintf(szText, sizeof szText, SUPPRESSED_FORMAT, static_cast<unsigned long long>(nCount));
+	if (nLen <= 0)
+		return;
+	if (_Record.m_bUtf8)
+		_Record.m_strLog.append(szText, static_cast<size_t>(nLen));
+	else
+		_Record.m_wstrLog.append(szText, szText + nLen);
+}
+
+void Log::writeSummary(const LogSite& _Site, const LOGLEVEL _LogLevel, const uint64_t _Count)
+{
+	// 低于日志等级的日志只进入回溯缓冲，不汇总输出
+	if (isBacktraced(_LogLevel))
+		return;
+	LogRecord& record = acquireRecord(_LogLevel);
+	record.m_bUtf8 = getEncoding() == LOG_ENCODING_UTF8;
+	stampRecord(record);
+	record.m_pSite = &_Site;
+	record.m_pfnFormat = formatSummary;
+	record.m_strArgs.assign(reinterpret_cast<const char*>(&_Count), sizeof _Count);
+	renderRecord(record);
+
+	std::scoped_lock<std::shared_mutex> writeLock(m_LogMutex);
+	outputRecord(record);
+}
+
+void Log::pushToRing(LogRecord& _Record)
+{
+	thread_local LogRingHolder holder;
+	if (!holder.m_pRing)
+	{
+		// 每个线程只在第一次写日志时注册一次
+		holder.m_pRing = std::make_shared<LogRingBuffer>(getQueueCapacity(), LogNuma::currentNode());
+		std::scoped_lock<std::mutex> ringLock(m_RingMutex);
+		holder.m_pRing->setWriter(m_Writers.writerOf(holder.m_pRing->node()));
+		m_RingList.push_back(holder.m_pRing);
+		m_nRingVersion.fetch_add(1, std::memory_order_release);
+	}
+
+	LogRingBuffer* ring = holder.m_pRing.get();
+	const uint64_t timestamp = steadyNanoseconds();
+	while (!ring->push(timestamp, _Record))
+	{
+		if (!m_bWriterRunning.load(std::memory_order_acquire) && !m_Writers.m_bRestart.load(std::memory_order_acquire))
+		{
+			// 后台线程已停止，退化为同步输出
+			CallerLock writeLock;
+			if (_Record.m_pfnFormat)
+				renderRecord(_Record);
+			outputRecord(_Record);
+			return;
+		}
+
+		switch (getOverflowPolicy())
+		{
+		case LOG_OVERFLOW_DROP_NEWEST:
+			m_nDroppedCount.fetch_add(1, std::memory_order_relaxed);
+			countLevel(m_Counters.m_nDropped, _Record.m_Level);
+			return;
+		case LOG_OVERFLOW_DROP_OLDEST:
+		{
+			LOGLEVEL level = LOG_LEVEL_NONE;
+			if (ring->pop(nullptr, &level))
+			{
+				m_nDroppedCount.fetch_add(1, std::memory_order_relaxed);
+				countLevel(m_Counters.m_nDropped, level);
+			}
+			break;
+		}
+		default:
+			wakeWriter(ring->writer());
+			std::this_thread::yield();
+			break;
+		}
+	}
+
+	// 队列深度的最大值，只在超过已记录的值时写入
+	const uint64_t depth = ring->size();
+	if (depth > m_Counters.m_nQueueHighWater.load(std::memory_order_relaxed))
+	{
+		uint64_t highWater = m_Counters.m_nQueueHighWater.load(std::memory_order_relaxed);
+		while (depth > highWater && !m_Counters.m_nQueueHighWater.compare_exchange_weak(highWater, depth, std::memory_order_relaxed))
+			;
+	}
+	wakeWriter(ring->writer());
+}
+
+void Log::wakeWriter(size_t _Writer)
+{
+	// 与后台线程休眠前的检查配对，保证不会丢失唤醒
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	LogWriterSlot& slot = m_Writers.m_Slots[_Writer];
+	if (!slot.m_bSleeping.load(std::memory_order_relaxed))
+		return;
+
+	std::scoped_lock<std::mutex> queueLock(m_QueueMutex);
+	slot.m_bWakeup = true;
+	slot.m_Cond.notify_one();
+}
+
+size_t Log::drainRings(const std::vector<std::shared_ptr<LogRingBuffer>>& _Rings, size_t _MaxBatch)
+{
+	// 各队列内部按时间有序，以小根堆做多路归并
+	using Front = std::pair<uint64_t, size_t>;
+	thread_local std::vector<Front> fronts;
+	fronts.clear();
+	uint64_t timestamp = 0;
+	for (size_t i = 0; i < _Rings.size(); ++i)
+	{
+		if (_Rings[i]->peek(timestamp))
+			fronts.emplace_back(timestamp, i);
+	}
+	std::make_heap(fronts.begin(), fronts.end(), std::greater<Front>());
+	if (fronts.empty())
+		return 0;
+
+	// 先在写锁外取出一批并完成延迟格式化，多个写线程时格式化并行进行，写锁只用于输出
+	thread_local std::vector<LogRecord> batch;
+	size_t count = 0;
+	while (!fronts.empty() && count < _MaxBatch)
+	{
+		std::pop_heap(fronts.begin(), fronts.end(), std::greater<Front>());
+		size_t index = fronts.back().second;
+		fronts.pop_back();
+		LogRingBuffer* ring = _Rings[index].get();
+		if (count == batch.size())
+			batch.emplace_back();
+		if (ring->pop(&batch[count]))
+		{
+			// 延迟格式化的日志在此格式化
+			if (batch[count].m_pfnFormat)
+				renderRecord(batch[count]);
+			++count;
+		}
+		if (ring->peek(timestamp))
+		{
+			fronts.emplace_back(timestamp, index);
+			std::push_heap(fronts.begin(), fronts.end(), std::greater<Front>());
+		}
+	}
+	if (!count)
+		return 0;
+
+	LogConsolePolicy consolePolicy;
+	{
+		std::scoped_lock<std::shared_mutex> writeLock(m_LogMutex);
+		m_Console.setBatch(true);
+		for (size_t i = 0; i < count; ++i)
+			outputRecord(batch[i]);
+		m_Console.setBatch(false);
+		consolePolicy = m_ConsolePolicy;
+	}
+
+	// 本轮的命令行输出一次写出，不持有写锁，标准输出阻塞时不影响文件输出、日志查询与设置
+	m_Console.flush(consolePolicy);
+	return count;
+}
+
+LogWriterPolicy Log::getWriterPolicy()
+{
+	std::scoped_lock<std::mutex> queueLock(m_QueueMutex);
+	return m_WriterPolicy;
+}
+
+void Log::setWriterPolicy(const LogWriterPolicy& _Policy)
+{
+	// 重启期间写入的日志留在各线程队列中，由新的写线程接着输出，队列满时等待而不退化为同步输出
+	static std::mutex restartMutex;
+	std::scoped_lock<std::mutex> restartLock(restartMutex);
+	m_Writers.m_bRestart.store(true, std::memory_order_release);
+	const bool bRestart = stopWriters();
+	std::scoped_lock<std::mutex> queueLock(m_QueueMutex);
+	m_WriterPolicy = _Policy;
+	if (bRestart && !m_bWriterRunning.load(std::memory_order_relaxed))
+		startWriters();
+	m_Writers.m_bRestart.store(false, std::memory_order_release);
+	m_FlushCond.notify_all();
+}
+
+size_t Log::getWriterCount() noexcept
+{
+	return m_bWriterRunning.load(std::memory_order_acquire) ? m_Writers.m_nCount.load(std::memory_order_relaxed) : 0;
+}
+
+void Log::startWriters()
+{
+	// 每个节点一个写线程及其CPU，节点数超过槽位数时多出的节点由第一个写线程负责
+	std::vector<std::pair<int, std::vector<int>>> plan;
+	const std::vector<LogNuma::Node>& nodes = LogNuma::nodes();
+	if (m_WriterPolicy.m_bPerNode && nodes.size() > 1)
+	{
+		for (size_t i = 0; i < nodes.size() && i < LogWriters::MAX_WRITERS; ++i)
+		{
+			std::vector<int> cpus;
+			for (int cpu : m_WriterPolicy.m_Cpus)
+			{
+				if (LogNuma::nodeOf(cpu) == nodes[i].m_nId)
+					cpus.push_back(cpu);
+			}
+			plan.emplace_back(nodes[i].m_nId, cpus.empty() ? nodes[i].m_Cpus : cpus);
+		}
+	}
+	else
+		plan.emplace_back(-1, m_WriterPolicy.m_Cpus);
+
+	{
+		std::scoped_lock<std::mutex> ringLock(m_RingMutex);
+		for (size_t i = 0; i < plan.size(); ++i)
+		{
+			LogWriterSlot& slot = m_Writers.m_Slots[i];
+			slot.m_nNode = plan[i].first;
+			slot.m_Cpus = std::move(plan[i].second);
+			slot.m_bWakeup = false;
+			// 重启前未完成的Flush请求由新的写线程确认
+			slot.m_nFlushDone = 0;
+		}
+		m_Writers.m_nCount.store(plan.size(), std::memory_order_relaxed);
+		// 已有的队列重新分配给所属节点的写线程
+		for (const auto& ring : m_RingList)
+			ring->setWriter(m_Writers.writerOf(ring->node()));
+		m_nRingVersion.fetch_add(1, std::memory_order_release);
+	}
+
+	m_bWriterRunning.store(true, std::memory_order_release);
+	for (size_t i = 0; i < plan.size(); ++i)
+		m_Writers.m_Slots[i].m_Thread = std::thread(writerThreadProc, i);
+}
+
+bool Log::stopWriters()
+{
+	size_t nWriters = 0;
+	{
+		std::scoped_lock<std::mutex> queueLock(m_QueueMutex);
+		if (!m_bWriterRunning.load(std::memory_order_acquire))
+			return false;
+		m_bWriterRunning.store(false, std::memory_order_release);
+		nWriters = m_Writers.m_nCount.load(std::memory_order_relaxed);
+		for (size_t i = 0; i < nWriters; ++i)
+		{
+			m_Writers.m_Slots[i].m_bWakeup = true;
+			m_Writers.m_Slots[i].m_Cond.notify_one();
+		}
+	}
+
+	for (size_t i = 0; i < nWriters; ++i)
+	{
+		if (m_Writers.m_Slots[i].m_Thread.joinable())
+			m_Writers.m_Slots[i].m_Thread.join();
+	}
+	return true;
+}
+
+void Log::writerThreadProc(size_t _Index)
+{
+	LogWriterSlot& self = m_Writers.m_Slots[_Index];
+	size_t nBatchSize = 0;
+	uint nSpinCount = 0;
+	std::vector<int> cpus;
+	{
+		std::scoped_lock<std::mutex> queueLock(m_QueueMutex);
+		nBatchSize = std::max<size_t>(m_WriterPolicy.m_nBatchSize, 1);
+		nSpinCount = m_WriterPolicy.m_nSpinCount;
+		cpus = self.m_Cpus;
+	}
+	LogNuma::bindCurrentThread(cpus);
+	// 定期统计与按时间写入文件只由第一个写线程进行
+	const bool bPrimary = _Index == 0;
+	uint nSpinBudget = nSpinCount;
+	// 写线程启动后才启用崩溃保护缓冲区时，在循环中安装备用信号栈
+	bool bSignalStack = false;
+
+	std::vector<std::shared_ptr<LogRingBuffer>> rings;
+	uint64_t ringVersion = ~0ull;
+	while (true)
+	{
+		// 重启时不必输出完队列，直接交给新的写线程
+		if (m_Writers.m_bRestart.load(std::memory_order_acquire))
+			break;
+
+		uint64_t flushRequest = 0;
+		bool bFlushPending = false;
+		{
+			std::scoped_lock<std::mutex> queueLock(m_QueueMutex);
+			flushRequest = m_nFlushRequest;
+			bFlushPending = self.m_nFlushDone < flushRequest;
+			self.m_bWakeup = false;
+		}
+
+		if (ringVersion != m_nRingVersion.load(std::memory_order_acquire))
+		{
+			std::scoped_lock<std::mutex> ringLock(m_RingMutex);
+			ringVersion = m_nRingVersion.load(std::memory_order_relaxed);
+			rings.clear();
+			for (const auto& ring : m_RingList)
+			{
+				if (ring->writer() == _Index)
+					rings.push_back(ring);
+			}
+		}
+
+		if (!bSignalStack && LogCrashBuffer::handlesSignals())
+		{
+			LogCrashBuffer::installSignalStack();
+			bSignalStack = true;
+		}
+
+		// 汇总不经过队列，持续有日志时也按时输出
+		if (bPrimary)
+			siteRegistry().reportIfDue(steadyNanoseconds(), writeSummary);
+
+		if (drainRings(rings, nBatchSize))
+		{
+			nSpinBudget = nSpinCount;
+			continue;
+		}
+
+		// 负责的队列均为空
+		if (bFlushPending)
+		{
+			{
+				std::scoped_lock<std::shared_mutex> writeLock(m_LogMutex);
+				m_Console.flush(m_ConsolePolicy);
+				m_LogFile.flush();
+				m_BinaryFile.flush();
+			}
+			std::scoped_lock<std::mutex> queueLock(m_QueueMutex);
+			self.m_nFlushDone = flushRequest;
+			m_FlushCond.notify_all();
+		}
+
+		// 空闲时按时间间隔写入文件，休眠时间不超过刷新间隔
+		uint nWaitMs = 100;
+		if (bPrimary)
+		{
+			std::scoped_lock<std::shared_mutex> writeLock(m_LogMutex);
+			if (m_LogFile.isFlushDue(m_FlushPolicy))
+				m_LogFile.flush();
+			if (m_BinaryFile.isFlushDue(m_FlushPolicy))
+				m_BinaryFile.flush();
+			if (m_FlushPolicy.m_nFlushIntervalMs && m_FlushPolicy.m_nFlushIntervalMs < nWaitMs)
+				nWaitMs = m_FlushPolicy.m_nFlushIntervalMs;
+		}
+
+		if (!m_bWriterRunning.load(std::memory_order_acquire))
+			break;
+
+		// 回收所属线程已退出且已输出完毕的队列
+		bool bRemoved = false;
+		uint64_t timestamp = 0;
+		for (const auto& ring : rings)
+		{
+			if (ring->isClosed() && !ring->peek(timestamp))
+			{
+				bRemoved = true;
+				break;
+			}
+		}
+		if (bRemoved)
+		{
+			std::scoped_lock<std::mutex> ringLock(m_RingMutex);
+			for (auto it = m_RingList.begin(); it != m_RingList.end();)
+			{
+				if ((*it)->isClosed() && !(*it)->peek(timestamp))
+					it = m_RingList.erase(it);
+				else
+					++it;
+			}
+			m_nRingVersion.fetch_add(1, std::memory_order_release);
+			continue;
+		}
+
+		// 休眠前先轮询，期间写日志的线程不必加锁唤醒；落空时下次减半，再有日志时恢复
+		if (nSpinBudget)
+		{
+			bool bPending = false;
+			for (uint i = 0; !bPending && i < nSpinBudget; ++i)
+			{
+				cpuRelax();
+				bPending = ringVersion != m_nRingVersion.load(std::memory_order_relaxed)
+					|| !m_bWriterRunning.load(std::memory_order_relaxed);
+				for (size_t j = 0; !bPending && j < rings.size(); ++j)
+					bPending = rings[j]->peek(timestamp);
+			}
+			if (bPending)
+				continue;
+			nSpinBudget /= 2;
+		}
+
+		// 休眠前再检查一次队列，与wakeWriter配对
+		std::unique_lock<std::mutex> queueLock(m_QueueMutex);
+		self.m_bSleeping.store(true, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		bool bPending = ringVersion != m_nRingVersion.load(std::memory_order_relaxed);
+		for (size_t i = 0; !bPending && i < rings.size(); ++i)
+			bPending = rings[i]->peek(timestamp);
+		if (!bPending)
+			self.m_Cond.wait_for(queueLock, std::chrono::milliseconds(nWaitMs), [&self] { return self.m_bWakeup; });
+		self.m_bSleeping.store(false, std::memory_order_relaxed);
 	}
 }
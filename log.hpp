@@ -13,6 +13,7 @@
 #define _LOG_HPP_
 
 #include <cstring>
+#include <cstdarg>
 #include <memory>
 #include <locale>
 #include <iostream>
@@ -22,65 +23,147 @@
 #include <unordered_map>
 #include <mutex>
 #include <shared_mutex>
+#include <atomic>
+#include <condition_variable>
+#include <thread>
+#include <array>
+#include <algorithm>
+#include <functional>
 #include <chrono>
+#include <filesystem>
+#include <csignal>
+#include "log_utf8.hpp"
+#include "log_kv.hpp"
+#include "log_snapshot.hpp"
+
+/* 可变参数函数的调用约定，非MSVC编译器无需指定 */
+#if !defined(_MSC_VER) && !defined(__cdecl)
+#define __cdecl
+#endif
 
 #if __cplusplus == 202002L
 #define CPP20
 #include <source_location>
+#include "log_format.hpp"
 #endif // __cplusplus == 202002L
 
 #ifndef LOG_INIT
 #define LOG_INIT Log::Init
 #endif // LOG_INIT
 
+/* 编译期日志等级，高于该等级的LOG调用在编译时即被移除，如发布版本可定义为LOG_LEVEL_WARNING */
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_INFO
+#endif // LOG_COMPILE_LEVEL
+
 #ifndef LOG
 
+/*
+ * LOG_EVERY_N每sampleEvery次执行只输出第1次，LOG_RATE_LIMIT每秒最多输出ratePerSec条并允许同样条数的突发，
+ * 未输出的条数由调用点按约1秒的间隔汇总为一条日志。运行时可通过Log::setSiteLimit修改任一调用点的设置
+ */
 #ifdef CPP20
 #include <source_location>
-#define LOG(logLevel, format, ...)\
-        {const std::source_location location{std::source_location::current()};\
-		size_t fn_size = strlen(location.file_name());\
-		size_t func_size = strlen(location.function_name());\
-        char fn[fn_size];\
-		char func[func_size];\
-		strncpy(fn, location.file_name(), fn_size);\
-		strncpy(func, location.function_name(), func_size);\
-		wchar_t wfn[fn_size];\
-		wchar_t wfunc[func_size];\
-		StrToWStr(fn, wfn);\
-        StrToWStr(func, wfunc);\
-		Log::writeLog(\
+#define LOG_LIMITED(logLevel, sampleEvery, ratePerSec, format, ...)\
+		{if ((logLevel) <= LOG_COMPILE_LEVEL && Log::isLevelEnabled(logLevel)) {\
+		static constexpr std::source_location location{std::source_location::current()};\
+		static const LogSite site{location.file_name(), location.function_name(), location.line(), format, sampleEvery, ratePerSec};\
+		if (site.admit(logLevel))\
+		Log::writeLog<format>(\
 			logLevel,\
-			wfn,\
-			wfunc,\
-			location.line(),\
-			format,\
-			__VA_ARGS__);}\
+			site\
+			__VA_OPT__(,) __VA_ARGS__);}}\
+
+#define LOG(logLevel, format, ...) LOG_LIMITED(logLevel, 1, 0, format __VA_OPT__(,) __VA_ARGS__)
+#define LOG_EVERY_N(logLevel, sampleEvery, format, ...) LOG_LIMITED(logLevel, sampleEvery, 0, format __VA_OPT__(,) __VA_ARGS__)
+#define LOG_RATE_LIMIT(logLevel, ratePerSec, format, ...) LOG_LIMITED(logLevel, 1, ratePerSec, format __VA_OPT__(,) __VA_ARGS__)
 
 #else
-#define LOG(logLevel, format, ...)\
-		{size_t fn_size = strlen(__FILE__);\
-		size_t func_size = strlen(__func__);\
-        char fn[fn_size];\
-		char func[func_size];\
-		strncpy(fn, __FILE__, fn_size);\
-		strncpy(func, __func__, func_size);\
-		wchar_t wfn[fn_size];\
-		wchar_t wfunc[func_size];\
-		StrToWStr(fn, wfn);\
-        StrToWStr(func, wfunc);\
-        Log::writeLog(\
+/* 没有可变参数时由##去掉format之后的逗号，GCC、Clang与MSVC均支持 */
+#define LOG_LIMITED(logLevel, sampleEvery, ratePerSec, format, ...)\
+		{if ((logLevel) <= LOG_COMPILE_LEVEL && Log::isLevelEnabled(logLevel)) {\
+		static const LogSite site{__FILE__, __func__, __LINE__, format, sampleEvery, ratePerSec};\
+		if (site.admit(logLevel))\
+		Log::writeLog(\
 			logLevel,\
-			wfn,\
-			wfunc,\
-			__LINE__,\
-			format,\
-			__VA_ARGS__);}\
+			site,\
+			format\
+			, ##__VA_ARGS__);}}\
+
+#define LOG(logLevel, format, ...) LOG_LIMITED(logLevel, 1, 0, format, ##__VA_ARGS__)
+#define LOG_EVERY_N(logLevel, sampleEvery, format, ...) LOG_LIMITED(logLevel, sampleEvery, 0, format, ##__VA_ARGS__)
+#define LOG_RATE_LIMIT(logLevel, ratePerSec, format, ...) LOG_LIMITED(logLevel, 1, ratePerSec, format, ##__VA_ARGS__)
 
 #endif // CPP20
 
 #endif // LOG
 
+/*
+ * 结构化日志，如LOG_KV(LOG_LEVEL_WARNING, "slow request", "user_id", id, "latency_us", t)。
+ * 消息与键为UTF-8字符串，按Log::setKvFormat输出为一行JSON或logfmt，不带分隔行，各编码下均为UTF-8
+ */
+#ifndef LOG_KV
+#ifdef CPP20
+#define LOG_KV(logLevel, message, ...)\
+		{if ((logLevel) <= LOG_COMPILE_LEVEL && Log::isLevelEnabled(logLevel)) {\
+		static constexpr std::source_location location{std::source_location::current()};\
+		static const LogSite site{location.file_name(), location.function_name(), location.line(), message};\
+		if (site.admit(logLevel))\
+		Log::writeKv(\
+			logLevel,\
+			site,\
+			message\
+			__VA_OPT__(,) __VA_ARGS__);}}\
+
+#else
+#define LOG_KV(logLevel, message, ...)\
+		{if ((logLevel) <= LOG_COMPILE_LEVEL && Log::isLevelEnabled(logLevel)) {\
+		static const LogSite site{__FILE__, __func__, __LINE__, message};\
+		if (site.admit(logLevel))\
+		Log::writeKv(\
+			logLevel,\
+			site,\
+			message\
+			, ##__VA_ARGS__);}}\
+
+#endif // CPP20
+#endif // LOG_KV
+
+/* 输出到命名的日志实例，如LOG_TO(Log::getLogger("net"), LOG_LEVEL_INFO, "...")；LOG_NAMED按名称查找一次后缓存在调用点 */
+#ifndef LOG_TO
+#ifdef CPP20
+#define LOG_TO(logger, logLevel, format, ...)\
+		{if ((logLevel) <= LOG_COMPILE_LEVEL && (logger).isLevelEnabled(logLevel)) {\
+		static constexpr std::source_location location{std::source_location::current()};\
+		static const LogSite site{location.file_name(), location.function_name(), location.line(), format};\
+		if (site.admit(logLevel))\
+		(logger).template writeLog<format>(\
+			logLevel,\
+			site\
+			__VA_OPT__(,) __VA_ARGS__);}}\
+
+#define LOG_NAMED(name, logLevel, format, ...)\
+		{static Logger& namedLogger = Log::getLogger(name);\
+		LOG_TO(namedLogger, logLevel, format __VA_OPT__(,) __VA_ARGS__)}\
+
+#else
+#define LOG_TO(logger, logLevel, format, ...)\
+		{if ((logLevel) <= LOG_COMPILE_LEVEL && (logger).isLevelEnabled(logLevel)) {\
+		static const LogSite site{__FILE__, __func__, __LINE__, format};\
+		if (site.admit(logLevel))\
+		(logger).writeLog(\
+			logLevel,\
+			site,\
+			format\
+			, ##__VA_ARGS__);}}\
+
+#define LOG_NAMED(name, logLevel, format, ...)\
+		{static Logger& namedLogger = Log::getLogger(name);\
+		LOG_TO(namedLogger, logLevel, format, ##__VA_ARGS__)}\
+
+#endif // CPP20
+#endif // LOG_TO
+
 using std::chrono::system_clock;
 
 typedef unsigned int uint;
@@ -99,9 +182,266 @@ enum LOGTARGET
 	LOG_TARGET_NONE             = 0b00,
 	LOG_TARGET_CONSOLE          = 0b01,
 	LOG_TARGET_FILE             = 0b10,
-	LOG_TARGET_CONSOLE_AND_FILE = 0b11
+	LOG_TARGET_CONSOLE_AND_FILE = 0b11,
+	LOG_TARGET_BINARY           = 0b100    // 紧凑的二进制文件，由log_decode还原为文本，可与以上目标组合
+};
+
+enum LOGMODE
+{
+	LOG_MODE_SYNC,    // 同步模式，调用线程直接输出日志
+	LOG_MODE_ASYNC,   // 异步模式，调用线程只负责入队，由后台线程输出日志
+	LOG_MODE_DEFERRED // 延迟格式化的异步模式，调用线程只拷贝参数，由后台线程格式化并输出（需要C++20）
+};
+
+enum LOGOVERFLOW
+{
+	LOG_OVERFLOW_BLOCK,          // 队列满时等待后台线程腾出空间
+	LOG_OVERFLOW_DROP_NEWEST,    // 队列满时丢弃新日志
+	LOG_OVERFLOW_DROP_OLDEST     // 队列满时丢弃队列中最旧的日志
+};
+
+enum LOGTIMEPRECISION
+{
+	LOG_TIME_SECOND,         // 精确到秒
+	LOG_TIME_MILLISECOND,    // 精确到毫秒
+	LOG_TIME_MICROSECOND,    // 精确到微秒
+	LOG_TIME_NANOSECOND      // 精确到纳秒
+};
+
+enum LOGCLOCK
+{
+	LOG_CLOCK_SYSTEM,    // 系统时钟
+	LOG_CLOCK_TSC        // CPU时间戳计数器，定期以系统时钟校准，非x86平台或CPU不支持恒定频率的计数器时等同于LOG_CLOCK_SYSTEM
+};
+
+enum LOGENCODING
+{
+	LOG_ENCODING_WIDE,    // 以wchar_t格式化，按当前区域设置转换后输出
+	LOG_ENCODING_UTF8     // 以char格式化，UTF-8文本原样输出，不经过区域设置转换
+};
+
+/* 日志文件的缓冲与刷新策略 */
+struct LogFlushPolicy
+{
+	size_t m_nBufferSize      { 64 * 1024 };   // 写缓冲区大小（字节），缓冲区满时写入文件
+	size_t m_nFlushBytes      { 0 };           // 缓冲的字节数达到该值时写入文件，0表示不启用
+	uint   m_nFlushIntervalMs { 1000 };        // 距上次写入超过该时间（毫秒）时写入文件，0表示不启用
+	bool   m_bFlushOnError    { true };        // LOG_LEVEL_ERROR立即写入文件
+};
+
+/* 日志文件的滚动策略 */
+struct LogRotatePolicy
+{
+	size_t m_nMaxFileSize { 0 };       // 文件达到该大小（字节）时滚动，0表示不按大小滚动
+	bool   m_bDaily       { false };   // 每天零点滚动
+	uint   m_nMaxFiles    { 5 };       // 保留的历史文件数，Log.txt依次滚动为Log.1.txt、Log.2.txt……
+	bool   m_bPreallocate { true };    // 提前创建下一个文件并预分配m_nMaxFileSize大小的空间
+};
+
+enum LOGCOMPRESSION
+{
+	LOG_COMPRESSION_NONE,    // 不压缩
+	LOG_COMPRESSION_GZIP     // gzip，需要以LOG_WITH_ZLIB编译并链接zlib，否则等同于LOG_COMPRESSION_NONE
+};
+
+/**
+ * 日志文件的压缩策略
+ *
+ * 流式压缩的文件由若干gzip成员拼接而成，每次写入文件时结束当前块，LogReader与getLogFromFile按文件头识别并透明解压。
+ * 流式压缩的文件不使用崩溃保护缓冲区，文件已有未压缩的内容时应换用新文件。
+ */
+struct LogCompressPolicy
+{
+	LOGCOMPRESSION m_Live    { LOG_COMPRESSION_NONE };   // 当前文件以流式压缩写入，在输出线程中压缩
+	LOGCOMPRESSION m_Rotated { LOG_COMPRESSION_NONE };   // 滚动后的历史文件在后台线程中压缩为Log.1.txt.gz
+	int            m_nLevel  { 1 };                      // 压缩级别，1最快，9压缩率最高
+};
+
+/* 命令行的输出策略 */
+struct LogConsolePolicy
+{
+	bool m_bDropWhenFull { false };   // 标准输出不可写（如管道已满）时丢弃本批剩余的日志而不等待，Windows下不支持
+	bool m_bColor        { false };   // 按日志等级着色输出
+};
+
+/**
+ * 异步模式下后台写线程的数量、CPU绑定与等待策略
+ *
+ * 按节点分线程时每个NUMA节点一个写线程，只输出首次在本节点上写日志的线程的队列，队列不跨节点读取。
+ * 写线程在写锁外完成延迟格式化，只在输出时持有写锁；同一写线程的日志按时间顺序输出，不同写线程的日志以批为单位交错。
+ */
+struct LogWriterPolicy
+{
+	bool             m_bPerNode   { false };   // 每个NUMA节点一个写线程，只有一个节点或非Linux平台时仍为一个写线程
+	std::vector<int> m_Cpus;                   // 写线程可运行的CPU编号，为空时不绑定；按节点分线程时只使用其中属于本节点的，没有时绑定到本节点的所有CPU
+	size_t           m_nBatchSize { 256 };     // 每次持有写锁输出的最大条数，即写锁外预先取出并格式化的条数，每条占用一份常驻的日志缓冲区
+	uint             m_nSpinCount { 0 };       // 队列为空后休眠前轮询的次数，轮询期间写日志的线程无需唤醒，落空时下次减半，0表示立即休眠
+};
+
+/* 默认的输出模式：分隔行、时间、进程号、线程号、文件名、函数名与行号、正文、分隔行，见Log::setPattern */
+constexpr const char* LOG_DEFAULT_PATTERN { "%B%t [PID : %5P] [TID : %5T] [%f] [%F : %4n] %m%B" };
+
+/* Log::reloadOnSignal默认的信号，Windows下没有SIGHUP且不支持该功能 */
+#ifdef _WIN32
+constexpr int LOG_RELOAD_SIGNAL { 1 };
+#else
+constexpr int LOG_RELOAD_SIGNAL { SIGHUP };
+#endif // _WIN32
+
+/* 文件写入耗时分布的区间数 */
+constexpr size_t LOG_STATS_FLUSH_BUCKETS { 16 };
+
+/* 日志模块的运行统计，计数自进程启动起累计 */
+struct LogStats
+{
+	std::array<uint64_t, 5> m_nWritten {};            // 各等级输出的日志数，下标为LOGLEVEL
+	std::array<uint64_t, 5> m_nDropped {};            // 各等级因队列满丢弃的日志数
+	uint64_t m_nConsoleDropped  { 0 };                // 因标准输出不可写丢弃的日志数
+	uint64_t m_nQueueHighWater  { 0 };                // 异步模式下各线程队列的最大深度
+	uint64_t m_nLockWaits       { 0 };                // 同步输出时写锁已被占用的次数
+	uint64_t m_nLockWaitNs      { 0 };                // 同步输出时等待写锁的总时间（纳秒）
+	uint64_t m_nConsoleBytes    { 0 };                // 写入标准输出的字节数
+	uint64_t m_nFileBytes       { 0 };                // 写入日志文件的字节数
+	uint64_t m_nBinaryBytes     { 0 };                // 写入二进制日志文件的字节数
+	uint64_t m_nRotations       { 0 };                // 日志文件与二进制日志文件的滚动次数
+	uint64_t m_nSuppressed      { 0 };                // 因调用点采样或限速未输出的日志数
+	std::array<uint64_t, LOG_STATS_FLUSH_BUCKETS> m_nFlushLatency {}; // 文件写入耗时分布，第0项为不足1微秒，第i项为[2^(i-1), 2^i)微秒，最后一项包含更长的
+};
+
+/* 崩溃保护缓冲区的设置 */
+struct LogCrashPolicy
+{
+	bool         m_bEnable        { false };              // 文本日志同时写入映射的文件，进程异常退出后可恢复未写入日志文件的部分
+	std::wstring m_wstrPath       { L"./Log.crash" };     // 缓冲区文件路径
+	size_t       m_nSize          { 4 * 1024 * 1024 };    // 数据区字节数，应大于日志文件的写缓冲区
+	bool         m_bHandleSignals { true };               // 在SIGSEGV、SIGABRT等信号中将未写入的日志写入日志文件
+};
+
+/* 线程名称，由Log::setThreadName登记，同名的线程共用一份，进程退出前不释放 */
+struct LogThreadName
+{
+	std::string  m_strName;     // UTF-8名称
+	std::wstring m_wstrName;    // 宽字符名称
+};
+
+/* 运行时可替换的配置，以快照整体发布 */
+struct LogConfig
+{
+	LOGLEVEL     m_LogLevel       { LOG_LEVEL_NONE };     // 日志等级
+	LOGTARGET    m_LogTarget      { LOG_TARGET_NONE };    // 输出位置
+	std::wstring m_wstrLogFile    { L"./Log.txt" };       // 日志文件路径
+	std::wstring m_wstrBinaryFile { L"./Log.bin" };       // 二进制日志文件路径
+};
+
+/* 日志调用点信息，LOG宏为每个调用点生成一个静态实例，文件名与函数名只在首次执行时转换一次 */
+struct LogSite
+{
+	/**
+	 * @brief 构造调用点，参数须为字符串字面量等静态字符串
+	 * 
+	 * 宽字符名称不释放，进程退出时队列中尚未输出的日志仍可引用。
+	 * 调用点登记后常驻内存，Log::setSiteLimit可按文件名与行号修改其采样与限速设置
+	 * 
+	 * @param _SampleEvery    每N次执行输出1次，0与1表示不采样
+	 * @param _RatePerSec     每秒最多输出的条数，0表示不限速
+	 */
+	LogSite(const char* _File, const char* _Function, uint _Line, const char* _Format, uint _SampleEvery = 1, uint _RatePerSec = 0);
+
+	/* 本次执行是否输出，未设置采样与限速时只有两次relaxed读取 */
+	bool admit(LOGLEVEL _LogLevel) const noexcept
+	{
+		if (m_nSampleEvery.load(std::memory_order_relaxed) <= 1 && !m_nRatePerSec.load(std::memory_order_relaxed))
+			return true;
+		return admitSlow(_LogLevel);
+	}
+
+	const char*    m_szFile;        // 文件名
+	const char*    m_szFunction;    // 函数名
+	uint           m_nLine;         // 行号
+	const char*    m_szFormat;      // 格式串
+	const wchar_t* m_wszFile;       // 宽字符文件名
+	const wchar_t* m_wszFunction;   // 宽字符函数名
+
+	mutable std::atomic<uint>     m_nSampleEvery  { 1 };  // 采样间隔
+	mutable std::atomic<uint>     m_nRatePerSec   { 0 };  // 每秒条数
+	mutable std::atomic<uint>     m_nBurst        { 0 };  // 突发条数，0表示与m_nRatePerSec相同
+	mutable std::atomic<uint64_t> m_nCalls        { 0 };  // 执行次数，用于采样
+	mutable std::atomic<int64_t>  m_nAllowAt      { 0 };  // 令牌桶：按速率计算的下一条日志的理论时间（纳秒）
+	mutable std::atomic<uint64_t> m_nSuppressed   { 0 };  // 上次汇总后未输出的条数
+	mutable std::atomic<LOGLEVEL> m_SuppressedLevel { LOG_LEVEL_NONE };  // 最近一次未输出的日志等级，汇总以该等级输出
+
+private:
+	/* 按采样与令牌桶判断，未输出时计数 */
+	bool admitSlow(LOGLEVEL _LogLevel) const noexcept;
+};
+
+/* 调用点的采样与限速设置 */
+struct LogSiteLimit
+{
+	uint m_nSampleEvery { 1 };   // 每N次执行输出1次，0与1表示不采样
+	uint m_nRatePerSec  { 0 };   // 每秒最多输出的条数，0表示不限速
+	uint m_nBurst       { 0 };   // 允许的突发条数，0表示与m_nRatePerSec相同
+};
+
+struct LogRecord;
+/* 延迟格式化时解码参数并格式化正文，由每个调用点的模板实例提供 */
+typedef void (*LogDeferredFormatter)(LogRecord& _Record);
+
+/* 一条日志，异步模式下由调用线程交给后台线程 */
+struct LogRecord
+{
+	LOGLEVEL             m_Level     { LOG_LEVEL_NONE };  // 日志等级
+	bool                 m_bUtf8     { false };           // 日志为UTF-8编码，保存在m_strLog中
+	bool                 m_bStructured { false };         // LOG_KV的结构化日志，UTF-8编码
+	std::wstring         m_wstrLog;                       // 已格式化的日志
+	std::string          m_strLog;                        // 已格式化的UTF-8日志
+	// 以下用于延迟格式化，m_pfnFormat为空表示日志已格式化
+	LogDeferredFormatter m_pfnFormat { nullptr };         // 正文格式化函数
+	const LogSite*       m_pSite     { nullptr };         // 调用点
+	int64_t              m_nTime     { 0 };               // 记录时间（纳秒）
+	uint                 m_nThreadId { 0 };               // 调用线程号
+	const LogThreadName* m_pThreadName { nullptr };       // 调用线程的名称，未设置时为空
+	std::string          m_strArgs;                       // 参数的原始字节
+	// 以下用于二进制目标
+	bool                 m_bBinary   { false };           // 是否携带二进制参数，需要m_pSite、m_nTime、m_nThreadId
+	std::string          m_strBinary;                     // 按log_binary.hpp编码的参数
+
+	/* 按字符类型取日志缓冲区 */
+	template<typename Char>
+	std::basic_string<Char>& text() noexcept
+	{
+		if constexpr (std::is_same_v<Char, char>)
+			return m_strLog;
+		else
+			return m_wstrLog;
+	}
 };
 
+/* 异步模式下每个线程独占的日志队列，定义见log.cpp */
+class LogRingBuffer;
+/* 常驻打开的日志文件，定义见log.cpp */
+class LogFile;
+/* 崩溃保护缓冲区，定义见log.cpp */
+class LogCrashBuffer;
+/* 运行统计的计数器，定义见log.cpp */
+struct LogCounters;
+/* 异步模式的后台写线程组，定义见log.cpp */
+struct LogWriters;
+/* 命令行输出缓冲，定义见log.cpp */
+class LogConsole;
+/* 编译后的输出模式，定义见log.cpp */
+class LogPattern;
+/* 二进制日志文件，定义见log.cpp */
+class LogBinaryFile;
+/* 日志查询条件，定义见log_reader.hpp */
+struct LogQuery;
+/* 可注册的输出目标，定义见log_sink.hpp */
+class LogSink;
+/* 输出目标的队列与线程，定义见log.cpp */
+class LogSinkWorker;
+/* 命名的日志实例，定义见下文 */
+class Logger;
+
 /**
  * @brief char* 转为 wchar_t*
  *
@@ -120,6 +460,27 @@ int StrToWStr(const char* _SrcBuf, wchar_t* _DstBuf);
  */
 int WStrToStr(const wchar_t* _SrcBuf, char* _DstBuf);
 
+/**
+ * @brief 格式化本地时间
+ *
+ * @param _TimeBuffer OUT 本地时间，至少20字节
+ * @param _Time       时间
+ */
+inline
+void formatLocalTime(char* _TimeBuffer, time_t _Time)
+{
+	// 异步模式下多个线程同时格式化，使用可重入版本
+	struct tm tmNow;
+#ifdef _WIN32
+	localtime_s(&tmNow, &_Time);
+#else
+	localtime_r(&_Time, &tmNow);
+#endif // _WIN32
+	snprintf(_TimeBuffer, 20, "%d-%02d-%02d %02d:%02d:%02d",
+		(int)tmNow.tm_year + 1900, (int)tmNow.tm_mon + 1, (int)tmNow.tm_mday,
+		(int)tmNow.tm_hour, (int)tmNow.tm_min, (int)tmNow.tm_sec);
+}
+
 /**
  * @brief 获取当前本地时间
  *
@@ -128,11 +489,7 @@ int WStrToStr(const wchar_t* _SrcBuf, char* _DstBuf);
 inline
 void getCurrentLocalTime(char* _TimeBuffer)
 {
-	time_t now = system_clock::to_time_t(system_clock::now());
-	struct tm* tmNow(localtime(&now));
-	snprintf(_TimeBuffer, 20, "%d-%02d-%02d %02d:%02d:%02d",
-		(int)tmNow->tm_year + 1900, (int)tmNow->tm_mon + 1, (int)tmNow->tm_mday,
-		(int)tmNow->tm_hour, (int)tmNow->tm_min, (int)tmNow->tm_sec);
+	formatLocalTime(_TimeBuffer, system_clock::to_time_t(system_clock::now()));
 }
 
 /* 以键值对形式存储日志等级对应的宽字符串 */
@@ -148,6 +505,7 @@ static const std::unordered_map<LOGLEVEL, const wchar_t*> LOGLEVEL_WSTRING
 class Log
 {
 	friend class std::shared_ptr<Log>;
+	friend class Logger;
 
 public:
 	~Log() = default;
@@ -159,12 +517,15 @@ public:
 	 * 
 	 * @param _LogLevel     日志等级
 	 * @param _LogTarget    日志输出目标，命令行或者文件系统。
+	 * @param _Path         日志文件路径
+	 * @param _LogMode      输出模式，异步模式下会启动后台写线程
 	 */
 	static void Init
 	(
 		LOGLEVEL _LogLevel,
 		LOGTARGET _LogTarget,
-		std::wstring _Path = m_wstrLogFile
+		std::wstring _Path = getLogFile(),
+		LOGMODE _LogMode = LOG_MODE_SYNC
 	);
 	/**
 	 * @brief 记录日志
@@ -186,50 +547,834 @@ public:
 		...
 	);
 	/**
-	 * @brief 从文件中读取日志
+	 * @brief 记录日志，C++17下LOG宏使用的版本
+	 * 
+	 * @param   _LogLevel    日志等级
+	 * @param       _Site    调用点，须为静态对象
+	 * @param     _Format    格式化
+	 * @param ...            参数列表
+	 */
+	static void __cdecl writeLog
+	(
+		const LOGLEVEL _LogLevel,
+		const LogSite&     _Site,
+		const char*      _Format,
+		...
+	);
+#ifdef CPP20
+	/**
+	 * @brief 记录日志，格式串在编译期解析并检查参数类型，正文不经过vswprintf
+	 * 
+	 * @tparam    _Format    格式串，须为字符串字面量
+	 * @param   _LogLevel    日志等级
+	 * @param   _FileName    函数所在文件名
+	 * @param   _Function    函数名
+	 * @param _LineNumber    行号
+	 * @param       _Args    参数列表
+	 */
+	template<LogFixedString _Format, typename... Args>
+	static void writeLog
+	(
+		const LOGLEVEL _LogLevel,
+		const wchar_t* _FileName,
+		const wchar_t* _Function,
+		const uint   _LineNumber,
+		const Args&...   _Args
+	)
+	{
+		static_assert(LogCheckFormat<_Format, Args...>());
+		if (!isLevelEnabled(_LogLevel))
+			return;
+
+		if (getEncoding() == LOG_ENCODING_UTF8)
+		{
+			thread_local std::string strFile, strFunction;
+			strFile.clear();
+			strFunction.clear();
+			LogAppendUtf8(strFile, _FileName);
+			LogAppendUtf8(strFunction, _Function);
+			writeFormatted<_Format>(_LogLevel, strFile.c_str(), strFunction.c_str(), _LineNumber, nullptr, _Args...);
+		}
+		else
+			writeFormatted<_Format>(_LogLevel, _FileName, _Function, _LineNumber, nullptr, _Args...);
+	}
+	/**
+	 * @brief 记录日志，LOG宏使用的版本
+	 * 
+	 * LOG_MODE_DEFERRED模式下只拷贝调用点指针与参数的原始字节，格式化在后台线程中进行。
+	 * 
+	 * @tparam    _Format    格式串，须为字符串字面量
+	 * @param   _LogLevel    日志等级
+	 * @param       _Site    调用点，须为静态对象
+	 * @param       _Args    参数列表
+	 */
+	template<LogFixedString _Format, typename... Args>
+	static void writeLog(const LOGLEVEL _LogLevel, const LogSite& _Site, const Args&... _Args)
+	{
+		static_assert(LogCheckFormat<_Format, Args...>());
+		if (!isLevelEnabled(_LogLevel))
+			return;
+
+		const bool bUtf8 = getEncoding() == LOG_ENCODING_UTF8;
+		auto fillRecord = [&](LogRecord& _Record)
+		{
+			const LOGTARGET target = getLogTarget();
+			_Record.m_bUtf8 = bUtf8;
+			_Record.m_pSite = &_Site;
+			stampRecord(_Record);
+			if (needsText(target))
+			{
+				_Record.m_pfnFormat = &formatDeferred<_Format, Args...>;
+				LogEncodeArgs<_Format>(_Record.m_strArgs, _Args...);
+			}
+			if (target & LOG_TARGET_BINARY)
+			{
+				_Record.m_bBinary = true;
+				LogEncodeBinary<_Format>(_Record.m_strBinary, _Args...);
+			}
+		};
+
+		// 低于日志等级的日志以延迟格式化的形式保存到回溯缓冲
+		if (isBacktraced(_LogLevel))
+		{
+			fillRecord(acquireBacktrace(_LogLevel));
+			return;
+		}
+		if (getLogMode() == LOG_MODE_DEFERRED)
+		{
+			flushBacktrace(_LogLevel, false);
+			LogRecord& record = acquireRecord(_LogLevel);
+			fillRecord(record);
+			pushToRing(record);
+			return;
+		}
+
+		// 调用点保存的文件名与函数名本身即为UTF-8，无需转换
+		if (bUtf8)
+			writeFormatted<_Format>(_LogLevel, _Site.m_szFile, _Site.m_szFunction, _Site.m_nLine, &_Site, _Args...);
+		else
+			writeFormatted<_Format>(_LogLevel, _Site.m_wszFile, _Site.m_wszFunction, _Site.m_nLine, &_Site, _Args...);
+	}
+#endif // CPP20
+	/**
+	 * @brief 记录结构化日志，LOG_KV宏使用的版本
+	 * 
+	 * 键值对直接序列化到UTF-8缓冲区，输出到LOGTARGET指定的目标与所有注册目标，
+	 * 设置了LogSink::setStructuredOnly的目标只接收这类日志
+	 * 
+	 * @param _LogLevel    日志等级
+	 * @param     _Site    调用点，须为静态对象
+	 * @param  _Message    消息，UTF-8
+	 * @param     _Args    键值对，键为字符串，值的类型见log_kv.hpp
+	 */
+	template<typename... Args>
+	static void writeKv(const LOGLEVEL _LogLevel, const LogSite& _Site, const char* _Message, const Args&... _Args)
+	{
+		static_assert(sizeof...(Args) % 2 == 0, "LOG_KV expects key-value pairs");
+		if (!isLevelEnabled(_LogLevel))
+			return;
+
+		auto fillRecord = [&](LogRecord& _Record)
+		{
+			const LOGKVFORMAT format = getKvFormat();
+			_Record.m_bUtf8 = true;
+			_Record.m_bStructured = true;
+			stampRecord(_Record);
+			formatKvHeader(_Record.m_strLog, format, _LogLevel, _Site, _Record.m_nTime, _Record.m_nThreadId, _Record.m_pThreadName, _Message);
+			LogKvAppendPairs(_Record.m_strLog, format, _Args...);
+			_Record.m_strLog += format == LOG_KV_JSON ? "}\n" : "\n";
+		};
+
+		if (isBacktraced(_LogLevel))
+		{
+			fillRecord(acquireBacktrace(_LogLevel));
+			return;
+		}
+		if (getLogMode() != LOG_MODE_SYNC)
+		{
+			flushBacktrace(_LogLevel, false);
+			LogRecord& record = acquireRecord(_LogLevel);
+			fillRecord(record);
+			pushToRing(record);
+			return;
+		}
+
+		CallerLock writeLock;
+		flushBacktrace(_LogLevel, true);
+		LogRecord& record = acquireRecord(_LogLevel);
+		fillRecord(record);
+		outputRecord(record);
+	}
+	/**
+	 * @brief 从文件中读取日志，每条日志为一个元素
+	 * 
+	 * 先以Flush等待已提交的日志写入文件，异步模式下同样包含最近的日志；
+	 * 文件以内存映射方式读取，不阻塞写日志的线程；需要逐条遍历大文件时直接使用LogReader
 	 * 
 	 * @param _LogTable    用于存储从文件读出的日志
 	 * @return true        日志读取成功 
-	 * @return false       日志读取失败
+	 * @return false       日志读取失败，或无法按当前的输出模式划分日志，见LogReader::setPattern
 	 */
 	static bool getLogFromFile(std::vector<std::wstring>& _LogTable);
-	/* 输出日志 */
-	static void outputToTarget();
+	/* 同上，只读取满足条件的日志，LogQuery定义见log_reader.hpp */
+	static bool getLogFromFile(std::vector<std::wstring>& _LogTable, const LogQuery& _Query);
+	/**
+	 * @brief 输出日志到目标
+	 * 
+	 * @param       _Log    已格式化的日志
+	 * @param  _LogLevel    日志等级，用于判断是否立即写入文件
+	 */
+	static void outputToTarget(const std::wstring& _Log, LOGLEVEL _LogLevel);
+	/* 同上，UTF-8日志原样写入文件描述符 */
+	static void outputToTarget(const std::string& _Log, LOGLEVEL _LogLevel);
+	/**
+	 * @brief 注册输出目标，与LOGTARGET指定的目标同时输出
+	 * 
+	 * @param _Sink         输出目标，同一目标只注册一次
+	 * @param _QueueSize    该目标的队列容量，队列满时丢弃新日志并计入其getDroppedCount
+	 */
+	static void addSink(const std::shared_ptr<LogSink>& _Sink, size_t _QueueSize = 8192);
+	/* 移除输出目标，返回前输出其队列中的日志并调用flush */
+	static void removeSink(const std::shared_ptr<LogSink>& _Sink);
+	/**
+	 * @brief 等待已提交的日志全部输出
+	 * 
+	 * 异步模式下阻塞至队列清空且后台线程完成当前批次，之后将文件缓冲区写入文件并刷新输出流。
+	 */
+	static void Flush();
+	/**
+	 * @brief 停止后台写线程
+	 * 
+	 * 队列中剩余的日志会全部输出，之后的日志改为同步输出。
+	 * 异步模式下Init会通过atexit注册本函数，进程正常退出时不会丢失日志。
+	 */
+	static void Shutdown();
 	/**
 	 * @brief 获取日志实例
 	 * 
-	 * @return std::shared_ptr<Log> 当前日志对象的指针
+	 * 首次调用时以当前设置初始化，之后只检查局部静态变量是否已初始化；初始化抛出异常时下次调用重新初始化
+	 * 
+	 * @return std::shared_ptr<Log> 当前日志对象的指针，返回引用，不增加引用计数
 	 */
-	static std::shared_ptr<Log> Instance() noexcept
+	static const std::shared_ptr<Log>& Instance()
 	{
-		// 保证初始化函数唯一执行
-		std::call_once(m_ResourceFlag, Init, m_LogLevel, m_LogTarget, m_wstrLogFile);
-		return m_Log;
+		static const std::shared_ptr<Log>& instance = []() -> const std::shared_ptr<Log>&
+		{
+			Init(getLogLevel(), getLogTarget(), getLogFile(), getLogMode());
+			return m_Log;
+		}();
+		return instance;
 	}
+	/**
+	 * @brief 获取命名的日志实例，首次调用时创建，之后返回同一对象
+	 * 
+	 * 实例不释放，可保存引用或由LOG_NAMED缓存在调用点，之后访问不再查找
+	 * 
+	 * @param _Name    名称
+	 * @return Logger& 日志实例
+	 */
+	static Logger& getLogger(const std::string& _Name);
+	/**
+	 * @brief 设置调用线程的名称，输出模式中的%N与结构化日志的thread字段使用该名称
+	 * 
+	 * 名称登记后常驻内存，每条日志只记录其指针；线程池中的线程可使用相同的名称
+	 * 
+	 * @param _Name    名称，UTF-8，为空表示取消
+	 */
+	static void setThreadName(const std::string& _Name);
+	/* 获取调用线程的名称，未设置时为空 */
+	static std::string getThreadName();
 	/* 获取Log等级 */
-	static LOGLEVEL getLogLevel() noexcept { return m_LogLevel; }
+	static LOGLEVEL getLogLevel() noexcept { return m_LogLevel.load(std::memory_order_relaxed); }
 	/* 设置Log等级 */
-	static void setLogLevel(LOGLEVEL _LogLevel) noexcept { m_LogLevel = _LogLevel; }
-	/* 获取Log输出位置 */
-	static LOGTARGET getLogTarget() noexcept { return m_LogTarget; }
+	static void setLogLevel(LOGLEVEL _LogLevel) noexcept { m_LogLevel.store(_LogLevel, std::memory_order_relaxed); }
+	/* 该等级的日志是否输出或保存到回溯缓冲，LOG宏在求值参数前调用 */
+	static bool isLevelEnabled(LOGLEVEL _LogLevel) noexcept
+	{
+		return _LogLevel <= LOG_COMPILE_LEVEL && (_LogLevel <= m_LogLevel.load(std::memory_order_relaxed)
+			|| _LogLevel <= m_BacktraceLevel.load(std::memory_order_relaxed));
+	}
+	/**
+	 * @brief 设置回溯缓冲，为故障保留调试上下文而不持续输出调试日志
+	 * 
+	 * 超出日志等级但在_LogLevel以内的日志不输出，保存到调用线程的环形缓冲，缓冲满时覆盖最早的一条；
+	 * 该线程输出LOG_LEVEL_ERROR日志时，先按记录顺序输出缓冲中的日志并清空。
+	 * C++20下LOG宏只保存调用点与参数的原始字节，输出时才格式化；其余接口在保存时格式化。
+	 * 
+	 * @param _LogLevel    保存的最低等级，如LOG_LEVEL_INFO，LOG_LEVEL_NONE表示关闭
+	 * @param    _Count    每个线程保存的条数，0表示关闭
+	 */
+	static void setBacktrace(LOGLEVEL _LogLevel, size_t _Count) noexcept
+	{
+		m_nBacktraceCount.store(_Count, std::memory_order_relaxed);
+		m_BacktraceLevel.store(_Count ? _LogLevel : LOG_LEVEL_NONE, std::memory_order_relaxed);
+	}
+	/* 获取回溯缓冲保存的最低等级，LOG_LEVEL_NONE表示关闭 */
+	static LOGLEVEL getBacktraceLevel() noexcept { return m_BacktraceLevel.load(std::memory_order_relaxed); }
+	/* 获取回溯缓冲每个线程保存的条数 */
+	static size_t getBacktraceCount() noexcept { return m_nBacktraceCount.load(std::memory_order_relaxed); }
+	/* 获取Log输出位置，读取当前配置快照，不加锁 */
+	static LOGTARGET getLogTarget() noexcept { return LogSnapshot<LogConfig>::Reader()->m_LogTarget; }
 	/* 设置Log输出位置 */
-	static void setLogTarget(LOGTARGET _LogTarget) noexcept { m_LogTarget = _LogTarget; }
+	static void setLogTarget(LOGTARGET _LogTarget);
 	/* 获取Log输出文件路径 */
-	static std::wstring getLogFile() noexcept { return m_wstrLogFile; }
-	/* 设置Log输出文件路径 */
-	static void setLogFile(const std::wstring& _Path) noexcept { m_wstrLogFile = _Path; }
+	static std::wstring getLogFile() { return LogSnapshot<LogConfig>::Reader()->m_wstrLogFile; }
+	/* 设置Log输出文件路径，输出线程在下一条日志时关闭旧文件并打开新文件 */
+	static void setLogFile(const std::wstring& _Path);
+	/* 获取二进制日志文件路径 */
+	static std::wstring getBinaryFile() { return LogSnapshot<LogConfig>::Reader()->m_wstrBinaryFile; }
+	/* 设置二进制日志文件路径 */
+	static void setBinaryFile(const std::wstring& _Path);
+	/* 获取当前配置 */
+	static LogConfig getConfig();
+	/**
+	 * @brief 替换配置
+	 * 
+	 * 新配置整体发布为一个快照，写日志的线程以一次原子读取获得完整的配置，不会读到新旧混合的值。
+	 * 旧快照在各线程都读取过新快照或退出后释放，见LogSnapshot
+	 * 
+	 * @param _Config    配置
+	 */
+	static void setConfig(const LogConfig& _Config);
+	/**
+	 * @brief 从文件读取配置并替换，未出现的项保持不变
+	 * 
+	 * 每行为"键 = 值"，#开头为注释。键为level（NONE、ERROR、WARNING、DEBUG、INFO）、
+	 * target（none、console、file、binary，以逗号或|组合）、file、binary_file、pattern，值为UTF-8
+	 * 
+	 * @param _Path     配置文件路径
+	 * @return true     读取成功并已替换
+	 * @return false    文件无法打开或有无法识别的行，配置不变
+	 */
+	static bool loadConfig(const std::wstring& _Path);
+	/**
+	 * @brief 收到信号时重新读取配置文件，信号处理函数只唤醒专用线程，读取在该线程中进行
+	 * 
+	 * @param _Path      配置文件路径，再次调用时替换
+	 * @param _Signal    信号，默认为SIGHUP
+	 * @return false     Windows下不支持或无法安装信号处理函数
+	 */
+	static bool reloadOnSignal(const std::wstring& _Path, int _Signal = LOG_RELOAD_SIGNAL);
+	/* 获取日志文件的缓冲与刷新策略 */
+	static LogFlushPolicy getFlushPolicy();
+	/* 设置日志文件的缓冲与刷新策略 */
+	static void setFlushPolicy(const LogFlushPolicy& _Policy);
+	/* 获取日志文件的滚动策略 */
+	static LogRotatePolicy getRotatePolicy();
+	/* 设置日志文件的滚动策略，异步模式下滚动在后台线程中进行 */
+	static void setRotatePolicy(const LogRotatePolicy& _Policy);
+	/* 获取日志文件的压缩策略 */
+	static LogCompressPolicy getCompressPolicy();
+	/* 设置日志文件的压缩策略，当前文件立即切换，二进制日志文件不压缩 */
+	static void setCompressPolicy(const LogCompressPolicy& _Policy);
+	/* 读取运行统计，各项分别以relaxed方式读取，彼此之间不保证一致；注册目标的字节数见LogSink::getBytesWritten */
+	static LogStats getStats() noexcept;
+	/**
+	 * @brief 设置调用点的采样与限速，覆盖LOG_EVERY_N、LOG_RATE_LIMIT的参数
+	 *
+	 * 立即作用于已执行过的调用点，并保存为规则，之后首次执行的匹配调用点同样生效，后设置的规则优先。
+	 * 以默认的LogSiteLimit调用即取消限制
+	 *
+	 * @param _File     文件名后缀，如"server.cpp"，为空表示所有文件
+	 * @param _Line     行号，0表示文件中的所有调用点
+	 * @param _Limit    设置
+	 */
+	static void setSiteLimit(const char* _File, uint _Line, const LogSiteLimit& _Limit);
+	/* 获取崩溃保护缓冲区的设置 */
+	static LogCrashPolicy getCrashPolicy();
+	/**
+	 * @brief 设置崩溃保护缓冲区，已初始化时立即生效，否则在Init时生效
+	 *
+	 * 启用时若缓冲区文件中有上次运行未写入日志文件的日志，先将其补写到原日志文件。
+	 * 保护的是已进入日志文件写缓冲区的日志；异步模式下仍在各线程队列中的日志不在保护范围内，
+	 * 需要保留崩溃前最后的日志时，可使用同步模式并调大写缓冲区与刷新间隔。
+	 * 信号处理函数在备用信号栈上运行，调用本函数或Init的线程与后台写线程会安装备用栈；
+	 * 其他线程栈溢出时处理函数无法运行，未写入的日志在下次启用时补写。
+	 *
+	 * @param _Policy    设置
+	 */
+	static void setCrashPolicy(const LogCrashPolicy& _Policy);
+	/* 获取命令行的输出策略 */
+	static LogConsolePolicy getConsolePolicy();
+	/* 设置命令行的输出策略 */
+	static void setConsolePolicy(const LogConsolePolicy& _Policy);
+	/* 获取因标准输出不可写而丢弃的日志数 */
+	static uint64_t getConsoleDroppedCount() noexcept;
+	/* 获取Log输出模式 */
+	static LOGMODE getLogMode() noexcept { return m_LogMode.load(std::memory_order_relaxed); }
+	/* 获取异步模式下每个线程的队列容量 */
+	static size_t getQueueCapacity() noexcept { return m_nQueueCapacity.load(std::memory_order_relaxed); }
+	/* 设置异步模式下每个线程的队列容量，只对之后创建的队列生效 */
+	static void setQueueCapacity(size_t _Capacity) noexcept { m_nQueueCapacity.store(_Capacity, std::memory_order_relaxed); }
+	/* 获取队列满时的处理策略 */
+	static LOGOVERFLOW getOverflowPolicy() noexcept { return m_OverflowPolicy.load(std::memory_order_relaxed); }
+	/* 设置队列满时的处理策略 */
+	static void setOverflowPolicy(LOGOVERFLOW _Policy) noexcept { m_OverflowPolicy.store(_Policy, std::memory_order_relaxed); }
+	/* 获取因队列满而丢弃的日志数 */
+	static uint64_t getDroppedCount() noexcept { return m_nDroppedCount.load(std::memory_order_relaxed); }
+	/* 获取后台写线程的设置 */
+	static LogWriterPolicy getWriterPolicy();
+	/* 设置后台写线程，已运行的写线程按新设置重新启动，队列中的日志由新的写线程接着输出 */
+	static void setWriterPolicy(const LogWriterPolicy& _Policy);
+	/* 获取运行中的后台写线程数，同步模式下为0 */
+	static size_t getWriterCount() noexcept;
+	/* 获取日志编码 */
+	static LOGENCODING getEncoding() noexcept { return m_Encoding.load(std::memory_order_relaxed); }
+	/* 设置日志编码，LOG_ENCODING_UTF8下格式串与字符串参数应为UTF-8 */
+	static void setEncoding(LOGENCODING _Encoding) noexcept { m_Encoding.store(_Encoding, std::memory_order_relaxed); }
+	/* 获取时间精度 */
+	static LOGTIMEPRECISION getTimePrecision() noexcept { return m_TimePrecision.load(std::memory_order_relaxed); }
+	/* 设置时间精度 */
+	static void setTimePrecision(LOGTIMEPRECISION _Precision) noexcept { m_TimePrecision.store(_Precision, std::memory_order_relaxed); }
+	/* 获取输出模式 */
+	static std::string getPattern();
+	/**
+	 * @brief 设置文本日志的输出模式，可在Init之前调用，之后格式化的日志立即使用新模式
+	 * 
+	 * 模式只在设置时解析一次。说明符：%t 时间，%l 等级，%P 进程号，%T 线程号，%N 线程名称（未设置时为线程号），%f 文件名，
+	 * %F 函数名，%n 行号，%m 正文，%B 等级分隔行（含前后换行），%% 百分号；%与字母之间的数字为最小宽度，
+	 * 如%5P。没有%m时正文在最后，模式不以换行或%B结尾时自动追加换行。
+	 * getLogFromFile按当前模式划分与解析日志文件，规则与限制见LogReader::setPattern；崩溃恢复在最早的部分被覆盖时
+	 * 从下一个分隔行开始，不含%B时从下一行开始。
+	 * 
+	 * @param _Pattern    输出模式，如"%t %l [%T] %f:%n %m"，默认为LOG_DEFAULT_PATTERN
+	 */
+	static void setPattern(const std::string& _Pattern);
+	/* 获取结构化日志的输出格式 */
+	static LOGKVFORMAT getKvFormat() noexcept { return m_KvFormat.load(std::memory_order_relaxed); }
+	/* 设置结构化日志的输出格式 */
+	static void setKvFormat(LOGKVFORMAT _Format) noexcept { m_KvFormat.store(_Format, std::memory_order_relaxed); }
+	/* 获取实际使用的时钟源 */
+	static LOGCLOCK getClockSource() noexcept { return m_ClockSource.load(std::memory_order_relaxed); }
+	/**
+	 * @brief 设置时钟源
+	 * 
+	 * 首次选择LOG_CLOCK_TSC时检查CPU是否提供恒定频率的计数器并测量其频率，约阻塞10毫秒，写日志时不再测量；
+	 * 不支持时仍使用系统时钟，可由getClockSource确认
+	 * 
+	 * @param _Clock    时钟源
+	 */
+	static void setClockSource(LOGCLOCK _Clock);
 
 protected:
 	Log() = default;
 
+private:
+	/**
+	 * @brief 格式化一条日志
+	 * 
+	 * @param     _Buffer    OUT 格式化后的日志
+	 * @param   _LogLevel    日志等级
+	 * @param   _FileName    函数所在文件名
+	 * @param   _Function    函数名
+	 * @param _LineNumber    行号
+	 * @param     _Format    格式化
+	 * @param       _Args    参数列表
+	 */
+	static void formatLog
+	(
+		std::wstring&    _Buffer,
+		const LOGLEVEL _LogLevel,
+		const wchar_t* _FileName,
+		const wchar_t* _Function,
+		const uint   _LineNumber,
+		const char*      _Format,
+		va_list            _Args
+	);
+	/* 同上，以UTF-8格式化，格式串不经过转换 */
+	static void formatLog
+	(
+		std::string&     _Buffer,
+		const LOGLEVEL _LogLevel,
+		const char*    _FileName,
+		const char*    _Function,
+		const uint   _LineNumber,
+		const char*      _Format,
+		va_list            _Args
+	);
+	/* 按字符类型格式化并输出，可变参数版本writeLog的实现，定义见log.cpp */
+	template<typename Char>
+	static void writeLogV
+	(
+		const LOGLEVEL _LogLevel,
+		const Char*    _FileName,
+		const Char*    _Function,
+		const uint   _LineNumber,
+		const char*      _Format,
+		va_list            _Args
+	);
+	/* 一条日志开头与结尾共用的输出模式快照，存续期间快照不会释放，须在同一线程构造与析构 */
+	class PatternReader
+	{
+	public:
+		PatternReader();
+		~PatternReader();
+		PatternReader(const PatternReader&) = delete;
+		PatternReader& operator=(const PatternReader&) = delete;
+
+		const LogPattern& operator*() const noexcept { return m_Pattern; }
+
+	private:
+		const LogPattern& m_Pattern;
+	};
+
+	/**
+	 * @brief 清空缓冲区并按输出模式写入正文之前的部分
+	 * 
+	 * @param    _Pattern    输出模式，同一条日志的开头与结尾须使用同一模式
+	 * @param     _Buffer    OUT 格式化后的日志
+	 * @param   _LogLevel    日志等级
+	 * @param   _FileName    函数所在文件名
+	 * @param   _Function    函数名
+	 * @param _LineNumber    行号
+	 * @param       _Time    记录时间，自1970年起的纳秒数
+	 * @param   _ThreadId    调用线程号
+	 * @param _ThreadName    调用线程的名称，未设置时为空
+	 */
+	static void formatLogHeader
+	(
+		const LogPattern& _Pattern,
+		std::wstring&    _Buffer,
+		const LOGLEVEL _LogLevel,
+		const wchar_t* _FileName,
+		const wchar_t* _Function,
+		const uint   _LineNumber,
+		const int64_t      _Time,
+		const uint     _ThreadId,
+		const LogThreadName* _ThreadName
+	);
+	/* 同上，UTF-8版本 */
+	static void formatLogHeader
+	(
+		const LogPattern& _Pattern,
+		std::string&     _Buffer,
+		const LOGLEVEL _LogLevel,
+		const char*    _FileName,
+		const char*    _Function,
+		const uint   _LineNumber,
+		const int64_t      _Time,
+		const uint     _ThreadId,
+		const LogThreadName* _ThreadName
+	);
+	/* 按输出模式写入正文之后的部分，参数与formatLogHeader相同 */
+	static void formatLogFooter
+	(
+		const LogPattern& _Pattern,
+		std::wstring&    _Buffer,
+		const LOGLEVEL _LogLevel,
+		const wchar_t* _FileName,
+		const wchar_t* _Function,
+		const uint   _LineNumber,
+		const int64_t      _Time,
+		const uint     _ThreadId,
+		const LogThreadName* _ThreadName
+	);
+	static void formatLogFooter
+	(
+		const LogPattern& _Pattern,
+		std::string&     _Buffer,
+		const LOGLEVEL _LogLevel,
+		const char*    _FileName,
+		const char*    _Function,
+		const uint   _LineNumber,
+		const int64_t      _Time,
+		const uint     _ThreadId,
+		const LogThreadName* _ThreadName
+	);
+	/**
+	 * @brief 写入结构化日志的时间、等级、进程号、线程号、调用点与消息，之后由调用者追加键值对
+	 * 
+	 * @param    _Buffer    OUT 格式化后的日志
+	 * @param    _Format    输出格式
+	 * @param  _LogLevel    日志等级
+	 * @param      _Site    调用点
+	 * @param      _Time    记录时间，自1970年起的纳秒数
+	 * @param  _ThreadId    调用线程号
+	 * @param _ThreadName   调用线程的名称，未设置时为空
+	 * @param   _Message    消息
+	 */
+	static void formatKvHeader
+	(
+		std::string&     _Buffer,
+		const LOGKVFORMAT _Format,
+		const LOGLEVEL _LogLevel,
+		const LogSite&     _Site,
+		const int64_t      _Time,
+		const uint     _ThreadId,
+		const LogThreadName* _ThreadName,
+		const char*     _Message
+	);
+	/* 同步模式下按字符类型取共用的缓冲区，调用者须持有写锁 */
+	template<typename Char>
+	static std::basic_string<Char>& syncBuffer() noexcept
+	{
+		if constexpr (std::is_same_v<Char, char>)
+			return m_strLogBuffer;
+		else
+			return m_wstrLogBuffer;
+	}
+#ifdef CPP20
+	/* 按字符类型格式化并输出，模板版本writeLog的实现，_Site不为空时同时记录二进制日志 */
+	template<LogFixedString _Format, typename Char, typename... Args>
+	static void writeFormatted
+	(
+		const LOGLEVEL _LogLevel,
+		const Char*    _FileName,
+		const Char*    _Function,
+		const uint   _LineNumber,
+		const LogSite*     _Site,
+		const Args&...   _Args
+	)
+	{
+		auto fillRecord = [&](LogRecord& _Record)
+		{
+			const LOGTARGET target = getLogTarget();
+			_Record.m_bUtf8 = std::is_same_v<Char, char>;
+			stampRecord(_Record);
+			if (needsText(target))
+			{
+				std::basic_string<Char>& buffer = _Record.text<Char>();
+				const PatternReader pattern;
+				formatLogHeader(*pattern, buffer, _LogLevel, _FileName, _Function, _LineNumber, _Record.m_nTime, _Record.m_nThreadId, _Record.m_pThreadName);
+				LogFormatTo<_Format>(buffer, _Args...);
+				formatLogFooter(*pattern, buffer, _LogLevel, _FileName, _Function, _LineNumber, _Record.m_nTime, _Record.m_nThreadId, _Record.m_pThreadName);
+			}
+			if (_Site && (target & LOG_TARGET_BINARY))
+			{
+				_Record.m_pSite = _Site;
+				_Record.m_bBinary = true;
+				LogEncodeBinary<_Format>(_Record.m_strBinary, _Args...);
+			}
+		};
+
+		if (isBacktraced(_LogLevel))
+		{
+			fillRecord(acquireBacktrace(_LogLevel));
+			return;
+		}
+		if (getLogMode() != LOG_MODE_SYNC)
+		{
+			flushBacktrace(_LogLevel, false);
+			LogRecord& record = acquireRecord(_LogLevel);
+			fillRecord(record);
+			pushToRing(record);
+			return;
+		}
+
+		// 写锁
+		CallerLock writeLock;
+		flushBacktrace(_LogLevel, true);
+		LogRecord& record = acquireRecord(_LogLevel);
+		fillRecord(record);
+		outputRecord(record);
+	}
+	/* 延迟格式化的正文：解码参数后按记录的编码格式化 */
+	template<LogFixedString _Format, typename... Args>
+	static void formatDeferred(LogRecord& _Record)
+	{
+		if (_Record.m_bUtf8)
+			LogDecodeFormat<_Format, Args...>(_Record.m_strLog, _Record.m_strArgs.data());
+		else
+			LogDecodeFormat<_Format, Args...>(_Record.m_wstrLog, _Record.m_strArgs.data());
+	}
+#endif // CPP20
+	/* 第_Index个后台写线程 */
+	static void writerThreadProc(size_t _Index);
+	/* 按m_WriterPolicy启动后台写线程，须持有m_QueueMutex */
+	static void startWriters();
+	/* 通知后台写线程退出并等待，重启时剩余的日志留给新的写线程，否则先输出；写线程未运行时返回false */
+	static bool stopWriters();
+	/**
+	 * @brief 日志放入当前线程的队列
+	 * 
+	 * @param _Record    日志，入队后内容与队列中的空闲缓冲区交换
+	 */
+	static void pushToRing(LogRecord& _Record);
+	/* 当前线程复用的日志记录，已预留空间 */
+	static LogRecord& acquireRecord(const LOGLEVEL _LogLevel);
+	/* 按时钟源获取当前时间，自1970年起的纳秒数 */
+	static int64_t currentTime() noexcept;
+	/* 通过isLevelEnabled但低于日志等级的日志保存到回溯缓冲 */
+	static bool isBacktraced(LOGLEVEL _LogLevel) noexcept { return _LogLevel > m_LogLevel.load(std::memory_order_relaxed); }
+	/* 调用线程回溯缓冲中的下一条记录，缓冲已满时复用最早的一条 */
+	static LogRecord& acquireBacktrace(const LOGLEVEL _LogLevel);
+	/* 输出LOG_LEVEL_ERROR日志前先输出调用线程回溯缓冲中的日志，_Locked表示调用者持有写锁并同步输出 */
+	static void flushBacktrace(LOGLEVEL _LogLevel, bool _Locked)
+	{
+		if (_LogLevel == LOG_LEVEL_ERROR)
+			dumpBacktrace(_Locked);
+	}
+	static void dumpBacktrace(bool _Locked);
+	/* 记录延迟格式化所需的时间与线程号 */
+	static void stampRecord(LogRecord& _Record);
+	/* 延迟格式化的日志在后台线程中格式化到m_wstrLog或m_strLog */
+	static void renderRecord(LogRecord& _Record);
+	/* 按记录的编码输出，调用者须持有写锁 */
+	static void outputRecord(const LogRecord& _Record);
+	/* 由后台写线程格式化并直接输出调用点的汇总，不经过队列，调用者不得持有写锁 */
+	static void writeSummary(const LogSite& _Site, LOGLEVEL _LogLevel, uint64_t _Count);
+	/* 输出到命令行与文本文件，调用者须持有写锁 */
+	static void outputText(const std::wstring& _Log, LOGLEVEL _LogLevel);
+	static void outputText(const std::string& _Log, LOGLEVEL _LogLevel);
+	/* 转为UTF-8后放入各注册目标的队列，调用者须持有写锁 */
+	static void outputToSinks(const std::wstring& _Log, LOGLEVEL _LogLevel);
+	static void outputToSinks(const std::string& _Log, LOGLEVEL _LogLevel, bool _Structured = false);
+	/* 是否需要格式化文本日志 */
+	static bool needsText(LOGTARGET _LogTarget) noexcept
+	{
+		return (_LogTarget & LOG_TARGET_CONSOLE_AND_FILE) || m_nSinkCount.load(std::memory_order_relaxed);
+	}
+	/* 同步输出时调用者持有的写锁，写锁已被占用时记录等待的时间 */
+	class CallerLock
+	{
+	public:
+		CallerLock() { if (!m_LogMutex.try_lock()) waitLock(); }
+		~CallerLock() { m_LogMutex.unlock(); }
+		CallerLock(const CallerLock&) = delete;
+		CallerLock& operator=(const CallerLock&) = delete;
+	};
+	/* 等待写锁并计入统计 */
+	static void waitLock();
+	/* 等待各注册目标输出队列中的日志并调用flush */
+	static void flushSinks();
+	/* 按第_Generation代配置快照打开日志文件，路径变化时先关闭旧文件，须持有写锁 */
+	static void openLogFile(const LogConfig& _Config, uint64_t _Generation);
+	/* 复制当前快照，修改后发布 */
+	static void updateConfig(const std::function<void(LogConfig&)>& _Update);
+	/* 按m_CrashPolicy打开或关闭崩溃保护缓冲区，须持有写锁 */
+	static void applyCrashPolicy();
+	/**
+	 * @brief 按时间戳合并各线程队列中的日志并输出
+	 * 
+	 * @param _Rings       各线程的队列
+	 * @param _MaxBatch    本轮输出的最大条数
+	 * @return size_t      输出的日志条数
+	 */
+	static size_t drainRings(const std::vector<std::shared_ptr<LogRingBuffer>>& _Rings, size_t _MaxBatch = 256);
+	/* 第_Writer个后台写线程休眠时将其唤醒 */
+	static void wakeWriter(size_t _Writer);
+
 private:
 	static std::shared_ptr<Log>    m_Log;              // 唯一实例
 	static std::wstring            m_wstrLogBuffer;    // 存储Log
-	static std::wstring            m_wstrLogFile;      // Log输出文件夹
-	static LOGLEVEL                m_LogLevel;         // Log等级
-	static LOGTARGET               m_LogTarget;        // Log输出位置
-	static std::once_flag          m_ResourceFlag;     // 用于初始化线程同步
+	static std::string             m_strLogBuffer;     // 存储UTF-8编码的Log
+	static std::atomic<LOGLEVEL>   m_LogLevel;         // Log等级，LOG宏直接读取，不经过配置快照
+	static std::atomic<LOGLEVEL>   m_BacktraceLevel;   // 回溯缓冲保存的最低等级
+	static std::atomic<size_t>     m_nBacktraceCount;  // 回溯缓冲每个线程保存的条数
+	static uint64_t                m_nFileGeneration;  // 日志文件按其打开的配置快照代数，由写锁保护
+	static std::mutex              m_ConfigMutex;      // 替换配置互斥
 	static std::shared_mutex       m_LogMutex;         // 读写互斥
+	static std::atomic<LOGMODE>    m_LogMode;          // Log输出模式
+	static LogCrashBuffer          m_CrashBuffer;      // 崩溃保护缓冲区，须先于m_LogFile构造
+	static LogFile                 m_LogFile;          // 常驻打开的Log输出文件
+	static LogBinaryFile           m_BinaryFile;       // 常驻打开的二进制Log输出文件
+	static LogFlushPolicy          m_FlushPolicy;      // Log文件缓冲与刷新策略
+	static LogRotatePolicy         m_RotatePolicy;     // Log文件滚动策略
+	static LogCompressPolicy       m_CompressPolicy;   // Log文件压缩策略
+	static LogConsole              m_Console;          // 命令行输出缓冲
+	static LogConsolePolicy        m_ConsolePolicy;    // 命令行输出策略
+	static LogCrashPolicy          m_CrashPolicy;      // 崩溃保护缓冲区的设置
+	static LogCounters             m_Counters;         // 运行统计，须先于各输出文件构造
+	static std::vector<std::shared_ptr<LogRingBuffer>> m_RingList; // 各线程的日志队列
+	static std::mutex              m_RingMutex;        // 队列注册互斥
+	static std::atomic<uint64_t>   m_nRingVersion;     // 队列列表版本，注册或移除队列时递增
+	static std::atomic<size_t>     m_nQueueCapacity;   // 每个线程的队列容量
+	static std::atomic<LOGOVERFLOW> m_OverflowPolicy;  // 队列满时的处理策略
+	static std::atomic<uint64_t>   m_nDroppedCount;    // 丢弃的日志数
+	static std::atomic<LOGENCODING> m_Encoding;        // 日志编码
+	static std::atomic<LOGTIMEPRECISION> m_TimePrecision; // 时间精度
+	static std::atomic<LOGCLOCK>   m_ClockSource;      // 时钟源
+	static std::atomic<LOGKVFORMAT> m_KvFormat;        // 结构化日志的输出格式
+	static std::vector<std::shared_ptr<LogSinkWorker>> m_SinkList; // 注册的输出目标，由写锁保护
+	static std::atomic<size_t>     m_nSinkCount;       // 注册的输出目标数
+	static std::mutex              m_QueueMutex;       // 后台线程休眠及Flush同步
+	static std::condition_variable m_FlushCond;        // 通知Flush已完成
+	static LogWriters              m_Writers;          // 后台写线程
+	static LogWriterPolicy         m_WriterPolicy;     // 后台写线程的设置，由m_QueueMutex保护
+	static std::atomic<bool>       m_bWriterRunning;   // 后台写线程是否运行
+	static uint64_t                m_nFlushRequest;    // Flush请求序号
+};
+
+/**
+ * 命名的日志实例，由Log::getLogger获取
+ *
+ * 每个实例有独立的日志等级与输出目标，调用线程格式化后直接放入各目标的队列，
+ * 不经过Log的写锁与队列，不同子系统的日志互不阻塞。日志以UTF-8格式化，使用Log::setPattern的输出模式。
+ */
+class Logger
+{
+public:
+	Logger(const Logger&) = delete;
+	Logger& operator=(const Logger&) = delete;
+
+	/* 名称 */
+	const std::string& name() const noexcept { return m_strName; }
+	/* 获取日志等级 */
+	LOGLEVEL getLevel() const noexcept { return m_Level.load(std::memory_order_relaxed); }
+	/* 设置日志等级，与Log::setLogLevel互不影响 */
+	void setLevel(LOGLEVEL _LogLevel) noexcept { m_Level.store(_LogLevel, std::memory_order_relaxed); }
+	/* 该等级的日志是否输出，LOG_TO宏在求值参数前调用 */
+	bool isLevelEnabled(LOGLEVEL _LogLevel) const noexcept
+	{
+		return _LogLevel <= LOG_COMPILE_LEVEL && _LogLevel <= m_Level.load(std::memory_order_relaxed);
+	}
+	/* 是否同时输出到LOGTARGET指定的目标 */
+	bool getPropagate() const noexcept { return m_bPropagate.load(std::memory_order_relaxed); }
+	/* 设置是否同时输出到LOGTARGET指定的目标，输出时需要Log的写锁 */
+	void setPropagate(bool _Propagate) noexcept { m_bPropagate.store(_Propagate, std::memory_order_relaxed); }
+	/**
+	 * @brief 注册输出目标，同一目标可同时注册到多个实例与Log
+	 * 
+	 * @param _Sink         输出目标，同一目标在本实例中只注册一次
+	 * @param _QueueSize    该目标在本实例中的队列容量
+	 */
+	void addSink(const std::shared_ptr<LogSink>& _Sink, size_t _QueueSize = 8192);
+	/* 移除输出目标，返回前输出其队列中的日志并调用flush */
+	void removeSink(const std::shared_ptr<LogSink>& _Sink);
+	/* 等待各目标输出队列中的日志并调用flush */
+	void flush();
+	/**
+	 * @brief 记录日志，C++17下LOG_TO宏使用的版本
+	 * 
+	 * @param   _LogLevel    日志等级
+	 * @param       _Site    调用点，须为静态对象
+	 * @param     _Format    格式化，UTF-8
+	 * @param ...            参数列表
+	 */
+	void __cdecl writeLog(const LOGLEVEL _LogLevel, const LogSite& _Site, const char* _Format, ...);
+#ifdef CPP20
+	/* 记录日志，格式串在编译期解析，LOG_TO宏使用的版本 */
+	template<LogFixedString _Format, typename... Args>
+	void writeLog(const LOGLEVEL _LogLevel, const LogSite& _Site, const Args&... _Args)
+	{
+		static_assert(LogCheckFormat<_Format, Args...>());
+		if (!isLevelEnabled(_LogLevel))
+			return;
+
+		LogRecord& record = Log::acquireRecord(_LogLevel);
+		Log::stampRecord(record);
+		const Log::PatternReader pattern;
+		Log::formatLogHeader(*pattern, record.m_strLog, _LogLevel, _Site.m_szFile, _Site.m_szFunction, _Site.m_nLine,
+			record.m_nTime, record.m_nThreadId, record.m_pThreadName);
+		LogFormatTo<_Format>(record.m_strLog, _Args...);
+		Log::formatLogFooter(*pattern, record.m_strLog, _LogLevel, _Site.m_szFile, _Site.m_szFunction, _Site.m_nLine,
+			record.m_nTime, record.m_nThreadId, record.m_pThreadName);
+		output(record.m_strLog, _LogLevel);
+	}
+#endif // CPP20
+
+private:
+	friend class LoggerRegistry;
+
+	explicit Logger(const std::string& _Name) : m_strName(_Name) {}
+	/* 放入各目标的队列，需要时同时输出到Log的目标 */
+	void output(const std::string& _Log, LOGLEVEL _LogLevel);
+
+	std::string                                 m_strName;                          // 名称
+	std::atomic<LOGLEVEL>                       m_Level      { LOG_LEVEL_INFO };    // 日志等级
+	std::atomic<bool>                           m_bPropagate { false };             // 同时输出到Log的目标
+	std::shared_mutex                           m_SinkMutex;                        // 保护m_SinkList
+	std::vector<std::shared_ptr<LogSinkWorker>> m_SinkList;                         // 输出目标
 };
 
 #endif // _LOG_HPP_
\ No newline at end of file
@@ -0,0 +1,516 @@
+/**
+ * @file log_aio.cpp
+ * @author ldk
+ * @brief 以异步I/O批量写入日志文件
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * 日志拷贝进固定的缓冲区池，缓冲区写满后整块提交，由内核在后台写入文件，写入完成后缓冲区回到池中。
+ * Linux下使用io_uring并预先注册缓冲区（IORING_OP_WRITE_FIXED），注册失败时使用普通的IORING_OP_WRITE；
+ * Windows下使用重叠I/O的WriteFile；两者均不可用时退化为同步的pwrite。
+ * 每块缓冲区写入文件中预先确定的位置，写入完成的先后不影响文件内容的顺序。
+ */
+
+#include "log_sink.hpp"
+
+#ifdef _WIN32
+
+#include <Windows.h>
+
+#else
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <cerrno>
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#if defined(__NR_io_uring_setup) && defined(IORING_OFF_SQ_RING)
+#define LOG_HAS_IO_URING
+#endif
+#endif // __linux__
+
+#endif // _WIN32
+
+/* 异步I/O文件，只在所属目标的输出线程中使用 */
+class LogAioFile
+{
+public:
+	LogAioFile(size_t _BufferSize, size_t _BufferCount)
+		: m_nBufferSize(_BufferSize ? _BufferSize : 1), m_Buffers(_BufferCount ? _BufferCount : 1)
+	{
+		for (Buffer& buffer : m_Buffers)
+			buffer.m_pData.reset(new char[m_nBufferSize]);
+		for (size_t i = m_Buffers.size(); i > 0; --i)
+			m_FreeList.push_back(i - 1);
+	}
+
+	~LogAioFile() { close(); }
+	LogAioFile(const LogAioFile&) = delete;
+	LogAioFile& operator=(const LogAioFile&) = delete;
+
+	/**
+	 * @brief 打开文件，日志追加到已有内容之后
+	 *
+	 * @param _Path     文件路径
+	 * @return false    打开失败
+	 */
+	bool open(const std::wstring& _Path)
+	{
+		const std::filesystem::path path(_Path);
+#ifdef _WIN32
+		m_hFile = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+			OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, nullptr);
+		if (m_hFile == INVALID_HANDLE_VALUE)
+		{
+			m_hFile = nullptr;
+			return false;
+		}
+		LARGE_INTEGER size {};
+		if (GetFileSizeEx(m_hFile, &size))
+			m_nOffset = static_cast<uint64_t>(size.QuadPart);
+		for (Buffer& buffer : m_Buffers)
+			buffer.m_hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+		m_Backend = LOG_AIO_OVERLAPPED;
+#else
+		m_nFd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+		if (m_nFd < 0)
+			return false;
+		struct stat status {};
+		if (fstat(m_nFd, &status) == 0)
+			m_nOffset = static_cast<uint64_t>(status.st_size);
+		m_Backend = LOG_AIO_SYNC;
+#ifdef LOG_HAS_IO_URING
+		setupRing();
+#endif // LOG_HAS_IO_URING
+#endif // _WIN32
+		return true;
+	}
+
+	/* 写完所有缓冲区并关闭文件 */
+	void close()
+	{
+		if (!isOpen())
+			return;
+		flush();
+#ifdef _WIN32
+		for (Buffer& buffer : m_Buffers)
+		{
+			if (buffer.m_hEvent)
+				CloseHandle(buffer.m_hEvent);
+			buffer.m_hEvent = nullptr;
+		}
+		CloseHandle(m_hFile);
+		m_hFile = nullptr;
+#else
+#ifdef LOG_HAS_IO_URING
+		closeRing();
+#endif // LOG_HAS_IO_URING
+		::close(m_nFd);
+		m_nFd = -1;
+#endif // _WIN32
+	}
+
+	bool isOpen() const noexcept
+	{
+#ifdef _WIN32
+		return m_hFile != nullptr;
+#else
+		return m_nFd >= 0;
+#endif // _WIN32
+	}
+
+	LOGAIOBACKEND backend() const noexcept { return m_Backend; }
+	uint64_t errorCount() const noexcept { return m_nErrorCount; }
+
+	/**
+	 * @brief 日志拷贝进当前缓冲区，写满后提交，超过缓冲区大小的日志分多块写入
+	 *
+	 * @param _Data    日志内容
+	 * @param _Size    字节数
+	 */
+	void write(const char* _Data, size_t _Size)
+	{
+		while (_Size)
+		{
+			if (m_nCurrent == NO_BUFFER)
+				m_nCurrent = acquire();
+			Buffer& buffer = m_Buffers[m_nCurrent];
+			const size_t nCopy = std::min(_Size, m_nBufferSize - buffer.m_nSize);
+			memcpy(buffer.m_pData.get() + buffer.m_nSize, _Data, nCopy);
+			buffer.m_nSize += nCopy;
+			_Data += nCopy;
+			_Size -= nCopy;
+			if (buffer.m_nSize == m_nBufferSize)
+				submitCurrent();
+		}
+	}
+
+	/* 提交未写满的当前缓冲区，不等待完成 */
+	void submitCurrent()
+	{
+		if (m_nCurrent == NO_BUFFER)
+			return;
+		const size_t nIndex = m_nCurrent;
+		m_nCurrent = NO_BUFFER;
+		Buffer& buffer = m_Buffers[nIndex];
+		if (!buffer.m_nSize)
+		{
+			m_FreeList.push_back(nIndex);
+			return;
+		}
+		buffer.m_nOffset = m_nOffset;
+		m_nOffset += buffer.m_nSize;
+		submit(nIndex);
+	}
+
+	/* 提交当前缓冲区并等待所有写入完成 */
+	void flush()
+	{
+		submitCurrent();
+		while (m_nInFlight)
+			reap(true);
+	}
+
+private:
+	static constexpr size_t NO_BUFFER = static_cast<size_t>(-1);
+#ifdef LOG_HAS_IO_URING
+	/* 提交暂时失败时的重试次数 */
+	static constexpr int SUBMIT_RETRIES = 8;
+#endif // LOG_HAS_IO_URING
+
+	struct Buffer
+	{
+		std::unique_ptr<char[]> m_pData;
+		size_t                  m_nSize   { 0 };   // 已填充的字节数
+		uint64_t                m_nOffset { 0 };   // 在文件中的写入位置
+#ifdef _WIN32
+		OVERLAPPED              m_Overlapped {};
+		HANDLE                  m_hEvent  { nullptr };
+#endif // _WIN32
+	};
+
+	/* 取一块空闲缓冲区，全部在写入中时等待最早的完成 */
+	size_t acquire()
+	{
+		while (m_FreeList.empty())
+			reap(true);
+		const size_t nIndex = m_FreeList.back();
+		m_FreeList.pop_back();
+		m_Buffers[nIndex].m_nSize = 0;
+		return nIndex;
+	}
+
+	/* 写入完成，缓冲区回到池中 */
+	void release(size_t _Index)
+	{
+		--m_nInFlight;
+		m_FreeList.push_back(_Index);
+	}
+
+	/* 同步写入缓冲区中[_Done, m_nSize)的部分，用于同步方式及异步写入未写完的情况 */
+	bool writeRest(size_t _Index, size_t _Done)
+	{
+		Buffer& buffer = m_Buffers[_Index];
+		while (_Done < buffer.m_nSize)
+		{
+#ifdef _WIN32
+			OVERLAPPED overlapped {};
+			const uint64_t nOffset = buffer.m_nOffset + _Done;
+			overlapped.Offset = static_cast<DWORD>(nOffset);
+			overlapped.OffsetHigh = static_cast<DWORD>(nOffset >> 32);
+			overlapped.hEvent = buffer.m_hEvent;
+			ResetEvent(buffer.m_hEvent);
+			DWORD nWritten = 0;
+			if (!WriteFile(m_hFile, buffer.m_pData.get() + _Done, static_cast<DWORD>(buffer.m_nSize - _Done), nullptr, &overlapped)
+				&& GetLastError() != ERROR_IO_PENDING)
+				return false;
+			if (!GetOverlappedResult(m_hFile, &overlapped, &nWritten, TRUE) || !nWritten)
+				return false;
+			_Done += nWritten;
+#else
+			const ssize_t n = pwrite(m_nFd, buffer.m_pData.get() + _Done, buffer.m_nSize - _Done, static_cast<off_t>(buffer.m_nOffset + _Done));
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0)
+				return false;
+			_Done += static_cast<size_t>(n);
+#endif // _WIN32
+		}
+		return true;
+	}
+
+	void submit(size_t _Index)
+	{
+		++m_nInFlight;
+#ifdef _WIN32
+		Buffer& buffer = m_Buffers[_Index];
+		buffer.m_Overlapped = OVERLAPPED {};
+		buffer.m_Overlapped.Offset = static_cast<DWORD>(buffer.m_nOffset);
+		buffer.m_Overlapped.OffsetHigh = static_cast<DWORD>(buffer.m_nOffset >> 32);
+		buffer.m_Overlapped.hEvent = buffer.m_hEvent;
+		ResetEvent(buffer.m_hEvent);
+		if (WriteFile(m_hFile, buffer.m_pData.get(), static_cast<DWORD>(buffer.m_nSize), nullptr, &buffer.m_Overlapped)
+			|| GetLastError() == ERROR_IO_PENDING)
+		{
+			m_Pending.push_back(_Index);
+			return;
+		}
+		++m_nErrorCount;
+		release(_Index);
+#else
+#ifdef LOG_HAS_IO_URING
+		if (m_nRing >= 0 && !m_bSubmitFailed)
+		{
+			submitRing(_Index);
+			return;
+		}
+#endif // LOG_HAS_IO_URING
+		if (!writeRest(_Index, 0))
+			++m_nErrorCount;
+		release(_Index);
+#endif // _WIN32
+	}
+
+	/**
+	 * @brief 处理已完成的写入
+	 *
+	 * @param _Wait    没有完成的写入时是否等待
+	 */
+	void reap(bool _Wait)
+	{
+#ifdef _WIN32
+		// 按提交顺序等待最早的一块
+		if (m_Pending.empty())
+			return;
+		const size_t nIndex = m_Pending.front();
+		Buffer& buffer = m_Buffers[nIndex];
+		DWORD nWritten = 0;
+		if (!GetOverlappedResult(m_hFile, &buffer.m_Overlapped, &nWritten, _Wait ? TRUE : FALSE))
+		{
+			if (GetLastError() == ERROR_IO_INCOMPLETE)
+				return;
+			nWritten = 0;
+		}
+		m_Pending.pop_front();
+		if (nWritten < buffer.m_nSize && !writeRest(nIndex, nWritten))
+			++m_nErrorCount;
+		release(nIndex);
+#elif defined(LOG_HAS_IO_URING)
+		if (m_nRing >= 0)
+			reapRing(_Wait);
+#else
+		(void)_Wait;
+#endif // _WIN32
+	}
+
+#ifdef LOG_HAS_IO_URING
+	/* 建立io_uring并注册缓冲区，失败时保持同步方式 */
+	void setupRing()
+	{
+		io_uring_params params {};
+		const int nRing = static_cast<int>(syscall(__NR_io_uring_setup, static_cast<unsigned>(m_Buffers.size()), &params));
+		if (nRing < 0)
+			return;
+
+		m_nSqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+		m_nCqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		if (params.features & IORING_FEAT_SINGLE_MMAP)
+			m_nSqRingSize = m_nCqRingSize = std::max(m_nSqRingSize, m_nCqRingSize);
+		m_nSqesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+		void* pSq = mmap(nullptr, m_nSqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, nRing, IORING_OFF_SQ_RING);
+		void* pCq = pSq;
+		if (pSq != MAP_FAILED && !(params.features & IORING_FEAT_SINGLE_MMAP))
+			pCq = mmap(nullptr, m_nCqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, nRing, IORING_OFF_CQ_RING);
+		void* pSqes = pCq != MAP_FAILED ? mmap(nullptr, m_nSqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, nRing, IORING_OFF_SQES) : MAP_FAILED;
+		if (pSq == MAP_FAILED || pCq == MAP_FAILED || pSqes == MAP_FAILED)
+		{
+			if (pSq != MAP_FAILED)
+				munmap(pSq, m_nSqRingSize);
+			if (pCq != MAP_FAILED && pCq != pSq)
+				munmap(pCq, m_nCqRingSize);
+			::close(nRing);
+			return;
+		}
+
+		char* sq = static_cast<char*>(pSq);
+		char* cq = static_cast<char*>(pCq);
+		m_pSqRing = pSq;
+		m_pCqRing = pCq;
+		m_pSqTail = reinterpret_cast<uint32_t*>(sq + params.sq_off.tail);
+		m_nSqMask = *reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+		m_pSqArray = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+		m_pSqes = static_cast<io_uring_sqe*>(pSqes);
+		m_pCqHead = reinterpret_cast<uint32_t*>(cq + params.cq_off.head);
+		m_pCqTail = reinterpret_cast<uint32_t*>(cq + params.cq_off.tail);
+		m_nCqMask = *reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+		m_pCqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+		m_nRing = nRing;
+
+		// 注册缓冲区后内核不必每次写入都映射用户内存，超出RLIMIT_MEMLOCK时不注册
+		std::vector<iovec> iovecs(m_Buffers.size());
+		for (size_t i = 0; i < m_Buffers.size(); ++i)
+			iovecs[i] = iovec { m_Buffers[i].m_pData.get(), m_nBufferSize };
+		m_bFixedBuffers = syscall(__NR_io_uring_register, m_nRing, IORING_REGISTER_BUFFERS, iovecs.data(), static_cast<unsigned>(iovecs.size())) == 0;
+		m_Backend = m_bFixedBuffers ? LOG_AIO_IO_URING_FIXED : LOG_AIO_IO_URING;
+	}
+
+	void closeRing()
+	{
+		if (m_nRing < 0)
+			return;
+		munmap(m_pSqes, m_nSqesSize);
+		if (m_pCqRing != m_pSqRing)
+			munmap(m_pCqRing, m_nCqRingSize);
+		munmap(m_pSqRing, m_nSqRingSize);
+		::close(m_nRing);
+		m_nRing = -1;
+	}
+
+	int enterRing(unsigned _Submit, unsigned _MinComplete, unsigned _Flags)
+	{
+		while (true)
+		{
+			const long n = syscall(__NR_io_uring_enter, m_nRing, _Submit, _MinComplete, _Flags, nullptr, 0);
+			if (n >= 0 || errno != EINTR)
+				return static_cast<int>(n);
+		}
+	}
+
+	void submitRing(size_t _Index)
+	{
+		// 写入中的缓冲区数不超过队列长度，提交队列不会满
+		const Buffer& buffer = m_Buffers[_Index];
+		const uint32_t nTail = *m_pSqTail;
+		const uint32_t nSlot = nTail & m_nSqMask;
+		io_uring_sqe& sqe = m_pSqes[nSlot];
+		sqe = io_uring_sqe {};
+		sqe.opcode = m_bFixedBuffers ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+		sqe.fd = m_nFd;
+		sqe.off = buffer.m_nOffset;
+		sqe.addr = reinterpret_cast<uint64_t>(buffer.m_pData.get());
+		sqe.len = static_cast<uint32_t>(buffer.m_nSize);
+		sqe.buf_index = static_cast<uint16_t>(_Index);
+		sqe.user_data = _Index;
+		m_pSqArray[nSlot] = nSlot;
+		__atomic_store_n(m_pSqTail, nTail + 1, __ATOMIC_RELEASE);
+		for (int nRetry = 0; ; ++nRetry)
+		{
+			const int n = enterRing(1, 0, 0);
+			if (n == 1)
+				return;
+			// 内核资源暂时不足时等待其他写入完成后重试
+			const bool bBusy = n == 0 || errno == EAGAIN || errno == EBUSY;
+			if (!bBusy || m_nInFlight <= 1 || nRetry >= SUBMIT_RETRIES)
+				break;
+			reapRing(true);
+		}
+		// 内核可能已看到新的尾指针，未取走的提交项不能撤回；此后不再提交，该项不会执行，改为同步写入
+		m_bSubmitFailed = true;
+		m_Backend = LOG_AIO_SYNC;
+		if (!writeRest(_Index, 0))
+			++m_nErrorCount;
+		release(_Index);
+	}
+
+	void reapRing(bool _Wait)
+	{
+		uint32_t nHead = *m_pCqHead;
+		if (nHead == __atomic_load_n(m_pCqTail, __ATOMIC_ACQUIRE))
+		{
+			if (!_Wait || enterRing(0, 1, IORING_ENTER_GETEVENTS) < 0)
+				return;
+		}
+		const uint32_t nTail = __atomic_load_n(m_pCqTail, __ATOMIC_ACQUIRE);
+		for (; nHead != nTail; ++nHead)
+		{
+			const io_uring_cqe& cqe = m_pCqes[nHead & m_nCqMask];
+			const size_t nIndex = static_cast<size_t>(cqe.user_data);
+			const size_t nDone = cqe.res > 0 ? static_cast<size_t>(cqe.res) : 0;
+			// 出错或未写完时同步写入剩余部分
+			if (nDone < m_Buffers[nIndex].m_nSize && !writeRest(nIndex, nDone))
+				++m_nErrorCount;
+			release(nIndex);
+		}
+		__atomic_store_n(m_pCqHead, nHead, __ATOMIC_RELEASE);
+	}
+#endif // LOG_HAS_IO_URING
+
+	size_t              m_nBufferSize;
+	std::vector<Buffer> m_Buffers;
+	std::vector<size_t> m_FreeList;                  // 空闲缓冲区
+	size_t              m_nCurrent    { NO_BUFFER }; // 正在填充的缓冲区
+	size_t              m_nInFlight   { 0 };         // 写入中的缓冲区数
+	uint64_t            m_nOffset     { 0 };         // 下一块缓冲区的写入位置
+	uint64_t            m_nErrorCount { 0 };         // 写入失败的缓冲区数
+	LOGAIOBACKEND       m_Backend     { LOG_AIO_SYNC };
+#ifdef _WIN32
+	HANDLE              m_hFile       { nullptr };
+	std::deque<size_t>  m_Pending;                   // 按提交顺序排列的写入中的缓冲区
+#else
+	int                 m_nFd         { -1 };
+#endif // _WIN32
+#ifdef LOG_HAS_IO_URING
+	int                 m_nRing       { -1 };
+	bool                m_bFixedBuffers { false };
+	bool                m_bSubmitFailed { false };   // 提交失败后只回收已提交的写入，新的缓冲区同步写入
+	void*               m_pSqRing     { nullptr };
+	void*               m_pCqRing     { nullptr };
+	size_t              m_nSqRingSize { 0 };
+	size_t              m_nCqRingSize { 0 };
+	size_t              m_nSqesSize   { 0 };
+	uint32_t*           m_pSqTail     { nullptr };
+	uint32_t            m_nSqMask     { 0 };
+	uint32_t*           m_pSqArray    { nullptr };
+	io_uring_sqe*       m_pSqes       { nullptr };
+	uint32_t*           m_pCqHead     { nullptr };
+	uint32_t*           m_pCqTail     { nullptr };
+	uint32_t            m_nCqMask     { 0 };
+	io_uring_cqe*       m_pCqes       { nullptr };
+#endif // LOG_HAS_IO_URING
+};
+
+LogAsyncFileSink::LogAsyncFileSink(const std::wstring& _Path, size_t _BufferSize, size_t _BufferCount)
+	: m_pFile(new LogAioFile(_BufferSize, _BufferCount))
+{
+	m_pFile->open(_Path);
+}
+
+LogAsyncFileSink::~LogAsyncFileSink() = default;
+
+void LogAsyncFileSink::write(LOGLEVEL _LogLevel, const std::string& _Log)
+{
+	if (!m_pFile->isOpen())
+		return;
+	m_pFile->write(_Log.data(), _Log.size());
+	// 错误日志立即提交，不等待缓冲区写满
+	if (_LogLevel == LOG_LEVEL_ERROR)
+		m_pFile->submitCurrent();
+}
+
+void LogAsyncFileSink::flush()
+{
+	if (m_pFile->isOpen())
+		m_pFile->flush();
+}
+
+bool LogAsyncFileSink::isOpen() const noexcept
+{
+	return m_pFile->isOpen();
+}
+
+LOGAIOBACKEND LogAsyncFileSink::getBackend() const noexcept
+{
+	return m_pFile->backend();
+}
+
+uint64_t LogAsyncFileSink::getErrorCount() const noexcept
+{
+	return m_pFile->errorCount();
+}
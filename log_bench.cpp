@@ -0,0 +1,357 @@
+/**
+ * @file log_bench.cpp
+ * @author ldk
+ * @brief writeLog吞吐量与调用延迟基准测试
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * 用法：log_bench [选项]
+ *   --threads 1,2,4     线程数列表，默认为1到核心数之间的2的幂
+ *   --records N         每个线程写入的日志数，默认100000
+ *   --modes sync,async,deferred
+ *                       输出模式，deferred为延迟格式化
+ *   --targets null,file,console
+ *                       null为不做任何事的LogSink，只测量格式化与分发；file为./log_bench.txt，console为标准输出
+ *   --messages short,long
+ *   --utf8              使用LOG_ENCODING_UTF8
+ *   --output FILE       结果写入文件，默认写到标准输出，测试console时写到标准错误
+ *   --baseline FILE     与之前的结果比较，吞吐量下降或p99延迟上升超过容差时返回2
+ *   --tolerance 0.10    比较的容差
+ * 结果为CSV，每种组合一行；吞吐量按所有线程写完的时间计算，异步与延迟格式化模式另给出包含Flush的吞吐量。
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "log.hpp"
+#include "log_sink.hpp"
+
+/* 一种组合的测试结果 */
+struct LogBenchResult
+{
+	std::string m_strMode;
+	std::string m_strTarget;
+	std::string m_strMessage;
+	unsigned    m_nThreads        { 0 };
+	uint64_t    m_nRecords        { 0 };   // 所有线程写入的日志数
+	double      m_dSeconds        { 0 };   // 所有线程写完的时间
+	double      m_dRecordsPerSec  { 0 };
+	double      m_dFlushedPerSec  { 0 };   // 包含Flush的吞吐量
+	uint64_t    m_nP50            { 0 };   // 调用延迟（纳秒）
+	uint64_t    m_nP99            { 0 };
+	uint64_t    m_nP999           { 0 };
+	uint64_t    m_nMax            { 0 };
+
+	/* 与基准比较时使用的键 */
+	std::string key() const
+	{
+		return m_strMode + ',' + m_strTarget + ',' + std::to_string(m_nThreads) + ',' + m_strMessage;
+	}
+};
+
+constexpr const char* LOG_BENCH_HEADER = "mode,target,threads,message,records,seconds,records_per_sec,flushed_per_sec,p50_ns,p99_ns,p999_ns,max_ns";
+
+static std::vector<std::string> splitList(const char* _Text)
+{
+	std::vector<std::string> items;
+	std::stringstream stream(_Text);
+	std::string item;
+	while (std::getline(stream, item, ','))
+	{
+		if (!item.empty())
+			items.push_back(item);
+	}
+	return items;
+}
+
+/* 丢弃所有日志的输出目标，不含任何I/O */
+class LogNullSink : public LogSink
+{
+public:
+	void write(LOGLEVEL, const std::string&) override {}
+};
+
+/* 输出模式的名称 */
+static bool parseMode(const std::string& _Name, LOGMODE& _Mode)
+{
+	if (_Name == "sync")
+		_Mode = LOG_MODE_SYNC;
+	else if (_Name == "async")
+		_Mode = LOG_MODE_ASYNC;
+	else if (_Name == "deferred")
+		_Mode = LOG_MODE_DEFERRED;
+	else
+		return false;
+	return true;
+}
+
+/* 写入一条日志并返回调用耗时 */
+static inline uint64_t timedLog(bool _Long, uint64_t _Index)
+{
+	const auto tBegin = std::chrono::steady_clock::now();
+	if (_Long)
+	{
+		LOG(LOG_LEVEL_INFO, "long message %llu: the quick brown fox jumps over the lazy dog, value=%d ratio=%.3f name=%s state=%s",
+			static_cast<unsigned long long>(_Index), static_cast<int>(_Index & 0xFFFF), static_cast<double>(_Index) / 7.0, "log_bench", "running");
+	}
+	else
+	{
+		LOG(LOG_LEVEL_INFO, "short message %llu", static_cast<unsigned long long>(_Index));
+	}
+	const auto tEnd = std::chrono::steady_clock::now();
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(tEnd - tBegin).count());
+}
+
+static uint64_t percentile(std::vector<uint64_t>& _Latencies, double _Ratio)
+{
+	if (_Latencies.empty())
+		return 0;
+	const size_t nIndex = std::min(_Latencies.size() - 1, static_cast<size_t>(static_cast<double>(_Latencies.size()) * _Ratio));
+	std::nth_element(_Latencies.begin(), _Latencies.begin() + static_cast<std::ptrdiff_t>(nIndex), _Latencies.end());
+	return _Latencies[nIndex];
+}
+
+/**
+ * @brief 运行一种组合
+ *
+ * @param _Mode        输出模式
+ * @param _Target      输出目标
+ * @param _bLong       是否使用长日志
+ * @param _Threads     线程数
+ * @param _Records     每个线程的日志数
+ * @param _Result      OUT 结果，名称字段由调用者填写
+ */
+static void runCase(LOGMODE _Mode, const std::string& _Target, bool _bLong, unsigned _Threads, uint64_t _Records, LogBenchResult& _Result)
+{
+	LOGTARGET target = LOG_TARGET_FILE;
+	const std::wstring wstrPath = L"./log_bench.txt";
+	std::shared_ptr<LogNullSink> pNullSink;
+	if (_Target == "console")
+		target = LOG_TARGET_CONSOLE;
+	else if (_Target == "null")
+	{
+		target = LOG_TARGET_NONE;
+		pNullSink = std::make_shared<LogNullSink>();
+		Log::addSink(pNullSink);
+	}
+	std::remove("./log_bench.txt");
+	LOG_INIT(LOG_LEVEL_INFO, target, wstrPath, _Mode);
+
+	// 每个线程先写入少量日志，使队列、缓冲区与调用点完成初始化
+	const uint64_t nWarmup = std::min<uint64_t>(_Records, 1000);
+	std::vector<std::vector<uint64_t>> latencies(_Threads);
+	std::atomic<unsigned> nReady { 0 };
+	std::atomic<bool> bStart { false };
+	std::vector<std::thread> threads;
+	for (unsigned t = 0; t < _Threads; ++t)
+	{
+		threads.emplace_back([&, t]
+		{
+			std::vector<uint64_t>& samples = latencies[t];
+			samples.reserve(static_cast<size_t>(_Records));
+			for (uint64_t i = 0; i < nWarmup; ++i)
+				timedLog(_bLong, i);
+			nReady.fetch_add(1);
+			while (!bStart.load(std::memory_order_acquire))
+				std::this_thread::yield();
+			for (uint64_t i = 0; i < _Records; ++i)
+				samples.push_back(timedLog(_bLong, i));
+		});
+	}
+	while (nReady.load() < _Threads)
+		std::this_thread::yield();
+	Log::Flush();
+
+	const auto tBegin = std::chrono::steady_clock::now();
+	bStart.store(true, std::memory_order_release);
+	for (auto& thread : threads)
+		thread.join();
+	const auto tWritten = std::chrono::steady_clock::now();
+	Log::Flush();
+	const auto tFlushed = std::chrono::steady_clock::now();
+
+	std::vector<uint64_t> all;
+	all.reserve(static_cast<size_t>(_Records) * _Threads);
+	for (const auto& samples : latencies)
+		all.insert(all.end(), samples.begin(), samples.end());
+
+	_Result.m_nThreads = _Threads;
+	_Result.m_nRecords = _Records * _Threads;
+	_Result.m_dSeconds = std::chrono::duration<double>(tWritten - tBegin).count();
+	const double dFlushed = std::chrono::duration<double>(tFlushed - tBegin).count();
+	_Result.m_dRecordsPerSec = _Result.m_dSeconds > 0 ? static_cast<double>(_Result.m_nRecords) / _Result.m_dSeconds : 0;
+	_Result.m_dFlushedPerSec = dFlushed > 0 ? static_cast<double>(_Result.m_nRecords) / dFlushed : 0;
+	_Result.m_nMax = all.empty() ? 0 : *std::max_element(all.begin(), all.end());
+	_Result.m_nP50 = percentile(all, 0.50);
+	_Result.m_nP99 = percentile(all, 0.99);
+	_Result.m_nP999 = percentile(all, 0.999);
+
+	LOG_INIT(LOG_LEVEL_INFO, LOG_TARGET_NONE, wstrPath, LOG_MODE_SYNC);
+	if (pNullSink)
+		Log::removeSink(pNullSink);
+	std::remove("./log_bench.txt");
+}
+
+static void writeResult(FILE* _Out, const LogBenchResult& _Result)
+{
+	fprintf(_Out, "%s,%s,%u,%s,%llu,%.6f,%.0f,%.0f,%llu,%llu,%llu,%llu\n",
+		_Result.m_strMode.c_str(), _Result.m_strTarget.c_str(), _Result.m_nThreads, _Result.m_strMessage.c_str(),
+		static_cast<unsigned long long>(_Result.m_nRecords), _Result.m_dSeconds, _Result.m_dRecordsPerSec, _Result.m_dFlushedPerSec,
+		static_cast<unsigned long long>(_Result.m_nP50), static_cast<unsigned long long>(_Result.m_nP99),
+		static_cast<unsigned long long>(_Result.m_nP999), static_cast<unsigned long long>(_Result.m_nMax));
+	fflush(_Out);
+}
+
+/* 读取之前输出的CSV结果 */
+static bool readBaseline(const char* _Path, std::map<std::string, LogBenchResult>& _Baseline)
+{
+	std::ifstream input(_Path);
+	if (!input)
+		return false;
+	std::string line;
+	while (std::getline(input, line))
+	{
+		if (line.empty() || line.rfind("mode,", 0) == 0)
+			continue;
+		std::vector<std::string> fields = splitList(line.c_str());
+		if (fields.size() < 12)
+			continue;
+		LogBenchResult result;
+		result.m_strMode = fields[0];
+		result.m_strTarget = fields[1];
+		result.m_nThreads = static_cast<unsigned>(std::strtoul(fields[2].c_str(), nullptr, 10));
+		result.m_strMessage = fields[3];
+		result.m_dRecordsPerSec = std::strtod(fields[6].c_str(), nullptr);
+		result.m_nP99 = std::strtoull(fields[9].c_str(), nullptr, 10);
+		_Baseline[result.key()] = result;
+	}
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<unsigned> threadCounts;
+	uint64_t nRecords = 100000;
+	std::vector<std::string> modes { "sync", "async", "deferred" };
+	std::vector<std::string> targets { "null", "file" };
+	std::vector<std::string> messages { "short", "long" };
+	const char* szOutput = nullptr;
+	const char* szBaseline = nullptr;
+	double dTolerance = 0.10;
+	for (int i = 1; i < argc; ++i)
+	{
+		const bool bValue = i + 1 < argc;
+		if (!strcmp(argv[i], "--threads") && bValue)
+		{
+			for (const std::string& item : splitList(argv[++i]))
+				threadCounts.push_back(static_cast<unsigned>(std::max(1ul, std::strtoul(item.c_str(), nullptr, 10))));
+		}
+		else if (!strcmp(argv[i], "--records") && bValue)
+			nRecords = std::max<uint64_t>(1, std::strtoull(argv[++i], nullptr, 10));
+		else if (!strcmp(argv[i], "--modes") && bValue)
+		{
+			modes = splitList(argv[++i]);
+			LOGMODE mode = LOG_MODE_SYNC;
+			for (const std::string& item : modes)
+			{
+				if (!parseMode(item, mode))
+				{
+					fprintf(stderr, "log_bench: unknown mode %s\n", item.c_str());
+					return 1;
+				}
+			}
+		}
+		else if (!strcmp(argv[i], "--targets") && bValue)
+			targets = splitList(argv[++i]);
+		else if (!strcmp(argv[i], "--messages") && bValue)
+			messages = splitList(argv[++i]);
+		else if (!strcmp(argv[i], "--utf8"))
+			Log::setEncoding(LOG_ENCODING_UTF8);
+		else if (!strcmp(argv[i], "--output") && bValue)
+			szOutput = argv[++i];
+		else if (!strcmp(argv[i], "--baseline") && bValue)
+			szBaseline = argv[++i];
+		else if (!strcmp(argv[i], "--tolerance") && bValue)
+			dTolerance = std::strtod(argv[++i], nullptr);
+		else
+		{
+			fprintf(stderr, "usage: log_bench [--threads 1,2,4] [--records N] [--modes sync,async,deferred] [--targets null,file,console]\n"
+				"                 [--messages short,long] [--utf8] [--output FILE] [--baseline FILE] [--tolerance 0.10]\n");
+			return 1;
+		}
+	}
+	if (threadCounts.empty())
+	{
+		const unsigned nCores = std::max(1u, std::thread::hardware_concurrency());
+		for (unsigned n = 1; n < nCores; n *= 2)
+			threadCounts.push_back(n);
+		threadCounts.push_back(nCores);
+	}
+
+	std::map<std::string, LogBenchResult> baseline;
+	if (szBaseline && !readBaseline(szBaseline, baseline))
+	{
+		fprintf(stderr, "log_bench: cannot read baseline %s\n", szBaseline);
+		return 1;
+	}
+
+	// 测试console时标准输出被日志占用
+	const bool bConsole = std::find(targets.begin(), targets.end(), "console") != targets.end();
+	FILE* out = szOutput ? fopen(szOutput, "w") : (bConsole ? stderr : stdout);
+	if (!out)
+	{
+		fprintf(stderr, "log_bench: cannot open %s\n", szOutput);
+		return 1;
+	}
+	fprintf(out, "%s\n", LOG_BENCH_HEADER);
+
+	int nResult = 0;
+	for (const std::string& mode : modes)
+	{
+		for (const std::string& target : targets)
+		{
+			for (const std::string& message : messages)
+			{
+				for (unsigned nThreads : threadCounts)
+				{
+					LogBenchResult result;
+					result.m_strMode = mode;
+					result.m_strTarget = target;
+					result.m_strMessage = message;
+					LOGMODE logMode = LOG_MODE_SYNC;
+					parseMode(mode, logMode);
+					runCase(logMode, target, message == "long", nThreads, nRecords, result);
+					writeResult(out, result);
+
+					const auto it = baseline.find(result.key());
+					if (it == baseline.end())
+						continue;
+					const LogBenchResult& base = it->second;
+					const bool bSlower = result.m_dRecordsPerSec < base.m_dRecordsPerSec * (1 - dTolerance);
+					const bool bLatency = base.m_nP99 && static_cast<double>(result.m_nP99) > static_cast<double>(base.m_nP99) * (1 + dTolerance);
+					fprintf(stderr, "%-32s %12.0f rec/s (%+6.1f%%)  p99 %8llu ns (%+6.1f%%)%s\n", result.key().c_str(),
+						result.m_dRecordsPerSec, base.m_dRecordsPerSec > 0 ? (result.m_dRecordsPerSec / base.m_dRecordsPerSec - 1) * 100 : 0.0,
+						static_cast<unsigned long long>(result.m_nP99), base.m_nP99 ? (static_cast<double>(result.m_nP99) / static_cast<double>(base.m_nP99) - 1) * 100 : 0.0,
+						bSlower || bLatency ? "  REGRESSION" : "");
+					if (bSlower || bLatency)
+						nResult = 2;
+				}
+			}
+		}
+	}
+	if (szOutput)
+		fclose(out);
+	Log::Shutdown();
+	return nResult;
+}
@@ -0,0 +1,152 @@
+/**
+ * @file log_binary.hpp
+ * @author ldk
+ * @brief 二进制日志文件格式，写入端与解码工具共用
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * 文件以"LOGB"与版本号开头，之后为若干记录，每条记录以一个字节的类型开头：
+ *   LOG_BINARY_SEGMENT  进程号                            进程每次打开文件时写入，之后的调用点编号重新分配
+ *   LOG_BINARY_SITE     编号 行号 文件名 函数名 格式串        调用点在本段中首次出现时写入
+ *   LOG_BINARY_EVENT    编号 等级 线程号 时间 参数长度 参数    时间为自1970年起的纳秒数
+ *   LOG_BINARY_TEXT     等级 日志                          无法按调用点记录的日志，保存格式化后的文本
+ * 整数均为LEB128变长编码，字符串为长度加UTF-8内容。参数按转换说明依次编码：
+ * 有符号整数为zigzag变长整数，无符号整数、字符与指针为变长整数，浮点数为8字节小端double，字符串为UTF-8。
+ */
+
+#ifndef _LOG_BINARY_HPP_
+#define _LOG_BINARY_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+/* 二进制日志的记录类型 */
+enum LOGBINARYTAG
+{
+	LOG_BINARY_SEGMENT = 1,
+	LOG_BINARY_SITE    = 2,
+	LOG_BINARY_EVENT   = 3,
+	LOG_BINARY_TEXT    = 4
+};
+
+/* 文件头 */
+constexpr char     LOG_BINARY_MAGIC[4]  { 'L', 'O', 'G', 'B' };
+constexpr uint32_t LOG_BINARY_VERSION   { 1 };
+
+/* 追加变长整数 */
+inline void LogPutVarint(std::string& _Out, uint64_t _Value)
+{
+	while (_Value >= 0x80)
+	{
+		_Out.push_back(static_cast<char>((_Value & 0x7F) | 0x80));
+		_Value >>= 7;
+	}
+	_Out.push_back(static_cast<char>(_Value));
+}
+
+/* 有符号整数按zigzag编码，绝对值小的负数同样占用较少字节 */
+inline void LogPutSigned(std::string& _Out, int64_t _Value)
+{
+	LogPutVarint(_Out, (static_cast<uint64_t>(_Value) << 1) ^ static_cast<uint64_t>(_Value >> 63));
+}
+
+/* 追加长度加内容 */
+inline void LogPutString(std::string& _Out, std::string_view _Value)
+{
+	LogPutVarint(_Out, _Value.size());
+	_Out.append(_Value.data(), _Value.size());
+}
+
+/* 追加8字节小端double */
+inline void LogPutDouble(std::string& _Out, double _Value)
+{
+	uint64_t bits = 0;
+	memcpy(&bits, &_Value, sizeof bits);
+	for (int i = 0; i < 8; ++i)
+		_Out.push_back(static_cast<char>((bits >> (i * 8)) & 0xFF));
+}
+
+/* 顺序读取二进制日志，越界时置失败标志，之后的读取均返回0 */
+class LogBinaryReader
+{
+public:
+	LogBinaryReader(const char* _Data, size_t _Size) : m_pData(_Data), m_pEnd(_Data + _Size) {}
+
+	bool ok() const noexcept { return m_bOk; }
+	bool eof() const noexcept { return m_pData >= m_pEnd; }
+	const char* position() const noexcept { return m_pData; }
+
+	uint8_t getByte()
+	{
+		if (!require(1))
+			return 0;
+		return static_cast<uint8_t>(*m_pData++);
+	}
+
+	uint64_t getVarint()
+	{
+		uint64_t value = 0;
+		for (int shift = 0; shift < 64; shift += 7)
+		{
+			if (!require(1))
+				return 0;
+			const uint8_t byte = static_cast<uint8_t>(*m_pData++);
+			value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+			if (!(byte & 0x80))
+				return value;
+		}
+		m_bOk = false;
+		return 0;
+	}
+
+	int64_t getSigned()
+	{
+		const uint64_t value = getVarint();
+		return static_cast<int64_t>((value >> 1) ^ (0 - (value & 1)));
+	}
+
+	std::string_view getString()
+	{
+		const uint64_t nSize = getVarint();
+		if (!require(nSize))
+			return std::string_view();
+		std::string_view value(m_pData, static_cast<size_t>(nSize));
+		m_pData += nSize;
+		return value;
+	}
+
+	double getDouble()
+	{
+		if (!require(8))
+			return 0.0;
+		uint64_t bits = 0;
+		for (int i = 0; i < 8; ++i)
+			bits |= static_cast<uint64_t>(static_cast<uint8_t>(m_pData[i])) << (i * 8);
+		m_pData += 8;
+		double value = 0.0;
+		memcpy(&value, &bits, sizeof value);
+		return value;
+	}
+
+private:
+	bool require(uint64_t _Size)
+	{
+		if (!m_bOk || static_cast<uint64_t>(m_pEnd - m_pData) < _Size)
+		{
+			m_bOk = false;
+			return false;
+		}
+		return true;
+	}
+
+	const char* m_pData;
+	const char* m_pEnd;
+	bool        m_bOk { true };
+};
+
+#endif // _LOG_BINARY_HPP_
@@ -0,0 +1,196 @@
+/**
+ * @file log_compress.hpp
+ * @author ldk
+ * @brief 日志文件的gzip流式压缩与解压，写入端与LogReader共用
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * 压缩的日志文件由一个或多个gzip成员依次拼接而成，每次打开文件开始一个新成员。
+ * 写入中的成员每次写入文件时以Z_SYNC_FLUSH结束当前块，已写入的部分即可解压，最后一个成员可以没有结尾。
+ * 需要在编译时定义LOG_WITH_ZLIB并链接zlib，否则压缩不可用，读取时压缩文件视为无效。
+ */
+
+#ifndef _LOG_COMPRESS_HPP_
+#define _LOG_COMPRESS_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#ifdef LOG_WITH_ZLIB
+#include <zlib.h>
+#endif // LOG_WITH_ZLIB
+
+/* 压缩文件的扩展名 */
+constexpr const wchar_t* LOG_GZIP_EXTENSION { L".gz" };
+
+/* 压缩后如何结束本次输出 */
+enum LOGDEFLATEFLUSH
+{
+	LOG_DEFLATE_NONE,      // 由压缩器决定何时输出，用于压缩整个文件
+	LOG_DEFLATE_SYNC,      // 结束当前块，已输出的部分即可解压
+	LOG_DEFLATE_FINISH     // 写入成员结尾并结束该成员
+};
+
+/* 是否以gzip文件头开始 */
+inline bool LogIsGzip(const char* _Data, size_t _Size) noexcept
+{
+	return _Size >= 2 && static_cast<unsigned char>(_Data[0]) == 0x1f && static_cast<unsigned char>(_Data[1]) == 0x8b;
+}
+
+/* 流式压缩，每个对象输出一个gzip成员 */
+class LogDeflater
+{
+public:
+	LogDeflater() = default;
+	~LogDeflater() { end(); }
+	LogDeflater(const LogDeflater&) = delete;
+	LogDeflater& operator=(const LogDeflater&) = delete;
+
+	/* 压缩是否可用 */
+	static constexpr bool isSupported() noexcept
+	{
+#ifdef LOG_WITH_ZLIB
+		return true;
+#else
+		return false;
+#endif // LOG_WITH_ZLIB
+	}
+
+	/* 是否已开始一个成员 */
+	bool isActive() const noexcept { return m_bActive; }
+
+	/**
+	 * @brief 开始一个新成员，之前的成员未结束时直接丢弃
+	 *
+	 * @param _Level    压缩级别，1最快，9压缩率最高
+	 * @return false    压缩不可用
+	 */
+	bool begin(int _Level)
+	{
+		end();
+#ifdef LOG_WITH_ZLIB
+		m_Stream = z_stream {};
+		// windowBits加16输出gzip格式
+		m_bActive = deflateInit2(&m_Stream, _Level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+#endif // LOG_WITH_ZLIB
+		return m_bActive;
+	}
+
+	/**
+	 * @brief 压缩并追加到_Out
+	 *
+	 * @param _Data      待压缩的内容
+	 * @param _Size      字节数
+	 * @param _Out       OUT 压缩后的内容
+	 * @param _Flush     结束方式
+	 */
+	void compress(const char* _Data, size_t _Size, std::string& _Out, LOGDEFLATEFLUSH _Flush)
+	{
+#ifdef LOG_WITH_ZLIB
+		if (!m_bActive)
+			return;
+		m_Stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(_Data));
+		m_Stream.avail_in = static_cast<uInt>(_Size);
+		const bool bFinish = _Flush == LOG_DEFLATE_FINISH;
+		const int nFlush = bFinish ? Z_FINISH : _Flush == LOG_DEFLATE_SYNC ? Z_SYNC_FLUSH : Z_NO_FLUSH;
+		int nResult = Z_OK;
+		do
+		{
+			const size_t nOld = _Out.size();
+			const size_t nChunk = deflateBound(&m_Stream, m_Stream.avail_in) + 64;
+			_Out.resize(nOld + nChunk);
+			m_Stream.next_out = reinterpret_cast<Bytef*>(&_Out[nOld]);
+			m_Stream.avail_out = static_cast<uInt>(nChunk);
+			nResult = deflate(&m_Stream, nFlush);
+			_Out.resize(nOld + nChunk - m_Stream.avail_out);
+		} while (nResult == Z_OK && (m_Stream.avail_in || !m_Stream.avail_out || bFinish));
+		if (bFinish)
+			end();
+#else
+		(void)_Data;
+		(void)_Size;
+		(void)_Out;
+		(void)_Flush;
+#endif // LOG_WITH_ZLIB
+	}
+
+private:
+	void end() noexcept
+	{
+#ifdef LOG_WITH_ZLIB
+		if (m_bActive)
+			deflateEnd(&m_Stream);
+#endif // LOG_WITH_ZLIB
+		m_bActive = false;
+	}
+
+#ifdef LOG_WITH_ZLIB
+	z_stream m_Stream {};
+#endif // LOG_WITH_ZLIB
+	bool     m_bActive { false };
+};
+
+/**
+ * @brief 解压依次拼接的gzip成员，最后一个成员没有结尾时解压到已写入的部分为止
+ *
+ * @param _Data    压缩的内容
+ * @param _Size    字节数
+ * @param _Out     OUT 解压后的内容
+ * @return false   压缩不可用或内容已损坏
+ */
+inline bool LogInflate(const char* _Data, size_t _Size, std::string& _Out)
+{
+#ifdef LOG_WITH_ZLIB
+	z_stream stream {};
+	if (inflateInit2(&stream, 15 + 16) != Z_OK)
+		return false;
+	stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(_Data));
+	// avail_in为32位，大文件分段输入
+	constexpr size_t INPUT_CHUNK { 1u << 30 };
+	size_t nLeft = _Size;
+	bool bResult = true;
+	while (nLeft || stream.avail_in)
+	{
+		if (!stream.avail_in)
+		{
+			stream.avail_in = static_cast<uInt>(std::min(nLeft, INPUT_CHUNK));
+			nLeft -= stream.avail_in;
+		}
+		const size_t nOld = _Out.size();
+		const size_t nChunk = std::clamp<size_t>(static_cast<size_t>(stream.avail_in) * 4, 64 * 1024, 64 * 1024 * 1024);
+		_Out.resize(nOld + nChunk);
+		stream.next_out = reinterpret_cast<Bytef*>(&_Out[nOld]);
+		stream.avail_out = static_cast<uInt>(nChunk);
+		const int nResult = inflate(&stream, Z_NO_FLUSH);
+		_Out.resize(nOld + nChunk - stream.avail_out);
+		if (nResult == Z_STREAM_END)
+		{
+			// 下一个成员
+			if (inflateReset(&stream) != Z_OK)
+				break;
+		}
+		else if (nResult == Z_BUF_ERROR)
+		{
+			// 输入已用完，最后一个成员尚未结束
+			break;
+		}
+		else if (nResult != Z_OK)
+		{
+			bResult = false;
+			break;
+		}
+	}
+	inflateEnd(&stream);
+	return bResult;
+#else
+	(void)_Data;
+	(void)_Size;
+	(void)_Out;
+	return false;
+#endif // LOG_WITH_ZLIB
+}
+
+#endif // _LOG_COMPRESS_HPP_
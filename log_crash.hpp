@@ -0,0 +1,96 @@
+/**
+ * @file log_crash.hpp
+ * @author ldk
+ * @brief 崩溃保护缓冲区的文件格式，写入端与恢复工具共用
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * 文件开头为LOG_CRASH_HEADER_SIZE字节的文件头，之后为m_nCapacity字节的环形数据区。
+ * 文本日志放入日志文件的写缓冲区时同时写入数据区，m_nHead为累计写入的字节数；
+ * 写缓冲区写入日志文件后m_nDurable追上m_nHead。进程异常退出后，两者之间的部分即未写入日志文件的日志。
+ * 文件以共享方式映射，进程崩溃后内容仍保留在系统缓存中，但不能防止断电丢失。
+ */
+
+#ifndef _LOG_CRASH_HPP_
+#define _LOG_CRASH_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+/* 文件头 */
+constexpr char     LOG_CRASH_MAGIC[8]    { 'L', 'O', 'G', 'C', 'R', 'A', 'S', 'H' };
+constexpr uint32_t LOG_CRASH_VERSION     { 1 };
+constexpr size_t   LOG_CRASH_HEADER_SIZE { 4096 };
+constexpr size_t   LOG_CRASH_PATH_SIZE   { 3072 };
+
+struct LogCrashHeader
+{
+	char                  m_szMagic[8];                     // LOG_CRASH_MAGIC
+	uint32_t              m_nVersion;                       // LOG_CRASH_VERSION
+	uint32_t              m_nPathSize;                      // 日志文件路径的字节数
+	uint64_t              m_nCapacity;                      // 数据区字节数
+	std::atomic<uint64_t> m_nHead;                          // 累计写入数据区的字节数
+	std::atomic<uint64_t> m_nDurable;                       // 其中已写入日志文件的字节数
+	char                  m_szPath[LOG_CRASH_PATH_SIZE];    // 日志文件路径，UTF-8
+};
+static_assert(sizeof(LogCrashHeader) <= LOG_CRASH_HEADER_SIZE, "LogCrashHeader exceeds LOG_CRASH_HEADER_SIZE");
+
+/**
+ * @brief 取出未写入日志文件的日志
+ *
+ * 未写入的部分超过数据区大小时，最早的内容已被覆盖，从剩余部分中第一条完整日志开始
+ *
+ * @param _Data    崩溃保护缓冲区文件的内容
+ * @param _Size    字节数
+ * @param _Path    OUT 日志文件路径，UTF-8
+ * @param _Out     OUT 未写入日志文件的日志
+ * @return 文件是否有效
+ */
+inline bool LogCrashTail(const char* _Data, size_t _Size, std::string& _Path, std::string& _Out)
+{
+	if (_Size < LOG_CRASH_HEADER_SIZE || memcmp(_Data, LOG_CRASH_MAGIC, sizeof LOG_CRASH_MAGIC))
+		return false;
+	const LogCrashHeader* header = reinterpret_cast<const LogCrashHeader*>(_Data);
+	const uint64_t nCapacity = header->m_nCapacity;
+	if (header->m_nVersion != LOG_CRASH_VERSION || header->m_nPathSize > LOG_CRASH_PATH_SIZE
+		|| !nCapacity || _Size - LOG_CRASH_HEADER_SIZE < nCapacity)
+		return false;
+	_Path.assign(header->m_szPath, header->m_nPathSize);
+
+	const uint64_t nHead = header->m_nHead.load(std::memory_order_acquire);
+	uint64_t nBegin = header->m_nDurable.load(std::memory_order_acquire);
+	if (nBegin >= nHead)
+		return true;
+	const bool bOverwritten = nHead - nBegin > nCapacity;
+	if (bOverwritten)
+		nBegin = nHead - nCapacity;
+
+	const char* data = _Data + LOG_CRASH_HEADER_SIZE;
+	const size_t nOld = _Out.size();
+	const size_t nFirst = static_cast<size_t>(nBegin % nCapacity);
+	const size_t nSize = static_cast<size_t>(nHead - nBegin);
+	const size_t nPart = std::min<size_t>(nSize, static_cast<size_t>(nCapacity) - nFirst);
+	_Out.append(data + nFirst, nPart);
+	_Out.append(data, nSize - nPart);
+
+	if (bOverwritten)
+	{
+		// 默认模式下每条日志以空行加分隔行开头，前一条日志的结尾分隔行之后紧接着下一条日志；
+		// 输出模式不含分隔行时从第一个完整的行开始
+		const std::string strStart = "\n\n" + std::string(60, '*');
+		size_t nStart = _Out.find(strStart, nOld);
+		if (nStart == std::string::npos)
+			nStart = _Out.find('\n', nOld);
+		_Out.erase(nOld, nStart == std::string::npos ? std::string::npos : nStart + 1 - nOld);
+	}
+	return true;
+}
+
+#endif // _LOG_CRASH_HPP_
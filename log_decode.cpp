@@ -0,0 +1,331 @@
+/**
+ * @file log_decode.cpp
+ * @author ldk
+ * @brief 二进制日志解码工具，按文本日志的格式输出
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * 用法：log_decode [-p s|ms|us|ns] [文件...]，未指定文件时解码./Log.bin
+ *       log_decode -r [文件...]，输出崩溃保护缓冲区中未写入日志文件的日志，未指定文件时读取./Log.crash
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "log.hpp"
+#include "log_binary.hpp"
+#include "log_crash.hpp"
+#include "log_format.hpp"
+
+/* 调用点定义，格式串在首次出现时解析 */
+struct LogDecodedSite
+{
+	uint                       m_nLine { 0 };
+	std::string                m_strFile;
+	std::string                m_strFunction;
+	std::string                m_strFormat;
+	std::vector<LogFormatSpec> m_Specs;
+	bool                       m_bValid { false };   // 格式串解析成功
+};
+
+/* 二进制日志解码器 */
+class LogDecoder
+{
+public:
+	explicit LogDecoder(LOGTIMEPRECISION _Precision) : m_Precision(_Precision) {}
+
+	/**
+	 * @brief 解码一个文件，结果追加到_Out
+	 *
+	 * @param _Data    文件内容
+	 * @param _Out     OUT 文本日志
+	 * @return 文件是否完整有效
+	 */
+	bool decode(std::string_view _Data, std::string& _Out)
+	{
+		LogBinaryReader reader(_Data.data(), _Data.size());
+		if (_Data.size() < sizeof LOG_BINARY_MAGIC || memcmp(_Data.data(), LOG_BINARY_MAGIC, sizeof LOG_BINARY_MAGIC))
+			return false;
+		for (size_t i = 0; i < sizeof LOG_BINARY_MAGIC; ++i)
+			reader.getByte();
+		if (reader.getVarint() > LOG_BINARY_VERSION)
+			return false;
+
+		while (reader.ok() && !reader.eof())
+		{
+			switch (reader.getByte())
+			{
+			case LOG_BINARY_SEGMENT:
+				m_nPid = static_cast<uint>(reader.getVarint());
+				m_Sites.clear();
+				break;
+			case LOG_BINARY_SITE:
+				readSite(reader);
+				break;
+			case LOG_BINARY_EVENT:
+				readEvent(reader, _Out);
+				break;
+			case LOG_BINARY_TEXT:
+			{
+				reader.getVarint();
+				const std::string_view text = reader.getString();
+				_Out.append(text.data(), text.size());
+				break;
+			}
+			default:
+				return false;
+			}
+		}
+		// 进程退出前未写完的最后一条记录不完整
+		return reader.ok();
+	}
+
+private:
+	void readSite(LogBinaryReader& _Reader)
+	{
+		const uint32_t nId = static_cast<uint32_t>(_Reader.getVarint());
+		LogDecodedSite& site = m_Sites[nId];
+		site.m_nLine = static_cast<uint>(_Reader.getVarint());
+		site.m_strFile = _Reader.getString();
+		site.m_strFunction = _Reader.getString();
+		site.m_strFormat = _Reader.getString();
+
+		const std::string& format = site.m_strFormat;
+		site.m_Specs.assign(LogCountSpecs(format.data(), format.size()) + 1, LogFormatSpec {});
+		size_t nArgs = 0;
+		bool bAscii = true;
+		site.m_bValid = LogParseFormat(format.data(), format.size(), site.m_Specs.data(), site.m_Specs.size(), nArgs, bAscii) == LOG_FORMAT_OK;
+	}
+
+	void readEvent(LogBinaryReader& _Reader, std::string& _Out)
+	{
+		const uint32_t nId = static_cast<uint32_t>(_Reader.getVarint());
+		const uint64_t nLevel = _Reader.getVarint();
+		const uint nThreadId = static_cast<uint>(_Reader.getVarint());
+		const int64_t nTime = static_cast<int64_t>(_Reader.getVarint());
+		const std::string_view payload = _Reader.getString();
+		if (!_Reader.ok())
+			return;
+
+		const auto it = m_Sites.find(nId);
+		const LOGLEVEL level = nLevel >= LOG_LEVEL_ERROR && nLevel <= LOG_LEVEL_INFO ? static_cast<LOGLEVEL>(nLevel) : LOG_LEVEL_NONE;
+		if (it == m_Sites.end() || level == LOG_LEVEL_NONE)
+			return;
+		const LogDecodedSite& site = it->second;
+
+		appendBanner(_Out, level);
+		appendTime(_Out, nTime);
+		char szHeader[64];
+		snprintf(szHeader, sizeof szHeader, " [PID : %-5u] [TID : %-5u] [", m_nPid, nThreadId);
+		_Out += szHeader;
+		_Out += site.m_strFile;
+		_Out += "] [";
+		_Out += site.m_strFunction;
+		snprintf(szHeader, sizeof szHeader, " : %-4u] ", site.m_nLine);
+		_Out += szHeader;
+		if (site.m_bValid)
+			appendBody(_Out, site, payload);
+		else
+			_Out += site.m_strFormat;
+		appendBanner(_Out, level);
+	}
+
+	/* 按调用点的格式串还原日志正文 */
+	static void appendBody(std::string& _Out, const LogDecodedSite& _Site, std::string_view _Payload)
+	{
+		LogBinaryReader args(_Payload.data(), _Payload.size());
+		for (const LogFormatSpec& spec : _Site.m_Specs)
+		{
+			_Out.append(_Site.m_strFormat, spec.m_nLiteralBegin, spec.m_nLiteralSize);
+			switch (spec.m_chConv)
+			{
+			case 0:
+				break;
+			case '%':
+				_Out += '%';
+				break;
+			case 'd': case 'i':
+			{
+				const int64_t nValue = args.getSigned();
+				const unsigned long long nAbs = nValue < 0 ? 0ull - static_cast<unsigned long long>(nValue) : static_cast<unsigned long long>(nValue);
+				LogAppendInteger(_Out, nAbs, nValue < 0, spec);
+				break;
+			}
+			case 'u': case 'o': case 'x': case 'X':
+				LogAppendInteger(_Out, args.getVarint(), false, spec);
+				break;
+			case 'c':
+			{
+				const wchar_t wc = static_cast<wchar_t>(args.getVarint());
+				std::string encoded;
+				LogAppendUtf8(encoded, &wc, 1);
+				LogAppendPadded(_Out, encoded.data(), encoded.size(), spec);
+				break;
+			}
+			case 's':
+			{
+				std::string_view value = args.getString();
+				if (spec.m_nPrecision >= 0 && value.size() > static_cast<size_t>(spec.m_nPrecision))
+				{
+					// 保存的是UTF-8，截断时不拆分多字节字符
+					size_t nSize = static_cast<size_t>(spec.m_nPrecision);
+					while (nSize && (static_cast<unsigned char>(value[nSize]) & 0xC0) == 0x80)
+						--nSize;
+					value = value.substr(0, nSize);
+				}
+				LogAppendPadded(_Out, value.data(), value.size(), spec);
+				break;
+			}
+			case 'p':
+				appendPrintf(_Out, spec, reinterpret_cast<const void*>(static_cast<uintptr_t>(args.getVarint())));
+				break;
+			default:
+				appendPrintf(_Out, spec, args.getDouble());
+				break;
+			}
+		}
+	}
+
+	/* 按转换说明调用snprintf，long double保存为double */
+	template<typename T>
+	static void appendPrintf(std::string& _Out, const LogFormatSpec& _Spec, T _Value)
+	{
+		std::string strSpec = "%";
+		if (_Spec.m_bLeft)  strSpec += '-';
+		if (_Spec.m_bPlus)  strSpec += '+';
+		if (_Spec.m_bSpace) strSpec += ' ';
+		if (_Spec.m_bAlt)   strSpec += '#';
+		if (_Spec.m_bZero)  strSpec += '0';
+		if (_Spec.m_nWidth > 0)
+			strSpec += std::to_string(_Spec.m_nWidth);
+		if (_Spec.m_nPrecision >= 0)
+			strSpec += '.' + std::to_string(_Spec.m_nPrecision);
+		strSpec += _Spec.m_chConv;
+
+		int nLen = snprintf(nullptr, 0, strSpec.c_str(), _Value);
+		if (nLen <= 0)
+			return;
+		const size_t nOld = _Out.size();
+		_Out.resize(nOld + static_cast<size_t>(nLen) + 1);
+		snprintf(&_Out[nOld], static_cast<size_t>(nLen) + 1, strSpec.c_str(), _Value);
+		_Out.resize(nOld + static_cast<size_t>(nLen));
+	}
+
+	static void appendBanner(std::string& _Out, LOGLEVEL _LogLevel)
+	{
+		_Out += '\n';
+		_Out.append(60, '*');
+		_Out += ' ';
+		for (const wchar_t* name = LOGLEVEL_WSTRING.at(_LogLevel); *name; ++name)
+			_Out += static_cast<char>(*name);
+		_Out += ' ';
+		_Out.append(60, '*');
+		_Out += '\n';
+	}
+
+	/* 记录时间按本地时区输出 */
+	void appendTime(std::string& _Out, int64_t _Time) const
+	{
+		const time_t tSecond = static_cast<time_t>(_Time / 1000000000);
+		struct tm tmTime {};
+#ifdef _WIN32
+		localtime_s(&tmTime, &tSecond);
+#else
+		localtime_r(&tSecond, &tmTime);
+#endif // _WIN32
+		char szTime[40];
+		size_t nLen = strftime(szTime, sizeof szTime, "%Y-%m-%d %H:%M:%S", &tmTime);
+		_Out.append(szTime, nLen);
+
+		int nDigits = 0;
+		uint64_t nFraction = static_cast<uint64_t>(_Time % 1000000000);
+		switch (m_Precision)
+		{
+		case LOG_TIME_MILLISECOND: nDigits = 3; nFraction /= 1000000; break;
+		case LOG_TIME_MICROSECOND: nDigits = 6; nFraction /= 1000;    break;
+		case LOG_TIME_NANOSECOND:  nDigits = 9;                       break;
+		default: return;
+		}
+		snprintf(szTime, sizeof szTime, ".%0*llu", nDigits, static_cast<unsigned long long>(nFraction));
+		_Out += szTime;
+	}
+
+	LOGTIMEPRECISION                             m_Precision;
+	uint                                         m_nPid { 0 };   // 当前段的进程号
+	std::unordered_map<uint32_t, LogDecodedSite> m_Sites;        // 当前段的调用点
+};
+
+int main(int argc, char* argv[])
+{
+	LOGTIMEPRECISION precision = LOG_TIME_SECOND;
+	bool bCrash = false;
+	std::vector<const char*> files;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "-r"))
+		{
+			bCrash = true;
+		}
+		else if (!strcmp(argv[i], "-p") && i + 1 < argc)
+		{
+			const std::string_view value = argv[++i];
+			if (value == "ms")
+				precision = LOG_TIME_MILLISECOND;
+			else if (value == "us")
+				precision = LOG_TIME_MICROSECOND;
+			else if (value == "ns")
+				precision = LOG_TIME_NANOSECOND;
+			else
+				precision = LOG_TIME_SECOND;
+		}
+		else
+		{
+			files.push_back(argv[i]);
+		}
+	}
+	if (files.empty())
+		files.push_back(bCrash ? "./Log.crash" : "./Log.bin");
+
+	int nResult = 0;
+	LogDecoder decoder(precision);
+	std::string strOut;
+	for (const char* file : files)
+	{
+		std::ifstream input(file, std::ios::binary);
+		if (!input)
+		{
+			fprintf(stderr, "log_decode: cannot open %s\n", file);
+			nResult = 1;
+			continue;
+		}
+		const std::string strData((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+		strOut.clear();
+		if (bCrash)
+		{
+			// 只读取，不标记为已写入，下次启用崩溃保护缓冲区时仍会补写到原日志文件
+			std::string strPath;
+			if (!LogCrashTail(strData.data(), strData.size(), strPath, strOut))
+			{
+				fprintf(stderr, "log_decode: %s is not a crash buffer\n", file);
+				nResult = 1;
+				continue;
+			}
+			fprintf(stderr, "log_decode: %s: %zu bytes not yet written to %s\n", file, strOut.size(), strPath.c_str());
+		}
+		else if (!decoder.decode(strData, strOut))
+		{
+			fprintf(stderr, "log_decode: %s is truncated or not a binary log\n", file);
+			nResult = 1;
+		}
+		fwrite(strOut.data(), 1, strOut.size(), stdout);
+	}
+	return nResult;
+}
@@ -0,0 +1,932 @@
+/**
+ * @file log_format.hpp
+ * @author ldk
+ * @brief 编译期解析的printf风格日志格式，需要C++20
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef _LOG_FORMAT_HPP_
+#define _LOG_FORMAT_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cwchar>
+#include <cstring>
+#include <climits>
+#include <array>
+#include <tuple>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include "log_utf8.hpp"
+#include "log_binary.hpp"
+
+/* 格式串解析错误 */
+enum LOGFORMATERROR
+{
+	LOG_FORMAT_OK,
+	LOG_FORMAT_ERROR_INCOMPLETE,     // 格式串以不完整的转换说明结尾
+	LOG_FORMAT_ERROR_CONVERSION,     // 无效的转换符
+	LOG_FORMAT_ERROR_STAR,           // 不支持以*指定宽度或精度
+	LOG_FORMAT_ERROR_TOO_MANY        // 转换说明过多
+};
+
+/* 格式串中的一个转换说明及其之前的普通文本，例如"用户%-8s"中的"用户"与"%-8s" */
+struct LogFormatSpec
+{
+	size_t m_nLiteralBegin { 0 };     // 普通文本在格式串中的起始位置
+	size_t m_nLiteralSize  { 0 };     // 普通文本长度
+	bool   m_bLeft         { false }; // '-' 左对齐
+	bool   m_bPlus         { false }; // '+' 总是输出符号
+	bool   m_bSpace        { false }; // ' ' 正数前输出空格
+	bool   m_bAlt          { false }; // '#' 输出进制前缀
+	bool   m_bZero         { false }; // '0' 以0填充
+	int    m_nWidth        { 0 };     // 最小宽度
+	int    m_nPrecision    { -1 };    // 精度，-1表示未指定
+	char   m_chLength      { 0 };     // 长度修饰：'H'(hh) 'h' 'l' 'M'(ll) 'j' 'z' 't' 'L'
+	char   m_chConv        { 0 };     // 转换符，0表示只有普通文本（位于格式串末尾）
+	int    m_nArgIndex     { -1 };    // 对应的参数序号，'%%'与末尾文本为-1
+};
+
+/* 可作为模板参数的格式串 */
+template<size_t N>
+struct LogFixedString
+{
+	char m_szData[N] {};
+
+	constexpr LogFixedString(const char (&_String)[N])
+	{
+		for (size_t i = 0; i < N; ++i)
+			m_szData[i] = _String[i];
+	}
+
+	static constexpr size_t size() noexcept { return N - 1; }
+	constexpr char operator[](size_t _Index) const noexcept { return m_szData[_Index]; }
+};
+
+/* 解析结果，N为转换说明个数（含'%%'），最后一项存放末尾的普通文本 */
+template<size_t N>
+struct LogParsedFormat
+{
+	std::array<LogFormatSpec, N + 1> m_Specs {};
+	size_t                           m_nArgs { 0 };
+	LOGFORMATERROR                   m_Error { LOG_FORMAT_OK };
+	bool                             m_bAscii { true };   // 普通文本是否只含ASCII字符
+};
+
+/**
+ * @brief 解析一个转换说明
+ *
+ * @param _Format    格式串
+ * @param _Size      格式串长度
+ * @param _Pos       IN/OUT 进入时指向'%'之后，返回时指向转换符之后
+ * @param _Spec      OUT 解析结果
+ * @return LOGFORMATERROR
+ */
+constexpr LOGFORMATERROR LogParseSpec(const char* _Format, size_t _Size, size_t& _Pos, LogFormatSpec& _Spec)
+{
+	// 标志
+	for (; _Pos < _Size; ++_Pos)
+	{
+		char ch = _Format[_Pos];
+		if (ch == '-')      _Spec.m_bLeft = true;
+		else if (ch == '+') _Spec.m_bPlus = true;
+		else if (ch == ' ') _Spec.m_bSpace = true;
+		else if (ch == '#') _Spec.m_bAlt = true;
+		else if (ch == '0') _Spec.m_bZero = true;
+		else break;
+	}
+	// 宽度
+	if (_Pos < _Size && _Format[_Pos] == '*')
+		return LOG_FORMAT_ERROR_STAR;
+	for (; _Pos < _Size && _Format[_Pos] >= '0' && _Format[_Pos] <= '9'; ++_Pos)
+		_Spec.m_nWidth = _Spec.m_nWidth * 10 + (_Format[_Pos] - '0');
+	// 精度
+	if (_Pos < _Size && _Format[_Pos] == '.')
+	{
+		++_Pos;
+		if (_Pos < _Size && _Format[_Pos] == '*')
+			return LOG_FORMAT_ERROR_STAR;
+		_Spec.m_nPrecision = 0;
+		for (; _Pos < _Size && _Format[_Pos] >= '0' && _Format[_Pos] <= '9'; ++_Pos)
+			_Spec.m_nPrecision = _Spec.m_nPrecision * 10 + (_Format[_Pos] - '0');
+	}
+	// 长度修饰
+	if (_Pos < _Size)
+	{
+		char ch = _Format[_Pos];
+		if (ch == 'h' || ch == 'l')
+		{
+			++_Pos;
+			if (_Pos < _Size && _Format[_Pos] == ch)
+			{
+				_Spec.m_chLength = ch == 'h' ? 'H' : 'M';
+				++_Pos;
+			}
+			else
+			{
+				_Spec.m_chLength = ch;
+			}
+		}
+		else if (ch == 'j' || ch == 'z' || ch == 't' || ch == 'L')
+		{
+			_Spec.m_chLength = ch;
+			++_Pos;
+		}
+	}
+	if (_Pos >= _Size)
+		return LOG_FORMAT_ERROR_INCOMPLETE;
+
+	// 转换符
+	char ch = _Format[_Pos++];
+	switch (ch)
+	{
+	case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+	case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+	case 'c': case 's': case 'p': case '%':
+		_Spec.m_chConv = ch;
+		return LOG_FORMAT_OK;
+	default:
+		return LOG_FORMAT_ERROR_CONVERSION;
+	}
+}
+
+/* 统计转换说明个数 */
+constexpr size_t LogCountSpecs(const char* _Format, size_t _Size)
+{
+	size_t nCount = 0;
+	for (size_t i = 0; i < _Size; ++i)
+	{
+		if (_Format[i] != '%')
+			continue;
+		++nCount;
+		if (i + 1 < _Size && _Format[i + 1] == '%')
+			++i;
+	}
+	return nCount;
+}
+
+/**
+ * @brief 解析格式串，也可在运行期调用
+ *
+ * @param _Format    格式串
+ * @param _Size      格式串长度
+ * @param _Specs     OUT 转换说明，容量至少为转换说明个数+1
+ * @param _Capacity  _Specs的容量
+ * @param _Args      OUT 需要的参数个数
+ * @param _Ascii     OUT 普通文本是否只含ASCII字符
+ * @return LOGFORMATERROR
+ */
+constexpr LOGFORMATERROR LogParseFormat
+(
+	const char*    _Format,
+	size_t         _Size,
+	LogFormatSpec* _Specs,
+	size_t         _Capacity,
+	size_t&        _Args,
+	bool&          _Ascii
+)
+{
+	size_t nSpec = 0;
+	size_t nLiteral = 0;
+	_Args = 0;
+	_Ascii = true;
+	for (size_t i = 0; i < _Size;)
+	{
+		if (_Format[i] != '%')
+		{
+			if (static_cast<unsigned char>(_Format[i]) >= 0x80)
+				_Ascii = false;
+			++i;
+			continue;
+		}
+		if (nSpec + 1 >= _Capacity)
+			return LOG_FORMAT_ERROR_TOO_MANY;
+
+		LogFormatSpec& spec = _Specs[nSpec++];
+		spec = LogFormatSpec {};
+		spec.m_nLiteralBegin = nLiteral;
+		spec.m_nLiteralSize = i - nLiteral;
+		++i;
+		LOGFORMATERROR error = LogParseSpec(_Format, _Size, i, spec);
+		if (error != LOG_FORMAT_OK)
+			return error;
+		if (spec.m_chConv != '%')
+			spec.m_nArgIndex = static_cast<int>(_Args++);
+		nLiteral = i;
+	}
+
+	LogFormatSpec& tail = _Specs[nSpec];
+	tail = LogFormatSpec {};
+	tail.m_nLiteralBegin = nLiteral;
+	tail.m_nLiteralSize = _Size - nLiteral;
+	return LOG_FORMAT_OK;
+}
+
+/* 编译期解析格式串 */
+template<LogFixedString _Format>
+consteval auto LogParseFormat()
+{
+	constexpr size_t N = LogCountSpecs(_Format.m_szData, _Format.size());
+	LogParsedFormat<N> parsed;
+	parsed.m_Error = LogParseFormat(_Format.m_szData, _Format.size(),
+		parsed.m_Specs.data(), parsed.m_Specs.size(), parsed.m_nArgs, parsed.m_bAscii);
+	return parsed;
+}
+
+/* 参数类型分类 */
+template<typename T> struct LogIsCharString : std::false_type {};
+template<> struct LogIsCharString<char*> : std::true_type {};
+template<> struct LogIsCharString<const char*> : std::true_type {};
+template<> struct LogIsCharString<std::string> : std::true_type {};
+template<> struct LogIsCharString<std::string_view> : std::true_type {};
+template<typename T> struct LogIsWideString : std::false_type {};
+template<> struct LogIsWideString<wchar_t*> : std::true_type {};
+template<> struct LogIsWideString<const wchar_t*> : std::true_type {};
+template<> struct LogIsWideString<std::wstring> : std::true_type {};
+template<> struct LogIsWideString<std::wstring_view> : std::true_type {};
+
+template<typename T>
+using LogArgType = std::decay_t<T>;
+
+template<typename T>
+constexpr bool LogIsIntegerArg = std::is_integral_v<T> || (std::is_enum_v<T> && std::is_convertible_v<T, long long>);
+
+/* 参数类型是否与转换符匹配 */
+template<typename T>
+consteval bool LogArgMatches(char _Conv)
+{
+	switch (_Conv)
+	{
+	case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c':
+		return LogIsIntegerArg<T>;
+	case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+		return std::is_arithmetic_v<T>;
+	case 's':
+		return LogIsCharString<T>::value || LogIsWideString<T>::value;
+	case 'p':
+		return std::is_pointer_v<T> || std::is_null_pointer_v<T>;
+	default:
+		return false;
+	}
+}
+
+/* 第_Arg个参数对应的转换符 */
+template<size_t N>
+consteval char LogArgConv(const LogParsedFormat<N>& _Parsed, size_t _Arg)
+{
+	for (const LogFormatSpec& spec : _Parsed.m_Specs)
+	{
+		if (spec.m_nArgIndex == static_cast<int>(_Arg))
+			return spec.m_chConv;
+	}
+	return 0;
+}
+
+template<size_t _Index, char _Conv, typename T>
+consteval bool LogCheckArg()
+{
+	static_assert(LogArgMatches<T>(_Conv), "日志参数类型与格式串中的转换说明不符，出错参数的序号见_Index");
+	return true;
+}
+
+/* 编译期检查格式串及参数，出错时给出编译错误 */
+template<LogFixedString _Format, typename... Args>
+consteval bool LogCheckFormat()
+{
+	constexpr auto parsed = LogParseFormat<_Format>();
+	static_assert(parsed.m_Error != LOG_FORMAT_ERROR_INCOMPLETE, "日志格式串以不完整的转换说明结尾");
+	static_assert(parsed.m_Error != LOG_FORMAT_ERROR_CONVERSION, "日志格式串中存在无效的转换符");
+	static_assert(parsed.m_Error != LOG_FORMAT_ERROR_STAR, "日志格式串不支持以*指定宽度或精度");
+	static_assert(parsed.m_nArgs == sizeof...(Args), "日志参数个数与格式串中的转换说明个数不一致");
+	if constexpr (parsed.m_Error == LOG_FORMAT_OK && parsed.m_nArgs == sizeof...(Args))
+	{
+		return []<size_t... I>(std::index_sequence<I...>)
+		{
+			return (true && ... && LogCheckArg<I, LogArgConv(LogParseFormat<_Format>(), I), LogArgType<Args>>());
+		}(std::index_sequence_for<Args...>{});
+	}
+	return false;
+}
+
+/* 按宽度填充空格 */
+template<typename Char>
+inline void LogAppendPadded(std::basic_string<Char>& _Out, const Char* _Data, size_t _Size, const LogFormatSpec& _Spec)
+{
+	size_t nPad = _Spec.m_nWidth > 0 && static_cast<size_t>(_Spec.m_nWidth) > _Size ? _Spec.m_nWidth - _Size : 0;
+	if (nPad && !_Spec.m_bLeft)
+		_Out.append(nPad, static_cast<Char>(' '));
+	_Out.append(_Data, _Size);
+	if (nPad && _Spec.m_bLeft)
+		_Out.append(nPad, static_cast<Char>(' '));
+}
+
+/**
+ * @brief 按转换说明格式化整数，与printf的行为一致
+ *
+ * @param _Out         OUT 输出
+ * @param _Value       绝对值
+ * @param _Negative    是否为负数
+ * @param _Spec        转换说明
+ */
+template<typename Char>
+inline void LogAppendInteger(std::basic_string<Char>& _Out, unsigned long long _Value, bool _Negative, const LogFormatSpec& _Spec)
+{
+	const char* digitTable = _Spec.m_chConv == 'X' ? "0123456789ABCDEF" : "0123456789abcdef";
+	unsigned base = 10;
+	if (_Spec.m_chConv == 'o')
+		base = 8;
+	else if (_Spec.m_chConv == 'x' || _Spec.m_chConv == 'X')
+		base = 16;
+
+	// 倒序生成数字
+	Char digits[sizeof(unsigned long long) * CHAR_BIT];
+	size_t nDigits = 0;
+	for (unsigned long long value = _Value; value; value /= base)
+		digits[nDigits++] = static_cast<Char>(digitTable[value % base]);
+	if (nDigits == 0 && _Spec.m_nPrecision != 0)
+		digits[nDigits++] = static_cast<Char>('0');
+
+	size_t nZeros = _Spec.m_nPrecision > 0 && static_cast<size_t>(_Spec.m_nPrecision) > nDigits ? _Spec.m_nPrecision - nDigits : 0;
+	if (base == 8 && _Spec.m_bAlt && nZeros == 0 && (nDigits == 0 || digits[nDigits - 1] != static_cast<Char>('0')))
+		nZeros = 1;
+
+	Char prefix[2];
+	size_t nPrefix = 0;
+	if (_Spec.m_chConv == 'd' || _Spec.m_chConv == 'i')
+	{
+		if (_Negative)
+			prefix[nPrefix++] = static_cast<Char>('-');
+		else if (_Spec.m_bPlus)
+			prefix[nPrefix++] = static_cast<Char>('+');
+		else if (_Spec.m_bSpace)
+			prefix[nPrefix++] = static_cast<Char>(' ');
+	}
+	else if (base == 16 && _Spec.m_bAlt && _Value)
+	{
+		prefix[nPrefix++] = static_cast<Char>('0');
+		prefix[nPrefix++] = static_cast<Char>(_Spec.m_chConv);
+	}
+
+	size_t nSize = nPrefix + nZeros + nDigits;
+	size_t nPad = _Spec.m_nWidth > 0 && static_cast<size_t>(_Spec.m_nWidth) > nSize ? _Spec.m_nWidth - nSize : 0;
+	// 指定精度时忽略'0'标志
+	if (nPad && _Spec.m_bZero && !_Spec.m_bLeft && _Spec.m_nPrecision < 0)
+	{
+		nZeros += nPad;
+		nPad = 0;
+	}
+
+	if (nPad && !_Spec.m_bLeft)
+		_Out.append(nPad, static_cast<Char>(' '));
+	_Out.append(prefix, nPrefix);
+	_Out.append(nZeros, static_cast<Char>('0'));
+	while (nDigits)
+		_Out.push_back(digits[--nDigits]);
+	if (nPad && _Spec.m_bLeft)
+		_Out.append(nPad, static_cast<Char>(' '));
+}
+
+/* 多字节字符串按当前区域设置转换后追加，最多追加_Max个宽字符 */
+inline void LogAppendWidened(std::wstring& _Out, const char* _Data, size_t _Size, size_t _Max = static_cast<size_t>(-1))
+{
+	std::mbstate_t state {};
+	size_t nCount = 0;
+	while (_Size && nCount < _Max)
+	{
+		wchar_t wc = 0;
+		size_t n = mbrtowc(&wc, _Data, _Size, &state);
+		if (n == 0 || n > _Size)
+		{
+			// 无法转换的字节原样按单字节处理
+			wc = static_cast<unsigned char>(*_Data);
+			n = 1;
+			state = std::mbstate_t {};
+		}
+		_Out.push_back(wc);
+		_Data += n;
+		_Size -= n;
+		++nCount;
+	}
+}
+
+/**
+ * @brief 字符串转为输出的字符类型后追加，最多追加_Max个字符
+ *
+ * 多字节字符串转为宽字符时按当前区域设置转换，宽字符串转为窄字符时编码为UTF-8，同类型时原样追加
+ */
+template<typename Char, typename Src>
+inline void LogAppendConverted(std::basic_string<Char>& _Out, const Src* _Data, size_t _Size, size_t _Max)
+{
+	if constexpr (std::is_same_v<Char, Src>)
+		_Out.append(_Data, _Size < _Max ? _Size : _Max);
+	else if constexpr (std::is_same_v<Char, wchar_t>)
+		LogAppendWidened(_Out, _Data, _Size, _Max);
+	else
+		LogAppendUtf8(_Out, _Data, _Size, _Max);
+}
+
+/* 格式化字符串参数 */
+template<typename Char, typename T>
+inline void LogAppendString(std::basic_string<Char>& _Out, const T& _Value, const LogFormatSpec& _Spec)
+{
+	using Src = std::conditional_t<LogIsWideString<LogArgType<T>>::value, wchar_t, char>;
+	const size_t nMax = _Spec.m_nPrecision >= 0 ? static_cast<size_t>(_Spec.m_nPrecision) : static_cast<size_t>(-1);
+	std::basic_string_view<Src> value;
+	if constexpr (std::is_pointer_v<LogArgType<T>>)
+	{
+		const auto ptr = static_cast<const std::remove_pointer_t<LogArgType<T>>*>(_Value);
+		static constexpr Src null[] = { '(', 'n', 'u', 'l', 'l', ')', '\0' };
+		value = ptr ? std::basic_string_view<Src>(ptr) : std::basic_string_view<Src>(null);
+	}
+	else
+		value = _Value;
+
+	if constexpr (std::is_same_v<Char, Src>)
+	{
+		value = value.substr(0, nMax);
+		LogAppendPadded(_Out, value.data(), value.size(), _Spec);
+	}
+	else
+	{
+		if (_Spec.m_nWidth == 0)
+		{
+			LogAppendConverted(_Out, value.data(), value.size(), nMax);
+			return;
+		}
+		thread_local std::basic_string<Char> converted;
+		converted.clear();
+		LogAppendConverted(converted, value.data(), value.size(), nMax);
+		LogAppendPadded(_Out, converted.data(), converted.size(), _Spec);
+	}
+}
+
+/* 浮点数与指针交给snprintf或swprintf处理，单个转换说明的格式串在编译期生成 */
+template<typename Char, LogFormatSpec _Spec, bool _LongDouble>
+consteval auto LogMakePrintfSpec()
+{
+	std::array<Char, 32> spec {};
+	size_t n = 0;
+	spec[n++] = '%';
+	if (_Spec.m_bLeft)  spec[n++] = '-';
+	if (_Spec.m_bPlus)  spec[n++] = '+';
+	if (_Spec.m_bSpace) spec[n++] = ' ';
+	if (_Spec.m_bAlt)   spec[n++] = '#';
+	if (_Spec.m_bZero)  spec[n++] = '0';
+	auto appendNumber = [&](int _Number)
+	{
+		Char digits[12];
+		size_t nDigits = 0;
+		do { digits[nDigits++] = static_cast<Char>('0' + _Number % 10); _Number /= 10; } while (_Number && nDigits < 8);
+		while (nDigits)
+			spec[n++] = digits[--nDigits];
+	};
+	if (_Spec.m_nWidth > 0)
+		appendNumber(_Spec.m_nWidth);
+	if (_Spec.m_nPrecision >= 0)
+	{
+		spec[n++] = '.';
+		appendNumber(_Spec.m_nPrecision);
+	}
+	if (_LongDouble)
+		spec[n++] = 'L';
+	spec[n++] = static_cast<Char>(_Spec.m_chConv);
+	return spec;
+}
+
+/* 按字符类型调用snprintf或swprintf */
+template<typename T>
+inline int LogPrintf(char* _Buffer, size_t _Size, const char* _Spec, T _Value)
+{
+	return snprintf(_Buffer, _Size, _Spec, _Value);
+}
+template<typename T>
+inline int LogPrintf(wchar_t* _Buffer, size_t _Size, const wchar_t* _Spec, T _Value)
+{
+	return swprintf(_Buffer, _Size, _Spec, _Value);
+}
+
+template<LogFormatSpec _Spec, typename Char, typename T>
+inline void LogAppendPrintf(std::basic_string<Char>& _Out, T _Value)
+{
+	static constexpr auto spec = LogMakePrintfSpec<Char, _Spec, std::is_same_v<T, long double>>();
+	Char buffer[128];
+	int n = LogPrintf(buffer, sizeof buffer / sizeof buffer[0], spec.data(), _Value);
+	// snprintf返回所需长度，swprintf空间不足时返回-1
+	if (n >= 0 && static_cast<size_t>(n) < sizeof buffer / sizeof buffer[0])
+	{
+		_Out.append(buffer, static_cast<size_t>(n));
+		return;
+	}
+	// 宽度或精度很大时换用更大的缓冲区
+	std::basic_string<Char> large(static_cast<size_t>(_Spec.m_nWidth + _Spec.m_nPrecision) + 512, Char());
+	n = LogPrintf(&large[0], large.size(), spec.data(), _Value);
+	if (n > 0)
+		_Out.append(large.data(), static_cast<size_t>(n));
+}
+
+/* 整数提升后的类型，枚举按其底层类型提升 */
+template<typename T, bool = std::is_enum_v<T>>
+struct LogPromote { using type = decltype(+std::declval<T>()); };
+template<typename T>
+struct LogPromote<T, true> { using type = decltype(+std::declval<std::underlying_type_t<T>>()); };
+
+/* 按长度修饰截断整数，与printf对hh、h的处理一致 */
+template<char _Length, bool _Signed, typename T>
+constexpr auto LogApplyLength(T _Value)
+{
+	if constexpr (_Length == 'H')
+		return static_cast<std::conditional_t<_Signed, signed char, unsigned char>>(_Value);
+	else if constexpr (_Length == 'h')
+		return static_cast<std::conditional_t<_Signed, short, unsigned short>>(_Value);
+	else
+		return _Value;
+}
+
+/* 按编译期已知的转换说明格式化一个参数 */
+template<LogFormatSpec _Spec, typename Char, typename T>
+inline void LogAppendArg(std::basic_string<Char>& _Out, const T& _Value)
+{
+	using Arg = LogArgType<T>;
+	constexpr char conv = _Spec.m_chConv;
+	if constexpr (conv == 'd' || conv == 'i')
+	{
+		using Promoted = typename LogPromote<Arg>::type;
+		long long nValue = LogApplyLength<_Spec.m_chLength, true>(static_cast<std::make_signed_t<Promoted>>(_Value));
+		unsigned long long nAbs = nValue < 0 ? 0ull - static_cast<unsigned long long>(nValue) : static_cast<unsigned long long>(nValue);
+		LogAppendInteger(_Out, nAbs, nValue < 0, _Spec);
+	}
+	else if constexpr (conv == 'u' || conv == 'o' || conv == 'x' || conv == 'X')
+	{
+		// 与printf一致，负数按对应的无符号类型输出
+		using Promoted = typename LogPromote<Arg>::type;
+		unsigned long long nValue = LogApplyLength<_Spec.m_chLength, false>(static_cast<std::make_unsigned_t<Promoted>>(_Value));
+		LogAppendInteger(_Out, nValue, false, _Spec);
+	}
+	else if constexpr (conv == 'c')
+	{
+		if constexpr (std::is_same_v<Char, char> && sizeof(Arg) == 1)
+		{
+			// 窄字符原样输出
+			const char ch = static_cast<char>(_Value);
+			LogAppendPadded(_Out, &ch, 1, _Spec);
+		}
+		else if constexpr (std::is_same_v<Char, char>)
+		{
+			const wchar_t wc = static_cast<wchar_t>(_Value);
+			std::string encoded;
+			LogAppendUtf8(encoded, &wc, 1);
+			LogAppendPadded(_Out, encoded.data(), encoded.size(), _Spec);
+		}
+		else
+		{
+			wchar_t wc;
+			if constexpr (sizeof(Arg) == 1)
+				wc = static_cast<wchar_t>(btowc(static_cast<unsigned char>(_Value)));
+			else
+				wc = static_cast<wchar_t>(_Value);
+			LogAppendPadded(_Out, &wc, 1, _Spec);
+		}
+	}
+	else if constexpr (conv == 's')
+	{
+		LogAppendString(_Out, _Value, _Spec);
+	}
+	else if constexpr (conv == 'p')
+	{
+		LogAppendPrintf<_Spec>(_Out, static_cast<const void*>(_Value));
+	}
+	else
+	{
+		if constexpr (std::is_same_v<Arg, long double>)
+			LogAppendPrintf<_Spec>(_Out, _Value);
+		else
+			LogAppendPrintf<_Spec>(_Out, static_cast<double>(_Value));
+	}
+}
+
+/* 追加第_Index段普通文本 */
+template<LogFixedString _Format, size_t _Index, typename Char>
+inline void LogAppendLiteral(std::basic_string<Char>& _Out)
+{
+	static constexpr auto parsed = LogParseFormat<_Format>();
+	static constexpr LogFormatSpec spec = parsed.m_Specs[_Index];
+	const char* data = _Format.m_szData + spec.m_nLiteralBegin;
+	if constexpr (std::is_same_v<Char, char>)
+	{
+		// 窄字符输出时格式串原样追加
+		_Out.append(data, spec.m_nLiteralSize);
+	}
+	else if constexpr (parsed.m_bAscii)
+	{
+		// 只含ASCII字符时逐字节扩展即可
+		const size_t nOld = _Out.size();
+		_Out.resize(nOld + spec.m_nLiteralSize);
+		for (size_t i = 0; i < spec.m_nLiteralSize; ++i)
+			_Out[nOld + i] = static_cast<wchar_t>(data[i]);
+	}
+	else
+	{
+		// 含多字节字符时按当前区域设置转换，每个调用点只转换一次
+		static const std::wstring literal = []
+		{
+			std::wstring wstrLiteral;
+			LogAppendWidened(wstrLiteral, _Format.m_szData + spec.m_nLiteralBegin, spec.m_nLiteralSize);
+			return wstrLiteral;
+		}();
+		_Out += literal;
+	}
+}
+
+/* 格式化第_Index个转换说明及其之前的普通文本 */
+template<LogFixedString _Format, size_t _Index, typename Char, typename Tuple>
+inline void LogFormatSegment(std::basic_string<Char>& _Out, const Tuple& _Args)
+{
+	static constexpr auto parsed = LogParseFormat<_Format>();
+	constexpr LogFormatSpec spec = parsed.m_Specs[_Index];
+	if constexpr (spec.m_nLiteralSize)
+		LogAppendLiteral<_Format, _Index>(_Out);
+	if constexpr (spec.m_chConv == '%')
+		_Out.push_back(static_cast<Char>('%'));
+	else if constexpr (spec.m_nArgIndex >= 0)
+		LogAppendArg<spec>(_Out, std::get<static_cast<size_t>(spec.m_nArgIndex)>(_Args));
+}
+
+/**
+ * @brief 按编译期解析的格式串格式化参数，每个调用点生成专用的格式化代码
+ *
+ * 输出为std::wstring时按当前区域设置转换多字节文本，输出为std::string时按UTF-8原样追加
+ *
+ * @param _Out     OUT 格式化结果追加到末尾
+ * @param _Args    参数列表
+ */
+template<LogFixedString _Format, typename Char, typename... Args>
+inline void LogFormatTo(std::basic_string<Char>& _Out, const Args&... _Args)
+{
+	static_assert(LogCheckFormat<_Format, Args...>());
+	constexpr size_t nSegments = LogParseFormat<_Format>().m_Specs.size();
+	const auto args = std::forward_as_tuple(_Args...);
+	[&]<size_t... I>(std::index_sequence<I...>)
+	{
+		(LogFormatSegment<_Format, I>(_Out, args), ...);
+	}(std::make_index_sequence<nSegments>{});
+}
+
+/* 延迟格式化：调用线程只拷贝参数的原始字节，由后台线程解码后再格式化 */
+template<char _Conv, typename T>
+struct LogDeferredArg
+{
+	// 数组按指向常量的指针处理
+	using Arg = std::conditional_t<std::is_array_v<T>, const std::remove_extent_t<T>*, LogArgType<T>>;
+	// 只有%s对应的参数按字符串拷贝内容，其余（含%p的char*）按值拷贝
+	static constexpr bool bString = _Conv == 's';
+	static constexpr bool bPointer = std::is_pointer_v<Arg>;
+	using Char = std::conditional_t<LogIsWideString<Arg>::value, wchar_t, char>;
+	using Decoded = std::conditional_t<!bString, Arg,
+		std::conditional_t<bPointer, const Char*, std::basic_string_view<Char>>>;
+
+	static constexpr uint32_t nNull = 0xFFFFFFFFu;
+
+	/* 字符串内容按字符类型对齐 */
+	static constexpr size_t align(size_t _Offset) noexcept
+	{
+		return (_Offset + alignof(Char) - 1) / alignof(Char) * alignof(Char);
+	}
+
+	static std::basic_string_view<Char> view(const T& _Value)
+	{
+		if constexpr (bPointer)
+		{
+			const auto ptr = static_cast<const Char*>(_Value);
+			return ptr ? std::basic_string_view<Char>(ptr) : std::basic_string_view<Char>();
+		}
+		else
+		{
+			return std::basic_string_view<Char>(_Value);
+		}
+	}
+
+	/* 编码后的结束位置 */
+	static size_t size(size_t _Offset, const T& _Value)
+	{
+		if constexpr (!bString)
+			return _Offset + sizeof(Arg);
+		else
+			return align(_Offset + sizeof(uint32_t)) + (view(_Value).size() + (bPointer ? 1 : 0)) * sizeof(Char);
+	}
+
+	/* 字符串编码为长度加内容，char*等以0结尾以便按指针解码 */
+	static size_t encode(char* _Buffer, size_t _Offset, const T& _Value)
+	{
+		if constexpr (!bString)
+		{
+			const Arg value = _Value;
+			memcpy(_Buffer + _Offset, &value, sizeof value);
+			return _Offset + sizeof value;
+		}
+		else
+		{
+			std::basic_string_view<Char> value = view(_Value);
+			uint32_t nLen = static_cast<uint32_t>(value.size());
+			if constexpr (bPointer && !std::is_array_v<T>)
+			{
+				if (_Value == nullptr)
+					nLen = nNull;
+			}
+			memcpy(_Buffer + _Offset, &nLen, sizeof nLen);
+			_Offset = align(_Offset + sizeof nLen);
+			memcpy(_Buffer + _Offset, value.data(), value.size() * sizeof(Char));
+			_Offset += value.size() * sizeof(Char);
+			if constexpr (bPointer)
+			{
+				const Char chEnd = 0;
+				memcpy(_Buffer + _Offset, &chEnd, sizeof chEnd);
+				_Offset += sizeof chEnd;
+			}
+			return _Offset;
+		}
+	}
+
+	static Decoded decode(const char* _Buffer, size_t& _Offset)
+	{
+		if constexpr (!bString)
+		{
+			Arg value;
+			memcpy(&value, _Buffer + _Offset, sizeof value);
+			_Offset += sizeof value;
+			return value;
+		}
+		else
+		{
+			uint32_t nLen = 0;
+			memcpy(&nLen, _Buffer + _Offset, sizeof nLen);
+			_Offset = align(_Offset + sizeof nLen);
+			const Char* data = reinterpret_cast<const Char*>(_Buffer + _Offset);
+			if constexpr (bPointer)
+			{
+				if (nLen == nNull)
+				{
+					_Offset += sizeof(Char);
+					return nullptr;
+				}
+				_Offset += (nLen + 1) * sizeof(Char);
+				return data;
+			}
+			else
+			{
+				_Offset += nLen * sizeof(Char);
+				return Decoded(data, nLen);
+			}
+		}
+	}
+};
+
+/**
+ * @brief 参数的原始字节写入缓冲区，缓冲区按需扩容
+ *
+ * @param _Buffer    OUT 编码后的参数
+ * @param _Args      参数列表
+ */
+template<LogFixedString _Format, typename... Args>
+inline void LogEncodeArgs(std::string& _Buffer, const Args&... _Args)
+{
+	static_assert(LogCheckFormat<_Format, Args...>());
+	if constexpr (sizeof...(Args) == 0)
+	{
+		_Buffer.clear();
+	}
+	else
+	{
+		[&]<size_t... I>(std::index_sequence<I...>)
+		{
+			size_t nSize = 0;
+			((nSize = LogDeferredArg<LogArgConv(LogParseFormat<_Format>(), I), Args>::size(nSize, _Args)), ...);
+			_Buffer.resize(nSize);
+			size_t nOffset = 0;
+			((nOffset = LogDeferredArg<LogArgConv(LogParseFormat<_Format>(), I), Args>::encode(&_Buffer[0], nOffset, _Args)), ...);
+		}(std::index_sequence_for<Args...>{});
+	}
+}
+
+/**
+ * @brief 解码LogEncodeArgs写入的参数并格式化，以函数指针形式随日志传给后台线程
+ *
+ * @param _Out     OUT 格式化结果追加到末尾
+ * @param _Args    编码后的参数
+ */
+template<LogFixedString _Format, typename... Args, typename Char>
+void LogDecodeFormat(std::basic_string<Char>& _Out, const char* _Args)
+{
+	if constexpr (sizeof...(Args) == 0)
+	{
+		(void)_Args;
+		LogFormatTo<_Format>(_Out);
+	}
+	else
+	{
+		[&]<size_t... I>(std::index_sequence<I...>)
+		{
+			size_t nOffset = 0;
+			// 花括号初始化保证按参数顺序解码
+			std::tuple<typename LogDeferredArg<LogArgConv(LogParseFormat<_Format>(), I), Args>::Decoded...> decoded
+			{
+				LogDeferredArg<LogArgConv(LogParseFormat<_Format>(), I), Args>::decode(_Args, nOffset)...
+			};
+			std::apply([&](const auto&... _Decoded) { LogFormatTo<_Format>(_Out, _Decoded...); }, decoded);
+		}(std::index_sequence_for<Args...>{});
+	}
+}
+
+/* 二进制日志：按转换说明将一个参数编码为与平台无关的形式，格式见log_binary.hpp */
+template<LogFormatSpec _Spec, typename T>
+inline void LogAppendBinaryArg(std::string& _Out, const T& _Value)
+{
+	using Arg = LogArgType<T>;
+	constexpr char conv = _Spec.m_chConv;
+	if constexpr (conv == 'd' || conv == 'i')
+	{
+		using Promoted = typename LogPromote<Arg>::type;
+		LogPutSigned(_Out, LogApplyLength<_Spec.m_chLength, true>(static_cast<std::make_signed_t<Promoted>>(_Value)));
+	}
+	else if constexpr (conv == 'u' || conv == 'o' || conv == 'x' || conv == 'X')
+	{
+		using Promoted = typename LogPromote<Arg>::type;
+		LogPutVarint(_Out, LogApplyLength<_Spec.m_chLength, false>(static_cast<std::make_unsigned_t<Promoted>>(_Value)));
+	}
+	else if constexpr (conv == 'c')
+	{
+		if constexpr (sizeof(Arg) == 1)
+			LogPutVarint(_Out, static_cast<unsigned char>(_Value));
+		else
+			LogPutVarint(_Out, static_cast<uint32_t>(_Value));
+	}
+	else if constexpr (conv == 's')
+	{
+		std::string_view value;
+		if constexpr (LogIsWideString<LogArgType<T>>::value)
+		{
+			std::wstring_view wide;
+			if constexpr (std::is_pointer_v<LogArgType<T>>)
+			{
+				const auto ptr = static_cast<const std::remove_pointer_t<LogArgType<T>>*>(_Value);
+				wide = ptr ? std::wstring_view(ptr) : std::wstring_view(L"(null)");
+			}
+			else
+				wide = _Value;
+			thread_local std::string encoded;
+			encoded.clear();
+			LogAppendUtf8(encoded, wide.data(), wide.size());
+			value = encoded;
+		}
+		else if constexpr (std::is_pointer_v<LogArgType<T>>)
+		{
+			const auto ptr = static_cast<const std::remove_pointer_t<LogArgType<T>>*>(_Value);
+			value = ptr ? std::string_view(ptr) : std::string_view("(null)");
+		}
+		else
+			value = _Value;
+		LogPutString(_Out, value);
+	}
+	else if constexpr (conv == 'p')
+	{
+		LogPutVarint(_Out, reinterpret_cast<uintptr_t>(static_cast<const void*>(_Value)));
+	}
+	else
+	{
+		LogPutDouble(_Out, static_cast<double>(_Value));
+	}
+}
+
+/**
+ * @brief 参数编码为二进制日志的参数部分
+ *
+ * @param _Out     OUT 编码结果，先清空
+ * @param _Args    参数列表
+ */
+template<LogFixedString _Format, typename... Args>
+inline void LogEncodeBinary(std::string& _Out, const Args&... _Args)
+{
+	static_assert(LogCheckFormat<_Format, Args...>());
+	_Out.clear();
+	if constexpr (sizeof...(Args) > 0)
+	{
+		static constexpr auto parsed = LogParseFormat<_Format>();
+		const auto args = std::forward_as_tuple(_Args...);
+		[&]<size_t... I>(std::index_sequence<I...>)
+		{
+			([&]
+			{
+				constexpr LogFormatSpec spec = parsed.m_Specs[I];
+				if constexpr (spec.m_nArgIndex >= 0)
+					LogAppendBinaryArg<spec>(_Out, std::get<static_cast<size_t>(spec.m_nArgIndex)>(args));
+			}(), ...);
+		}(std::make_index_sequence<parsed.m_Specs.size()>{});
+	}
+}
+
+#endif // _LOG_FORMAT_HPP_
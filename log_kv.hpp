@@ -0,0 +1,175 @@
+/**
+ * @file log_kv.hpp
+ * @author ldk
+ * @brief LOG_KV结构化日志的键值序列化，输出JSON行或logfmt
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * 键与值直接追加到日志记录的UTF-8缓冲区，不经过格式串与vswprintf。
+ * 值支持bool、整数、枚举、浮点数、nullptr、char与wchar_t字符串，宽字符串转为UTF-8。
+ */
+
+#ifndef _LOG_KV_HPP_
+#define _LOG_KV_HPP_
+
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include "log_utf8.hpp"
+
+/* 结构化日志的输出格式 */
+enum LOGKVFORMAT
+{
+	LOG_KV_JSON,      // 每条日志一行JSON对象
+	LOG_KV_LOGFMT     // 每条日志一行key=value
+};
+
+/**
+ * @brief 追加转义后的字符串，JSON始终加引号，logfmt只在含空白、等号、引号或为空时加引号
+ *
+ * @param _Out       OUT 输出
+ * @param _Format    输出格式
+ * @param _Text      UTF-8字符串
+ */
+inline void LogKvAppendString(std::string& _Out, LOGKVFORMAT _Format, std::string_view _Text)
+{
+	bool bQuote = _Format == LOG_KV_JSON || _Text.empty();
+	for (size_t i = 0; !bQuote && i < _Text.size(); ++i)
+	{
+		const unsigned char c = static_cast<unsigned char>(_Text[i]);
+		bQuote = c <= ' ' || c == '=' || c == '"' || c == '\\' || c == 0x7f;
+	}
+	if (!bQuote)
+	{
+		_Out.append(_Text);
+		return;
+	}
+
+	static constexpr char HEX[] = "0123456789abcdef";
+	_Out += '"';
+	size_t nBegin = 0;
+	for (size_t i = 0; i < _Text.size(); ++i)
+	{
+		const unsigned char c = static_cast<unsigned char>(_Text[i]);
+		if (c >= ' ' && c != '"' && c != '\\' && c != 0x7f)
+			continue;
+		_Out.append(_Text.data() + nBegin, i - nBegin);
+		nBegin = i + 1;
+		_Out += '\\';
+		switch (c)
+		{
+		case '"':  _Out += '"';  break;
+		case '\\': _Out += '\\'; break;
+		case '\n': _Out += 'n';  break;
+		case '\r': _Out += 'r';  break;
+		case '\t': _Out += 't';  break;
+		default:
+			_Out += "u00";
+			_Out += HEX[c >> 4];
+			_Out += HEX[c & 0xf];
+			break;
+		}
+	}
+	_Out.append(_Text.data() + nBegin, _Text.size() - nBegin);
+	_Out += '"';
+}
+
+/* 追加宽字符串，转为UTF-8后转义 */
+inline void LogKvAppendString(std::string& _Out, LOGKVFORMAT _Format, std::wstring_view _Text)
+{
+	thread_local std::string strText;
+	strText.clear();
+	LogAppendUtf8(strText, _Text.data(), _Text.size());
+	LogKvAppendString(_Out, _Format, strText);
+}
+
+/* 追加一个值 */
+template<typename T>
+void LogKvAppendValue(std::string& _Out, LOGKVFORMAT _Format, const T& _Value)
+{
+	if constexpr (std::is_same_v<T, bool>)
+		_Out += _Value ? "true" : "false";
+	else if constexpr (std::is_enum_v<T>)
+		LogKvAppendValue(_Out, _Format, static_cast<std::underlying_type_t<T>>(_Value));
+	else if constexpr (std::is_same_v<T, char> || std::is_same_v<T, wchar_t>)
+		LogKvAppendValue(_Out, _Format, static_cast<int>(_Value));
+	else if constexpr (std::is_integral_v<T>)
+	{
+		char szNumber[24];
+		const auto result = std::to_chars(szNumber, szNumber + sizeof szNumber, _Value);
+		_Out.append(szNumber, result.ptr);
+	}
+	else if constexpr (std::is_floating_point_v<T>)
+	{
+		// JSON没有NaN与无穷大
+		if (!std::isfinite(_Value))
+		{
+			_Out += _Format == LOG_KV_JSON ? "null" : std::isnan(_Value) ? "NaN" : _Value > 0 ? "+Inf" : "-Inf";
+			return;
+		}
+		char szNumber[32];
+		const auto result = std::to_chars(szNumber, szNumber + sizeof szNumber, _Value);
+		_Out.append(szNumber, result.ptr);
+	}
+	else if constexpr (std::is_null_pointer_v<T>)
+		_Out += "null";
+	else if constexpr (std::is_convertible_v<const T&, std::string_view>)
+	{
+		if constexpr (std::is_pointer_v<std::decay_t<T>>)
+		{
+			if (!_Value)
+			{
+				_Out += "null";
+				return;
+			}
+		}
+		LogKvAppendString(_Out, _Format, std::string_view(_Value));
+	}
+	else if constexpr (std::is_convertible_v<const T&, std::wstring_view>)
+	{
+		if constexpr (std::is_pointer_v<std::decay_t<T>>)
+		{
+			if (!_Value)
+			{
+				_Out += "null";
+				return;
+			}
+		}
+		LogKvAppendString(_Out, _Format, std::wstring_view(_Value));
+	}
+	else
+		static_assert(!sizeof(T), "LOG_KV value type is not supported");
+}
+
+/* 依次追加键值对，键须为字符串 */
+inline void LogKvAppendPairs(std::string&, LOGKVFORMAT) {}
+
+template<typename Key, typename Value, typename... Rest>
+void LogKvAppendPairs(std::string& _Out, LOGKVFORMAT _Format, const Key& _Key, const Value& _Value, const Rest&... _Rest)
+{
+	static_assert(std::is_convertible_v<const Key&, std::string_view>, "LOG_KV keys must be strings");
+	static_assert(sizeof...(Rest) % 2 == 0, "LOG_KV expects key-value pairs");
+	if (_Format == LOG_KV_JSON)
+	{
+		_Out += ',';
+		LogKvAppendString(_Out, _Format, std::string_view(_Key));
+		_Out += ':';
+	}
+	else
+	{
+		_Out += ' ';
+		_Out.append(std::string_view(_Key));
+		_Out += '=';
+	}
+	LogKvAppendValue(_Out, _Format, _Value);
+	LogKvAppendPairs(_Out, _Format, _Rest...);
+}
+
+#endif // _LOG_KV_HPP_
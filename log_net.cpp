@@ -0,0 +1,493 @@
+/**
+ * @file log_net.cpp
+ * @author ldk
+ * @brief 通过TCP或UDP将日志发送到远端收集器
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * 待发送的日志按条保存，TCP以一次sendmsg发送多条，UDP以一次sendmmsg发送多个数据报，减少系统调用次数。
+ * 溢出文件中每条日志前为4字节的小端长度，连接恢复后从上次发送到的位置依次读出发送，全部发送后截断为空。
+ * 所有函数只在所属目标的输出线程中调用，统计计数可在任意线程读取。
+ */
+
+#include "log_sink.hpp"
+
+#ifndef _WIN32
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/* 一次sendmsg或sendmmsg最多包含的日志条数 */
+constexpr size_t LOG_NET_BATCH_RECORDS { 64 };
+/* UDP数据报的最大长度 */
+constexpr size_t LOG_NET_MAX_DATAGRAM { 65507 };
+/* 复用的日志缓冲区个数上限 */
+constexpr size_t LOG_NET_FREE_BUFFERS { 256 };
+
+class LogNetClient
+{
+public:
+	LogNetClient(const std::string& _Host, uint16_t _Port, const LogNetworkPolicy& _Policy)
+		: m_strHost(_Host), m_strPort(std::to_string(_Port)), m_Policy(_Policy), m_nRetryMs(std::max(_Policy.m_nRetryMs, 1u))
+	{
+		m_LastSend = std::chrono::steady_clock::now();
+		m_NextConnect = m_LastSend;
+		openSpill();
+	}
+
+	~LogNetClient()
+	{
+		send();
+		disconnect();
+		// 未发送的日志写入溢出文件，已读出但未发送的部分仍在文件中
+		while (!m_Pending.empty())
+		{
+			if (m_nSpillFd >= 0)
+				spillFront();
+			else
+			{
+				m_nDiscarded.fetch_add(1, std::memory_order_relaxed);
+				m_Pending.pop_front();
+			}
+		}
+		if (m_nSpillFd >= 0)
+		{
+			compactSpill();
+			::close(m_nSpillFd);
+		}
+	}
+
+	LogNetClient(const LogNetClient&) = delete;
+	LogNetClient& operator=(const LogNetClient&) = delete;
+
+	/* 日志加入待发送列表，达到批量大小或间隔时发送 */
+	void write(const std::string& _Log)
+	{
+		if (_Log.empty())
+			return;
+		std::string& strLog = m_Pending.emplace_back();
+		if (!m_FreeList.empty())
+		{
+			strLog.swap(m_FreeList.back());
+			m_FreeList.pop_back();
+		}
+		strLog.assign(_Log);
+		m_nPendingBytes += _Log.size();
+
+		if (m_nPendingBytes >= m_Policy.m_nBatchBytes || m_nPendingBytes > m_Policy.m_nBufferBytes
+			|| std::chrono::steady_clock::now() - m_LastSend >= std::chrono::milliseconds(m_Policy.m_nBatchIntervalMs))
+			send();
+		trim();
+	}
+
+	/* 依次发送溢出文件与内存中的日志，连接断开时返回false */
+	bool send()
+	{
+		m_LastSend = std::chrono::steady_clock::now();
+		if (!connect())
+			return false;
+		while (!m_Replay.empty() || m_nReplayEnd < m_nSpillSize)
+		{
+			if (m_Replay.empty())
+				loadReplay();
+			if (!sendRecords(m_Replay, true))
+				return false;
+		}
+		if (m_nSpillSize)
+		{
+			// 溢出文件已全部发送
+			(void)ftruncate(m_nSpillFd, 0);
+			m_nSpillSize = m_nSpillRead = m_nReplayEnd = 0;
+		}
+		return sendRecords(m_Pending, false);
+	}
+
+	bool isConnected() const noexcept { return m_bConnected.load(std::memory_order_relaxed); }
+	uint64_t sentCount() const noexcept { return m_nSent.load(std::memory_order_relaxed); }
+	uint64_t spilledCount() const noexcept { return m_nSpilled.load(std::memory_order_relaxed); }
+	uint64_t discardedCount() const noexcept { return m_nDiscarded.load(std::memory_order_relaxed); }
+	uint64_t connectCount() const noexcept { return m_nConnects.load(std::memory_order_relaxed); }
+
+private:
+	/* 内存中的日志超出上限时，最早的移入溢出文件或丢弃 */
+	void trim()
+	{
+		while (m_nPendingBytes > m_Policy.m_nBufferBytes && !m_Pending.empty())
+		{
+			if (m_nSpillFd >= 0)
+				spillFront();
+			else
+			{
+				m_nDiscarded.fetch_add(1, std::memory_order_relaxed);
+				popFront(m_Pending, false);
+			}
+		}
+	}
+
+	/* 最早的一条日志追加到溢出文件 */
+	void spillFront()
+	{
+		const std::string& strLog = m_Pending.front();
+		const uint32_t nSize = static_cast<uint32_t>(strLog.size());
+		const unsigned char szHeader[4] { static_cast<unsigned char>(nSize), static_cast<unsigned char>(nSize >> 8),
+			static_cast<unsigned char>(nSize >> 16), static_cast<unsigned char>(nSize >> 24) };
+		iovec iov[2] { { const_cast<unsigned char*>(szHeader), sizeof szHeader }, { const_cast<char*>(strLog.data()), strLog.size() } };
+		const ssize_t nWritten = ::writev(m_nSpillFd, iov, 2);
+		if (nWritten == static_cast<ssize_t>(sizeof szHeader + strLog.size()))
+		{
+			m_nSpillSize += static_cast<uint64_t>(nWritten);
+			m_nSpilled.fetch_add(1, std::memory_order_relaxed);
+		}
+		else
+		{
+			// 写了一半的记录之后的内容无法解析，回到写入前的长度
+			if (nWritten > 0)
+				(void)ftruncate(m_nSpillFd, static_cast<off_t>(m_nSpillSize));
+			m_nDiscarded.fetch_add(1, std::memory_order_relaxed);
+		}
+		popFront(m_Pending, false);
+	}
+
+	/* 从溢出文件读出一批日志 */
+	void loadReplay()
+	{
+		size_t nLoaded = 0;
+		while (m_nReplayEnd < m_nSpillSize && nLoaded < std::max<size_t>(m_Policy.m_nBatchBytes, 1))
+		{
+			unsigned char szHeader[4];
+			uint32_t nSize = 0;
+			if (m_nSpillSize - m_nReplayEnd >= sizeof szHeader
+				&& pread(m_nSpillFd, szHeader, sizeof szHeader, static_cast<off_t>(m_nReplayEnd)) == sizeof szHeader)
+				nSize = szHeader[0] | szHeader[1] << 8 | szHeader[2] << 16 | static_cast<uint32_t>(szHeader[3]) << 24;
+			std::string& strLog = m_Replay.emplace_back(nSize, '\0');
+			if (m_nSpillSize - m_nReplayEnd < sizeof szHeader + nSize
+				|| pread(m_nSpillFd, &strLog[0], nSize, static_cast<off_t>(m_nReplayEnd + sizeof szHeader)) != static_cast<ssize_t>(nSize))
+			{
+				// 文件已损坏，放弃剩余的内容
+				m_Replay.pop_back();
+				m_nReplayEnd = m_nSpillSize;
+				if (m_Replay.empty())
+					m_nSpillRead = m_nSpillSize;
+				return;
+			}
+			m_nReplayEnd += sizeof szHeader + nSize;
+			nLoaded += nSize;
+		}
+	}
+
+	/* 溢出文件中未发送的部分移到文件开头 */
+	void compactSpill()
+	{
+		if (!m_nSpillRead)
+			return;
+		// 以O_APPEND打开时pwrite同样写到文件末尾
+		fcntl(m_nSpillFd, F_SETFL, fcntl(m_nSpillFd, F_GETFL, 0) & ~O_APPEND);
+		std::string strChunk(256 * 1024, '\0');
+		uint64_t nRead = m_nSpillRead;
+		uint64_t nWrite = 0;
+		while (nRead < m_nSpillSize)
+		{
+			const ssize_t n = pread(m_nSpillFd, &strChunk[0], static_cast<size_t>(std::min<uint64_t>(strChunk.size(), m_nSpillSize - nRead)), static_cast<off_t>(nRead));
+			if (n <= 0 || pwrite(m_nSpillFd, strChunk.data(), static_cast<size_t>(n), static_cast<off_t>(nWrite)) != n)
+				break;
+			nRead += static_cast<uint64_t>(n);
+			nWrite += static_cast<uint64_t>(n);
+		}
+		(void)ftruncate(m_nSpillFd, static_cast<off_t>(nWrite));
+	}
+
+	/**
+	 * @brief 发送列表中的日志，发送完成的移出列表
+	 *
+	 * @param _Records    待发送的日志
+	 * @param _Replay     是否为溢出文件中读出的日志
+	 * @return false      连接已断开，未发送的日志保留在列表中
+	 */
+	bool sendRecords(std::deque<std::string>& _Records, bool _Replay)
+	{
+		iovec iov[LOG_NET_BATCH_RECORDS];
+		if (m_Policy.m_Protocol == LOG_NET_TCP)
+		{
+			size_t nOffset = 0;   // 第一条日志已发送的字节数
+			while (!_Records.empty())
+			{
+				const size_t nCount = std::min(_Records.size(), LOG_NET_BATCH_RECORDS);
+				for (size_t i = 0; i < nCount; ++i)
+				{
+					const size_t nSkip = i ? 0 : nOffset;
+					iov[i].iov_base = const_cast<char*>(_Records[i].data()) + nSkip;
+					iov[i].iov_len = _Records[i].size() - nSkip;
+				}
+				msghdr msg {};
+				msg.msg_iov = iov;
+				msg.msg_iovlen = static_cast<decltype(msg.msg_iovlen)>(nCount);
+				const ssize_t nSent = sendmsg(m_nSocket, &msg, MSG_NOSIGNAL);
+				if (nSent < 0 && errno == EINTR)
+					continue;
+				if (nSent <= 0)
+				{
+					disconnect();
+					return false;
+				}
+				size_t nLeft = static_cast<size_t>(nSent);
+				while (nLeft)
+				{
+					const size_t nRest = _Records.front().size() - nOffset;
+					if (nLeft < nRest)
+					{
+						nOffset += nLeft;
+						break;
+					}
+					nLeft -= nRest;
+					nOffset = 0;
+					m_nSent.fetch_add(1, std::memory_order_relaxed);
+					popFront(_Records, _Replay);
+				}
+			}
+			return true;
+		}
+
+		while (!_Records.empty())
+		{
+			// 超过数据报大小的日志无法发送
+			if (_Records.front().size() > LOG_NET_MAX_DATAGRAM)
+			{
+				m_nDiscarded.fetch_add(1, std::memory_order_relaxed);
+				popFront(_Records, _Replay);
+				continue;
+			}
+#ifdef __linux__
+			mmsghdr msgs[LOG_NET_BATCH_RECORDS] {};
+			size_t nCount = 0;
+			while (nCount < std::min(_Records.size(), LOG_NET_BATCH_RECORDS) && _Records[nCount].size() <= LOG_NET_MAX_DATAGRAM)
+			{
+				iov[nCount].iov_base = const_cast<char*>(_Records[nCount].data());
+				iov[nCount].iov_len = _Records[nCount].size();
+				msgs[nCount].msg_hdr.msg_iov = &iov[nCount];
+				msgs[nCount].msg_hdr.msg_iovlen = 1;
+				++nCount;
+			}
+			const int nSent = sendmmsg(m_nSocket, msgs, static_cast<unsigned>(nCount), 0);
+#else
+			const int nSent = ::send(m_nSocket, _Records.front().data(), _Records.front().size(), 0) < 0 ? -1 : 1;
+#endif // __linux__
+			if (nSent < 0 && errno == EINTR)
+				continue;
+			if (nSent <= 0)
+			{
+				// 收集器未监听时已连接的UDP套接字返回ECONNREFUSED，同样按间隔重试
+				disconnect();
+				return false;
+			}
+			for (int i = 0; i < nSent; ++i)
+			{
+				m_nSent.fetch_add(1, std::memory_order_relaxed);
+				popFront(_Records, _Replay);
+			}
+		}
+		return true;
+	}
+
+	/* 移出第一条日志，缓冲区留待复用 */
+	void popFront(std::deque<std::string>& _Records, bool _Replay)
+	{
+		std::string& strLog = _Records.front();
+		if (_Replay)
+			m_nSpillRead += 4 + strLog.size();
+		else
+			m_nPendingBytes -= strLog.size();
+		if (m_FreeList.size() < LOG_NET_FREE_BUFFERS)
+			m_FreeList.push_back(std::move(strLog));
+		_Records.pop_front();
+	}
+
+	/* 未连接且已到重连时间时连接，失败后重连间隔加倍 */
+	bool connect()
+	{
+		if (m_nSocket >= 0)
+			return true;
+		const auto now = std::chrono::steady_clock::now();
+		if (now < m_NextConnect)
+			return false;
+		m_nSocket = open();
+		if (m_nSocket < 0)
+		{
+			m_NextConnect = now + std::chrono::milliseconds(m_nRetryMs);
+			m_nRetryMs = std::min(m_nRetryMs * 2, std::max(m_Policy.m_nMaxRetryMs, m_Policy.m_nRetryMs));
+			return false;
+		}
+		m_nRetryMs = std::max(m_Policy.m_nRetryMs, 1u);
+		m_nConnects.fetch_add(1, std::memory_order_relaxed);
+		m_bConnected.store(true, std::memory_order_relaxed);
+		return true;
+	}
+
+	/* 解析地址并依次尝试连接，返回套接字 */
+	int open() const
+	{
+		addrinfo hints {};
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = m_Policy.m_Protocol == LOG_NET_TCP ? SOCK_STREAM : SOCK_DGRAM;
+		addrinfo* result = nullptr;
+		if (getaddrinfo(m_strHost.c_str(), m_strPort.c_str(), &hints, &result) != 0)
+			return -1;
+
+		int nSocket = -1;
+		for (addrinfo* ai = result; ai && nSocket < 0; ai = ai->ai_next)
+		{
+			nSocket = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+			if (nSocket < 0)
+				continue;
+			fcntl(nSocket, F_SETFD, FD_CLOEXEC);
+			if (!connectWithTimeout(nSocket, ai->ai_addr, ai->ai_addrlen))
+			{
+				::close(nSocket);
+				nSocket = -1;
+			}
+		}
+		freeaddrinfo(result);
+		if (nSocket < 0)
+			return -1;
+
+		// 发送超时视为连接断开，避免输出线程无限期阻塞
+		timeval timeout {};
+		timeout.tv_sec = m_Policy.m_nSendTimeoutMs / 1000;
+		timeout.tv_usec = static_cast<decltype(timeout.tv_usec)>(m_Policy.m_nSendTimeoutMs % 1000 * 1000);
+		setsockopt(nSocket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof timeout);
+#ifdef SO_NOSIGPIPE
+		const int nNoSigPipe = 1;
+		setsockopt(nSocket, SOL_SOCKET, SO_NOSIGPIPE, &nNoSigPipe, sizeof nNoSigPipe);
+#endif // SO_NOSIGPIPE
+		if (m_Policy.m_Protocol == LOG_NET_TCP)
+		{
+			// 已按批发送，不再由Nagle算法合并
+			const int nNoDelay = 1;
+			setsockopt(nSocket, IPPROTO_TCP, TCP_NODELAY, &nNoDelay, sizeof nNoDelay);
+		}
+		return nSocket;
+	}
+
+	/* 以非阻塞方式连接，超时或失败返回false，成功后恢复为阻塞模式 */
+	bool connectWithTimeout(int _Socket, const sockaddr* _Addr, socklen_t _AddrLen) const
+	{
+		const int nFlags = fcntl(_Socket, F_GETFL, 0);
+		fcntl(_Socket, F_SETFL, nFlags | O_NONBLOCK);
+		if (::connect(_Socket, _Addr, _AddrLen) != 0)
+		{
+			if (errno != EINPROGRESS)
+				return false;
+			pollfd pfd { _Socket, POLLOUT, 0 };
+			int nError = 0;
+			socklen_t nLength = sizeof nError;
+			if (poll(&pfd, 1, static_cast<int>(m_Policy.m_nConnectTimeoutMs)) != 1
+				|| getsockopt(_Socket, SOL_SOCKET, SO_ERROR, &nError, &nLength) != 0 || nError)
+				return false;
+		}
+		fcntl(_Socket, F_SETFL, nFlags);
+		return true;
+	}
+
+	void disconnect()
+	{
+		if (m_nSocket < 0)
+			return;
+		::close(m_nSocket);
+		m_nSocket = -1;
+		m_bConnected.store(false, std::memory_order_relaxed);
+		m_NextConnect = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_nRetryMs);
+	}
+
+	void openSpill()
+	{
+		if (m_Policy.m_wstrSpillFile.empty())
+			return;
+		const std::filesystem::path path(m_Policy.m_wstrSpillFile);
+		m_nSpillFd = ::open(path.c_str(), O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+		struct stat st;
+		if (m_nSpillFd >= 0 && fstat(m_nSpillFd, &st) == 0)
+			m_nSpillSize = static_cast<uint64_t>(st.st_size);
+	}
+
+	std::string                           m_strHost;
+	std::string                           m_strPort;
+	LogNetworkPolicy                      m_Policy;
+	int                                   m_nSocket { -1 };
+	std::chrono::steady_clock::time_point m_LastSend;              // 上次发送的时间
+	std::chrono::steady_clock::time_point m_NextConnect;           // 下一次允许连接的时间
+	uint32_t                              m_nRetryMs;              // 当前的重连间隔
+	std::deque<std::string>               m_Pending;               // 内存中待发送的日志
+	size_t                                m_nPendingBytes { 0 };   // m_Pending的总字节数
+	std::vector<std::string>              m_FreeList;              // 发送完成后留待复用的缓冲区
+	int                                   m_nSpillFd { -1 };       // 溢出文件
+	uint64_t                              m_nSpillSize { 0 };      // 溢出文件的长度
+	uint64_t                              m_nSpillRead { 0 };      // 溢出文件中已发送的位置
+	uint64_t                              m_nReplayEnd { 0 };      // 溢出文件中已读入m_Replay的位置
+	std::deque<std::string>               m_Replay;                // 从溢出文件读出、尚未发送的日志
+	std::atomic<bool>                     m_bConnected { false };
+	std::atomic<uint64_t>                 m_nSent { 0 };
+	std::atomic<uint64_t>                 m_nSpilled { 0 };
+	std::atomic<uint64_t>                 m_nDiscarded { 0 };
+	std::atomic<uint64_t>                 m_nConnects { 0 };
+};
+
+LogNetworkSink::LogNetworkSink(const std::string& _Host, uint16_t _Port, const LogNetworkPolicy& _Policy)
+	: m_pClient(new LogNetClient(_Host, _Port, _Policy))
+{
+}
+
+LogNetworkSink::~LogNetworkSink() = default;
+
+void LogNetworkSink::write(LOGLEVEL, const std::string& _Log)
+{
+	m_pClient->write(_Log);
+}
+
+void LogNetworkSink::flush()
+{
+	m_pClient->send();
+}
+
+bool LogNetworkSink::isConnected() const noexcept
+{
+	return m_pClient->isConnected();
+}
+
+uint64_t LogNetworkSink::getSentCount() const noexcept
+{
+	return m_pClient->sentCount();
+}
+
+uint64_t LogNetworkSink::getSpilledCount() const noexcept
+{
+	return m_pClient->spilledCount();
+}
+
+uint64_t LogNetworkSink::getDiscardedCount() const noexcept
+{
+	return m_pClient->discardedCount();
+}
+
+uint64_t LogNetworkSink::getConnectCount() const noexcept
+{
+	return m_pClient->connectCount();
+}
+
+#endif // _WIN32
@@ -0,0 +1,133 @@
+/**
+ * @file log_pattern.hpp
+ * @author ldk
+ * @brief 文本日志输出模式的解析，写入端与LogReader共用
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * 模式以正文（%m）为界分为开头与结尾两段，每段为依次输出的字段，说明符见Log::setPattern。
+ * 写入端按字段序列追加，LogReader按同一序列划分与解析日志。
+ */
+
+#ifndef _LOG_PATTERN_HPP_
+#define _LOG_PATTERN_HPP_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/* 输出模式中的字段 */
+enum LOGFIELD
+{
+	LOG_FIELD_TEXT,        // 原样输出的文本
+	LOG_FIELD_TIME,        // %t 日期与时间，精度见Log::setTimePrecision
+	LOG_FIELD_LEVEL,       // %l 等级名称
+	LOG_FIELD_PID,         // %P 进程号
+	LOG_FIELD_TID,         // %T 线程号
+	LOG_FIELD_THREAD,      // %N 线程名称，未设置时为线程号
+	LOG_FIELD_FILE,        // %f 文件名
+	LOG_FIELD_FUNCTION,    // %F 函数名
+	LOG_FIELD_LINE,        // %n 行号
+	LOG_FIELD_BANNER       // %B 等级分隔行，含前后换行
+};
+
+struct LogPatternField
+{
+	LOGFIELD    m_Type   { LOG_FIELD_TEXT };
+	size_t      m_nWidth { 0 };     // 最小宽度，不足时在右侧补空格
+	std::string m_strText;          // LOG_FIELD_TEXT的文本
+};
+
+/**
+ * @brief 解析输出模式，未知的说明符原样作为文本
+ *
+ * 没有%m时正文在最后；结尾段不以换行或%B结束时追加换行，每条日志以换行结尾
+ *
+ * @param _Pattern    输出模式
+ * @param _Header     OUT 正文之前的字段
+ * @param _Footer     OUT 正文之后的字段
+ */
+inline void LogParsePattern(const std::string& _Pattern, std::vector<LogPatternField>& _Header, std::vector<LogPatternField>& _Footer)
+{
+	_Header.clear();
+	_Footer.clear();
+	std::vector<LogPatternField>* pFields = &_Header;
+	bool bMessage = false;
+	std::string strText;
+	auto flushText = [&]
+	{
+		if (strText.empty())
+			return;
+		LogPatternField& field = pFields->emplace_back();
+		field.m_strText = strText;
+		strText.clear();
+	};
+
+	for (size_t i = 0; i < _Pattern.size(); ++i)
+	{
+		const size_t nBegin = i;
+		if (_Pattern[i] != '%' || i + 1 >= _Pattern.size())
+		{
+			strText += _Pattern[i];
+			continue;
+		}
+		size_t nWidth = 0;
+		while (i + 1 < _Pattern.size() && _Pattern[i + 1] >= '0' && _Pattern[i + 1] <= '9')
+			nWidth = nWidth * 10 + static_cast<size_t>(_Pattern[++i] - '0');
+		const char c = i + 1 < _Pattern.size() ? _Pattern[++i] : '\0';
+		LOGFIELD type = LOG_FIELD_TEXT;
+		switch (c)
+		{
+		case 't': type = LOG_FIELD_TIME;     break;
+		case 'l': type = LOG_FIELD_LEVEL;    break;
+		case 'P': type = LOG_FIELD_PID;      break;
+		case 'T': type = LOG_FIELD_TID;      break;
+		case 'N': type = LOG_FIELD_THREAD;   break;
+		case 'f': type = LOG_FIELD_FILE;     break;
+		case 'F': type = LOG_FIELD_FUNCTION; break;
+		case 'n': type = LOG_FIELD_LINE;     break;
+		case 'B': type = LOG_FIELD_BANNER;   break;
+		case 'm':
+			if (!bMessage)
+			{
+				flushText();
+				bMessage = true;
+				pFields = &_Footer;
+				continue;
+			}
+			break;
+		case '%':
+			strText += '%';
+			continue;
+		default:
+			break;
+		}
+		if (type == LOG_FIELD_TEXT)
+		{
+			// 未知的说明符原样保留
+			strText.append(_Pattern, nBegin, i + 1 - nBegin);
+			continue;
+		}
+		flushText();
+		LogPatternField& field = pFields->emplace_back();
+		field.m_Type = type;
+		field.m_nWidth = nWidth;
+	}
+	if (!bMessage)
+	{
+		// 模式中没有%m时正文在最后
+		flushText();
+		pFields = &_Footer;
+	}
+	// 每条日志以换行结尾
+	const bool bEndsWithLine = strText.empty()
+		? !_Footer.empty() && _Footer.back().m_Type == LOG_FIELD_BANNER
+		: strText.back() == '\n';
+	if (!bEndsWithLine)
+		strText += '\n';
+	flushText();
+}
+
+#endif // _LOG_PATTERN_HPP_
@@ -0,0 +1,782 @@
+/**
+ * @file log_reader.cpp
+ * @author ldk
+ * @brief 基于内存映射的文本日志读取
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "log_reader.hpp"
+#include "log_compress.hpp"
+#include <ctime>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif // _WIN32
+
+/* 分隔行中每侧'*'的个数，与levelBanner一致 */
+constexpr size_t LOG_BANNER_STARS { 60 };
+
+/* 分隔行的开头，查找时先以memchr定位首字符，glibc中为向量化实现 */
+static const std::string& bannerPrefix()
+{
+	static const std::string strPrefix = '\n' + std::string(LOG_BANNER_STARS, '*') + ' ';
+	return strPrefix;
+}
+
+/* 自1970-01-01起的天数，适用于公历 */
+static int64_t daysFromCivil(int64_t _Year, unsigned _Month, unsigned _Day)
+{
+	_Year -= _Month <= 2;
+	const int64_t era = (_Year >= 0 ? _Year : _Year - 399) / 400;
+	const unsigned yoe = static_cast<unsigned>(_Year - era * 400);
+	const unsigned doy = (153 * (_Month + (_Month > 2 ? -3 : 9)) + 2) / 5 + _Day - 1;
+	const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + static_cast<int64_t>(doe) - 719468;
+}
+
+int64_t LogLocalTime::toTime(int _Year, int _Month, int _Day, int _Hour, int _Minute, int _Second, int64_t _Nanosecond)
+{
+	const int64_t nLocal = daysFromCivil(_Year, static_cast<unsigned>(_Month), static_cast<unsigned>(_Day)) * 86400
+		+ _Hour * 3600 + _Minute * 60 + _Second;
+	const int64_t nHour = nLocal / 3600;
+	if (nHour != m_nHour)
+	{
+		// 夏令时只在整点切换，按小时缓存本地时间与UTC之差
+		struct tm tmLocal {};
+		tmLocal.tm_year = _Year - 1900;
+		tmLocal.tm_mon = _Month - 1;
+		tmLocal.tm_mday = _Day;
+		tmLocal.tm_hour = _Hour;
+		tmLocal.tm_isdst = -1;
+		// 并行建立索引时各线程都可能调用，mktime会读取并更新时区设置
+		static std::mutex mutex;
+		std::scoped_lock<std::mutex> lock(mutex);
+		m_nHour = nHour;
+		m_nOffset = nHour * 3600 - static_cast<int64_t>(mktime(&tmLocal));
+	}
+	return (nLocal - m_nOffset) * 1000000000 + _Nanosecond;
+}
+
+/* 解析固定位数的十进制数字 */
+static bool parseDigits(const char* _Data, size_t _Count, int& _Value)
+{
+	_Value = 0;
+	for (size_t i = 0; i < _Count; ++i)
+	{
+		if (_Data[i] < '0' || _Data[i] > '9')
+			return false;
+		_Value = _Value * 10 + (_Data[i] - '0');
+	}
+	return true;
+}
+
+/* 解析日志开头的"YYYY-MM-DD HH:MM:SS[.小数]"，以本地时间换算 */
+static bool parseTime(std::string_view _Text, LogLocalTime& _LocalTime, int64_t& _Time)
+{
+	constexpr size_t nLength = sizeof "0000-00-00 00:00:00" - 1;
+	if (_Text.size() < nLength || _Text[4] != '-' || _Text[7] != '-' || _Text[10] != ' ' || _Text[13] != ':' || _Text[16] != ':')
+		return false;
+	int nYear, nMonth, nDay, nHour, nMinute, nSecond;
+	const char* data = _Text.data();
+	if (!parseDigits(data, 4, nYear) || !parseDigits(data + 5, 2, nMonth) || !parseDigits(data + 8, 2, nDay)
+		|| !parseDigits(data + 11, 2, nHour) || !parseDigits(data + 14, 2, nMinute) || !parseDigits(data + 17, 2, nSecond))
+		return false;
+	if (nMonth < 1 || nMonth > 12 || nDay < 1 || nDay > 31)
+		return false;
+
+	int64_t nNanosecond = 0;
+	if (_Text.size() > nLength && _Text[nLength] == '.')
+	{
+		int64_t nScale = 100000000;
+		for (size_t i = nLength + 1; i < _Text.size() && _Text[i] >= '0' && _Text[i] <= '9' && nScale; ++i, nScale /= 10)
+			nNanosecond += (_Text[i] - '0') * nScale;
+	}
+	_Time = _LocalTime.toTime(nYear, nMonth, nDay, nHour, nMinute, nSecond, nNanosecond);
+	return true;
+}
+
+/* 时间部分的长度，parseTime成功后调用 */
+static size_t timeLength(std::string_view _Text)
+{
+	size_t nPos = sizeof "0000-00-00 00:00:00" - 1;
+	if (nPos < _Text.size() && _Text[nPos] == '.')
+		for (++nPos; nPos < _Text.size() && _Text[nPos] >= '0' && _Text[nPos] <= '9'; ++nPos);
+	return nPos;
+}
+
+/* 解析十进制数字 */
+static bool parseNumber(std::string_view _Text, size_t& _Pos, uint32_t& _Value)
+{
+	const size_t nBegin = _Pos;
+	_Value = 0;
+	for (; _Pos < _Text.size() && _Text[_Pos] >= '0' && _Text[_Pos] <= '9'; ++_Pos)
+		_Value = _Value * 10 + static_cast<uint32_t>(_Text[_Pos] - '0');
+	return _Pos > nBegin;
+}
+
+/* 跳过_Text中_Pos处的_Expected */
+static bool expect(std::string_view _Text, size_t& _Pos, std::string_view _Expected)
+{
+	if (_Text.substr(_Pos, _Expected.size()) != _Expected)
+		return false;
+	_Pos += _Expected.size();
+	return true;
+}
+
+/* 分隔行中的等级名称 */
+static LOGLEVEL parseLevel(std::string_view _Name)
+{
+	for (const auto& level : LOGLEVEL_WSTRING)
+	{
+		const wchar_t* name = level.second;
+		size_t i = 0;
+		for (; i < _Name.size() && name[i] && name[i] == static_cast<wchar_t>(_Name[i]); ++i);
+		if (i == _Name.size() && !name[i])
+			return level.first;
+	}
+	return LOG_LEVEL_NONE;
+}
+
+/* 解析_Pos处的等级名称，各名称互不为前缀 */
+static LOGLEVEL matchLevel(std::string_view _Text, size_t& _Pos)
+{
+	for (const auto& level : LOGLEVEL_WSTRING)
+	{
+		const wchar_t* name = level.second;
+		size_t i = 0;
+		for (; name[i] && _Pos + i < _Text.size() && name[i] == static_cast<wchar_t>(_Text[_Pos + i]); ++i);
+		if (!name[i])
+		{
+			_Pos += i;
+			return level.first;
+		}
+	}
+	return LOG_LEVEL_NONE;
+}
+
+/* 以其后的文本为界的名称字段 */
+static bool isNameField(LOGFIELD _Type)
+{
+	return _Type == LOG_FIELD_FILE || _Type == LOG_FIELD_FUNCTION || _Type == LOG_FIELD_THREAD;
+}
+
+/**
+ * @brief 从_Pos开始依次匹配_Fields
+ *
+ * 名称字段到其后文本的第一次出现为止，不跨行；最后一个字段为名称字段时到_Text结尾为止。
+ * 不足最小宽度时跳过右侧补齐的空格
+ *
+ * @param _Pos      IN/OUT 开始的位置，返回时为之后的位置
+ * @param _Entry    OUT 解析出的字段
+ * @return 是否全部匹配
+ */
+static bool parseFields(const std::vector<LogPatternField>& _Fields, std::string_view _Text, size_t& _Pos, LogLocalTime& _LocalTime, LogEntry& _Entry)
+{
+	for (size_t i = 0; i < _Fields.size(); ++i)
+	{
+		const LogPatternField& field = _Fields[i];
+		const size_t nBegin = _Pos;
+		switch (field.m_Type)
+		{
+		case LOG_FIELD_TEXT:
+			if (!expect(_Text, _Pos, field.m_strText))
+				return false;
+			break;
+		case LOG_FIELD_TIME:
+		{
+			const std::string_view time = _Text.substr(_Pos, 40);
+			if (!parseTime(time, _LocalTime, _Entry.m_nTime))
+				return false;
+			_Pos += timeLength(time);
+			break;
+		}
+		case LOG_FIELD_LEVEL:
+			_Entry.m_Level = matchLevel(_Text, _Pos);
+			if (_Entry.m_Level == LOG_LEVEL_NONE)
+				return false;
+			break;
+		case LOG_FIELD_PID:
+			if (!parseNumber(_Text, _Pos, _Entry.m_nProcessId))
+				return false;
+			break;
+		case LOG_FIELD_TID:
+			if (!parseNumber(_Text, _Pos, _Entry.m_nThreadId))
+				return false;
+			break;
+		case LOG_FIELD_LINE:
+			if (!parseNumber(_Text, _Pos, _Entry.m_nLine))
+				return false;
+			break;
+		case LOG_FIELD_FILE:
+		case LOG_FIELD_FUNCTION:
+		case LOG_FIELD_THREAD:
+		{
+			size_t nEnd = _Text.size();
+			if (i + 1 < _Fields.size())
+			{
+				const std::string& strNext = _Fields[i + 1].m_strText;
+				const size_t nLineEnd = std::min(_Text.find('\n', _Pos), _Text.size());
+				nEnd = _Text.substr(0, std::min(nLineEnd + strNext.size(), _Text.size())).find(strNext, _Pos);
+				if (nEnd == std::string_view::npos)
+					return false;
+			}
+			// 补齐的空格不属于名称
+			if (field.m_nWidth)
+			{
+				while (nEnd > _Pos && _Text[nEnd - 1] == ' ')
+					--nEnd;
+			}
+			if (field.m_Type == LOG_FIELD_FILE)
+				_Entry.m_strFile = _Text.substr(_Pos, nEnd - _Pos);
+			else if (field.m_Type == LOG_FIELD_FUNCTION)
+				_Entry.m_strFunction = _Text.substr(_Pos, nEnd - _Pos);
+			_Pos = nEnd;
+			break;
+		}
+		case LOG_FIELD_BANNER:
+			return false;
+		}
+		for (; _Pos - nBegin < field.m_nWidth && _Pos < _Text.size() && _Text[_Pos] == ' '; ++_Pos);
+	}
+	return true;
+}
+
+bool LogReader::open(const std::wstring& _Path)
+{
+	close();
+	m_wstrPath = _Path;
+	m_bOpen = map();
+	return m_bOpen;
+}
+
+void LogReader::close()
+{
+	unmap();
+	m_bOpen = false;
+	m_bIndexed = false;
+	m_nIndexed = 0;
+	m_Index.clear();
+}
+
+bool LogReader::setPattern(const std::string& _Pattern)
+{
+	Layout layout;
+	if (!makeLayout(_Pattern, layout))
+		return false;
+	m_Layout = std::move(layout);
+	// 已建立的索引按原来的模式划分
+	m_Index.clear();
+	m_nIndexed = 0;
+	m_bIndexed = false;
+	return true;
+}
+
+bool LogReader::makeLayout(const std::string& _Pattern, Layout& _Layout)
+{
+	std::vector<LogPatternField>& header = _Layout.m_Header;
+	std::vector<LogPatternField>& footer = _Layout.m_Footer;
+	LogParsePattern(_Pattern, header, footer);
+	_Layout.m_bBanner = !header.empty() && header.front().m_Type == LOG_FIELD_BANNER;
+	if (_Layout.m_bBanner)
+		header.erase(header.begin());
+	_Layout.m_bClosingBanner = _Layout.m_bBanner && !footer.empty() && footer.back().m_Type == LOG_FIELD_BANNER;
+	if (_Layout.m_bClosingBanner)
+		footer.pop_back();
+
+	// 其余位置的分隔行无法用于划分日志
+	auto isBanner = [](const LogPatternField& _Field) { return _Field.m_Type == LOG_FIELD_BANNER; };
+	if (std::any_of(header.begin(), header.end(), isBanner) || std::any_of(footer.begin(), footer.end(), isBanner))
+		return false;
+	// 正文的结束位置由正文之后的第一段文本确定
+	if (!footer.empty() && footer.front().m_Type != LOG_FIELD_TEXT)
+		return false;
+	for (size_t i = 0; i < header.size(); ++i)
+	{
+		if (isNameField(header[i].m_Type) && (i + 1 == header.size() || header[i + 1].m_Type != LOG_FIELD_TEXT))
+			return false;
+	}
+	for (size_t i = 0; i + 1 < footer.size(); ++i)
+	{
+		if (isNameField(footer[i].m_Type) && footer[i + 1].m_Type != LOG_FIELD_TEXT)
+			return false;
+	}
+	return true;
+}
+
+bool LogReader::refresh()
+{
+	if (!m_bOpen)
+		return false;
+	unmap();
+	m_bOpen = map();
+	if (!m_bOpen || m_nSize < m_nIndexed)
+	{
+		// 文件被截断或已滚动，重新建立索引
+		m_Index.clear();
+		m_nIndexed = 0;
+	}
+	if (m_bOpen && m_bIndexed)
+		buildIndex();
+	return m_bOpen;
+}
+
+std::shared_ptr<const std::regex> LogReader::prepare(const LogQuery& _Query)
+{
+	if (m_bOpen && !m_bIndexed)
+	{
+		buildIndex();
+		m_bIndexed = true;
+	}
+	if (_Query.m_strRegex.empty())
+		return nullptr;
+	return std::make_shared<const std::regex>(_Query.m_strRegex, std::regex::ECMAScript | std::regex::optimize);
+}
+
+LogReader::Range LogReader::query(const LogQuery& _Query)
+{
+	std::shared_ptr<const std::regex> regex = prepare(_Query);
+	return Range(this, _Query, std::move(regex), 0, m_Index.size());
+}
+
+std::vector<LogEntry> LogReader::search(const LogQuery& _Query, unsigned _Threads)
+{
+	const std::shared_ptr<const std::regex> regex = prepare(_Query);
+	if (!_Threads)
+		_Threads = std::max(1u, std::thread::hardware_concurrency());
+
+	// 每个任务为连续的若干索引块，结果按任务顺序合并即为文件中的顺序
+	const size_t nTasks = (m_Index.size() + LOG_READER_SEARCH_BLOCKS - 1) / LOG_READER_SEARCH_BLOCKS;
+	std::vector<std::vector<LogEntry>> results(nTasks);
+	std::atomic<size_t> nNext { 0 };
+	auto worker = [&]
+	{
+		for (size_t nTask = nNext++; nTask < nTasks; nTask = nNext++)
+		{
+			const size_t nBegin = nTask * LOG_READER_SEARCH_BLOCKS;
+			const size_t nEnd = std::min(nBegin + LOG_READER_SEARCH_BLOCKS, m_Index.size());
+			for (Iterator it(this, _Query, regex, nBegin, nEnd), end; it != end; ++it)
+				results[nTask].push_back(*it);
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (unsigned i = 1; i < _Threads && i < nTasks; ++i)
+		threads.emplace_back(worker);
+	worker();
+	for (std::thread& thread : threads)
+		thread.join();
+
+	std::vector<LogEntry> entries;
+	size_t nTotal = 0;
+	for (const std::vector<LogEntry>& result : results)
+		nTotal += result.size();
+	entries.reserve(nTotal);
+	for (const std::vector<LogEntry>& result : results)
+		entries.insert(entries.end(), result.begin(), result.end());
+	return entries;
+}
+
+bool LogReader::parseRecord(uint64_t& _Offset, uint64_t _Limit, LogLocalTime& _LocalTime, LogEntry& _Entry) const
+{
+	if (m_Layout.m_bBanner)
+		return parseBannerRecord(_Offset, _Limit, _LocalTime, _Entry);
+	return parseLineRecord(_Offset, _Limit, _LocalTime, _Entry);
+}
+
+bool LogReader::parseBannerRecord(uint64_t& _Offset, uint64_t _Limit, LogLocalTime& _LocalTime, LogEntry& _Entry) const
+{
+	const std::string& strPrefix = bannerPrefix();
+	const std::string_view data(m_pData, static_cast<size_t>(m_nSize));
+	size_t nPos = static_cast<size_t>(_Offset);
+	for (;; ++nPos)
+	{
+		nPos = data.find(strPrefix, nPos);
+		if (nPos == std::string_view::npos || nPos >= _Limit)
+			return false;
+
+		// 分隔行："\n***... 等级 ***...\n"
+		const size_t nName = nPos + strPrefix.size();
+		const size_t nNameEnd = data.find(' ', nName);
+		if (nNameEnd == std::string_view::npos || nNameEnd - nName > 16)
+			continue;
+		const size_t nBody = nNameEnd + 1 + LOG_BANNER_STARS + 1;
+		if (nBody > data.size() || data[nBody - 1] != '\n'
+			|| data.find_first_not_of('*', nNameEnd + 1) != nBody - 1)
+			continue;
+		const LOGLEVEL level = parseLevel(data.substr(nName, nNameEnd - nName));
+		if (level == LOG_LEVEL_NONE)
+			continue;
+		// 上一条日志结尾的分隔行之后紧接下一条日志开头的分隔行
+		if (data.compare(nBody, strPrefix.size(), strPrefix) == 0)
+			continue;
+
+		size_t nEnd = 0;
+		size_t nNext = 0;
+		if (m_Layout.m_bClosingBanner)
+		{
+			// 结尾的分隔行与开头相同，找不到时说明日志尚未写完
+			const std::string_view banner = data.substr(nPos, nBody - nPos);
+			nEnd = data.find(banner, nBody);
+			if (nEnd == std::string_view::npos)
+				return false;
+			nNext = nEnd + banner.size();
+		}
+		else
+		{
+			// 到下一条日志开头的分隔行为止，最后一条日志以换行结尾时视为已写完
+			nEnd = data.find(strPrefix, nBody);
+			if (nEnd == std::string_view::npos)
+			{
+				if (data.back() != '\n')
+					return false;
+				nEnd = data.size();
+			}
+			nNext = nEnd;
+		}
+
+		_Entry.m_Level = level;
+		if (!parseContent(data.substr(nBody, nEnd - nBody), _LocalTime, _Entry))
+			continue;
+		_Entry.m_nOffset = nPos;
+		_Entry.m_strText = data.substr(nPos, nNext - nPos);
+		_Offset = nNext;
+		return true;
+	}
+}
+
+bool LogReader::parseLineRecord(uint64_t& _Offset, uint64_t _Limit, LogLocalTime& _LocalTime, LogEntry& _Entry) const
+{
+	const std::string_view data(m_pData, static_cast<size_t>(m_nSize));
+	size_t nPos = static_cast<size_t>(_Offset);
+	if (nPos && nPos < data.size() && data[nPos - 1] != '\n')
+	{
+		nPos = data.find('\n', nPos);
+		if (nPos == std::string_view::npos)
+			return false;
+		++nPos;
+	}
+	while (nPos < _Limit && nPos < data.size())
+	{
+		// 最后一行尚未写完
+		const size_t nLineEnd = data.find('\n', nPos);
+		if (nLineEnd == std::string_view::npos)
+			return false;
+		if (!isLineStart(nPos, _LocalTime))
+		{
+			nPos = nLineEnd + 1;
+			continue;
+		}
+
+		// 之后不能解析出正文之前部分的行属于同一条日志
+		size_t nEnd = nLineEnd + 1;
+		while (!m_Layout.m_Header.empty() && nEnd < data.size() && !isLineStart(nEnd, _LocalTime))
+		{
+			const size_t nNext = data.find('\n', nEnd);
+			if (nNext == std::string_view::npos)
+				break;
+			nEnd = nNext + 1;
+		}
+		_Entry.m_Level = LOG_LEVEL_NONE;
+		parseContent(data.substr(nPos, nEnd - nPos), _LocalTime, _Entry);
+		_Entry.m_nOffset = nPos;
+		_Entry.m_strText = data.substr(nPos, nEnd - nPos);
+		_Offset = nEnd;
+		return true;
+	}
+	return false;
+}
+
+bool LogReader::isLineStart(size_t _Pos, LogLocalTime& _LocalTime) const
+{
+	LogEntry entry;
+	size_t nPos = 0;
+	return parseFields(m_Layout.m_Header, std::string_view(m_pData + _Pos, static_cast<size_t>(m_nSize) - _Pos), nPos, _LocalTime, entry);
+}
+
+bool LogReader::parseContent(std::string_view _Content, LogLocalTime& _LocalTime, LogEntry& _Entry) const
+{
+	_Entry.m_nTime = 0;
+	_Entry.m_nProcessId = _Entry.m_nThreadId = _Entry.m_nLine = 0;
+	_Entry.m_strFile = _Entry.m_strFunction = std::string_view();
+	size_t nPos = 0;
+	if (!parseFields(m_Layout.m_Header, _Content, nPos, _LocalTime, _Entry))
+		return false;
+	_Entry.m_strMessage = _Content.substr(nPos);
+
+	// 正文之后的部分从其第一段文本最后一次出现的位置开始
+	const std::vector<LogPatternField>& footer = m_Layout.m_Footer;
+	if (footer.empty())
+		return true;
+	size_t nFooter = _Content.rfind(footer.front().m_strText);
+	if (nFooter == std::string_view::npos || nFooter < nPos)
+		return true;
+	LogEntry entry = _Entry;
+	size_t nEnd = nFooter;
+	if (parseFields(footer, _Content, nEnd, _LocalTime, entry) && nEnd == _Content.size())
+	{
+		entry.m_strMessage = _Content.substr(nPos, nFooter - nPos);
+		_Entry = entry;
+	}
+	return true;
+}
+
+void LogReader::buildIndex()
+{
+	// 最后一块可能不满，从其开头重新建立
+	if (!m_Index.empty())
+	{
+		m_nIndexed = m_Index.back().m_nOffset;
+		m_Index.pop_back();
+	}
+
+	// 按字节等分，每段从其中第一条日志的开头开始，段内索引按顺序拼接
+	const uint64_t nBytes = m_nSize - m_nIndexed;
+	const uint64_t nMaxParts = m_nThreads ? m_nThreads : std::max(1u, std::thread::hardware_concurrency());
+	const uint64_t nParts = std::clamp<uint64_t>(nBytes / LOG_READER_PARALLEL_BYTES, 1, nMaxParts);
+	std::vector<std::vector<LogIndexBlock>> parts(static_cast<size_t>(nParts));
+	std::vector<uint64_t> ends(static_cast<size_t>(nParts), 0);
+	auto indexPart = [&](size_t _Part)
+	{
+		const uint64_t nBegin = m_nIndexed + nBytes * _Part / nParts;
+		const uint64_t nEnd = _Part + 1 == nParts ? m_nSize : m_nIndexed + nBytes * (_Part + 1) / nParts;
+		ends[_Part] = indexRange(nBegin, nEnd, parts[_Part]);
+	};
+	std::vector<std::thread> threads;
+	for (size_t i = 1; i < parts.size(); ++i)
+		threads.emplace_back(indexPart, i);
+	indexPart(0);
+	for (std::thread& thread : threads)
+		thread.join();
+
+	for (size_t i = 0; i < parts.size(); ++i)
+	{
+		m_Index.insert(m_Index.end(), parts[i].begin(), parts[i].end());
+		if (ends[i])
+			m_nIndexed = ends[i];
+	}
+}
+
+uint64_t LogReader::indexRange(uint64_t _Begin, uint64_t _End, std::vector<LogIndexBlock>& _Index) const
+{
+	LogLocalTime localTime;
+	LogEntry entry;
+	LogIndexBlock block;
+	uint64_t nOffset = _Begin;
+	uint64_t nIndexed = 0;
+	while (parseRecord(nOffset, _End, localTime, entry))
+	{
+		if (block.m_nRecords && entry.m_nOffset - block.m_nOffset >= LOG_READER_INDEX_STRIDE)
+		{
+			_Index.push_back(block);
+			block = LogIndexBlock {};
+		}
+		if (!block.m_nRecords)
+			block.m_nOffset = entry.m_nOffset;
+		block.m_nMinTime = std::min(block.m_nMinTime, entry.m_nTime);
+		block.m_nMaxTime = std::max(block.m_nMaxTime, entry.m_nTime);
+		block.m_nLevels |= 1u << entry.m_Level;
+		block.m_nThreads |= 1ull << (entry.m_nThreadId % 64);
+		++block.m_nRecords;
+		nIndexed = nOffset;
+	}
+	if (block.m_nRecords)
+		_Index.push_back(block);
+	return nIndexed;
+}
+
+bool LogReader::seekText(uint64_t& _Offset, uint64_t _Limit, std::string_view _Text) const
+{
+	const std::string_view data(m_pData, static_cast<size_t>(_Limit));
+	const size_t nFound = data.find(_Text, static_cast<size_t>(_Offset));
+	if (nFound == std::string_view::npos)
+	{
+		_Offset = _Limit;
+		return false;
+	}
+	if (m_Layout.m_bBanner)
+	{
+		// 之前最近的分隔行即所在日志开头的分隔行，结尾的分隔行之后不会再有正文
+		const size_t nRecord = data.rfind(bannerPrefix(), nFound);
+		if (nRecord != std::string_view::npos && nRecord > _Offset)
+			_Offset = nRecord;
+		return true;
+	}
+
+	// 向前找到能解析出正文之前部分的行
+	LogLocalTime localTime;
+	size_t nLine = nFound;
+	while (nLine > _Offset)
+	{
+		nLine = data.rfind('\n', nLine - 1);
+		nLine = nLine == std::string_view::npos ? 0 : nLine + 1;
+		if (nLine <= _Offset)
+			break;
+		if (isLineStart(nLine, localTime))
+		{
+			_Offset = nLine;
+			break;
+		}
+		--nLine;
+	}
+	return true;
+}
+
+bool LogReader::blockMatches(const LogIndexBlock& _Block, const LogQuery& _Query) noexcept
+{
+	// 第0位为等级未知的日志
+	const uint32_t nLevels = (2u << _Query.m_Level) - 1;
+	return (_Block.m_nLevels & nLevels)
+		&& _Block.m_nMaxTime >= _Query.m_nBeginTime && _Block.m_nMinTime < _Query.m_nEndTime
+		&& (!_Query.m_nThreadId || (_Block.m_nThreads & (1ull << (_Query.m_nThreadId % 64))));
+}
+
+bool LogReader::entryMatches(const LogEntry& _Entry, const LogQuery& _Query, const std::regex* _Regex)
+{
+	if (_Entry.m_Level > _Query.m_Level || _Entry.m_nTime < _Query.m_nBeginTime || _Entry.m_nTime >= _Query.m_nEndTime)
+		return false;
+	if (_Query.m_nThreadId && _Entry.m_nThreadId != _Query.m_nThreadId)
+		return false;
+	if (!_Query.m_strFile.empty() && _Entry.m_strFile.find(_Query.m_strFile) == std::string_view::npos)
+		return false;
+	if (!_Query.m_strFunction.empty() && _Entry.m_strFunction.find(_Query.m_strFunction) == std::string_view::npos)
+		return false;
+	if (!_Query.m_strText.empty() && _Entry.m_strMessage.find(_Query.m_strText) == std::string_view::npos)
+		return false;
+	return !_Regex || std::regex_search(_Entry.m_strMessage.begin(), _Entry.m_strMessage.end(), *_Regex);
+}
+
+LogReader::Iterator::Iterator(const LogReader* _Reader, const LogQuery& _Query, std::shared_ptr<const std::regex> _Regex, size_t _BeginBlock, size_t _EndBlock)
+	: m_pReader(_Reader), m_Query(_Query), m_pRegex(std::move(_Regex)), m_nBlock(_BeginBlock), m_nEndBlock(_EndBlock)
+{
+	advance();
+}
+
+void LogReader::Iterator::advance()
+{
+	while (m_pReader)
+	{
+		while (m_nOffset < m_nBlockEnd && (m_Query.m_strText.empty() || m_pReader->seekText(m_nOffset, m_nBlockEnd, m_Query.m_strText))
+			&& m_pReader->parseRecord(m_nOffset, m_nBlockEnd, m_LocalTime, m_Entry))
+		{
+			if (entryMatches(m_Entry, m_Query, m_pRegex.get()))
+				return;
+		}
+
+		// 跳过不可能命中的块
+		const std::vector<LogIndexBlock>& index = m_pReader->m_Index;
+		while (m_nBlock < m_nEndBlock && !blockMatches(index[m_nBlock], m_Query))
+			++m_nBlock;
+		if (m_nBlock >= m_nEndBlock)
+		{
+			m_pReader = nullptr;
+			return;
+		}
+		m_nOffset = index[m_nBlock].m_nOffset;
+		m_nBlockEnd = m_nBlock + 1 < index.size() ? index[m_nBlock + 1].m_nOffset : m_pReader->m_nIndexed;
+		++m_nBlock;
+	}
+}
+
+bool LogReader::map()
+{
+	const std::filesystem::path path(m_wstrPath);
+#ifdef _WIN32
+	HANDLE hFile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(hFile, &size))
+	{
+		CloseHandle(hFile);
+		return false;
+	}
+	m_hFile = hFile;
+	m_nSize = static_cast<uint64_t>(size.QuadPart);
+	// 空文件无法映射
+	if (!m_nSize)
+		return true;
+	m_hMapping = CreateFileMappingW(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (m_hMapping)
+		m_pData = static_cast<const char*>(MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0));
+#else
+	const int nFd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (nFd < 0)
+		return false;
+	struct stat st;
+	if (fstat(nFd, &st) != 0)
+	{
+		::close(nFd);
+		return false;
+	}
+	m_nSize = static_cast<uint64_t>(st.st_size);
+	// 空文件无法映射
+	if (!m_nSize)
+	{
+		::close(nFd);
+		return true;
+	}
+	void* pData = mmap(nullptr, static_cast<size_t>(m_nSize), PROT_READ, MAP_PRIVATE, nFd, 0);
+	// 映射建立后即可关闭文件
+	::close(nFd);
+	if (pData != MAP_FAILED)
+		m_pData = static_cast<const char*>(pData);
+#endif // _WIN32
+	if (!m_pData)
+	{
+		unmap();
+		return false;
+	}
+	if (LogIsGzip(m_pData, static_cast<size_t>(m_nSize)))
+		return inflate();
+	return true;
+}
+
+bool LogReader::inflate()
+{
+	// 压缩文件整体解压到内存，之后按未压缩的内容读取
+	std::string strInflated;
+	const bool bResult = LogInflate(m_pData, static_cast<size_t>(m_nSize), strInflated);
+	unmap();
+	if (!bResult)
+		return false;
+	m_strInflated = std::move(strInflated);
+	m_pData = m_strInflated.data();
+	m_nSize = m_strInflated.size();
+	return true;
+}
+
+void LogReader::unmap()
+{
+	if (m_pData && m_pData == m_strInflated.data())
+	{
+		m_strInflated.clear();
+		m_strInflated.shrink_to_fit();
+		m_pData = nullptr;
+		m_nSize = 0;
+	}
+#ifdef _WIN32
+	if (m_pData)
+		UnmapViewOfFile(m_pData);
+	if (m_hMapping)
+		CloseHandle(m_hMapping);
+	if (m_hFile)
+		CloseHandle(m_hFile);
+	m_hMapping = nullptr;
+	m_hFile = nullptr;
+#else
+	if (m_pData)
+		munmap(const_cast<char*>(m_pData), static_cast<size_t>(m_nSize));
+#endif // _WIN32
+	m_pData = nullptr;
+	m_nSize = 0;
+}
@@ -0,0 +1,287 @@
+/**
+ * @file log_reader.hpp
+ * @author ldk
+ * @brief 基于内存映射的文本日志读取，按记录建立稀疏索引
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * 日志文件以只读方式映射，首次查询时扫描一遍文件，每隔约LOG_READER_INDEX_STRIDE字节建立一个索引块，
+ * 记录块内日志的起始位置、时间范围与出现过的等级。查询时跳过不满足条件的整块，只解析可能命中的块，
+ * 结果通过迭代器逐条返回，日志内容直接引用映射的内存，不做拷贝。大文件的索引与search按块并行处理。
+ * 日志按写入时的输出模式划分与解析，见setPattern。
+ * gzip压缩的文件按文件头识别，打开与refresh时整体解压到内存，之后的读取与未压缩的文件相同。
+ */
+
+#ifndef _LOG_READER_HPP_
+#define _LOG_READER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <climits>
+#include <iterator>
+#include <memory>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "log.hpp"
+#include "log_pattern.hpp"
+
+/* 索引块的大致字节数 */
+constexpr uint64_t LOG_READER_INDEX_STRIDE { 256 * 1024 };
+/* 并行建立索引时每个线程至少处理的字节数，小文件只用一个线程 */
+constexpr uint64_t LOG_READER_PARALLEL_BYTES { 16 * 1024 * 1024 };
+/* 并行查询时每个任务包含的索引块数 */
+constexpr size_t   LOG_READER_SEARCH_BLOCKS { 8 };
+
+/* 日志查询条件 */
+struct LogQuery
+{
+	LOGLEVEL m_Level      { LOG_LEVEL_INFO };   // 只返回该等级及更严重的日志，如LOG_LEVEL_WARNING返回WARNING与ERROR，等级未知的日志总是返回
+	int64_t  m_nBeginTime { INT64_MIN };        // 起始时间（自1970年起的纳秒数），包含
+	int64_t  m_nEndTime   { INT64_MAX };        // 结束时间（自1970年起的纳秒数），不包含
+	uint32_t m_nThreadId  { 0 };                // 线程号，0表示不限
+	std::string m_strFile;                      // 文件名包含该字符串，为空表示不限
+	std::string m_strFunction;                  // 函数名包含该字符串，为空表示不限
+	std::string m_strText;                      // 日志正文包含该字符串，为空表示不限
+	std::string m_strRegex;                     // 日志正文匹配该正则表达式（ECMAScript），为空表示不限
+};
+
+/* 读出的一条日志 */
+struct LogEntry
+{
+	LOGLEVEL         m_Level   { LOG_LEVEL_NONE };   // 日志等级，模式不含%l与%B时为LOG_LEVEL_NONE
+	int64_t          m_nTime   { 0 };                // 记录时间（纳秒），精度取决于写入时的时间精度，模式不含%t时为0
+	uint64_t         m_nOffset { 0 };                // 在文件中的起始位置
+	std::string_view m_strText;                      // 整条日志的原始字节，含分隔行与结尾的换行，读取器关闭或刷新后失效
+	uint32_t         m_nProcessId { 0 };             // 进程号
+	uint32_t         m_nThreadId  { 0 };             // 线程号
+	uint32_t         m_nLine      { 0 };             // 行号
+	std::string_view m_strFile;                      // 文件名
+	std::string_view m_strFunction;                  // 函数名
+	std::string_view m_strMessage;                   // 日志正文
+};
+
+/* 索引块 */
+struct LogIndexBlock
+{
+	uint64_t m_nOffset   { 0 };           // 块内第一条日志的起始位置
+	int64_t  m_nMinTime  { INT64_MAX };   // 块内最早的日志时间
+	int64_t  m_nMaxTime  { INT64_MIN };   // 块内最晚的日志时间
+	uint32_t m_nLevels   { 0 };           // 块内出现过的等级，第n位对应等级n
+	uint32_t m_nRecords  { 0 };           // 块内日志条数
+	uint64_t m_nThreads  { 0 };           // 块内出现过的线程号，第n位对应线程号除以64余n
+};
+
+/* 本地时间换算，同一小时内的日志只调用一次mktime */
+struct LogLocalTime
+{
+	int64_t m_nHour   { INT64_MIN };   // 缓存对应的本地时间小时数
+	int64_t m_nOffset { 0 };           // 本地时间减去UTC时间的秒数
+
+	/* 本地日期时间转为自1970年起的纳秒数 */
+	int64_t toTime(int _Year, int _Month, int _Day, int _Hour, int _Minute, int _Second, int64_t _Nanosecond);
+};
+
+/* 文本日志读取器，索引在首次查询时建立，之后的遍历只读取映射的内容 */
+class LogReader
+{
+public:
+	/* 查询结果的迭代器，逐条解析满足条件的日志 */
+	class Iterator
+	{
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type        = LogEntry;
+		using difference_type   = std::ptrdiff_t;
+		using pointer           = const LogEntry*;
+		using reference         = const LogEntry&;
+
+		Iterator() = default;
+
+		reference operator*() const noexcept { return m_Entry; }
+		pointer operator->() const noexcept { return &m_Entry; }
+		Iterator& operator++() { advance(); return *this; }
+		bool operator==(const Iterator& _Other) const noexcept { return m_pReader == _Other.m_pReader && (!m_pReader || m_nOffset == _Other.m_nOffset); }
+		bool operator!=(const Iterator& _Other) const noexcept { return !(*this == _Other); }
+
+	private:
+		friend class LogReader;
+		Iterator(const LogReader* _Reader, const LogQuery& _Query, std::shared_ptr<const std::regex> _Regex, size_t _BeginBlock, size_t _EndBlock);
+		/* 移到下一条满足条件的日志，没有时成为结束迭代器 */
+		void advance();
+
+		const LogReader* m_pReader    { nullptr };
+		LogQuery         m_Query;
+		std::shared_ptr<const std::regex> m_pRegex;   // 编译后的m_Query.m_strRegex
+		size_t           m_nBlock     { 0 };   // 当前索引块
+		size_t           m_nEndBlock  { 0 };   // 最后一个索引块之后
+		uint64_t         m_nOffset    { 0 };   // 下一条待解析日志的位置
+		uint64_t         m_nBlockEnd  { 0 };   // 当前索引块的结束位置
+		LogLocalTime     m_LocalTime;
+		LogEntry         m_Entry;
+	};
+
+	/* 查询结果，可用于范围for */
+	class Range
+	{
+	public:
+		Iterator begin() const { return Iterator(m_pReader, m_Query, m_pRegex, m_nBeginBlock, m_nEndBlock); }
+		Iterator end() const { return Iterator(); }
+
+	private:
+		friend class LogReader;
+		Range(const LogReader* _Reader, const LogQuery& _Query, std::shared_ptr<const std::regex> _Regex, size_t _BeginBlock, size_t _EndBlock)
+			: m_pReader(_Reader), m_Query(_Query), m_pRegex(std::move(_Regex)), m_nBeginBlock(_BeginBlock), m_nEndBlock(_EndBlock) {}
+
+		const LogReader* m_pReader;
+		LogQuery         m_Query;
+		std::shared_ptr<const std::regex> m_pRegex;
+		size_t           m_nBeginBlock;
+		size_t           m_nEndBlock;
+	};
+
+	LogReader() { setPattern(LOG_DEFAULT_PATTERN); }
+	explicit LogReader(const std::wstring& _Path) : LogReader() { open(_Path); }
+	~LogReader() { close(); }
+	LogReader(const LogReader&) = delete;
+	LogReader& operator=(const LogReader&) = delete;
+
+	/**
+	 * @brief 映射日志文件，之前打开的文件会被关闭
+	 *
+	 * @param _Path    日志文件路径
+	 * @return true    打开成功，空文件同样视为成功
+	 * @return false   文件不存在或无法映射
+	 */
+	bool open(const std::wstring& _Path);
+	/* 解除映射并清空索引 */
+	void close();
+	bool isOpen() const noexcept { return m_bOpen; }
+	/* 当前映射的字节数 */
+	uint64_t size() const noexcept { return m_nSize; }
+
+	/**
+	 * @brief 文件增长后重新映射，索引从上次结束的位置继续建立
+	 *
+	 * 之前返回的LogEntry与迭代器均失效
+	 *
+	 * @return true    重新映射成功
+	 */
+	bool refresh();
+
+	/**
+	 * @brief 设置写入文件时的输出模式，默认为LOG_DEFAULT_PATTERN，已建立的索引按新模式重新建立
+	 *
+	 * 模式以%B开头时日志从分隔行开始，以%B结尾时到相同的分隔行为止，否则到下一个分隔行为止。
+	 * 不含%B时日志从能按模式解析出正文之前部分的行开始，之后不能解析的行属于同一条日志；
+	 * 正文之前没有字段时每行为一条日志。文件名、函数名与线程名称以其后的文本为界。
+	 *
+	 * @param _Pattern    输出模式，说明符见Log::setPattern
+	 * @return false      无法据此划分日志，保持原来的模式：%B不在开头或结尾，文件名、函数名或线程名称之后
+	 *                    不是文本，或正文之后的部分不以文本开头
+	 */
+	bool setPattern(const std::string& _Pattern);
+
+	/**
+	 * @brief 查询满足条件的日志，首次查询时建立索引
+	 *
+	 * @param _Query    查询条件
+	 * @return 结果按在文件中的顺序逐条解析，正则表达式无效时抛出std::regex_error
+	 */
+	Range query(const LogQuery& _Query = LogQuery {});
+	/**
+	 * @brief 并行查询，满足条件的索引块分给多个线程扫描，结果按在文件中的顺序合并
+	 *
+	 * @param _Query      查询条件
+	 * @param _Threads    线程数，0表示使用全部核心
+	 * @return 满足条件的日志，正则表达式无效时抛出std::regex_error
+	 */
+	std::vector<LogEntry> search(const LogQuery& _Query, unsigned _Threads = 0);
+	/* 已建立的索引，首次查询前为空 */
+	const std::vector<LogIndexBlock>& index() const noexcept { return m_Index; }
+	/* 设置建立索引的最大线程数，0表示使用全部核心；每个线程仍至少处理LOG_READER_PARALLEL_BYTES字节 */
+	void setThreads(unsigned _Threads) noexcept { m_nThreads = _Threads; }
+
+private:
+	/* 由输出模式得到的日志结构 */
+	struct Layout
+	{
+		bool m_bBanner        { true };          // 日志以分隔行开头，否则从一行的开头开始
+		bool m_bClosingBanner { true };          // 日志以与开头相同的分隔行结尾
+		std::vector<LogPatternField> m_Header;   // 开头的分隔行之后、正文之前的字段
+		std::vector<LogPatternField> m_Footer;   // 正文之后、结尾的分隔行之前的字段
+	};
+
+	/**
+	 * @brief 解析_Offset处或其后的第一条完整日志
+	 *
+	 * @param _Offset       IN/OUT 开始查找的位置，返回时为该日志之后的位置
+	 * @param _Limit        日志须在该位置之前开始
+	 * @param _LocalTime    本地时间换算缓存
+	 * @param _Entry        OUT 解析结果
+	 * @return 是否找到完整的日志，最后一条写了一半的日志视为不存在
+	 */
+	bool parseRecord(uint64_t& _Offset, uint64_t _Limit, LogLocalTime& _LocalTime, LogEntry& _Entry) const;
+	/* 以分隔行划分的日志，参数同parseRecord */
+	bool parseBannerRecord(uint64_t& _Offset, uint64_t _Limit, LogLocalTime& _LocalTime, LogEntry& _Entry) const;
+	/* 从一行开头开始的日志，参数同parseRecord */
+	bool parseLineRecord(uint64_t& _Offset, uint64_t _Limit, LogLocalTime& _LocalTime, LogEntry& _Entry) const;
+	/* 位于行首的_Pos处能否解析出正文之前的部分 */
+	bool isLineStart(size_t _Pos, LogLocalTime& _LocalTime) const;
+	/**
+	 * @brief 解析去掉分隔行后的一条日志，设置等级以外的字段
+	 *
+	 * @return 正文之前的部分是否与模式一致；正文之后的部分不一致时整体视为正文
+	 */
+	bool parseContent(std::string_view _Content, LogLocalTime& _LocalTime, LogEntry& _Entry) const;
+	/* 由输出模式得到日志结构，无法据此划分日志时返回false */
+	static bool makeLayout(const std::string& _Pattern, Layout& _Layout);
+	/**
+	 * @brief 在原始字节中查找正文包含的字符串，跳到可能包含它的那条日志
+	 *
+	 * @param _Offset    IN/OUT 开始查找的位置，返回时为包含该字符串的日志的开头
+	 * @param _Limit     查找的结束位置
+	 * @param _Text      查找的字符串
+	 * @return 是否找到，找不到时_Offset置为_Limit
+	 */
+	bool seekText(uint64_t& _Offset, uint64_t _Limit, std::string_view _Text) const;
+	/* 从m_nIndexed开始为新增的内容建立索引，大文件分段并行 */
+	void buildIndex();
+	/**
+	 * @brief 为开头位于[_Begin, _End)的日志建立索引
+	 *
+	 * @param _Index    OUT 索引块
+	 * @return 最后一条完整日志之后的位置，没有日志时返回0
+	 */
+	uint64_t indexRange(uint64_t _Begin, uint64_t _End, std::vector<LogIndexBlock>& _Index) const;
+	/* 索引块是否可能包含满足条件的日志 */
+	static bool blockMatches(const LogIndexBlock& _Block, const LogQuery& _Query) noexcept;
+	/* 日志是否满足条件 */
+	static bool entryMatches(const LogEntry& _Entry, const LogQuery& _Query, const std::regex* _Regex);
+	/* 确保已建立索引，并编译查询中的正则表达式 */
+	std::shared_ptr<const std::regex> prepare(const LogQuery& _Query);
+	bool map();
+	void unmap();
+	/* 映射的内容为gzip时解压到m_strInflated并解除映射 */
+	bool inflate();
+
+	std::wstring               m_wstrPath;
+	bool                       m_bOpen    { false };
+	const char*                m_pData    { nullptr };   // 映射的内容
+	uint64_t                   m_nSize    { 0 };         // 映射的字节数
+	std::string                m_strInflated;            // 压缩文件解压后的内容，m_pData指向其中
+	uint64_t                   m_nIndexed { 0 };         // 已建立索引的位置
+	bool                       m_bIndexed { false };     // 是否已建立索引
+	unsigned                   m_nThreads { 0 };         // 建立索引的最大线程数，0表示全部核心
+	Layout                     m_Layout;                 // 写入时的输出模式对应的结构
+	std::vector<LogIndexBlock> m_Index;
+#ifdef _WIN32
+	void*                      m_hFile    { nullptr };
+	void*                      m_hMapping { nullptr };
+#endif // _WIN32
+};
+
+#endif // _LOG_READER_HPP_
@@ -0,0 +1,234 @@
+/**
+ * @file log_sink.hpp
+ * @author ldk
+ * @brief 可注册的日志输出目标
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * 通过Log::addSink注册的输出目标与LOGTARGET指定的命令行、文件并列。每条日志只格式化一次并转为UTF-8，
+ * 由各目标共享；每个目标有独立的等级、队列与线程，慢速目标的队列满时只丢弃该目标的日志，不影响其它输出。
+ * LOG_KV的结构化日志为一行JSON或logfmt，设置setStructuredOnly的目标只接收这类日志。
+ * LogNetworkSink通过TCP或UDP发送到远端收集器，Windows下不支持。
+ */
+
+#ifndef _LOG_SINK_HPP_
+#define _LOG_SINK_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "log.hpp"
+
+/* 输出目标接口 */
+class LogSink
+{
+public:
+	virtual ~LogSink() = default;
+
+	/**
+	 * @brief 输出一条日志，在该目标的线程中依次调用
+	 *
+	 * @param _LogLevel    日志等级
+	 * @param _Log         UTF-8编码的完整日志，含首尾分隔行；结构化日志为以换行结尾的一行
+	 */
+	virtual void write(LOGLEVEL _LogLevel, const std::string& _Log) = 0;
+	/* 将缓冲的日志写出，队列空闲约1秒、Log::Flush或移除目标时调用 */
+	virtual void flush() {}
+
+	/* 获取该目标的日志等级，只输出该等级及更严重的日志 */
+	LOGLEVEL getLevel() const noexcept { return m_Level.load(std::memory_order_relaxed); }
+	/* 设置该目标的日志等级，严于Log::setLogLevel时才有效果 */
+	void setLevel(LOGLEVEL _LogLevel) noexcept { m_Level.store(_LogLevel, std::memory_order_relaxed); }
+	/* 因队列已满丢弃的日志数 */
+	uint64_t getDroppedCount() const noexcept { return m_nDroppedCount.load(std::memory_order_relaxed); }
+	/* 是否只接收LOG_KV的结构化日志 */
+	bool isStructuredOnly() const noexcept { return m_bStructuredOnly.load(std::memory_order_relaxed); }
+	/* 设置为只接收LOG_KV的结构化日志，如以LogFileSink输出JSON行文件 */
+	void setStructuredOnly(bool _StructuredOnly) noexcept { m_bStructuredOnly.store(_StructuredOnly, std::memory_order_relaxed); }
+	/* 交给write的字节数 */
+	uint64_t getBytesWritten() const noexcept { return m_nBytesWritten.load(std::memory_order_relaxed); }
+
+private:
+	friend class LogSinkWorker;
+
+	std::atomic<LOGLEVEL> m_Level         { LOG_LEVEL_INFO };
+	std::atomic<uint64_t> m_nDroppedCount { 0 };
+	std::atomic<uint64_t> m_nBytesWritten { 0 };
+	std::atomic<bool>     m_bStructuredOnly { false };
+};
+
+/* 输出到文件描述符，默认为标准输出 */
+class LogConsoleSink : public LogSink
+{
+public:
+	explicit LogConsoleSink(int _Fd = 1) : m_nFd(_Fd) {}
+	void write(LOGLEVEL _LogLevel, const std::string& _Log) override;
+
+private:
+	int m_nFd;
+};
+
+/* 输出到文件，缓冲、刷新、滚动与压缩与LOG_TARGET_FILE相同 */
+class LogFileSink : public LogSink
+{
+public:
+	explicit LogFileSink(const std::wstring& _Path, const LogFlushPolicy& _Policy = LogFlushPolicy {}, const LogRotatePolicy& _Rotate = LogRotatePolicy {},
+		const LogCompressPolicy& _Compress = LogCompressPolicy {});
+	~LogFileSink() override;
+	void write(LOGLEVEL _LogLevel, const std::string& _Log) override;
+	void flush() override;
+
+private:
+	std::unique_ptr<LogFile> m_pFile;
+	LogFlushPolicy           m_FlushPolicy;
+	LogRotatePolicy          m_RotatePolicy;
+};
+
+/* 异步文件目标实际使用的写入方式 */
+enum LOGAIOBACKEND
+{
+	LOG_AIO_SYNC,              // 同步pwrite，io_uring不可用时使用
+	LOG_AIO_IO_URING,          // io_uring，缓冲区注册失败（如超出RLIMIT_MEMLOCK）
+	LOG_AIO_IO_URING_FIXED,    // io_uring，使用预先注册的缓冲区
+	LOG_AIO_OVERLAPPED         // Windows重叠I/O
+};
+
+/* 异步I/O文件，定义见log_aio.cpp */
+class LogAioFile;
+
+/**
+ * 以异步I/O批量写入文件，适用于日志量很大的场景
+ *
+ * 日志拷贝进固定大小的缓冲区池，写满一块即提交给内核，写入完成后缓冲区回到池中，输出线程不等待磁盘。
+ * 文件按打开时的长度继续写入，不支持滚动，也不应与其他进程同时追加同一文件。
+ */
+class LogAsyncFileSink : public LogSink
+{
+public:
+	/**
+	 * @brief 打开文件并建立缓冲区池
+	 *
+	 * @param _Path           文件路径
+	 * @param _BufferSize     每块缓冲区的字节数
+	 * @param _BufferCount    缓冲区数，即同时写入中的最大块数
+	 */
+	explicit LogAsyncFileSink(const std::wstring& _Path, size_t _BufferSize = 1024 * 1024, size_t _BufferCount = 8);
+	~LogAsyncFileSink() override;
+	void write(LOGLEVEL _LogLevel, const std::string& _Log) override;
+	/* 提交未写满的缓冲区并等待所有写入完成 */
+	void flush() override;
+
+	bool isOpen() const noexcept;
+	/* 实际使用的写入方式 */
+	LOGAIOBACKEND getBackend() const noexcept;
+	/* 写入失败的缓冲区数 */
+	uint64_t getErrorCount() const noexcept;
+
+private:
+	std::unique_ptr<LogAioFile> m_pFile;
+};
+
+/* 在内存中保留最近的若干条日志，供诊断接口等读取 */
+class LogMemorySink : public LogSink
+{
+public:
+	explicit LogMemorySink(size_t _Capacity = 1024) : m_nCapacity(_Capacity) {}
+	void write(LOGLEVEL _LogLevel, const std::string& _Log) override;
+	/* 按时间顺序拷贝保留的日志 */
+	std::vector<std::string> snapshot() const;
+
+private:
+	size_t                  m_nCapacity;
+	mutable std::mutex      m_Mutex;
+	std::deque<std::string> m_Logs;
+};
+
+#ifndef _WIN32
+/* 网络输出的传输协议 */
+enum LOGNETPROTOCOL
+{
+	LOG_NET_TCP,    // 日志依次写入连接，批量以一次sendmsg发送
+	LOG_NET_UDP     // 每条日志一个数据报，Linux下以sendmmsg批量发送，超过数据报大小的日志被丢弃
+};
+
+/* 网络输出的批量发送、重连与缓冲策略 */
+struct LogNetworkPolicy
+{
+	LOGNETPROTOCOL m_Protocol          { LOG_NET_TCP };
+	size_t         m_nBatchBytes       { 64 * 1024 };          // 待发送的日志达到该字节数时发送
+	uint32_t       m_nBatchIntervalMs  { 100 };                // 距上次发送超过该时间（毫秒）时发送，队列空闲时由flush发送
+	size_t         m_nBufferBytes      { 16 * 1024 * 1024 };   // 未能发送的日志在内存中保留的最大字节数
+	std::wstring   m_wstrSpillFile;                            // 内存已满时最早的日志移入该文件，连接恢复后先发送，为空时丢弃
+	uint32_t       m_nConnectTimeoutMs { 3000 };               // 连接超时（毫秒）
+	uint32_t       m_nSendTimeoutMs    { 5000 };               // 发送超时（毫秒），超时视为连接断开
+	uint32_t       m_nRetryMs          { 500 };                // 首次重连的间隔（毫秒），连续失败时加倍
+	uint32_t       m_nMaxRetryMs       { 30000 };              // 重连间隔的上限（毫秒）
+};
+
+/* 网络连接与待发送的日志，定义见log_net.cpp */
+class LogNetClient;
+
+/**
+ * 将日志发送到远端收集器，替代逐行读取日志文件再转发的方式
+ *
+ * 日志在该目标的输出线程中累积，达到批量大小或间隔时一次发送。连接断开时日志保留在内存中，
+ * 按间隔重连，内存已满时移入溢出文件或丢弃最早的日志；发送阻塞时该目标的队列写满，
+ * 之后的日志计入getDroppedCount，不阻塞写日志的线程。TCP连接断开时写了一半的日志在重连后整条重发。
+ * 析构时未发送的日志写入溢出文件，下次以同一溢出文件创建目标时继续发送。
+ */
+class LogNetworkSink : public LogSink
+{
+public:
+	/**
+	 * @brief 创建目标，首次发送时连接
+	 *
+	 * @param _Host      收集器的主机名或地址
+	 * @param _Port      端口
+	 * @param _Policy    发送策略
+	 */
+	LogNetworkSink(const std::string& _Host, uint16_t _Port, const LogNetworkPolicy& _Policy = LogNetworkPolicy {});
+	~LogNetworkSink() override;
+	void write(LOGLEVEL _LogLevel, const std::string& _Log) override;
+	/* 发送所有待发送的日志，连接断开且未到重连时间时保留 */
+	void flush() override;
+
+	bool isConnected() const noexcept;
+	/* 已发送的日志数 */
+	uint64_t getSentCount() const noexcept;
+	/* 移入溢出文件的日志数 */
+	uint64_t getSpilledCount() const noexcept;
+	/* 因内存已满或数据报过大丢弃的日志数 */
+	uint64_t getDiscardedCount() const noexcept;
+	/* 建立连接的次数，含重连 */
+	uint64_t getConnectCount() const noexcept;
+
+private:
+	std::unique_ptr<LogNetClient> m_pClient;
+};
+
+/* syslog设施LOG_USER，与<syslog.h>中的值相同；本头文件不包含<syslog.h>，其LOG_INFO、LOG_DEBUG等宏易与使用者的名称冲突 */
+constexpr int LOG_SYSLOG_FACILITY_USER { 1 << 3 };
+
+/* 输出到syslog，去掉按输出模式写入的首尾分隔行，等级映射为对应的syslog优先级 */
+class LogSyslogSink : public LogSink
+{
+public:
+	/**
+	 * @brief 调用openlog
+	 *
+	 * @param _Ident       标识，须在目标存续期间有效，为空时使用程序名
+	 * @param _Facility    syslog设施，默认为LOG_USER
+	 */
+	explicit LogSyslogSink(const char* _Ident = nullptr, int _Facility = LOG_SYSLOG_FACILITY_USER);
+	~LogSyslogSink() override;
+	void write(LOGLEVEL _LogLevel, const std::string& _Log) override;
+};
+#endif // _WIN32
+
+#endif // _LOG_SINK_HPP_
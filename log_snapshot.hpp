@@ -0,0 +1,223 @@
+/**
+ * @file log_snapshot.hpp
+ * @author ldk
+ * @brief 以原子指针发布的只读快照，替换后的旧快照在没有线程使用时释放
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * 每种类型一份快照。线程缓存最近读取的快照，并在自己的登记槽中写下其地址，
+ * 快照未替换时读取只有一次原子读与一次比较。替换时扫描各线程的登记槽，未被登记的旧快照立即释放，
+ * 其余留到之后的替换再检查；每个线程最多保留一份旧快照，占用的内存不随替换次数增长。
+ * 同一线程嵌套读取时沿用最外层读取的快照，外层持有的引用不会因嵌套读取而释放。
+ */
+
+#ifndef _LOG_SNAPSHOT_HPP_
+#define _LOG_SNAPSHOT_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+template<typename T>
+class LogSnapshot
+{
+	/* 快照及其代数，代数从1开始，每次替换加1 */
+	struct Node
+	{
+		T        m_Value;
+		uint64_t m_nGeneration;
+	};
+
+	/* 线程的登记槽，线程退出后由之后的线程复用，不释放 */
+	struct Slot
+	{
+		std::atomic<Node*> m_pNode { nullptr };   // 该线程正在使用的快照
+		std::atomic<bool>  m_bUsed { true };      // 是否属于某个线程
+		Slot*              m_pNext { nullptr };
+	};
+
+	/* 全局状态，不释放，线程退出与静态对象析构时仍可访问 */
+	struct State
+	{
+		std::atomic<Node*> m_pCurrent    { new Node { T {}, 1 } };
+		std::atomic<Slot*> m_pSlots      { nullptr };
+		std::mutex         m_Mutex;               // 替换互斥
+		std::vector<Node*> m_Retired;             // 已替换但仍被登记的快照，由m_Mutex保护
+		uint64_t           m_nGeneration { 1 };   // 最新快照的代数，由m_Mutex保护
+	};
+
+	/**
+	 * 线程对快照的缓存
+	 *
+	 * 可平凡析构，线程退出时不析构，其他线程局部对象析构时仍可读取；登记槽由LeaseGuard在线程退出时归还
+	 */
+	struct Lease
+	{
+		Node*  m_pNode   { nullptr };
+		Slot*  m_pSlot   { nullptr };
+		size_t m_nDepth  { 0 };       // 嵌套读取的层数
+		bool   m_bExited { false };   // LeaseGuard已析构，之后的读取在最外层结束时归还登记槽
+
+		Node* enter(State& _State)
+		{
+			if (m_nDepth++ && m_pNode)
+				return m_pNode;
+			Node* node = _State.m_pCurrent.load(std::memory_order_acquire);
+			if (node != m_pNode)
+				node = pin(_State, node);
+			return node;
+		}
+
+		void leave() noexcept
+		{
+			if (!--m_nDepth && m_bExited)
+				release();
+		}
+
+		/* 登记_Node后确认其仍为当前快照，此后替换的线程扫描时必然看到该登记 */
+		Node* pin(State& _State, Node* _Node)
+		{
+			if (!m_pSlot)
+				m_pSlot = acquireSlot(_State);
+			for (;;)
+			{
+				m_pSlot->m_pNode.store(_Node, std::memory_order_seq_cst);
+				Node* current = _State.m_pCurrent.load(std::memory_order_seq_cst);
+				if (current == _Node)
+					break;
+				_Node = current;
+			}
+			m_pNode = _Node;
+			return _Node;
+		}
+
+		void release() noexcept
+		{
+			if (!m_pSlot)
+				return;
+			m_pSlot->m_pNode.store(nullptr, std::memory_order_release);
+			m_pSlot->m_bUsed.store(false, std::memory_order_release);
+			m_pSlot = nullptr;
+			m_pNode = nullptr;
+		}
+	};
+
+	/* 线程退出时归还该线程的登记槽 */
+	struct LeaseGuard
+	{
+		~LeaseGuard()
+		{
+			Lease& lease = LogSnapshot::lease();
+			if (!lease.m_nDepth)
+				lease.release();
+			lease.m_bExited = true;
+		}
+	};
+
+public:
+	/**
+	 * @brief 读取当前快照，对象存续期间快照不会释放
+	 *
+	 * 同一线程嵌套读取时沿用最外层的快照；线程第一次读取时登记，可能分配内存
+	 */
+	class Reader
+	{
+	public:
+		Reader() : m_Lease(lease()), m_pNode(m_Lease.enter(state())) {}
+		~Reader() { m_Lease.leave(); }
+		Reader(const Reader&) = delete;
+		Reader& operator=(const Reader&) = delete;
+
+		const T& operator*() const noexcept { return m_pNode->m_Value; }
+		const T* operator->() const noexcept { return &m_pNode->m_Value; }
+		/* 快照的代数，内容相同的快照也不相同 */
+		uint64_t generation() const noexcept { return m_pNode->m_nGeneration; }
+
+	private:
+		Lease& m_Lease;
+		Node*  m_pNode;
+	};
+
+	/**
+	 * @brief 读取当前快照，与release成对调用，语义同Reader
+	 *
+	 * 供只见到T的前向声明、无法构造Reader的代码在定义T的源文件中封装使用，须在同一线程调用release
+	 */
+	static const T& acquire() { return lease().enter(state())->m_Value; }
+	/* 结束acquire开始的读取 */
+	static void release() noexcept { lease().leave(); }
+
+	/* 发布新快照，释放不再被任何线程登记的旧快照 */
+	static void publish(T _Value)
+	{
+		State& state = LogSnapshot::state();
+		std::scoped_lock<std::mutex> lock(state.m_Mutex);
+		Node* node = new Node { std::move(_Value), ++state.m_nGeneration };
+		state.m_Retired.push_back(state.m_pCurrent.exchange(node, std::memory_order_seq_cst));
+
+		std::vector<Node*> pinned;
+		for (Slot* slot = state.m_pSlots.load(std::memory_order_acquire); slot; slot = slot->m_pNext)
+		{
+			if (Node* pNode = slot->m_pNode.load(std::memory_order_seq_cst))
+				pinned.push_back(pNode);
+		}
+		auto end = std::remove_if(state.m_Retired.begin(), state.m_Retired.end(), [&pinned](Node* _Node)
+		{
+			if (std::find(pinned.begin(), pinned.end(), _Node) != pinned.end())
+				return false;
+			delete _Node;
+			return true;
+		});
+		state.m_Retired.erase(end, state.m_Retired.end());
+	}
+
+	/* 已替换但仍被线程使用、尚未释放的旧快照数 */
+	static size_t retiredCount()
+	{
+		State& state = LogSnapshot::state();
+		std::scoped_lock<std::mutex> lock(state.m_Mutex);
+		return state.m_Retired.size();
+	}
+
+private:
+	static State& state()
+	{
+		static State* pState = new State;
+		return *pState;
+	}
+
+	static Lease& lease()
+	{
+		static_assert(std::is_trivially_destructible_v<Lease>, "Lease must stay readable during thread exit");
+		thread_local Lease lease;
+		// 第一次读取时构造，线程退出时析构；此后lease仍有效，读取的线程重新登记并在最外层结束时归还
+		thread_local LeaseGuard guard;
+		return lease;
+	}
+
+	/* 复用已退出线程的登记槽，没有时新建 */
+	static Slot* acquireSlot(State& _State)
+	{
+		for (Slot* slot = _State.m_pSlots.load(std::memory_order_acquire); slot; slot = slot->m_pNext)
+		{
+			bool bUsed = false;
+			if (!slot->m_bUsed.load(std::memory_order_relaxed)
+				&& slot->m_bUsed.compare_exchange_strong(bUsed, true, std::memory_order_acquire))
+				return slot;
+		}
+		Slot* slot = new Slot;
+		slot->m_pNext = _State.m_pSlots.load(std::memory_order_relaxed);
+		while (!_State.m_pSlots.compare_exchange_weak(slot->m_pNext, slot, std::memory_order_release, std::memory_order_relaxed))
+			;
+		return slot;
+	}
+};
+
+#endif // _LOG_SNAPSHOT_HPP_
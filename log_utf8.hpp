@@ -0,0 +1,145 @@
+/**
+ * @file log_utf8.hpp
+ * @author ldk
+ * @brief 宽字符与UTF-8之间的转换，不依赖区域设置
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef _LOG_UTF8_HPP_
+#define _LOG_UTF8_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief 宽字符串编码为UTF-8后追加
+ *
+ * wchar_t为2字节时按UTF-16处理代理对，无效的码点以U+FFFD代替
+ *
+ * @param _Out     OUT 输出
+ * @param _Data    宽字符串
+ * @param _Size    宽字符个数
+ * @param _Max     最多编码的字符个数
+ */
+inline void LogAppendUtf8(std::string& _Out, const wchar_t* _Data, size_t _Size, size_t _Max = static_cast<size_t>(-1))
+{
+	size_t nCount = 0;
+	for (size_t i = 0; i < _Size && nCount < _Max; ++i, ++nCount)
+	{
+		uint32_t code = static_cast<uint32_t>(_Data[i]);
+		if (sizeof(wchar_t) == 2 && code >= 0xD800 && code <= 0xDBFF && i + 1 < _Size)
+		{
+			const uint32_t low = static_cast<uint32_t>(_Data[i + 1]);
+			if (low >= 0xDC00 && low <= 0xDFFF)
+			{
+				code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+				++i;
+			}
+		}
+		if ((code >= 0xD800 && code <= 0xDFFF) || code > 0x10FFFF)
+			code = 0xFFFD;
+
+		if (code < 0x80)
+		{
+			_Out.push_back(static_cast<char>(code));
+		}
+		else if (code < 0x800)
+		{
+			_Out.push_back(static_cast<char>(0xC0 | (code >> 6)));
+			_Out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+		}
+		else if (code < 0x10000)
+		{
+			_Out.push_back(static_cast<char>(0xE0 | (code >> 12)));
+			_Out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+			_Out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+		}
+		else
+		{
+			_Out.push_back(static_cast<char>(0xF0 | (code >> 18)));
+			_Out.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+			_Out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+			_Out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+		}
+	}
+}
+
+/* 同上，宽字符串以'\0'结尾 */
+inline void LogAppendUtf8(std::string& _Out, const wchar_t* _Data)
+{
+	size_t nSize = 0;
+	while (_Data[nSize])
+		++nSize;
+	LogAppendUtf8(_Out, _Data, nSize);
+}
+
+/**
+ * @brief UTF-8字符串解码为宽字符后追加
+ *
+ * wchar_t为2字节时超出BMP的字符编码为代理对，无效的字节序列以U+FFFD代替
+ *
+ * @param _Out     OUT 输出
+ * @param _Data    UTF-8字符串
+ * @param _Size    字节数
+ */
+inline void LogAppendWide(std::wstring& _Out, const char* _Data, size_t _Size)
+{
+	for (size_t i = 0; i < _Size;)
+	{
+		const unsigned char lead = static_cast<unsigned char>(_Data[i]);
+		size_t nCount = 0;
+		uint32_t code = 0;
+		if (lead < 0x80)
+		{
+			code = lead;
+		}
+		else if (lead >= 0xC2 && lead < 0xE0)
+		{
+			nCount = 1;
+			code = lead & 0x1F;
+		}
+		else if (lead >= 0xE0 && lead < 0xF0)
+		{
+			nCount = 2;
+			code = lead & 0x0F;
+		}
+		else if (lead >= 0xF0 && lead < 0xF5)
+		{
+			nCount = 3;
+			code = lead & 0x07;
+		}
+		else
+		{
+			_Out.push_back(static_cast<wchar_t>(0xFFFD));
+			++i;
+			continue;
+		}
+
+		size_t n = 1;
+		for (; n <= nCount && i + n < _Size && (static_cast<unsigned char>(_Data[i + n]) & 0xC0) == 0x80; ++n)
+			code = (code << 6) | (static_cast<unsigned char>(_Data[i + n]) & 0x3F);
+		// 截断的序列、过长编码与代理区码点均视为无效
+		static constexpr uint32_t minimum[] = { 0, 0x80, 0x800, 0x10000 };
+		if (n <= nCount || code < minimum[nCount] || (code >= 0xD800 && code <= 0xDFFF) || code > 0x10FFFF)
+			code = 0xFFFD;
+		i += n;
+
+		if (sizeof(wchar_t) == 2 && code >= 0x10000)
+		{
+			code -= 0x10000;
+			_Out.push_back(static_cast<wchar_t>(0xD800 + (code >> 10)));
+			_Out.push_back(static_cast<wchar_t>(0xDC00 + (code & 0x3FF)));
+		}
+		else
+		{
+			_Out.push_back(static_cast<wchar_t>(code));
+		}
+	}
+}
+
+#endif // _LOG_UTF8_HPP_
@@ -0,0 +1,85 @@
+/**
+ * @file log_test.hpp
+ * @author ldk
+ * @brief 测试共用的检查宏与文件工具
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * 每个测试为一个可执行文件，由ctest运行；检查失败时打印位置并继续，main以logTestResult()的返回值退出。
+ * Log为进程内唯一的静态对象，同一可执行文件中的各用例依次运行，各自使用独立的目录与文件。
+ */
+
+#ifndef _LOG_TEST_HPP_
+#define _LOG_TEST_HPP_
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/* 失败的检查数 */
+inline int& logTestFailures()
+{
+	static int nFailures = 0;
+	return nFailures;
+}
+
+/* 检查失败时打印位置，不中止测试 */
+#define LOG_CHECK(expr)\
+	do { if (!(expr)) { ++logTestFailures(); fprintf(stderr, "%s:%d: LOG_CHECK(%s) failed\n", __FILE__, __LINE__, #expr); } } while (0)
+
+/* 同上，打印两侧的值 */
+#define LOG_CHECK_EQ(lhs, rhs)\
+	do {\
+		const auto& logTestLhs = (lhs);\
+		const auto& logTestRhs = (rhs);\
+		if (!(logTestLhs == logTestRhs))\
+		{\
+			++logTestFailures();\
+			std::ostringstream logTestStream;\
+			logTestStream << logTestLhs << " != " << logTestRhs;\
+			fprintf(stderr, "%s:%d: LOG_CHECK_EQ(%s, %s) failed: %s\n", __FILE__, __LINE__, #lhs, #rhs, logTestStream.str().c_str());\
+		}\
+	} while (0)
+
+/* 打印结果，作为main的返回值 */
+inline int logTestResult()
+{
+	if (logTestFailures())
+		fprintf(stderr, "%d check(s) failed\n", logTestFailures());
+	return logTestFailures() ? 1 : 0;
+}
+
+/* 清空并创建测试用的临时目录 */
+inline std::filesystem::path logTestDir(const std::string& _Name)
+{
+	const std::filesystem::path path = std::filesystem::temp_directory_path() / ("log_test_" + _Name);
+	std::error_code error;
+	std::filesystem::remove_all(path, error);
+	std::filesystem::create_directories(path);
+	return path;
+}
+
+/* 读取整个文件，不存在时为空 */
+inline std::string logTestReadFile(const std::filesystem::path& _Path)
+{
+	std::ifstream input(_Path, std::ios::binary);
+	return std::string((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+}
+
+/* 按行读取文件 */
+inline std::vector<std::string> logTestReadLines(const std::filesystem::path& _Path)
+{
+	std::vector<std::string> lines;
+	std::ifstream input(_Path, std::ios::binary);
+	for (std::string strLine; std::getline(input, strLine);)
+		lines.push_back(strLine);
+	return lines;
+}
+
+#endif // _LOG_TEST_HPP_
@@ -0,0 +1,88 @@
+/**
+ * @file test_alloc.cpp
+ * @author ldk
+ * @brief 预热后写日志不分配内存：同步、异步与延迟格式化模式，宽字符与UTF-8编码；获取实例不分配内存
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "log.hpp"
+#include "log_test.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+/* 替换全局operator new以统计分配次数 */
+static std::atomic<long> g_nAllocations { 0 };
+
+void* operator new(size_t _Size)
+{
+	g_nAllocations.fetch_add(1, std::memory_order_relaxed);
+	void* p = malloc(_Size ? _Size : 1);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+void operator delete(void* _Ptr) noexcept { free(_Ptr); }
+void operator delete(void* _Ptr, size_t) noexcept { free(_Ptr); }
+
+/* 超出短字符串优化长度的参数，在统计之前构造 */
+static const std::string g_strText = "a string that is long enough to avoid sso";
+
+static void writeRecords(int _Count)
+{
+	for (int i = 0; i < _Count; ++i)
+	{
+#ifdef CPP20
+		LOG(LOG_LEVEL_INFO, "i=%d s=%s f=%.3f", i, g_strText, i * 0.25);
+#else
+		// C++17下参数经过C的可变参数列表，字符串须以const char*传入
+		LOG(LOG_LEVEL_INFO, "i=%d s=%s f=%.3f", i, g_strText.c_str(), i * 0.25);
+#endif // CPP20
+		Log::writeLog(LOG_LEVEL_INFO, L"f.cpp", L"fn", 1, "v %d %s", i, "x");
+	}
+}
+
+/* 第一轮建立线程队列、缓冲区与文件，第二轮不应再分配 */
+static void testMode(const std::filesystem::path& _Dir, LOGMODE _Mode, LOGENCODING _Encoding)
+{
+	const std::filesystem::path path = _Dir / ("alloc_" + std::to_string(_Mode) + "_" + std::to_string(_Encoding) + ".txt");
+	Log::setEncoding(_Encoding);
+	LOG_INIT(LOG_LEVEL_INFO, LOG_TARGET_FILE, path.wstring(), _Mode);
+	writeRecords(20000);
+	Log::Flush();
+
+	const long nBefore = g_nAllocations.load(std::memory_order_relaxed);
+	writeRecords(20000);
+	Log::Flush();
+	const long nAfter = g_nAllocations.load(std::memory_order_relaxed);
+	LOG_CHECK_EQ(nAfter - nBefore, 0L);
+	Log::Shutdown();
+}
+
+/* 首次调用后Instance只检查是否已初始化，不再读取配置 */
+static void testInstance()
+{
+	const std::shared_ptr<Log>& instance = Log::Instance();
+	LOG_CHECK(instance != nullptr);
+	const long nBefore = g_nAllocations.load(std::memory_order_relaxed);
+	for (int i = 0; i < 1000; ++i)
+		LOG_CHECK(&Log::Instance() == &instance);
+	LOG_CHECK_EQ(g_nAllocations.load(std::memory_order_relaxed) - nBefore, 0L);
+}
+
+int main()
+{
+	const std::filesystem::path dir = logTestDir("alloc");
+	for (LOGENCODING encoding : { LOG_ENCODING_WIDE, LOG_ENCODING_UTF8 })
+	{
+		testMode(dir, LOG_MODE_SYNC, encoding);
+		testMode(dir, LOG_MODE_ASYNC, encoding);
+		testMode(dir, LOG_MODE_DEFERRED, encoding);
+	}
+	testInstance();
+	return logTestResult();
+}
@@ -0,0 +1,54 @@
+/**
+ * @file test_clock.cpp
+ * @author ldk
+ * @brief 时间戳计数器时钟：选择时完成测量，跨过每秒的校准后同一线程的时间不倒退
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "log.hpp"
+#include "log_test.hpp"
+#include <chrono>
+
+/* 同一线程以纳秒精度连续写日志超过一次校准周期，时间按字符串比较不递减 */
+static void testMonotonic(const std::filesystem::path& _Dir)
+{
+	const std::filesystem::path path = _Dir / "clock.txt";
+	Log::setClockSource(LOG_CLOCK_TSC);
+	LOG_CHECK(Log::getClockSource() == LOG_CLOCK_TSC || Log::getClockSource() == LOG_CLOCK_SYSTEM);
+	LOG_INIT(LOG_LEVEL_INFO, LOG_TARGET_FILE, path.wstring(), LOG_MODE_SYNC);
+
+	const auto tBegin = std::chrono::steady_clock::now();
+	int nRecords = 0;
+	while (std::chrono::steady_clock::now() - tBegin < std::chrono::milliseconds(1300))
+	{
+		LOG(LOG_LEVEL_INFO, "n=%d", nRecords++);
+		const auto tNext = std::chrono::steady_clock::now() + std::chrono::microseconds(20);
+		while (std::chrono::steady_clock::now() < tNext)
+			;
+	}
+	Log::Flush();
+
+	// "2026-10-14 07:16:05.123456789 n=0"
+	const std::vector<std::string> lines = logTestReadLines(path);
+	LOG_CHECK_EQ(lines.size(), static_cast<size_t>(nRecords));
+	bool bMonotonic = !lines.empty();
+	for (size_t i = 1; bMonotonic && i < lines.size(); ++i)
+		bMonotonic = lines[i].substr(0, 29) >= lines[i - 1].substr(0, 29);
+	LOG_CHECK(bMonotonic);
+	Log::setClockSource(LOG_CLOCK_SYSTEM);
+	LOG_CHECK(Log::getClockSource() == LOG_CLOCK_SYSTEM);
+}
+
+int main()
+{
+	Log::setEncoding(LOG_ENCODING_UTF8);
+	Log::setPattern("%t %m");
+	Log::setTimePrecision(LOG_TIME_NANOSECOND);
+	testMonotonic(logTestDir("clock"));
+	Log::Shutdown();
+	return logTestResult();
+}
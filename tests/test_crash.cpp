@@ -0,0 +1,200 @@
+/**
+ * @file test_crash.cpp
+ * @author ldk
+ * @brief 崩溃保护缓冲区：取出未写入部分、覆盖后重新同步、被杀死后恢复、信号与栈溢出时写出
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "log.hpp"
+#include "log_crash.hpp"
+#include "log_test.hpp"
+#include <csignal>
+#include <new>
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif // _WIN32
+
+/* 在内存中构造缓冲区文件，数据区依次写入_Data，其中最后_Pending字节未写入日志文件 */
+static std::string makeCrashFile(size_t _Capacity, const std::string& _Data, size_t _Pending)
+{
+	std::string strFile(LOG_CRASH_HEADER_SIZE + _Capacity, '\0');
+	LogCrashHeader* header = new (strFile.data()) LogCrashHeader {};
+	memcpy(header->m_szMagic, LOG_CRASH_MAGIC, sizeof LOG_CRASH_MAGIC);
+	header->m_nVersion = LOG_CRASH_VERSION;
+	header->m_nCapacity = _Capacity;
+	const std::string strPath = "/tmp/Log.txt";
+	memcpy(header->m_szPath, strPath.data(), strPath.size());
+	header->m_nPathSize = static_cast<uint32_t>(strPath.size());
+	for (size_t i = 0; i < _Data.size(); ++i)
+		strFile[LOG_CRASH_HEADER_SIZE + i % _Capacity] = _Data[i];
+	header->m_nHead.store(_Data.size());
+	header->m_nDurable.store(_Data.size() - _Pending);
+	return strFile;
+}
+
+static void testTail()
+{
+	std::string strPath;
+	std::string strTail;
+
+	// 未绕回
+	std::string strFile = makeCrashFile(64, "written|pending", 7);
+	LOG_CHECK(LogCrashTail(strFile.data(), strFile.size(), strPath, strTail));
+	LOG_CHECK_EQ(strPath, std::string("/tmp/Log.txt"));
+	LOG_CHECK_EQ(strTail, std::string("pending"));
+
+	// 未写入的部分跨过数据区末尾
+	strTail.clear();
+	strFile = makeCrashFile(16, "0123456789abcdefGHIJKL", 10);
+	LOG_CHECK(LogCrashTail(strFile.data(), strFile.size(), strPath, strTail));
+	LOG_CHECK_EQ(strTail, std::string("cdefGHIJKL"));
+
+	// 全部已写入
+	strTail.clear();
+	strFile = makeCrashFile(16, "0123456789", 0);
+	LOG_CHECK(LogCrashTail(strFile.data(), strFile.size(), strPath, strTail));
+	LOG_CHECK(strTail.empty());
+
+	// 最早的部分已被覆盖，从下一条以分隔行开头的日志开始
+	const std::string strBanner = "\n\n" + std::string(60, '*') + " INFO " + std::string(60, '*') + "\n";
+	const std::string strRecords = strBanner + "first record" + strBanner + "second record" + strBanner + "third record";
+	strTail.clear();
+	strFile = makeCrashFile(strRecords.size() - 10, strRecords, strRecords.size());
+	LOG_CHECK(LogCrashTail(strFile.data(), strFile.size(), strPath, strTail));
+	LOG_CHECK_EQ(strTail, strRecords.substr(strBanner.size() + 12 + 1));
+
+	// 不含分隔行时从第一个完整的行开始
+	strTail.clear();
+	strFile = makeCrashFile(16, "line 1\nline 2\nline 3\n", 21);
+	LOG_CHECK(LogCrashTail(strFile.data(), strFile.size(), strPath, strTail));
+	LOG_CHECK_EQ(strTail, std::string("line 2\nline 3\n"));
+
+	// 无效的文件
+	strTail.clear();
+	strFile = makeCrashFile(64, "written|pending", 7);
+	LOG_CHECK(!LogCrashTail(strFile.data(), LOG_CRASH_HEADER_SIZE - 1, strPath, strTail));
+	LOG_CHECK(!LogCrashTail(strFile.data(), LOG_CRASH_HEADER_SIZE + 32, strPath, strTail));
+	reinterpret_cast<LogCrashHeader*>(strFile.data())->m_nVersion = LOG_CRASH_VERSION + 1;
+	LOG_CHECK(!LogCrashTail(strFile.data(), strFile.size(), strPath, strTail));
+	strFile[0] = 'X';
+	LOG_CHECK(!LogCrashTail(strFile.data(), strFile.size(), strPath, strTail));
+	LOG_CHECK(strTail.empty());
+}
+
+#ifndef _WIN32
+constexpr int CRASH_RECORDS = 200;
+/* 以该值代替信号时子进程以无限递归耗尽栈 */
+constexpr int CRASH_STACK_OVERFLOW = 0;
+
+static volatile bool g_bRecurse = true;
+
+static int overflowStack(int _Depth)
+{
+	volatile char buffer[4096];
+	buffer[0] = static_cast<char>(_Depth);
+	if (!g_bRecurse)
+		return buffer[0];
+	return overflowStack(_Depth + 1) + buffer[0];
+}
+
+/* 子进程同步写日志，写缓冲区不写入文件，之后以_Signal或栈溢出结束 */
+static void crashChild(const std::filesystem::path& _Log, const std::filesystem::path& _Crash, int _Signal)
+{
+	LogFlushPolicy flushPolicy;
+	flushPolicy.m_nFlushIntervalMs = 0;
+	Log::setFlushPolicy(flushPolicy);
+	LogCrashPolicy crashPolicy;
+	crashPolicy.m_bEnable = true;
+	crashPolicy.m_wstrPath = _Crash.wstring();
+	crashPolicy.m_nSize = 64 * 1024;
+	Log::setCrashPolicy(crashPolicy);
+	Log::setPattern("%m");
+	LOG_INIT(LOG_LEVEL_INFO, LOG_TARGET_FILE, _Log.wstring(), LOG_MODE_SYNC);
+	for (int i = 0; i < CRASH_RECORDS; ++i)
+		LOG(LOG_LEVEL_INFO, "record %d", i);
+	if (_Signal == CRASH_STACK_OVERFLOW)
+		overflowStack(0);
+	else
+		raise(_Signal);
+	_exit(0);
+}
+
+static int runChild(const std::filesystem::path& _Log, const std::filesystem::path& _Crash, int _Signal)
+{
+	fflush(nullptr);
+	const pid_t pid = fork();
+	if (!pid)
+		crashChild(_Log, _Crash, _Signal);
+	int nStatus = 0;
+	waitpid(pid, &nStatus, 0);
+	return WIFSIGNALED(nStatus) ? WTERMSIG(nStatus) : -1;
+}
+
+static bool hasAllRecords(const std::filesystem::path& _Log)
+{
+	const std::vector<std::string> lines = logTestReadLines(_Log);
+	if (lines.size() != CRASH_RECORDS)
+		return false;
+	for (int i = 0; i < CRASH_RECORDS; ++i)
+	{
+		if (lines[i] != "record " + std::to_string(i))
+			return false;
+	}
+	return true;
+}
+
+/* 启用缓冲区，补写其中上次运行未写入的日志 */
+static void recoverFrom(const std::filesystem::path& _Crash)
+{
+	LogCrashPolicy policy;
+	policy.m_bEnable = true;
+	policy.m_wstrPath = _Crash.wstring();
+	policy.m_bHandleSignals = false;
+	Log::setCrashPolicy(policy);
+}
+
+/**
+ * @brief 子进程被SIGKILL杀死时写缓冲区中的日志丢失，下次启用缓冲区时补写；
+ * 收到SIGSEGV或栈溢出时信号处理函数写出未写入的日志，之后不再重复补写
+ *
+ * 子进程先于本进程初始化日志运行，本进程以Init启用缓冲区
+ */
+static void testChildren(const std::filesystem::path& _Dir)
+{
+	const std::filesystem::path killedLog = _Dir / "killed.txt";
+	const std::filesystem::path killedCrash = _Dir / "killed.crash";
+	const std::filesystem::path signalLog = _Dir / "signal.txt";
+	const std::filesystem::path signalCrash = _Dir / "signal.crash";
+	const std::filesystem::path overflowLog = _Dir / "overflow.txt";
+	const std::filesystem::path overflowCrash = _Dir / "overflow.crash";
+	LOG_CHECK_EQ(runChild(killedLog, killedCrash, SIGKILL), SIGKILL);
+	LOG_CHECK_EQ(runChild(signalLog, signalCrash, SIGSEGV), SIGSEGV);
+	LOG_CHECK_EQ(runChild(overflowLog, overflowCrash, CRASH_STACK_OVERFLOW), SIGSEGV);
+	LOG_CHECK(logTestReadLines(killedLog).empty());
+	LOG_CHECK(hasAllRecords(signalLog));
+	// 栈溢出时处理函数在备用栈上运行
+	LOG_CHECK(hasAllRecords(overflowLog));
+
+	recoverFrom(killedCrash);
+	LOG_INIT(LOG_LEVEL_INFO, LOG_TARGET_FILE, (_Dir / "parent.txt").wstring(), LOG_MODE_SYNC);
+	LOG_CHECK(hasAllRecords(killedLog));
+	recoverFrom(signalCrash);
+	LOG_CHECK(hasAllRecords(signalLog));
+}
+#endif // _WIN32
+
+int main()
+{
+	testTail();
+#ifndef _WIN32
+	const std::filesystem::path dir = logTestDir("crash");
+	testChildren(dir);
+	Log::setCrashPolicy(LogCrashPolicy {});
+#endif // _WIN32
+	return logTestResult();
+}
@@ -0,0 +1,113 @@
+/**
+ * @file test_net.cpp
+ * @author ldk
+ * @brief 网络输出：收集器不可用时移入溢出文件，以同一溢出文件重新创建目标后按顺序补发
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "log_sink.hpp"
+#include "log_test.hpp"
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <thread>
+
+/* 在本机任意端口监听，返回套接字与端口 */
+static int listenLocal(uint16_t& _Port)
+{
+	const int nSocket = socket(AF_INET, SOCK_STREAM, 0);
+	sockaddr_in addr {};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t nLength = sizeof addr;
+	if (bind(nSocket, reinterpret_cast<sockaddr*>(&addr), sizeof addr) != 0 || listen(nSocket, 4) != 0
+		|| getsockname(nSocket, reinterpret_cast<sockaddr*>(&addr), &nLength) != 0)
+	{
+		::close(nSocket);
+		return -1;
+	}
+	_Port = ntohs(addr.sin_port);
+	return nSocket;
+}
+
+static std::string record(int _Index)
+{
+	char szRecord[16];
+	snprintf(szRecord, sizeof szRecord, "n=%04d\n", _Index);
+	return szRecord;
+}
+
+static void testSpillReplay(const std::filesystem::path& _Dir)
+{
+	constexpr int SPILLED = 300;
+	constexpr int LIVE = 100;
+	LogNetworkPolicy policy;
+	policy.m_nBufferBytes = 1024;
+	policy.m_nBatchBytes = 256;
+	policy.m_nRetryMs = 1;
+	policy.m_nMaxRetryMs = 1;
+	policy.m_wstrSpillFile = (_Dir / "net.spill").wstring();
+
+	// 取得一个空闲端口后关闭，连接被拒绝
+	uint16_t nClosedPort = 0;
+	::close(listenLocal(nClosedPort));
+	{
+		LogNetworkSink sink("127.0.0.1", nClosedPort, policy);
+		for (int i = 0; i < SPILLED; ++i)
+			sink.write(LOG_LEVEL_INFO, record(i));
+		sink.flush();
+		LOG_CHECK(!sink.isConnected());
+		LOG_CHECK_EQ(sink.getSentCount(), 0ull);
+		LOG_CHECK(sink.getSpilledCount() > 0);
+		LOG_CHECK_EQ(sink.getDiscardedCount(), 0ull);
+	}
+	// 析构时剩余的日志也已移入溢出文件
+	LOG_CHECK(std::filesystem::file_size(_Dir / "net.spill") >= SPILLED * (4 + record(0).size()));
+
+	uint16_t nPort = 0;
+	const int nListen = listenLocal(nPort);
+	LOG_CHECK(nListen >= 0);
+	std::string strReceived;
+	std::thread receiver([nListen, &strReceived]
+	{
+		const int nSocket = accept(nListen, nullptr, nullptr);
+		char buffer[4096];
+		ssize_t n = 0;
+		while (nSocket >= 0 && (n = read(nSocket, buffer, sizeof buffer)) > 0)
+			strReceived.append(buffer, static_cast<size_t>(n));
+		if (nSocket >= 0)
+			::close(nSocket);
+	});
+	{
+		LogNetworkSink sink("127.0.0.1", nPort, policy);
+		for (int i = SPILLED; i < SPILLED + LIVE; ++i)
+			sink.write(LOG_LEVEL_INFO, record(i));
+		sink.flush();
+		LOG_CHECK(sink.isConnected());
+		LOG_CHECK_EQ(sink.getConnectCount(), 1ull);
+		LOG_CHECK_EQ(sink.getSentCount(), static_cast<uint64_t>(SPILLED + LIVE));
+	}
+	receiver.join();
+	::close(nListen);
+
+	std::string strExpected;
+	for (int i = 0; i < SPILLED + LIVE; ++i)
+		strExpected += record(i);
+	LOG_CHECK(strReceived == strExpected);
+	LOG_CHECK_EQ(std::filesystem::file_size(_Dir / "net.spill"), 0ull);
+}
+#endif // _WIN32
+
+int main()
+{
+#ifndef _WIN32
+	testSpillReplay(logTestDir("net"));
+#endif // _WIN32
+	return logTestResult();
+}
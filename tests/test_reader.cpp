@@ -0,0 +1,316 @@
+/**
+ * @file test_reader.cpp
+ * @author ldk
+ * @brief LogReader：查询条件、refresh、写了一半的日志、异步模式下的getLogFromFile、跨段并行建立索引与按输出模式解析
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "log.hpp"
+#include "log_reader.hpp"
+#include "log_test.hpp"
+#include <thread>
+
+constexpr LOGLEVEL READER_LEVELS[] { LOG_LEVEL_ERROR, LOG_LEVEL_WARNING, LOG_LEVEL_DEBUG, LOG_LEVEL_INFO };
+
+/* _Threads个线程各写_Records条日志，第i条的等级为READER_LEVELS[i % 4] */
+static void writeRecords(int _Threads, int _Records, const std::string& _Padding)
+{
+	std::vector<std::thread> threads;
+	for (int t = 0; t < _Threads; ++t)
+	{
+		threads.emplace_back([t, _Records, &_Padding]
+		{
+			for (int i = 0; i < _Records; ++i)
+				LOG(READER_LEVELS[i % 4], "t=%d i=%d %s", t, i, _Padding.c_str());
+		});
+	}
+	for (std::thread& thread : threads)
+		thread.join();
+	Log::Flush();
+}
+
+static std::vector<LogEntry> collect(LogReader& _Reader, const LogQuery& _Query = LogQuery {})
+{
+	std::vector<LogEntry> entries;
+	for (const LogEntry& entry : _Reader.query(_Query))
+		entries.push_back(entry);
+	return entries;
+}
+
+/* 正文中的线程与序号 */
+static bool parseMessage(const LogEntry& _Entry, int& _Thread, int& _Index)
+{
+	return sscanf(std::string(_Entry.m_strMessage).c_str(), "t=%d i=%d", &_Thread, &_Index) == 2;
+}
+
+/* 各线程的日志齐全且按写入顺序出现 */
+static bool isComplete(const std::vector<LogEntry>& _Entries, int _Threads, int _Records)
+{
+	std::vector<int> next(_Threads, 0);
+	for (const LogEntry& entry : _Entries)
+	{
+		int nThread = 0;
+		int nIndex = 0;
+		if (!parseMessage(entry, nThread, nIndex) || nThread < 0 || nThread >= _Threads || nIndex != next[nThread]
+			|| entry.m_Level != READER_LEVELS[nIndex % 4])
+			return false;
+		++next[nThread];
+	}
+	for (int nCount : next)
+	{
+		if (nCount != _Records)
+			return false;
+	}
+	return true;
+}
+
+/* 等级、正文、正则、线程号与时间条件与逐条筛选的结果一致 */
+static void testQuery(const std::filesystem::path& _Dir)
+{
+	constexpr int THREADS = 2;
+	constexpr int RECORDS = 2000;
+	const std::filesystem::path path = _Dir / "query.txt";
+	LOG_INIT(LOG_LEVEL_INFO, LOG_TARGET_FILE, path.wstring(), LOG_MODE_SYNC);
+	writeRecords(THREADS, RECORDS, "query");
+
+	LogReader reader(path.wstring());
+	LOG_CHECK(reader.isOpen());
+	const std::vector<LogEntry> all = collect(reader);
+	LOG_CHECK_EQ(all.size(), static_cast<size_t>(THREADS * RECORDS));
+	LOG_CHECK(isComplete(all, THREADS, RECORDS));
+	LOG_CHECK(!reader.index().empty());
+
+	LogQuery query;
+	query.m_Level = LOG_LEVEL_WARNING;
+	LOG_CHECK_EQ(collect(reader, query).size(), static_cast<size_t>(THREADS * RECORDS / 2));
+	query.m_Level = LOG_LEVEL_ERROR;
+	LOG_CHECK_EQ(collect(reader, query).size(), static_cast<size_t>(THREADS * RECORDS / 4));
+
+	query = LogQuery {};
+	query.m_strText = "t=1 i=1999 ";
+	std::vector<LogEntry> entries = collect(reader, query);
+	LOG_CHECK_EQ(entries.size(), static_cast<size_t>(1));
+	query = LogQuery {};
+	query.m_strRegex = "^t=0 i=1[0-9]{3} ";
+	LOG_CHECK_EQ(collect(reader, query).size(), static_cast<size_t>(1000));
+	LOG_CHECK_EQ(reader.search(query, 4).size(), static_cast<size_t>(1000));
+
+	query = LogQuery {};
+	query.m_nThreadId = all.front().m_nThreadId;
+	size_t nThreadCount = 0;
+	for (const LogEntry& entry : all)
+		nThreadCount += entry.m_nThreadId == query.m_nThreadId;
+	LOG_CHECK_EQ(collect(reader, query).size(), nThreadCount);
+
+	query = LogQuery {};
+	query.m_nBeginTime = all[all.size() / 2].m_nTime;
+	query.m_nEndTime = all.back().m_nTime;
+	size_t nTimeCount = 0;
+	for (const LogEntry& entry : all)
+		nTimeCount += entry.m_nTime >= query.m_nBeginTime && entry.m_nTime < query.m_nEndTime;
+	LOG_CHECK_EQ(collect(reader, query).size(), nTimeCount);
+	LOG_CHECK_EQ(reader.search(query, 4).size(), nTimeCount);
+}
+
+/* refresh后只为新增内容建立索引；最后一条写了一半的日志在写完之前不出现 */
+static void testRefresh(const std::filesystem::path& _Dir)
+{
+	const std::filesystem::path path = _Dir / "refresh.txt";
+	LOG_INIT(LOG_LEVEL_INFO, LOG_TARGET_FILE, path.wstring(), LOG_MODE_SYNC);
+	writeRecords(1, 100, "refresh");
+
+	LogReader reader(path.wstring());
+	std::vector<LogEntry> entries = collect(reader);
+	LOG_CHECK_EQ(entries.size(), static_cast<size_t>(100));
+	const std::string strRecord(entries.front().m_strText);
+
+	writeRecords(1, 100, "refresh");
+	LOG_CHECK(reader.refresh());
+	LOG_CHECK_EQ(collect(reader).size(), static_cast<size_t>(200));
+
+	// 另一个进程正在写入的日志
+	Log::Shutdown();
+	{
+		std::ofstream output(path, std::ios::binary | std::ios::app);
+		output << strRecord.substr(0, strRecord.size() - 10);
+	}
+	LOG_CHECK(reader.refresh());
+	LOG_CHECK_EQ(collect(reader).size(), static_cast<size_t>(200));
+	{
+		std::ofstream output(path, std::ios::binary | std::ios::app);
+		output << strRecord.substr(strRecord.size() - 10);
+	}
+	LOG_CHECK(reader.refresh());
+	entries = collect(reader);
+	LOG_CHECK_EQ(entries.size(), static_cast<size_t>(201));
+	if (!entries.empty())
+		LOG_CHECK(entries.back().m_strText == strRecord);
+}
+
+/* 异步模式下写入后立即读取，各线程队列中的日志同样读出 */
+static void testGetLogFromFile(const std::filesystem::path& _Dir)
+{
+	constexpr int THREADS = 2;
+	constexpr int RECORDS = 500;
+	const std::filesystem::path path = _Dir / "async.txt";
+	LOG_INIT(LOG_LEVEL_INFO, LOG_TARGET_FILE, path.wstring(), LOG_MODE_ASYNC);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < THREADS; ++t)
+	{
+		threads.emplace_back([t]
+		{
+			for (int i = 0; i < RECORDS; ++i)
+				LOG(LOG_LEVEL_INFO, "t=%d i=%d", t, i);
+		});
+	}
+	for (std::thread& thread : threads)
+		thread.join();
+
+	std::vector<std::wstring> logs;
+	LOG_CHECK(Log::getLogFromFile(logs));
+	LOG_CHECK_EQ(logs.size(), static_cast<size_t>(THREADS * RECORDS));
+	LogQuery query;
+	query.m_strText = "t=1 i=" + std::to_string(RECORDS - 1);
+	logs.clear();
+	LOG_CHECK(Log::getLogFromFile(logs, query));
+	LOG_CHECK_EQ(logs.size(), static_cast<size_t>(1));
+	Log::Shutdown();
+}
+
+/* 超过3个LOG_READER_PARALLEL_BYTES的文件，分段并行与单线程建立的索引读出的结果相同，段边界处的日志不重复不遗漏 */
+static void testParallel(const std::filesystem::path& _Dir)
+{
+	constexpr int THREADS = 4;
+	constexpr int RECORDS = 25000;
+	const std::filesystem::path path = _Dir / "parallel.txt";
+	LOG_INIT(LOG_LEVEL_INFO, LOG_TARGET_FILE, path.wstring(), LOG_MODE_SYNC);
+	writeRecords(THREADS, RECORDS, std::string(160, 'x'));
+	LOG_CHECK(std::filesystem::file_size(path) > 3 * LOG_READER_PARALLEL_BYTES);
+
+	LogReader single(path.wstring());
+	single.setThreads(1);
+	LogReader parallel(path.wstring());
+	parallel.setThreads(4);
+	const std::vector<LogEntry> expected = collect(single);
+	const std::vector<LogEntry> actual = collect(parallel);
+	LOG_CHECK_EQ(actual.size(), static_cast<size_t>(THREADS * RECORDS));
+	LOG_CHECK(isComplete(actual, THREADS, RECORDS));
+	LOG_CHECK_EQ(actual.size(), expected.size());
+	bool bSame = actual.size() == expected.size();
+	for (size_t i = 0; bSame && i < actual.size(); ++i)
+		bSame = actual[i].m_nOffset == expected[i].m_nOffset && actual[i].m_strText == expected[i].m_strText;
+	LOG_CHECK(bSame);
+
+	uint64_t nRecords = 0;
+	for (const LogIndexBlock& block : parallel.index())
+		nRecords += block.m_nRecords;
+	LOG_CHECK_EQ(nRecords, static_cast<uint64_t>(THREADS * RECORDS));
+
+	LogQuery query;
+	query.m_Level = LOG_LEVEL_ERROR;
+	LOG_CHECK_EQ(parallel.search(query, 4).size(), static_cast<size_t>(THREADS * RECORDS / 4));
+}
+
+/* 输出模式与其中可读出的字段 */
+struct ReaderPattern
+{
+	const char* m_szPattern;
+	bool        m_bLevel;       // 含等级
+	bool        m_bMultiLine;   // 多行正文读出为一条日志
+	bool        m_bSite;        // 含文件名与行号
+};
+
+/* 各输出模式写入的日志由LogReader与getLogFromFile按同一模式读出，多行正文为一条日志 */
+static void testPatterns(const std::filesystem::path& _Dir)
+{
+	constexpr int RECORDS = 40;
+	constexpr ReaderPattern PATTERNS[]
+	{
+		{ LOG_DEFAULT_PATTERN,         true,  true,  true  },
+		{ "%t %l [%T] %f:%n %m",       true,  true,  true  },
+		{ "%B%l %t %m%B",              true,  true,  false },
+		{ "%B%t %m",                   false, true,  false },
+		{ "%t %m [%T]",                false, true,  false },
+		{ "%8l|%8T|%m|",               true,  true,  false },
+		{ "%m",                        false, false, false },
+	};
+	for (size_t p = 0; p < std::size(PATTERNS); ++p)
+	{
+		const ReaderPattern& pattern = PATTERNS[p];
+		const std::filesystem::path path = _Dir / ("pattern" + std::to_string(p) + ".txt");
+		Log::setPattern(pattern.m_szPattern);
+		LOG_INIT(LOG_LEVEL_INFO, LOG_TARGET_FILE, path.wstring(), LOG_MODE_SYNC);
+		for (int i = 0; i < RECORDS; ++i)
+			LOG(READER_LEVELS[i % 4], "t=0 i=%d", i);
+		LOG(LOG_LEVEL_INFO, "first\nsecond");
+		Log::Flush();
+		const size_t nExpected = RECORDS + (pattern.m_bMultiLine ? 1 : 2);
+
+		LogReader reader;
+		LOG_CHECK(reader.setPattern(pattern.m_szPattern));
+		LOG_CHECK(reader.open(path.wstring()));
+		const std::vector<LogEntry> entries = collect(reader);
+		LOG_CHECK_EQ(entries.size(), nExpected);
+		bool bFields = entries.size() == nExpected;
+		for (int i = 0; bFields && i < RECORDS; ++i)
+		{
+			const LogEntry& entry = entries[i];
+			bFields = entry.m_strMessage == "t=0 i=" + std::to_string(i)
+				&& (!pattern.m_bLevel || entry.m_Level == READER_LEVELS[i % 4])
+				&& (!pattern.m_bSite || (entry.m_nLine > 0 && entry.m_strFile.find("test_reader") != std::string_view::npos));
+		}
+		LOG_CHECK(bFields);
+		if (pattern.m_bMultiLine && bFields)
+		{
+			LOG_CHECK(entries.back().m_strMessage == "first\nsecond");
+			LogQuery query;
+			query.m_strText = "second";
+			const std::vector<LogEntry> found = collect(reader, query);
+			LOG_CHECK_EQ(found.size(), static_cast<size_t>(1));
+			if (!found.empty())
+				LOG_CHECK(found.front().m_strMessage == "first\nsecond");
+		}
+		if (pattern.m_bLevel)
+		{
+			LogQuery query;
+			query.m_Level = LOG_LEVEL_ERROR;
+			LOG_CHECK_EQ(collect(reader, query).size(), static_cast<size_t>(RECORDS / 4));
+		}
+
+		std::vector<std::wstring> logs;
+		LOG_CHECK(Log::getLogFromFile(logs));
+		LOG_CHECK_EQ(logs.size(), nExpected);
+		Log::Shutdown();
+	}
+
+	// 无法据此划分日志的模式
+	LogReader reader;
+	LOG_CHECK(!reader.setPattern("%t %m%B"));
+	LOG_CHECK(!reader.setPattern("%t %f%m"));
+	LOG_CHECK(!reader.setPattern("%t %m%T"));
+	Log::setPattern("%t %m%B");
+	LOG_INIT(LOG_LEVEL_INFO, LOG_TARGET_FILE, (_Dir / "unsupported.txt").wstring(), LOG_MODE_SYNC);
+	LOG(LOG_LEVEL_INFO, "unsupported");
+	std::vector<std::wstring> logs;
+	LOG_CHECK(!Log::getLogFromFile(logs));
+	Log::Shutdown();
+	Log::setPattern(LOG_DEFAULT_PATTERN);
+}
+
+int main()
+{
+	const std::filesystem::path dir = logTestDir("reader");
+	Log::setEncoding(LOG_ENCODING_UTF8);
+	testQuery(dir);
+	testRefresh(dir);
+	testGetLogFromFile(dir);
+	testParallel(dir);
+	testPatterns(dir);
+	Log::Shutdown();
+	std::filesystem::remove(dir / "parallel.txt");
+	return logTestResult();
+}
@@ -0,0 +1,208 @@
+/**
+ * @file test_ring.cpp
+ * @author ldk
+ * @brief 异步模式的线程队列：不丢失、按时间合并与队列满时的丢弃策略
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "log.hpp"
+#include "log_test.hpp"
+#include <atomic>
+#include <thread>
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif // _WIN32
+
+/* 输出模式为"t=线程 i=序号"，解析文件中的每一行 */
+struct RingLine
+{
+	int m_nThread;
+	int m_nIndex;
+};
+
+static std::vector<RingLine> readRingLines(const std::filesystem::path& _Path)
+{
+	std::vector<RingLine> result;
+	for (const std::string& strLine : logTestReadLines(_Path))
+	{
+		RingLine line {};
+		if (sscanf(strLine.c_str(), "t=%d i=%d", &line.m_nThread, &line.m_nIndex) == 2)
+			result.push_back(line);
+	}
+	return result;
+}
+
+/* 每个线程的日志按写入顺序出现，序号严格递增 */
+static bool isPerThreadOrdered(const std::vector<RingLine>& _Lines, int _Threads)
+{
+	std::vector<int> last(_Threads, -1);
+	for (const RingLine& line : _Lines)
+	{
+		if (line.m_nThread < 0 || line.m_nThread >= _Threads || line.m_nIndex <= last[line.m_nThread])
+			return false;
+		last[line.m_nThread] = line.m_nIndex;
+	}
+	return true;
+}
+
+static void runProducers(int _Threads, int _Records)
+{
+	std::vector<std::thread> threads;
+	for (int t = 0; t < _Threads; ++t)
+	{
+		threads.emplace_back([t, _Records]
+		{
+			for (int i = 0; i < _Records; ++i)
+				LOG(LOG_LEVEL_INFO, "t=%d i=%d", t, i);
+		});
+	}
+	for (std::thread& thread : threads)
+		thread.join();
+}
+
+/* 队列满时等待，所有日志都输出且各线程内有序 */
+static void testBlock(const std::filesystem::path& _Dir, LOGMODE _Mode)
+{
+	constexpr int THREADS = 4;
+	constexpr int RECORDS = 20000;
+	const std::filesystem::path path = _Dir / ("block_" + std::to_string(_Mode) + ".txt");
+	Log::setOverflowPolicy(LOG_OVERFLOW_BLOCK);
+	Log::setQueueCapacity(64);
+	LOG_INIT(LOG_LEVEL_INFO, LOG_TARGET_FILE, path.wstring(), _Mode);
+	const uint64_t nDropped = Log::getDroppedCount();
+	runProducers(THREADS, RECORDS);
+	Log::Flush();
+
+	const std::vector<RingLine> lines = readRingLines(path);
+	LOG_CHECK_EQ(lines.size(), static_cast<size_t>(THREADS * RECORDS));
+	LOG_CHECK(isPerThreadOrdered(lines, THREADS));
+	LOG_CHECK_EQ(Log::getDroppedCount(), nDropped);
+}
+
+/* 两个线程轮流写入，合并后的顺序与写入顺序完全一致 */
+static void testMerge(const std::filesystem::path& _Dir)
+{
+	constexpr int RECORDS = 2000;
+	const std::filesystem::path path = _Dir / "merge.txt";
+	Log::setOverflowPolicy(LOG_OVERFLOW_BLOCK);
+	LOG_INIT(LOG_LEVEL_INFO, LOG_TARGET_FILE, path.wstring(), LOG_MODE_ASYNC);
+	std::atomic<int> nTurn { 0 };
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 2; ++t)
+	{
+		threads.emplace_back([t, &nTurn]
+		{
+			for (int i = 0; i < RECORDS; ++i)
+			{
+				while (nTurn.load(std::memory_order_acquire) != i * 2 + t)
+					std::this_thread::yield();
+				LOG(LOG_LEVEL_INFO, "t=%d i=%d", t, i);
+				nTurn.fetch_add(1, std::memory_order_release);
+			}
+		});
+	}
+	for (std::thread& thread : threads)
+		thread.join();
+	Log::Flush();
+
+	const std::vector<RingLine> lines = readRingLines(path);
+	LOG_CHECK_EQ(lines.size(), static_cast<size_t>(2 * RECORDS));
+	bool bInterleaved = lines.size() == 2 * RECORDS;
+	for (size_t i = 0; bInterleaved && i < lines.size(); ++i)
+		bInterleaved = lines[i].m_nThread == static_cast<int>(i % 2) && lines[i].m_nIndex == static_cast<int>(i / 2);
+	LOG_CHECK(bInterleaved);
+}
+
+#ifndef _WIN32
+/**
+ * @brief 标准输出换成已写满的管道使后台线程阻塞在命令行输出上，队列必然写满
+ *
+ * 丢弃的与输出的日志数之和等于写入数，留下的日志在各线程内有序；
+ * 丢弃最新时每个线程的第一条一定保留，丢弃最旧时最后一条一定保留
+ */
+static void testOverflow(const std::filesystem::path& _Dir, LOGOVERFLOW _Policy)
+{
+	constexpr int THREADS = 2;
+	constexpr int RECORDS = 5000;
+	const std::filesystem::path path = _Dir / ("overflow_" + std::to_string(_Policy) + ".txt");
+	Log::Shutdown();
+	Log::setOverflowPolicy(_Policy);
+	Log::setQueueCapacity(16);
+
+	int pipeFds[2];
+	LOG_CHECK(pipe(pipeFds) == 0);
+	fflush(stdout);
+	const int nStdout = dup(1);
+	dup2(pipeFds[1], 1);
+	fcntl(pipeFds[1], F_SETFL, O_NONBLOCK);
+	const std::string strFill(4096, 'x');
+	while (write(pipeFds[1], strFill.data(), strFill.size()) > 0)
+		;
+	fcntl(pipeFds[1], F_SETFL, 0);
+
+	LOG_INIT(LOG_LEVEL_INFO, LOG_TARGET_CONSOLE_AND_FILE, path.wstring(), LOG_MODE_ASYNC);
+	const uint64_t nDroppedBefore = Log::getDroppedCount();
+	const LogStats statsBefore = Log::getStats();
+	runProducers(THREADS, RECORDS);
+
+	// 读空管道，后台线程继续输出，全部输出后恢复标准输出
+	close(pipeFds[1]);
+	std::thread drain([fd = pipeFds[0]]
+	{
+		char buffer[65536];
+		while (read(fd, buffer, sizeof buffer) > 0)
+			;
+	});
+	Log::Flush();
+	Log::Shutdown();
+	dup2(nStdout, 1);
+	close(nStdout);
+	drain.join();
+	close(pipeFds[0]);
+
+	const std::vector<RingLine> lines = readRingLines(path);
+	const uint64_t nDropped = Log::getDroppedCount() - nDroppedBefore;
+	const LogStats statsAfter = Log::getStats();
+	LOG_CHECK(nDropped > 0);
+	LOG_CHECK_EQ(lines.size() + nDropped, static_cast<uint64_t>(THREADS * RECORDS));
+	LOG_CHECK_EQ(statsAfter.m_nDropped[LOG_LEVEL_INFO] - statsBefore.m_nDropped[LOG_LEVEL_INFO], nDropped);
+	LOG_CHECK(isPerThreadOrdered(lines, THREADS));
+	for (int t = 0; t < THREADS; ++t)
+	{
+		bool bFirst = false;
+		bool bLast = false;
+		for (const RingLine& line : lines)
+		{
+			bFirst |= line.m_nThread == t && line.m_nIndex == 0;
+			bLast |= line.m_nThread == t && line.m_nIndex == RECORDS - 1;
+		}
+		if (_Policy == LOG_OVERFLOW_DROP_NEWEST)
+			LOG_CHECK(bFirst);
+		else
+			LOG_CHECK(bLast);
+	}
+	Log::setQueueCapacity(8192);
+}
+#endif // _WIN32
+
+int main()
+{
+	const std::filesystem::path dir = logTestDir("ring");
+	Log::setEncoding(LOG_ENCODING_UTF8);
+	Log::setPattern("%m");
+	testBlock(dir, LOG_MODE_ASYNC);
+	testBlock(dir, LOG_MODE_DEFERRED);
+	testMerge(dir);
+#ifndef _WIN32
+	testOverflow(dir, LOG_OVERFLOW_DROP_NEWEST);
+	testOverflow(dir, LOG_OVERFLOW_DROP_OLDEST);
+#endif // _WIN32
+	Log::Shutdown();
+	return logTestResult();
+}
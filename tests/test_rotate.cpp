@@ -0,0 +1,223 @@
+/**
+ * @file test_rotate.cpp
+ * @author ldk
+ * @brief 按大小滚动的改名链与保留数量，滚动后压缩与流式压缩的文件可由LogReader读取
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "log.hpp"
+#include "log_reader.hpp"
+#include "log_test.hpp"
+#include <chrono>
+#include <thread>
+#ifdef __linux__
+#include <sys/stat.h>
+#endif // __linux__
+
+constexpr size_t ROTATE_MAX_SIZE = 4096;
+
+/* 第_Generation代历史文件，0为当前文件 */
+static std::filesystem::path generationOf(const std::filesystem::path& _Dir, int _Generation, const char* _Suffix = "")
+{
+	if (!_Generation)
+		return _Dir / "Log.txt";
+	return _Dir / ("Log." + std::to_string(_Generation) + ".txt" + _Suffix);
+}
+
+static void writeRecords(int _Count)
+{
+	for (int i = 0; i < _Count; ++i)
+		LOG(LOG_LEVEL_INFO, "r=%06d", i);
+	Log::Flush();
+}
+
+/* 解析"r=序号"，依次追加到_Numbers */
+static void appendNumbers(const std::vector<std::string>& _Lines, std::vector<int>& _Numbers)
+{
+	for (const std::string& strLine : _Lines)
+	{
+		int nNumber = 0;
+		if (sscanf(strLine.c_str(), "r=%d", &nNumber) == 1)
+			_Numbers.push_back(nNumber);
+	}
+}
+
+/* 序号连续且以_Last结尾 */
+static bool isConsecutive(const std::vector<int>& _Numbers, int _Last)
+{
+	for (size_t i = 1; i < _Numbers.size(); ++i)
+	{
+		if (_Numbers[i] != _Numbers[i - 1] + 1)
+			return false;
+	}
+	return !_Numbers.empty() && _Numbers.back() == _Last;
+}
+
+/* 只保留最近的3个历史文件，各历史文件在达到上限的那条日志后切换，从旧到新拼接后序号连续 */
+static void testChain(const std::filesystem::path& _Dir)
+{
+	constexpr int RECORDS = 2000;
+	LogRotatePolicy rotate;
+	rotate.m_nMaxFileSize = ROTATE_MAX_SIZE;
+	rotate.m_nMaxFiles = 3;
+	Log::setRotatePolicy(rotate);
+	const uint64_t nRotations = Log::getStats().m_nRotations;
+	LOG_INIT(LOG_LEVEL_INFO, LOG_TARGET_FILE, generationOf(_Dir, 0).wstring(), LOG_MODE_SYNC);
+	writeRecords(RECORDS);
+
+	// 每条日志"r=000000\n"为9字节
+	LOG_CHECK_EQ(Log::getStats().m_nRotations - nRotations, static_cast<uint64_t>(RECORDS * 9 / ROTATE_MAX_SIZE));
+	LOG_CHECK(!std::filesystem::exists(generationOf(_Dir, 4)));
+	std::vector<int> numbers;
+	for (int i = 3; i >= 0; --i)
+	{
+		const std::filesystem::path path = generationOf(_Dir, i);
+		LOG_CHECK(std::filesystem::exists(path));
+		if (i)
+		{
+			const uintmax_t nSize = std::filesystem::file_size(path);
+			LOG_CHECK(nSize >= ROTATE_MAX_SIZE && nSize < ROTATE_MAX_SIZE + 9);
+		}
+		appendNumbers(logTestReadLines(path), numbers);
+	}
+	LOG_CHECK(isConsecutive(numbers, RECORDS - 1));
+	Log::setRotatePolicy(LogRotatePolicy {});
+}
+
+/**
+ * @brief 写缓冲区不小于文件上限的一半时，第一次写入文件即是滚动前的那次，
+ * 滚动前同样提前创建并预分配下一个文件；Log::Flush后文件已写过一半时也会提前创建
+ */
+static void testPrepareNext(const std::filesystem::path& _Dir)
+{
+	constexpr size_t MAX_SIZE = 64 * 1024;
+	LogRotatePolicy rotate;
+	rotate.m_nMaxFileSize = MAX_SIZE;
+	rotate.m_nMaxFiles = 3;
+	Log::setRotatePolicy(rotate);
+	Log::setFlushPolicy(LogFlushPolicy {});
+	LOG_INIT(LOG_LEVEL_INFO, LOG_TARGET_FILE, generationOf(_Dir, 0).wstring(), LOG_MODE_SYNC);
+	const std::filesystem::path next = _Dir / "Log.next.txt";
+
+	// 9字节一条，超过上限后滚动，滚动前写入文件时创建的下一个文件已改名为当前文件
+	const uint64_t nRotations = Log::getStats().m_nRotations;
+	for (size_t i = 0; i < MAX_SIZE / 9 + 1; ++i)
+		LOG(LOG_LEVEL_INFO, "r=%06d", static_cast<int>(i));
+	LOG_CHECK_EQ(Log::getStats().m_nRotations - nRotations, 1ull);
+	LOG_CHECK(std::filesystem::exists(generationOf(_Dir, 1)));
+	LOG_CHECK(!std::filesystem::exists(next));
+#ifdef __linux__
+	struct stat st {};
+	LOG_CHECK(stat(generationOf(_Dir, 0).c_str(), &st) == 0);
+	LOG_CHECK(static_cast<size_t>(st.st_blocks) * 512 >= MAX_SIZE);
+#endif // __linux__
+
+	// 写过一半后显式写入文件
+	for (size_t i = 0; i < MAX_SIZE / 9 / 2 + 1; ++i)
+		LOG(LOG_LEVEL_INFO, "r=%06d", static_cast<int>(i));
+	LOG_CHECK(!std::filesystem::exists(next));
+	Log::Flush();
+	LOG_CHECK(std::filesystem::exists(next));
+	Log::setRotatePolicy(LogRotatePolicy {});
+}
+
+#ifdef LOG_WITH_ZLIB
+/* 按在文件中的顺序读出正文 */
+static std::vector<std::string> readMessages(const std::filesystem::path& _Path)
+{
+	std::vector<std::string> messages;
+	LogReader reader;
+	LOG_CHECK(reader.open(_Path.wstring()));
+	for (const LogEntry& entry : reader.query())
+		messages.emplace_back(entry.m_strMessage);
+	return messages;
+}
+
+/* 历史文件在后台压缩为.gz并删除原文件，滚动时压缩文件一并改名 */
+static void testRotatedGzip(const std::filesystem::path& _Dir)
+{
+	constexpr int RECORDS = 300;
+	LogRotatePolicy rotate;
+	rotate.m_nMaxFileSize = ROTATE_MAX_SIZE * 4;
+	rotate.m_nMaxFiles = 10;
+	LogCompressPolicy compress;
+	compress.m_Rotated = LOG_COMPRESSION_GZIP;
+	Log::setRotatePolicy(rotate);
+	Log::setCompressPolicy(compress);
+	Log::setPattern(LOG_DEFAULT_PATTERN);
+	LOG_INIT(LOG_LEVEL_INFO, LOG_TARGET_FILE, generationOf(_Dir, 0).wstring(), LOG_MODE_SYNC);
+	writeRecords(RECORDS);
+
+	// 等待后台压缩完成
+	int nGenerations = 0;
+	while (std::filesystem::exists(generationOf(_Dir, nGenerations + 1)) || std::filesystem::exists(generationOf(_Dir, nGenerations + 1, ".gz")))
+		++nGenerations;
+	LOG_CHECK(nGenerations >= 2);
+	const auto tDeadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+	bool bCompressed = false;
+	while (!bCompressed && std::chrono::steady_clock::now() < tDeadline)
+	{
+		bCompressed = true;
+		for (int i = 1; i <= nGenerations; ++i)
+			bCompressed = bCompressed && !std::filesystem::exists(generationOf(_Dir, i)) && std::filesystem::exists(generationOf(_Dir, i, ".gz"));
+		if (!bCompressed)
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	LOG_CHECK(bCompressed);
+
+	std::vector<int> numbers;
+	for (int i = nGenerations; i >= 1; --i)
+	{
+		const std::filesystem::path path = generationOf(_Dir, i, ".gz");
+		const std::string strHead = logTestReadFile(path).substr(0, 2);
+		LOG_CHECK_EQ(strHead, std::string("\x1f\x8b"));
+		appendNumbers(readMessages(path), numbers);
+	}
+	appendNumbers(readMessages(generationOf(_Dir, 0)), numbers);
+	LOG_CHECK_EQ(numbers.front(), 0);
+	LOG_CHECK(isConsecutive(numbers, RECORDS - 1));
+	Log::setRotatePolicy(LogRotatePolicy {});
+	Log::setCompressPolicy(LogCompressPolicy {});
+}
+
+/* 当前文件以流式压缩写入，每次写入文件结束一个gzip成员，拼接的成员可整体读取 */
+static void testLiveGzip(const std::filesystem::path& _Dir)
+{
+	constexpr int RECORDS = 1000;
+	LogCompressPolicy compress;
+	compress.m_Live = LOG_COMPRESSION_GZIP;
+	Log::setCompressPolicy(compress);
+	Log::setPattern(LOG_DEFAULT_PATTERN);
+	LOG_INIT(LOG_LEVEL_INFO, LOG_TARGET_FILE, generationOf(_Dir, 0).wstring(), LOG_MODE_SYNC);
+	writeRecords(RECORDS / 2);
+	for (int i = RECORDS / 2; i < RECORDS; ++i)
+		LOG(LOG_LEVEL_INFO, "r=%06d", i);
+	Log::Flush();
+
+	const std::string strHead = logTestReadFile(generationOf(_Dir, 0)).substr(0, 2);
+	LOG_CHECK_EQ(strHead, std::string("\x1f\x8b"));
+	std::vector<int> numbers;
+	appendNumbers(readMessages(generationOf(_Dir, 0)), numbers);
+	LOG_CHECK_EQ(numbers.size(), static_cast<size_t>(RECORDS));
+	LOG_CHECK(isConsecutive(numbers, RECORDS - 1));
+	Log::setCompressPolicy(LogCompressPolicy {});
+}
+#endif // LOG_WITH_ZLIB
+
+int main()
+{
+	Log::setEncoding(LOG_ENCODING_UTF8);
+	Log::setPattern("%m");
+	testChain(logTestDir("rotate_chain"));
+	testPrepareNext(logTestDir("rotate_next"));
+#ifdef LOG_WITH_ZLIB
+	testRotatedGzip(logTestDir("rotate_gzip"));
+	testLiveGzip(logTestDir("rotate_live"));
+#endif // LOG_WITH_ZLIB
+	Log::Shutdown();
+	return logTestResult();
+}
@@ -0,0 +1,171 @@
+/**
+ * @file test_snapshot.cpp
+ * @author ldk
+ * @brief LogSnapshot：嵌套读取沿用外层快照，反复替换时旧快照在不再使用后释放，线程退出时仍可读取，替换配置与模式时日志不丢失
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "log.hpp"
+#include "log_snapshot.hpp"
+#include "log_test.hpp"
+#include <thread>
+
+constexpr uint64_t SNAPSHOT_MAGIC = 0x5a5a5a5a5a5a5a5aull;
+
+/* 统计存活的实例，析构后清除标记 */
+struct Probe
+{
+	static inline std::atomic<int> m_nLive { 0 };
+
+	uint64_t m_nMagic { SNAPSHOT_MAGIC };
+	int      m_nValue { 0 };
+
+	Probe() { ++m_nLive; }
+	explicit Probe(int _Value) : m_nValue(_Value) { ++m_nLive; }
+	Probe(const Probe& _Other) : m_nMagic(_Other.m_nMagic), m_nValue(_Other.m_nValue) { ++m_nLive; }
+	~Probe()
+	{
+		m_nMagic = 0;
+		--m_nLive;
+	}
+};
+
+/* 外层读取期间替换，嵌套读取仍得到外层的快照，外层结束后读取到新快照 */
+static void testNested()
+{
+	LogSnapshot<Probe>::Reader outer;
+	const uint64_t nGeneration = outer.generation();
+	LogSnapshot<Probe>::publish(Probe(1));
+	{
+		LogSnapshot<Probe>::Reader inner;
+		LOG_CHECK_EQ(inner.generation(), nGeneration);
+		LOG_CHECK_EQ(&*inner, &*outer);
+	}
+	LOG_CHECK_EQ(outer->m_nMagic, SNAPSHOT_MAGIC);
+	LOG_CHECK_EQ(LogSnapshot<Probe>::retiredCount(), static_cast<size_t>(1));
+}
+
+/* 读取的线程各最多保留一份旧快照，线程退出后只剩本线程缓存的一份 */
+static void testReclaim()
+{
+	constexpr int THREADS = 4;
+	constexpr int PUBLISHES = 20000;
+	{
+		LogSnapshot<Probe>::Reader reader;
+		LOG_CHECK_EQ(reader->m_nValue, 1);
+	}
+	std::atomic<bool> bStop { false };
+	std::atomic<int> nBroken { 0 };
+	std::vector<std::thread> threads;
+	for (int t = 0; t < THREADS; ++t)
+	{
+		threads.emplace_back([&bStop, &nBroken]
+		{
+			int nLast = 0;
+			while (!bStop.load(std::memory_order_relaxed))
+			{
+				LogSnapshot<Probe>::Reader reader;
+				if (reader->m_nMagic != SNAPSHOT_MAGIC || reader->m_nValue < nLast)
+					++nBroken;
+				nLast = reader->m_nValue;
+			}
+		});
+	}
+	int nMaxLive = 0;
+	for (int i = 2; i < PUBLISHES; ++i)
+	{
+		LogSnapshot<Probe>::publish(Probe(i));
+		nMaxLive = std::max(nMaxLive, Probe::m_nLive.load());
+	}
+	bStop = true;
+	for (std::thread& thread : threads)
+		thread.join();
+
+	LOG_CHECK_EQ(nBroken.load(), 0);
+	LOG_CHECK(nMaxLive <= THREADS + 2);
+	LogSnapshot<Probe>::publish(Probe(PUBLISHES));
+	LOG_CHECK(LogSnapshot<Probe>::retiredCount() <= 1);
+	LOG_CHECK_EQ(Probe::m_nLive.load(), static_cast<int>(LogSnapshot<Probe>::retiredCount()) + 1);
+}
+
+/* 线程退出时其他线程局部对象的析构函数中仍可读取，读取结束后归还登记槽 */
+static void testExitRead()
+{
+	static std::atomic<int> nExitValue { 0 };
+	struct ExitReader
+	{
+		~ExitReader()
+		{
+			LogSnapshot<Probe>::Reader reader;
+			nExitValue = reader->m_nMagic == SNAPSHOT_MAGIC ? reader->m_nValue : -1;
+		}
+	};
+	const int nValue = LogSnapshot<Probe>::Reader()->m_nValue;
+	std::thread([]
+	{
+		// 先于本线程的快照缓存构造，在其之后析构
+		thread_local ExitReader exitReader;
+		(void)exitReader;
+		LogSnapshot<Probe>::Reader reader;
+	}).join();
+
+	LOG_CHECK_EQ(nExitValue.load(), nValue);
+	LogSnapshot<Probe>::publish(Probe(nValue + 1));
+	LOG_CHECK(LogSnapshot<Probe>::retiredCount() <= 1);
+}
+
+/* 异步写日志期间反复替换配置与模式，日志齐全，每条日志的开头与结尾出自同一模式，旧快照不累积 */
+static void testLogReplace(const std::filesystem::path& _Dir)
+{
+	constexpr int THREADS = 2;
+	constexpr int RECORDS = 20000;
+	const std::filesystem::path path = _Dir / "replace.txt";
+	Log::setPattern("A %m A");
+	LOG_INIT(LOG_LEVEL_INFO, LOG_TARGET_FILE, path.wstring(), LOG_MODE_ASYNC);
+	std::atomic<int> nDone { 0 };
+	std::vector<std::thread> threads;
+	for (int t = 0; t < THREADS; ++t)
+	{
+		threads.emplace_back([t, &nDone]
+		{
+			for (int i = 0; i < RECORDS; ++i)
+				LOG(LOG_LEVEL_INFO, "t=%d i=%d", t, i);
+			++nDone;
+		});
+	}
+	for (int i = 0; nDone.load() < THREADS; ++i)
+	{
+		Log::setPattern(i % 2 ? "A %m A" : "B %m B");
+		Log::setLogTarget(LOG_TARGET_FILE);
+	}
+	for (std::thread& thread : threads)
+		thread.join();
+	Log::Flush();
+
+	size_t nRecords = 0;
+	size_t nMixed = 0;
+	for (const std::string& strLine : logTestReadLines(path))
+	{
+		nRecords += strLine.find("t=") != std::string::npos;
+		nMixed += strLine.empty() || strLine.front() != strLine.back();
+	}
+	LOG_CHECK_EQ(nRecords, static_cast<size_t>(THREADS * RECORDS));
+	LOG_CHECK_EQ(nMixed, static_cast<size_t>(0));
+	// 只有后台写线程与本线程可能保留旧快照
+	LOG_CHECK(LogSnapshot<LogConfig>::retiredCount() <= Log::getWriterCount() + 1);
+	Log::Shutdown();
+}
+
+int main()
+{
+	Log::setEncoding(LOG_ENCODING_UTF8);
+	testNested();
+	testReclaim();
+	testExitRead();
+	testLogReplace(logTestDir("snapshot"));
+	return logTestResult();
+}